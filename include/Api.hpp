@@ -95,6 +95,25 @@ class Api
      */
     void cancelOrder(const enums::ExchangeName& exchange_name, const std::string& symbol, const std::string& orderId);
 
+    /**
+     * @brief Submit several orders in one driver call
+     * @param exchange_name Exchange name
+     * @param specs Orders to submit
+     * @return Created orders in the order of the specs if successful, nullopt otherwise
+     */
+    std::optional< std::vector< std::shared_ptr< db::Order > > > submitOrders(
+        const enums::ExchangeName& exchange_name, const std::vector< exchange::OrderSpec >& specs);
+
+    /**
+     * @brief Cancel several orders of a symbol in one driver call
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param order_ids Order IDs to cancel
+     */
+    void cancelOrders(const enums::ExchangeName& exchange_name,
+                      const std::string& symbol,
+                      const std::vector< std::string >& order_ids);
+
    private:
     Api();
     ~Api()                     = default;
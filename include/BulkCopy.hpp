@@ -0,0 +1,317 @@
+#ifndef CT_BULK_COPY_HPP
+#define CT_BULK_COPY_HPP
+
+#include "DB.hpp"
+#include "Helper.hpp"
+
+namespace ct
+{
+namespace db
+{
+
+/**
+ * @brief What happens to copied rows that collide with the unique index of the target table
+ */
+enum class CopyConflict
+{
+    // Copy straight into the table, a duplicate aborts the whole copy
+    FAIL,
+    // Merge through a staging table and keep the stored rows
+    IGNORE,
+    // Merge through a staging table and overwrite the stored rows
+    UPDATE,
+};
+
+enum class CopyTable
+{
+    CANDLES,
+    TRADES,
+    TICKERS,
+    ORDERBOOKS,
+};
+
+/**
+ * @brief Encoder of the PostgreSQL binary COPY format
+ *
+ * The header is written on construction. Tuples are appended to an in-memory buffer which the caller sends to
+ * the server and clears whenever it grows large enough, so the memory used does not depend on the row count.
+ */
+class BinaryCopyWriter
+{
+   public:
+    BinaryCopyWriter();
+
+    void beginRow(int16_t fields);
+
+    void writeNull();
+    void writeInt32(int32_t value);
+    void writeInt64(int64_t value);
+    void writeDouble(double value);
+    void writeText(const std::string& value);
+    void writeBytes(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Write a UUID as its 36 character text form
+     */
+    void writeUuid(const boost::uuids::uuid& id);
+
+    /**
+     * @brief Append the trailer, nothing may be written afterwards
+     */
+    void finish();
+
+    const char* data() const { return buffer_.data(); }
+    size_t size() const { return buffer_.size(); }
+
+    /**
+     * @brief Drop the buffered bytes once they were sent
+     */
+    void clear() { buffer_.clear(); }
+
+    size_t countRows() const { return rows_; }
+
+   private:
+    template < typename T >
+    void writeBigEndian(T value);
+
+    std::vector< char > buffer_;
+    size_t rows_ = 0;
+};
+
+/**
+ * @brief Writes the next row into the writer
+ *
+ * @return bool False once there are no rows left, nothing may be written in that call
+ */
+using CopyRowSource = std::function< bool(BinaryCopyWriter& writer) >;
+
+/**
+ * @brief Bulk load rows with binary COPY FROM STDIN
+ *
+ * Runs on the libpq handle of the sqlpp11 connection. Every row must write all the columns of the table in the
+ * order of its migration, starting with the id. Unless on_conflict is FAIL the rows go into a temporary staging
+ * table first and are merged into the target with INSERT ... SELECT ... ON CONFLICT. Duplicates within the copied
+ * rows are collapsed to one of them.
+ *
+ * @param conn_ptr Connection to use, the pool is used if null
+ * @param table Target table
+ * @param next_row Row source
+ * @param on_conflict Conflict handling
+ * @return size_t Number of rows inserted or updated in the target table
+ * @throws std::runtime_error If the server rejects the copy or the merge
+ */
+size_t copyRows(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                CopyTable table,
+                const CopyRowSource& next_row,
+                CopyConflict on_conflict = CopyConflict::IGNORE);
+
+namespace detail
+{
+
+// Candle rows are indexed like the candle matrices: timestamp, open, close, high, low, volume
+template < typename Row >
+void writeCandleRow(BinaryCopyWriter& writer,
+                    const Row& row,
+                    const std::string& exchange_name,
+                    const std::string& symbol,
+                    const std::string& timeframe)
+{
+    writer.beginRow(10);
+    writer.writeUuid(helper::generateFastUUID());
+    writer.writeInt64(static_cast< int64_t >(row[0]));
+    writer.writeDouble(row[1]);
+    writer.writeDouble(row[2]);
+    writer.writeDouble(row[3]);
+    writer.writeDouble(row[4]);
+    writer.writeDouble(row[5]);
+    writer.writeText(exchange_name);
+    writer.writeText(symbol);
+    writer.writeText(timeframe);
+}
+
+// Trade rows: timestamp, price, buy_qty, sell_qty, buy_count, sell_count
+template < typename Row >
+void writeTradeRow(BinaryCopyWriter& writer,
+                   const Row& row,
+                   const std::string& exchange_name,
+                   const std::string& symbol)
+{
+    writer.beginRow(9);
+    writer.writeUuid(helper::generateFastUUID());
+    writer.writeInt64(static_cast< int64_t >(row[0]));
+    writer.writeDouble(row[1]);
+    writer.writeDouble(row[2]);
+    writer.writeDouble(row[3]);
+    writer.writeInt32(static_cast< int32_t >(row[4]));
+    writer.writeInt32(static_cast< int32_t >(row[5]));
+    writer.writeText(symbol);
+    writer.writeText(exchange_name);
+}
+
+// Ticker rows: timestamp, last_price, volume, high_price, low_price
+template < typename Row >
+void writeTickerRow(BinaryCopyWriter& writer,
+                    const Row& row,
+                    const std::string& exchange_name,
+                    const std::string& symbol)
+{
+    writer.beginRow(8);
+    writer.writeUuid(helper::generateFastUUID());
+    writer.writeInt64(static_cast< int64_t >(row[0]));
+    writer.writeDouble(row[1]);
+    writer.writeDouble(row[2]);
+    writer.writeDouble(row[3]);
+    writer.writeDouble(row[4]);
+    writer.writeText(symbol);
+    writer.writeText(exchange_name);
+}
+
+template < typename Iterator, typename WriteRow >
+size_t copyRange(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                 CopyTable table,
+                 Iterator first,
+                 Iterator last,
+                 WriteRow write_row,
+                 CopyConflict on_conflict)
+{
+    return copyRows(
+        conn_ptr,
+        table,
+        [&](BinaryCopyWriter& writer)
+        {
+            if (first == last)
+            {
+                return false;
+            }
+            write_row(writer, *first);
+            ++first;
+            return true;
+        },
+        on_conflict);
+}
+
+} // namespace detail
+
+/**
+ * @brief Bulk load candles from a matrix in the layout of saveCandles
+ */
+size_t copyCandles(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                   const enums::ExchangeName& exchange_name,
+                   const std::string& symbol,
+                   const timeframe::Timeframe& timeframe,
+                   const blaze::DynamicMatrix< double >& candles,
+                   CopyConflict on_conflict = CopyConflict::IGNORE);
+
+/**
+ * @brief Bulk load candles from a range of rows indexable like the candle matrices, e.g. std::array< double, 6 >
+ */
+template < typename Iterator >
+size_t copyCandles(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                   const enums::ExchangeName& exchange_name,
+                   const std::string& symbol,
+                   const timeframe::Timeframe& timeframe,
+                   Iterator first,
+                   Iterator last,
+                   CopyConflict on_conflict = CopyConflict::IGNORE)
+{
+    const std::string exchange = enums::toString(exchange_name);
+    const std::string tf       = timeframe::toString(timeframe);
+    return detail::copyRange(
+        conn_ptr,
+        CopyTable::CANDLES,
+        first,
+        last,
+        [&](BinaryCopyWriter& writer, const auto& row) { detail::writeCandleRow(writer, row, exchange, symbol, tf); },
+        on_conflict);
+}
+
+/**
+ * @brief Bulk load trades from a matrix with the columns timestamp, price, buy_qty, sell_qty, buy_count, sell_count
+ */
+size_t copyTrades(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                  const enums::ExchangeName& exchange_name,
+                  const std::string& symbol,
+                  const blaze::DynamicMatrix< double >& trades,
+                  CopyConflict on_conflict = CopyConflict::IGNORE);
+
+template < typename Iterator >
+size_t copyTrades(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                  const enums::ExchangeName& exchange_name,
+                  const std::string& symbol,
+                  Iterator first,
+                  Iterator last,
+                  CopyConflict on_conflict = CopyConflict::IGNORE)
+{
+    const std::string exchange = enums::toString(exchange_name);
+    return detail::copyRange(
+        conn_ptr,
+        CopyTable::TRADES,
+        first,
+        last,
+        [&](BinaryCopyWriter& writer, const auto& row) { detail::writeTradeRow(writer, row, exchange, symbol); },
+        on_conflict);
+}
+
+/**
+ * @brief Bulk load tickers from a matrix with the columns timestamp, last_price, volume, high_price, low_price
+ */
+size_t copyTickers(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                   const enums::ExchangeName& exchange_name,
+                   const std::string& symbol,
+                   const blaze::DynamicMatrix< double >& tickers,
+                   CopyConflict on_conflict = CopyConflict::IGNORE);
+
+template < typename Iterator >
+size_t copyTickers(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                   const enums::ExchangeName& exchange_name,
+                   const std::string& symbol,
+                   Iterator first,
+                   Iterator last,
+                   CopyConflict on_conflict = CopyConflict::IGNORE)
+{
+    const std::string exchange = enums::toString(exchange_name);
+    return detail::copyRange(
+        conn_ptr,
+        CopyTable::TICKERS,
+        first,
+        last,
+        [&](BinaryCopyWriter& writer, const auto& row) { detail::writeTickerRow(writer, row, exchange, symbol); },
+        on_conflict);
+}
+
+/**
+ * @brief Bulk load order book snapshots
+ *
+ * @param first Start of a range of pairs of a timestamp and a contiguous byte container, e.g.
+ * std::pair< int64_t, std::vector< uint8_t > >
+ */
+template < typename Iterator >
+size_t copyOrderbooks(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                      const enums::ExchangeName& exchange_name,
+                      const std::string& symbol,
+                      Iterator first,
+                      Iterator last,
+                      CopyConflict on_conflict = CopyConflict::IGNORE)
+{
+    const std::string exchange = enums::toString(exchange_name);
+    return detail::copyRange(
+        conn_ptr,
+        CopyTable::ORDERBOOKS,
+        first,
+        last,
+        [&](BinaryCopyWriter& writer, const auto& snapshot)
+        {
+            writer.beginRow(5);
+            writer.writeUuid(helper::generateFastUUID());
+            writer.writeInt64(static_cast< int64_t >(snapshot.first));
+            writer.writeText(symbol);
+            writer.writeText(exchange);
+            writer.writeBytes(reinterpret_cast< const uint8_t* >(snapshot.second.data()), snapshot.second.size());
+        },
+        on_conflict);
+}
+
+} // namespace db
+} // namespace ct
+
+#endif // CT_BULK_COPY_HPP
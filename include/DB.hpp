@@ -61,14 +61,63 @@ class DatabaseShutdownManager
     std::future< void > shutdownFuture_;
 };
 
-// Thread-safe connection pool for PostgreSQL
+/**
+ * @brief Connection pool counters
+ *
+ * The wait histogram counts the time spent in getConnection in power of two buckets, bucket i holds the waits
+ * below 2^(i + 1) nanoseconds.
+ */
+struct ConnectionPoolStats
+{
+    static constexpr size_t WAIT_BUCKETS = 64;
+
+    size_t active_                 = 0;
+    size_t idle_                   = 0;
+    size_t open_                   = 0;
+    size_t max_                    = 0;
+    uint64_t checkouts_            = 0;
+    uint64_t waits_                = 0;
+    uint64_t timeouts_             = 0;
+    uint64_t created_              = 0;
+    uint64_t closed_               = 0;
+    uint64_t health_checks_        = 0;
+    uint64_t failed_health_checks_ = 0;
+    double wait_p50_us_            = 0.0;
+    double wait_p99_us_            = 0.0;
+    double wait_max_us_            = 0.0;
+    std::array< uint64_t, WAIT_BUCKETS > wait_buckets_{};
+};
+
+/**
+ * @brief Thread-safe connection pool for PostgreSQL
+ *
+ * Connections live in a fixed array of slots whose state is switched with a CAS, so checking a connection out and
+ * returning it takes no lock. A thread first tries the slot it used last: its connection still holds the
+ * statements that thread prepared. The mutex is only taken to wait for a connection once the pool is at its
+ * maximum and to wake the maintenance thread.
+ *
+ * The maintenance thread opens connections up to the pool size in the background, pings connections that were idle
+ * for a health check interval and closes idle connections beyond the maximum. Returning a connection only checks
+ * its libpq status, a broken connection or one left inside a transaction is closed and replaced in the background.
+ */
 class ConnectionPool
 {
    public:
+    // Largest number of connections the pool can hold
+    static constexpr size_t MAX_SLOTS = 256;
+
     // Get singleton instance
     static ConnectionPool& getInstance();
 
-    // Initialize the connection pool
+    /**
+     * @brief Initialize the connection pool
+     *
+     * The first connection is opened on the calling thread so bad parameters surface here, the others are opened
+     * by the maintenance thread.
+     *
+     * @param poolSize Number of connections kept open
+     * @throws std::runtime_error If the first connection cannot be opened
+     */
     void init(const std::string& host,
               const std::string& dbname,
               const std::string& username,
@@ -79,44 +128,122 @@ class ConnectionPool
     // Get a connection from the pool (or create one if pool is empty)
     std::shared_ptr< sqlpp::postgresql::connection > getConnection();
 
-    // Get a connection from the pool with health check
-    std::shared_ptr< sqlpp::postgresql::connection > getConnectionWithHealthCheck();
+    /**
+     * @brief Same as getConnection, health checks run on the maintenance thread
+     *
+     * @deprecated Use getConnection
+     */
+    [[deprecated("Use getConnection")]] std::shared_ptr< sqlpp::postgresql::connection >
+    getConnectionWithHealthCheck();
 
-    // Set maximum number of connections
+    /**
+     * @brief Set maximum number of connections, idle connections beyond it are closed in the background
+     *
+     * @throws std::invalid_argument If maxConnections is 0 or above MAX_SLOTS
+     */
     void setMaxConnections(size_t maxConnections);
 
+    /**
+     * @brief Set how long a connection may stay idle before the maintenance thread pings it
+     */
+    void setHealthCheckInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Wait until every checked out connection is returned, the maintenance thread is stopped first
+     */
     void waitForConnectionsToClose();
 
+    ConnectionPoolStats getStats() const;
+
     // Delete copy constructor and assignment operator
     ConnectionPool(const ConnectionPool&)            = delete;
     ConnectionPool& operator=(const ConnectionPool&) = delete;
 
    private:
+    enum SlotState : uint8_t
+    {
+        EMPTY,
+        IDLE,
+        BUSY,
+        // Owned by the thread opening, pinging or closing its connection
+        RESERVED,
+    };
+
+    // Slots are cache line aligned so threads checking out neighbouring connections do not false share
+    struct alignas(64) Slot
+    {
+        std::atomic< uint8_t > state_{EMPTY};
+        std::unique_ptr< sqlpp::postgresql::connection > conn_;
+        // Steady clock nanoseconds of the last return or health check
+        std::atomic< int64_t > idle_since_{0};
+    };
+
     // Private constructor for singleton
     ConnectionPool();
+    ~ConnectionPool();
+
+    // Take an idle connection, starting with the slot this thread used last
+    bool tryCheckout(size_t& index);
+
+    // Open a connection into an empty slot left in the given state, false if limit connections are open
+    bool openConnection(size_t limit, SlotState state, size_t& index);
+
+    // Wait for a returned connection
+    void waitForCheckout(size_t& index);
+
+    std::shared_ptr< sqlpp::postgresql::connection > handOut(size_t index);
 
     // Return a connection to the pool
-    void returnConnection(sqlpp::postgresql::connection* conn);
+    void returnConnection(size_t index);
 
     // Create a new database connection
-    void createNewConnection();
-
-    // Connection pool members
-    std::mutex mutex_;
+    std::unique_ptr< sqlpp::postgresql::connection > createNewConnection();
+
+    // Close the connection of a slot owned by the caller and free the slot
+    void closeSlot(Slot& slot);
+
+    void recordWait(uint64_t wait_ns);
+    void notifyAvailable();
+    void wakeMaintenance();
+    void stopMaintenance();
+    void runMaintenance();
+    void checkIdleConnections();
+    void warmUp();
+    void trimIdleConnections();
+
+    std::array< Slot, MAX_SLOTS > slots_;
+    // Slots below this index have been used, checkout does not look further
+    std::atomic< size_t > usedSlots_{0};
+
+    std::atomic< size_t > openConnections_{0};
+    std::atomic< size_t > activeConnections_{0};
+    std::atomic< size_t > maxConnections_{20};
+    std::atomic< size_t > poolSize_{0};
+    std::atomic< int64_t > healthCheckIntervalMs_{30000};
+    std::atomic< bool > initialized_{false};
+
+    std::atomic< uint64_t > checkouts_{0};
+    std::atomic< uint64_t > waits_{0};
+    std::atomic< uint64_t > timeouts_{0};
+    std::atomic< uint64_t > created_{0};
+    std::atomic< uint64_t > closed_{0};
+    std::atomic< uint64_t > healthChecks_{0};
+    std::atomic< uint64_t > failedHealthChecks_{0};
+    std::atomic< uint64_t > waitMaxNs_{0};
+    std::array< std::atomic< uint64_t >, ConnectionPoolStats::WAIT_BUCKETS > waitBuckets_{};
+
+    // Guards the connection parameters and the waits below, never held while a connection is in use
+    mutable std::mutex mutex_;
     std::condition_variable connectionAvailable_;
     std::condition_variable connectionReturned_;
-    std::queue< std::unique_ptr< sqlpp::postgresql::connection > > availableConnections_;
-    std::vector< std::unique_ptr< sqlpp::postgresql::connection > > managedConnections_;
-    size_t activeConnections_;
-    size_t maxConnections_;
-    bool initialized_;
+    std::condition_variable maintenanceWake_;
+    std::atomic< size_t > waiters_{0};
+    bool maintenanceRequested_ = false;
+    bool stopping_             = false;
+    std::thread maintenance_;
 
     // Connection parameters
-    std::string host_;
-    std::string dbname_;
-    std::string username_;
-    std::string password_;
-    unsigned int port_;
+    std::shared_ptr< sqlpp::postgresql::connection_config > config_;
 };
 
 // For backward compatibility, keep a simpler interface
@@ -208,6 +335,180 @@ class ConnectionStateGuard
     bool needs_reset_;
 };
 
+/**
+ * @brief Server-side prepared statement executed through libpq under its own name
+ */
+struct NamedStatement
+{
+    std::string name_;
+    std::string sql_;
+    int params_ = 0;
+};
+
+/**
+ * @brief Build an INSERT ... ON CONFLICT (key) DO UPDATE statement taking every column as a parameter
+ *
+ * Every column except id is overwritten on conflict, the stored id is kept like the update of save does.
+ *
+ * @param table Table name
+ * @param columns Columns in parameter order, starting with id
+ * @param key Columns of a unique index of the table
+ */
+NamedStatement makeUpsertStatement(const std::string& table,
+                                   const std::vector< std::string >& columns,
+                                   const std::vector< std::string >& key);
+
+/**
+ * @brief Parameter values of a NamedStatement, sent in text format except for byte arrays
+ */
+class StatementParams
+{
+   public:
+    void addNull();
+    void add(int32_t value);
+    void add(int64_t value);
+    void add(double value);
+    void add(const std::string& value);
+    void add(const std::vector< uint8_t >& value);
+
+    int count() const { return static_cast< int >(values_.size()); }
+
+    /**
+     * @brief Arrays in the layout of PQexecPrepared, valid until the next add
+     */
+    std::vector< const char* > getValues() const;
+    std::vector< int > getLengths() const;
+    const std::vector< int >& getFormats() const { return formats_; }
+
+   private:
+    std::vector< std::optional< std::string > > values_;
+    std::vector< int > formats_;
+};
+
+/**
+ * @brief Statements prepared on each connection, kept while the connection is pooled
+ *
+ * Prepared statements live as long as the session, so a statement is prepared the first time it runs on a
+ * connection and reused by later checkouts. Two kinds are cached:
+ * - NamedStatement, prepared through libpq under a fixed name, on any connection.
+ * - sqlpp11 prepared statements keyed by model and statement shape, only on connections tracked by ConnectionPool
+ *   since they must be destroyed before their connection.
+ *
+ * DEALLOCATE ALL drops everything, whoever runs it must invalidate the connection here first.
+ */
+class PreparedStatementCache
+{
+   public:
+    static PreparedStatementCache& getInstance();
+
+    /**
+     * @brief Prepare the statement unless it already is on this connection
+     *
+     * @throws std::runtime_error If the server rejects the statement
+     */
+    void prepare(sqlpp::postgresql::connection& conn, const NamedStatement& statement);
+
+    bool isPrepared(sqlpp::postgresql::connection& conn, const std::string& name);
+
+    /**
+     * @brief Get the sqlpp11 prepared statement of a shape, preparing it on a miss
+     *
+     * @param key Model and statement shape, e.g. "Candle:findById"
+     * @param prepare Prepares the statement on conn
+     * @return Shared with the cache on pooled connections, only held by the caller on others
+     */
+    template < typename Prepare >
+    auto getPrepared(sqlpp::postgresql::connection& conn, const std::string& key, Prepare&& prepare)
+        -> std::shared_ptr< std::decay_t< decltype(prepare()) > >;
+
+    /**
+     * @brief Cache sqlpp11 prepared statements on a connection until untrack
+     */
+    void track(sqlpp::postgresql::connection& conn);
+
+    /**
+     * @brief Release everything cached for a connection that is about to close
+     */
+    void untrack(sqlpp::postgresql::connection& conn);
+
+    /**
+     * @brief Release everything cached for a connection, must run before DEALLOCATE ALL
+     *
+     * The sqlpp11 statements deallocate themselves when released, which is why this has to come first.
+     */
+    void invalidate(sqlpp::postgresql::connection& conn);
+
+    uint64_t countHits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t countMisses() const { return misses_.load(std::memory_order_relaxed); }
+
+    PreparedStatementCache(const PreparedStatementCache&)            = delete;
+    PreparedStatementCache& operator=(const PreparedStatementCache&) = delete;
+
+   private:
+    PreparedStatementCache()  = default;
+    ~PreparedStatementCache() = default;
+
+    struct Entry
+    {
+        bool tracked_ = false;
+        std::set< std::string > names_;
+        std::map< std::string, std::shared_ptr< void > > statements_;
+    };
+
+    std::mutex mutex_;
+    std::map< const sqlpp::postgresql::connection*, Entry > entries_;
+
+    std::atomic< uint64_t > hits_{0};
+    std::atomic< uint64_t > misses_{0};
+};
+
+template < typename Prepare >
+auto PreparedStatementCache::getPrepared(sqlpp::postgresql::connection& conn,
+                                         const std::string& key,
+                                         Prepare&& prepare) -> std::shared_ptr< std::decay_t< decltype(prepare()) > >
+{
+    using Prepared = std::decay_t< decltype(prepare()) >;
+
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+
+        auto it = entries_.find(&conn);
+        if (it != entries_.end() && it->second.tracked_)
+        {
+            auto found = it->second.statements_.find(key);
+            if (found != it->second.statements_.end())
+            {
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return std::static_pointer_cast< Prepared >(found->second);
+            }
+        }
+    }
+
+    // Only the thread holding the connection prepares on it, so nobody caches the same key meanwhile
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    auto prepared = std::make_shared< Prepared >(prepare());
+
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    auto it = entries_.find(&conn);
+    if (it != entries_.end() && it->second.tracked_)
+    {
+        it->second.statements_[key] = prepared;
+    }
+
+    return prepared;
+}
+
+/**
+ * @brief Execute a named statement, preparing it on the connection first if needed
+ *
+ * @return size_t Number of affected rows
+ * @throws std::runtime_error If preparing or executing fails
+ */
+size_t executePrepared(sqlpp::postgresql::connection& conn,
+                       const NamedStatement& statement,
+                       const StatementParams& params);
+
 // Generic findById implementation
 template < typename ModelType >
 std::optional< ModelType > findById(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
@@ -218,6 +519,25 @@ template < typename ModelType, typename FilterType >
 std::optional< std::vector< ModelType > > findByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
                                                        const FilterType& filter);
 
+/**
+ * @brief Stream the rows matching a filter in chunks instead of materialising them all
+ *
+ * The query of findByFilter runs through a server-side cursor and every FETCH fills one chunk. A cursor lives in a
+ * transaction: an open transaction of the connection is used, otherwise one is opened around the cursor.
+ *
+ * @param conn_ptr Connection to use, the pool is used if null
+ * @param filter Filter as for findByFilter
+ * @param on_chunk Receives every chunk and may move the models out of it, returning false stops the stream
+ * @param chunk_size Rows fetched per round trip
+ * @return size_t Number of rows handed to on_chunk
+ * @throws std::invalid_argument If chunk_size is 0
+ */
+template < typename ModelType, typename FilterType >
+size_t streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                      const FilterType& filter,
+                      const std::function< bool(std::vector< ModelType >& chunk) >& on_chunk,
+                      size_t chunk_size = 10000);
+
 // Generic save implementation
 template < typename ModelType >
 void save(ModelType& model, std::shared_ptr< sqlpp::postgresql::connection > conn_ptr, const bool update_on_conflict);
@@ -553,6 +873,21 @@ struct OrdersTable
     };
 };
 
+class Order;
+
+/**
+ * @brief Receives the id, exchange id, price and status changes of the orders it is attached to
+ *
+ * Notifications arrive on the thread mutating the order, implementations guard their own state.
+ */
+class OrderListener
+{
+   public:
+    virtual ~OrderListener() = default;
+
+    virtual void onOrderChanged(const Order& order) = 0;
+};
+
 // TODO: Read logic, fix TODOs.
 class Order
 {
@@ -581,18 +916,26 @@ class Order
           nlohmann::json vars,
           std::optional< enums::OrderSubmittedVia > submitted_via);
 
-    // Rule of five
-    Order(const Order&)                = default;
-    Order(Order&&) noexcept            = default;
-    Order& operator=(const Order&)     = default;
-    Order& operator=(Order&&) noexcept = default;
-    ~Order()                           = default;
+    // Rule of five, copies start without a listener and assigning into an order notifies its listener
+    Order(const Order&)     = default;
+    Order(Order&&) noexcept = default;
+    Order& operator=(const Order& other);
+    Order& operator=(Order&& other);
+    ~Order() = default;
 
     // Getters and setters
     const boost::uuids::uuid& getId() const { return id_; }
-    void setId(const boost::uuids::uuid& id) { id_ = id; }
+    void setId(const boost::uuids::uuid& id)
+    {
+        id_ = id;
+        notifyChanged();
+    }
     std::string getIdAsString() const { return boost::uuids::to_string(id_); }
-    void setId(const std::string& id_str) { id_ = boost::uuids::string_generator()(id_str); }
+    void setId(const std::string& id_str)
+    {
+        id_ = boost::uuids::string_generator()(id_str);
+        notifyChanged();
+    }
 
     const std::optional< boost::uuids::uuid >& getTradeId() const { return trade_id_; }
     void setTradeId(const boost::uuids::uuid& id) { trade_id_ = id; }
@@ -613,8 +956,16 @@ class Order
     void setSessionId(const std::string& id_str) { session_id_ = boost::uuids::string_generator()(id_str); }
 
     const std::optional< std::string >& getExchangeId() const { return exchange_id_; }
-    void setExchangeId(const std::string& id) { exchange_id_ = id; }
-    void clearExchangeId() { exchange_id_.reset(); }
+    void setExchangeId(const std::string& id)
+    {
+        exchange_id_ = id;
+        notifyChanged();
+    }
+    void clearExchangeId()
+    {
+        exchange_id_.reset();
+        notifyChanged();
+    }
 
     const std::string& getSymbol() const { return symbol_; }
     void setSymbol(const std::string& symbol) { symbol_ = symbol; }
@@ -638,11 +989,23 @@ class Order
     void setFilledQty(double filled_qty) { filled_qty_ = filled_qty; }
 
     const std::optional< double >& getPrice() const { return price_; }
-    void setPrice(double price) { price_ = price; }
-    void clearPrice() { price_.reset(); }
+    void setPrice(double price)
+    {
+        price_ = price;
+        notifyChanged();
+    }
+    void clearPrice()
+    {
+        price_.reset();
+        notifyChanged();
+    }
 
     enums::OrderStatus getStatus() const { return status_; }
-    void setStatus(enums::OrderStatus status) { status_ = status; }
+    void setStatus(enums::OrderStatus status)
+    {
+        status_ = status;
+        notifyChanged();
+    }
 
     int64_t getCreatedAt() const { return created_at_; }
     void setCreatedAt(int64_t created_at) { created_at_ = created_at; }
@@ -692,12 +1055,37 @@ class Order
 
     void resubmit();
 
+    /**
+     * @brief Let the exchange of the order reserve balance or margin for it
+     *
+     * Queuing and resubmitting submit the order as well. Done at most once per order object, copies start
+     * unsubmitted. Only submitted orders are released by cancel and execute, so the exchange never gives back
+     * what it did not hold. Without a registered exchange nothing is reserved.
+     *
+     * @throws exception::InsufficientBalance, exception::InsufficientMargin If the exchange rejects the order, it
+     * stays unsubmitted then
+     */
+    void submitToExchange();
+
+    bool isSubmittedToExchange() const { return exchange_link_.submitted_; }
+
     void cancel(bool silent = false, const std::string& source = "");
 
     void execute(bool silent = false);
 
     void executePartially(bool silent = false);
 
+    /**
+     * @brief Apply a fill of part of the order to its exchange and position
+     *
+     * The order is partially filled until the fills add up to its qty, and executed then.
+     *
+     * @param qty Filled quantity, the sign is taken from the order side
+     * @param price Fill price
+     * @param silent Skip the log and notification of the status change
+     */
+    void fill(double qty, double price, bool silent = false);
+
     // Notification methods
     void notifySubmission() const;
 
@@ -844,7 +1232,51 @@ class Order
     // Return a dictionary representation of the order
     nlohmann::json toJson() const;
 
+    /**
+     * @brief Attach the listener notified after the id, exchange id, price or status of this order changed
+     *
+     * @param listener Listener to attach, nullptr to detach the current one
+     */
+    void setChangeListener(OrderListener* listener) { listener_link_.listener_.store(listener); }
+    OrderListener* getChangeListener() const { return listener_link_.listener_.load(); }
+
    private:
+    template < typename Other >
+    void assignFields(Other&& other);
+
+    // Status change, log and save of an execution, the exchange and position are left to the caller
+    void markExecuted(bool silent);
+
+    void notifyChanged() const
+    {
+        if (auto* listener = listener_link_.listener_.load(std::memory_order_acquire))
+        {
+            listener->onOrderChanged(*this);
+        }
+    }
+
+    // Only the order a listener attached itself to reports to it, copies start detached
+    struct ListenerLink
+    {
+        std::atomic< OrderListener* > listener_{nullptr};
+
+        ListenerLink() = default;
+        ListenerLink(const ListenerLink&) noexcept {}
+        ListenerLink& operator=(const ListenerLink&) noexcept { return *this; }
+    };
+    ListenerLink listener_link_;
+
+    // Whether the exchange holds balance or margin for this very object, copies hold nothing
+    struct ExchangeLink
+    {
+        bool submitted_ = false;
+
+        ExchangeLink() = default;
+        ExchangeLink(const ExchangeLink&) noexcept {}
+        ExchangeLink& operator=(const ExchangeLink&) noexcept { return *this; }
+    };
+    ExchangeLink exchange_link_;
+
     boost::uuids::uuid id_;
     std::optional< boost::uuids::uuid > trade_id_;
     boost::uuids::uuid session_id_;
@@ -1157,6 +1589,11 @@ class Candle
 
     auto prepareUpdateStatement(const CandlesTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -1356,6 +1793,47 @@ extern void saveCandles(std::shared_ptr< sqlpp::postgresql::connection > conn_pt
                         const timeframe::Timeframe& timeframe,
                         const blaze::DynamicMatrix< double >& candles);
 
+/**
+ * @brief Read the candles of a range into a matrix in the layout of saveCandles, ordered by timestamp
+ *
+ * Rows are fetched from a server-side cursor in chunks and parsed straight into the matrix, no Candle is built.
+ * The matrix only grows if the range holds more candles than it has rows, so sizing it for the range up front
+ * keeps the read to that one allocation.
+ *
+ * @param start_timestamp First timestamp, inclusive
+ * @param finish_timestamp Last timestamp, inclusive
+ * @param candles Destination with at least 6 columns, filled from its first row
+ * @param chunk_size Rows fetched per round trip
+ * @return size_t Number of rows written, the rows after them are left as they were
+ * @throws std::invalid_argument If candles has fewer than 6 columns or chunk_size is 0
+ */
+size_t loadCandles(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                   const enums::ExchangeName& exchange_name,
+                   const std::string& symbol,
+                   const timeframe::Timeframe& timeframe,
+                   int64_t start_timestamp,
+                   int64_t finish_timestamp,
+                   blaze::DynamicMatrix< double >& candles,
+                   size_t chunk_size = 10000);
+
+/**
+ * @brief Read the candles of a range like loadCandles, with the result in binary format
+ *
+ * Runs a statement prepared once per connection with resultFormat=1, so the int8 and float8 columns arrive in
+ * network byte order and are copied into the matrix without parsing text. The range comes in one result rather
+ * than in chunks, which suits the hot reads of ranges that fit in memory.
+ *
+ * @return size_t Number of rows written, the matrix grows to that if it is smaller
+ * @throws std::invalid_argument If candles has fewer than 6 columns
+ */
+size_t loadCandlesBinary(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                         const enums::ExchangeName& exchange_name,
+                         const std::string& symbol,
+                         const timeframe::Timeframe& timeframe,
+                         int64_t start_timestamp,
+                         int64_t finish_timestamp,
+                         blaze::DynamicMatrix< double >& candles);
+
 inline std::ostream& operator<<(std::ostream& os, const Candle& candle)
 {
     os << "Candle { " << "id: " << candle.id_ << ", timestamp: " << candle.timestamp_ << ", open: " << candle.open_
@@ -1656,6 +2134,11 @@ class ClosedTrade
 
     auto prepareUpdateStatement(const ClosedTradesTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -2349,6 +2832,11 @@ class ExchangeApiKeys
 
     auto prepareUpdateStatement(const ExchangeApiKeysTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -2634,6 +3122,11 @@ class Log
 
     auto prepareUpdateStatement(const LogTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -2924,6 +3417,11 @@ class NotificationApiKeys
 
     auto prepareUpdateStatement(const NotificationApiKeysTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -3184,6 +3682,11 @@ class Option
 
     auto prepareUpdateStatement(const OptionsTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -3441,6 +3944,11 @@ class Orderbook
 
     auto prepareUpdateStatement(const OrderbooksTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -3556,6 +4064,15 @@ inline std::ostream& operator<<(std::ostream& os, const Orderbook& orderbook)
     return os;
 }
 
+/**
+ * @brief Store multiple orderbook rows into the database with a single multi-row insert
+ *
+ * @param conn_ptr Optional connection, the default connection is used when null
+ * @param orderbooks Orderbook rows to store
+ */
+extern void saveOrderbooks(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                           const std::vector< Orderbook >& orderbooks);
+
 namespace ticker
 {
 struct Id
@@ -3794,6 +4311,11 @@ class Ticker
 
     auto prepareUpdateStatement(const TickersTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -4244,6 +4766,11 @@ class Trade
 
     auto prepareUpdateStatement(const TradesTable& t, sqlpp::postgresql::connection& conn) const;
 
+    // Insert or update on the unique index of the table in one round trip
+    static const NamedStatement& upsertStatement();
+
+    void bindUpsertParams(StatementParams& params) const;
+
     void save(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr, bool update_on_conflict = false)
     {
         db::save(*this, conn_ptr, update_on_conflict);
@@ -4365,6 +4892,22 @@ inline std::ostream& operator<<(std::ostream& os, const Trade& trade)
     return os;
 }
 
+/**
+ * @brief Read the trades of a range into a matrix ordered by timestamp, with the result in binary format
+ *
+ * Same decoding as loadCandlesBinary, the columns are timestamp, price, buy_qty, sell_qty, buy_count and
+ * sell_count.
+ *
+ * @return size_t Number of rows written
+ * @throws std::invalid_argument If trades has fewer than 6 columns
+ */
+size_t loadTradesBinary(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                        const enums::ExchangeName& exchange_name,
+                        const std::string& symbol,
+                        int64_t start_timestamp,
+                        int64_t finish_timestamp,
+                        blaze::DynamicMatrix< double >& trades);
+
 } // namespace db
 } // namespace ct
 
@@ -0,0 +1,137 @@
+#pragma once
+
+namespace ct
+{
+namespace datastructure
+{
+
+/**
+ * @brief Bounded lock-free multi-producer / single-consumer queue
+ *
+ * Every slot carries a sequence number telling whose turn it is: producers claim a position by
+ * advancing the tail with a CAS and publish the value by bumping the slot sequence, the consumer
+ * takes the value once the sequence shows it was published and hands the slot back to the next
+ * lap. Neither side ever waits for the other, a full queue makes tryPush fail instead.
+ *
+ * With a single producer this is also a valid SPSC queue, the tail CAS then never contends.
+ *
+ * Only one thread may call tryPop at a time.
+ *
+ * @tparam T Default constructible and move assignable element
+ */
+template < typename T >
+class MpscQueue
+{
+   public:
+    /**
+     * @param capacity Number of slots, must be a power of two of at least 2
+     * @throws std::invalid_argument If capacity is not a power of two of at least 2
+     */
+    explicit MpscQueue(size_t capacity) : mask_(capacity - 1), slots_(nullptr)
+    {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+        {
+            throw std::invalid_argument("Queue capacity must be a power of two of at least 2, got " +
+                                        std::to_string(capacity));
+        }
+
+        slots_ = std::make_unique< Slot[] >(capacity);
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            slots_[i].sequence_.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&)            = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Append a value, safe to call from any number of threads
+     *
+     * @param value Value to append, left untouched when the queue is full
+     * @return bool False if the queue is full
+     */
+    template < typename U >
+    bool tryPush(U&& value)
+    {
+        size_t position = tail_.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            Slot& slot    = slots_[position & mask_];
+            size_t turn   = slot.sequence_.load(std::memory_order_acquire);
+            intptr_t diff = static_cast< intptr_t >(turn) - static_cast< intptr_t >(position);
+
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.value_ = std::forward< U >(value);
+                    slot.sequence_.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // The consumer has not released this slot from the previous lap yet
+                return false;
+            }
+            else
+            {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Take the oldest value, consumer thread only
+     *
+     * @param out Destination, only written on success
+     * @return bool False if the queue is empty
+     */
+    bool tryPop(T& out)
+    {
+        size_t position = head_.load(std::memory_order_relaxed);
+        Slot& slot      = slots_[position & mask_];
+
+        if (slot.sequence_.load(std::memory_order_acquire) != position + 1)
+        {
+            return false;
+        }
+
+        out = std::move(slot.value_);
+        slot.sequence_.store(position + mask_ + 1, std::memory_order_release);
+        head_.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Number of queued values, approximate while producers or the consumer are active
+     */
+    size_t size() const
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return mask_ + 1; }
+
+   private:
+    // Slots are cache line aligned so neighbouring producers do not false share
+    struct alignas(64) Slot
+    {
+        std::atomic< size_t > sequence_;
+        T value_;
+    };
+
+    const size_t mask_;
+    std::unique_ptr< Slot[] > slots_;
+
+    alignas(64) std::atomic< size_t > tail_{0};
+    alignas(64) std::atomic< size_t > head_{0};
+};
+
+} // namespace datastructure
+} // namespace ct
@@ -5,6 +5,8 @@
 #include "DB.hpp"
 #include "DynamicArray.hpp"
 #include "Enum.hpp"
+#include "FixedPoint.hpp"
+#include "MatchingEngine.hpp"
 #include "Timeframe.hpp"
 
 namespace ct
@@ -12,6 +14,21 @@ namespace ct
 namespace exchange
 {
 
+/**
+ * @brief Parameters of one order in a batch submission
+ *
+ * For market orders price is the current price.
+ */
+struct OrderSpec
+{
+    std::string symbol_;
+    enums::OrderType order_type_;
+    enums::OrderSide order_side_;
+    double qty_;
+    double price_;
+    bool reduce_only_ = false;
+};
+
 class Exchange
 {
    public:
@@ -38,13 +55,22 @@ class Exchange
     virtual void chargeFee(double amount)                                                = 0;
     virtual void increateAssetTempReducedAmount(const std::string& asset, double amount) = 0;
 
+    // Execution and cancellation settle what is left of an order, its qty minus its filled qty
     virtual void onOrderSubmission(const db::Order& order)   = 0;
     virtual void onOrderExecution(const db::Order& order)    = 0;
     virtual void onOrderCancellation(const db::Order& order) = 0;
 
+    /**
+     * Settle a fill of part of a submitted order, the rest of it stays open
+     * @param order The order, its filled qty does not include this fill yet
+     * @param qty The filled quantity, signed like the order's qty
+     * @param price The fill price
+     */
+    virtual void onOrderFill(const db::Order& order, double qty, double price) = 0;
+
     // Asset-Balance management
     double getAsset(const std::string& asset) const;
-    void setAsset(const std::string& asset, double balance);
+    virtual void setAsset(const std::string& asset, double balance);
     const std::unordered_map< std::string, double >& getAssets() const { return assets_; }
     const std::unordered_map< std::string, double >& getStartingAssets() const { return starting_assets_; }
 
@@ -105,6 +131,22 @@ class Exchange
      */
     virtual void cancelOrder(const std::string& symbol, const std::string& order_id) = 0;
 
+    /**
+     * Place several orders at once
+     * The default places them one by one, drivers can map the batch to a batch endpoint of the exchange
+     * @param specs The orders to place
+     * @return The created orders, in the order of the specs
+     */
+    virtual std::vector< std::shared_ptr< db::Order > > submitOrders(const std::vector< OrderSpec >& specs);
+
+    /**
+     * Cancel several orders of a symbol at once
+     * The default cancels them one by one, drivers can map the batch to a batch endpoint of the exchange
+     * @param symbol The trading pair symbol
+     * @param order_ids The IDs of the orders to cancel
+     */
+    virtual void cancelOrders(const std::string& symbol, const std::vector< std::string >& order_ids);
+
    protected:
     /**
      * Fetch trading pair precisions
@@ -158,6 +200,7 @@ class SpotExchange : public Exchange
     void onOrderSubmission(const db::Order& order) override;
     void onOrderExecution(const db::Order& order) override;
     void onOrderCancellation(const db::Order& order) override;
+    void onOrderFill(const db::Order& order, double qty, double price) override;
 
     // Live trading specific methods
     void onUpdateFromStream(const nlohmann::json& data);
@@ -181,9 +224,43 @@ class SpotExchange : public Exchange
 
     void fetchPrecisions() override;
 
+    void setAsset(const std::string& asset, double balance) override;
+
    private:
-    std::unordered_map< std::string, double > stop_sell_orders_qty_sum_;
-    std::unordered_map< std::string, double > limit_sell_orders_qty_sum_;
+    /**
+     * @brief Scale of an asset's balance, the largest qty precision among its symbols but at least the default
+     *
+     * The scale is fixed on first use, precisions must be fetched before the asset is traded.
+     */
+    const helper::FixedScale& getAssetScale(const std::string& asset);
+
+    /**
+     * @brief Scale of a symbol's prices, its price precision but at least the default
+     */
+    const helper::FixedScale& getPriceScale(const std::string& symbol);
+
+    int64_t getAssetUnits(const std::string& asset);
+    void setAssetUnits(const std::string& asset, int64_t units);
+
+    // Absolute unfilled qty of an order in units of its base asset
+    int64_t getOrderQtyUnits(const db::Order& order);
+    // Absolute unfilled qty times price of an order in units of the settlement currency
+    int64_t getOrderValueUnits(const db::Order& order);
+    // Move an executed qty of an order between the balances, the caller holds the lock
+    void applyExecution(const db::Order& order, int64_t qty, double fill_price);
+
+    // Balances are kept in fixed-point units, assets_ mirrors them as doubles for readers
+    std::unordered_map< std::string, int64_t > asset_units_;
+    std::unordered_map< std::string, helper::FixedScale > asset_scales_;
+    std::unordered_map< std::string, helper::FixedScale > price_scales_;
+
+    // Open sell quantities per symbol, in units of the base asset
+    std::unordered_map< std::string, int64_t > stop_sell_orders_qty_sum_;
+    std::unordered_map< std::string, int64_t > limit_sell_orders_qty_sum_;
+
+    // Share of a fill left after fees, 1 - fee rate
+    helper::FixedScale fee_scale_;
+    int64_t fee_complement_units_;
 
     double started_balance_ = 0.0;
     mutable std::mutex mutex_;
@@ -215,6 +292,7 @@ class FuturesExchange : public Exchange
     void onOrderSubmission(const db::Order& order) override;
     void onOrderExecution(const db::Order& order) override;
     void onOrderCancellation(const db::Order& order) override;
+    void onOrderFill(const db::Order& order, double qty, double price) override;
 
     // Live trading specific methods
     void onUpdateFromStream(const nlohmann::json& data);
@@ -238,10 +316,44 @@ class FuturesExchange : public Exchange
 
     void fetchPrecisions() override;
 
+    /**
+     * @brief Check the running open order sums against a full recomputation from the ledger of open orders
+     *
+     * Position costs are read from PositionsState whenever margin is computed, so they cannot drift. In debug builds
+     * the check also runs after each order event.
+     *
+     * @throws std::logic_error If the running sums drifted
+     */
+    void checkMarginConsistency() const;
+
    private:
+    // Running margin of the open orders of a base asset, updated on order events
+    struct AssetMargin
+    {
+        // Sum of qty * price of open buy and sell orders that are not reduce-only
+        double buy_orders_value_  = 0.0;
+        double sell_orders_value_ = 0.0;
+        size_t buy_orders_count_  = 0;
+        size_t sell_orders_count_ = 0;
+
+        // Contribution currently included in used_margin_
+        double used_ = 0.0;
+    };
+
+    double computeUsedMargin(const AssetMargin& margin) const;
+    // Cost minus unrealized PNL of the open positions on this exchange, read from the PositionsState totals in O(1)
+    double computePositionsMargin() const;
+    void refreshUsedMargin(AssetMargin& margin);
+    void removeOpenOrder(AssetMargin& margin, const std::string& base_asset, const db::Order& order);
+    void verifyMargin() const;
+
     enums::LeverageMode futures_leverage_mode_;
     int futures_leverage_;
 
+    std::unordered_map< std::string, AssetMargin > margins_;
+    // Margin spent on open orders of all assets
+    double used_margin_ = 0.0;
+
     // For live trading
     // in futures trading, margin is only with one asset, so:
     double available_margin_ = 0.0;
@@ -351,6 +463,13 @@ class ExchangesState
      */
     void reset();
 
+    /**
+     * @brief Register an exchange under its name, replacing the one registered there before
+     *
+     * @param exchange The exchange to register
+     */
+    void addExchange(const std::shared_ptr< Exchange >& exchange);
+
     /**
      * @brief Get an exchange by name
      *
@@ -411,6 +530,7 @@ class Sandbox : public Exchange
     void onOrderSubmission(const db::Order& order) override;
     void onOrderExecution(const db::Order& order) override;
     void onOrderCancellation(const db::Order& order) override;
+    void onOrderFill(const db::Order& order, double qty, double price) override;
 
     /**
      * Place a market order
@@ -464,12 +584,77 @@ class Sandbox : public Exchange
      */
     void cancelOrder(const std::string& symbol, const std::string& order_id) override;
 
+    /**
+     * Place several orders atomically
+     * Every spec is validated and every order is built before any of them is added to the state
+     * @param specs The orders to place
+     * @return The created orders, in the order of the specs
+     * @throws exception::ExchangeRejectedOrder If a spec is invalid, no order is placed then
+     * @throws exception::InsufficientBalance, exception::InsufficientMargin If the exchange cannot cover the batch,
+     * no order is placed then
+     */
+    std::vector< std::shared_ptr< db::Order > > submitOrders(const std::vector< OrderSpec >& specs) override;
+
+    /**
+     * Cancel several orders of a symbol atomically
+     * @param symbol The trading pair symbol
+     * @param order_ids The IDs of the orders to cancel
+     * @throws exception::ExchangeOrderNotFound If an ID is unknown, no order is canceled then
+     */
+    void cancelOrders(const std::string& symbol, const std::vector< std::string >& order_ids) override;
+
+    /**
+     * Back the orders placed from now on with an in-process matching engine
+     * Orders then fill against each other and against replayed public trades instead of being queued for execution
+     * @param workers Number of matching worker threads
+     */
+    void enableMatching(size_t workers = 1);
+
+    bool isMatching() const { return engine_ != nullptr; }
+
+    /**
+     * Replay a public trade as liquidity for the resting orders
+     * @param symbol The trading pair symbol
+     * @param price The traded price
+     * @param qty The traded quantity
+     * @throws std::logic_error If matching is not enabled
+     */
+    void onPublicTrade(const std::string& symbol, double price, double qty);
+
+    /**
+     * Wait for the matching engine and apply its fills and cancellations to the orders
+     * Reports arrive on the matching workers, they are applied here on the calling thread. Every fill reaches the
+     * exchange and the position with its own quantity and price.
+     * @return The number of reports that were applied
+     */
+    size_t applyExecutionReports();
+
    protected:
     /**
      * Fetch trading pair precisions
      * This is a protected method as it should only be called internally
      */
     void fetchPrecisions() override;
+
+   private:
+    // Build an order without adding it to the state
+    std::shared_ptr< db::Order > createOrder(const OrderSpec& spec) const;
+    // Reserve a built order on its exchange and add it to the state, then submit it to the engine or queue market
+    // orders for execution
+    void placeOrder(const std::shared_ptr< db::Order >& order);
+    // Cancel an order and pull it from the engine book
+    void cancelPlacedOrder(const std::shared_ptr< db::Order >& order);
+
+    // Engine ids of the orders still live in the engine, and the other way around
+    std::unordered_map< uint64_t, std::shared_ptr< db::Order > > engine_orders_;
+    std::unordered_map< const db::Order*, uint64_t > engine_ids_;
+
+    // Reports received from the matching workers and not applied yet
+    std::mutex reports_mutex_;
+    std::vector< std::pair< std::string, matching::ExecutionReport > > reports_;
+
+    // Declared last so its workers are stopped before the reports they write to are destroyed
+    std::unique_ptr< matching::MatchingEngine > engine_;
 };
 
 extern const std::unordered_map< enums::ExchangeName, exchange::ExchangeData > EXCHANGES_DATA;
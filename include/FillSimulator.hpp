@@ -0,0 +1,89 @@
+#ifndef CT_FILL_SIMULATOR_HPP
+#define CT_FILL_SIMULATOR_HPP
+
+#include "Candle.hpp"
+#include "Enum.hpp"
+#include "Order.hpp"
+#include "Position.hpp"
+
+namespace ct
+{
+namespace simulator
+{
+
+/**
+ * @brief Executes resting orders inside a candle along a deterministic price path
+ *
+ * A bullish candle is assumed to move open -> low -> high -> close and a bearish one open -> high -> low -> close,
+ * the same path candle::splitCandle uses. Orders are executed one at a time in the order the path reaches their
+ * price. After each fill the candle is split at the fill price and only the rest of the path is searched again, so
+ * orders submitted or moved from the fill callback are handled by the same candle.
+ *
+ * Orders are executed through db::Order::execute, which applies each fill to the pair's exchange and position when
+ * they are registered.
+ */
+class FillSimulator
+{
+   public:
+    using Candle       = blaze::DynamicVector< double, blaze::rowVector >;
+    using FillCallback = std::function< void(const std::shared_ptr< db::Order >& order, const Candle& candle) >;
+
+    // Guards against a fill callback that keeps submitting orders at a reachable price
+    static constexpr size_t MAX_FILLS_PER_CANDLE = 10000;
+
+    /**
+     * @param silent Execute orders without logging or notifying, e.g. while optimizing
+     */
+    explicit FillSimulator(bool silent = false) : silent_(silent) {}
+
+    /**
+     * @brief Set the callback invoked after every fill
+     *
+     * @param callback Receives the executed order and the part of the candle up to the fill
+     */
+    void setOnFill(FillCallback callback) { on_fill_ = std::move(callback); }
+
+    /**
+     * @brief Execute every pending order of a pair reached by the candle
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param candle 1m candle
+     * @return size_t Number of executed orders
+     * @throws std::runtime_error If more than MAX_FILLS_PER_CANDLE orders are executed
+     */
+    size_t simulate(const enums::ExchangeName& exchange_name, const std::string& symbol, const Candle& candle);
+
+    /**
+     * @brief Distance the price travels along the candle path before reaching a price in the candle range
+     */
+    static double getPathDistance(const Candle& candle, double price);
+
+    size_t countFills() const { return fills_; }
+
+    /**
+     * @brief Forget cached positions and reset the fill counter
+     */
+    void reset();
+
+   private:
+    const std::shared_ptr< position::Position >& getPosition(const enums::ExchangeName& exchange_name,
+                                                            const std::string& symbol);
+
+    void execute(const std::shared_ptr< position::Position >& position,
+                 const std::shared_ptr< db::Order >& order,
+                 double price);
+
+    // Positions by pair, their current price is moved to every fill price
+    std::unordered_map< std::string, std::shared_ptr< position::Position > > positions_;
+    FillCallback on_fill_;
+    // Reused between candles to avoid an allocation per candle
+    order::PendingOrderBook::Orders triggered_;
+    size_t fills_ = 0;
+    bool silent_;
+};
+
+} // namespace simulator
+} // namespace ct
+
+#endif // CT_FILL_SIMULATOR_HPP
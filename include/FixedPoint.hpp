@@ -0,0 +1,62 @@
+#ifndef CT_FIXED_POINT_HPP
+#define CT_FIXED_POINT_HPP
+
+namespace ct
+{
+namespace helper
+{
+
+/**
+ * @brief Decimal scale of a fixed-point amount stored as an integer multiple of 10^-decimals
+ *
+ * Sums and differences of amounts sharing a scale are plain int64_t arithmetic and therefore exact. Products are
+ * computed in 128 bits and rounded once, half away from zero, into the target scale.
+ */
+class FixedScale
+{
+   public:
+    static constexpr int DEFAULT_DECIMALS = 8;
+    static constexpr int MAX_DECIMALS     = 18;
+
+    /**
+     * @param decimals Number of decimal places in [0, MAX_DECIMALS]
+     * @throws std::invalid_argument If decimals is out of range
+     */
+    explicit FixedScale(int decimals = DEFAULT_DECIMALS);
+
+    int getDecimals() const { return decimals_; }
+    int64_t getFactor() const { return factor_; }
+
+    /**
+     * @brief Convert a value to units of this scale, rounding to the nearest unit
+     *
+     * @throws std::overflow_error If the value does not fit in 64 bits at this scale
+     */
+    int64_t toUnits(double value) const;
+
+    /**
+     * @brief Convert units of this scale back to a value
+     */
+    double toDouble(int64_t units) const { return static_cast< double >(units) / static_cast< double >(factor_); }
+
+    /**
+     * @brief Multiply two amounts of possibly different scales into this scale
+     *
+     * @param a First amount in units of a_scale
+     * @param a_scale Scale of the first amount
+     * @param b Second amount in units of b_scale
+     * @param b_scale Scale of the second amount
+     * @return int64_t Product in units of this scale
+     * @throws std::overflow_error If the product does not fit in 64 bits at this scale
+     */
+    int64_t multiply(int64_t a, const FixedScale& a_scale, int64_t b, const FixedScale& b_scale) const;
+
+   private:
+    int decimals_;
+    int64_t factor_;
+};
+
+} // namespace helper
+} // namespace ct
+
+#endif // CT_FIXED_POINT_HPP
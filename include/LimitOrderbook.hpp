@@ -13,34 +13,12 @@ struct LimitOrderbook
 {
     std::array< std::array< double, ROWS >, COLS > data;
 
-    // Default constructor
-    LimitOrderbook() = default;
-
-    // Copy constructor
-    LimitOrderbook(const LimitOrderbook& other) noexcept : data(other.data) {}
-
-    // Move constructor
-    LimitOrderbook(LimitOrderbook&& other) noexcept : data(std::move(other.data)) {}
-
-    // Copy assignment operator
-    LimitOrderbook& operator=(const LimitOrderbook& other) noexcept
-    {
-        if (this != &other)
-        {
-            data = other.data;
-        }
-        return *this;
-    }
-
-    // Move assignment operator
-    LimitOrderbook& operator=(LimitOrderbook&& other) noexcept
-    {
-        if (this != &other)
-        {
-            data = std::move(other.data);
-        }
-        return *this;
-    }
+    // Special members are defaulted so the type stays trivially copyable and can be published lock-free
+    LimitOrderbook()                                     = default;
+    LimitOrderbook(const LimitOrderbook&)                = default;
+    LimitOrderbook(LimitOrderbook&&) noexcept            = default;
+    LimitOrderbook& operator=(const LimitOrderbook&)     = default;
+    LimitOrderbook& operator=(LimitOrderbook&&) noexcept = default;
 
     // Equality comparison operator
     bool operator==(const LimitOrderbook& other) const { return data == other.data; }
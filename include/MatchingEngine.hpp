@@ -0,0 +1,278 @@
+#ifndef CT_MATCHING_ENGINE_HPP
+#define CT_MATCHING_ENGINE_HPP
+
+#include "Enum.hpp"
+#include "EventQueue.hpp"
+
+namespace ct
+{
+namespace matching
+{
+
+enum class ReportType
+{
+    FILL,
+    CANCEL,
+};
+
+/**
+ * @brief Outcome of an order in the matching engine
+ *
+ * A trade between two engine orders yields one FILL per side. Fills against replayed public trades have no
+ * counter order. A CANCEL carries the quantity that was left unfilled.
+ */
+struct ExecutionReport
+{
+    ReportType type_   = ReportType::FILL;
+    uint64_t order_id_ = 0;
+    // Order on the other side of the trade, 0 for public liquidity
+    uint64_t counter_order_id_ = 0;
+    double price_              = 0.0;
+    double qty_                = 0.0;
+    double remaining_qty_      = 0.0;
+};
+
+struct EngineOrder
+{
+    uint64_t id_           = 0;
+    enums::OrderSide side_ = enums::OrderSide::BUY;
+    enums::OrderType type_ = enums::OrderType::MARKET;
+    // Unfilled quantity, always positive
+    double qty_ = 0.0;
+    // Limit or stop price, unused for market orders
+    double price_ = 0.0;
+};
+
+/**
+ * @brief Price-time priority book of a single symbol
+ *
+ * Market orders take the best prices until filled and cancel what is left. Limit orders take what crosses their
+ * price and rest with the remainder. Stop orders wait until the last trade price reaches their price and then
+ * act as market orders.
+ *
+ * Replayed public trades are liquidity: resting orders at or better than the printed price fill against it at
+ * their own price, and stops it triggers may take its quantity at the printed price. Each side may take up to the
+ * printed quantity since the aggressor of a public trade is unknown.
+ *
+ * Not thread-safe, MatchingEngine gives every book to exactly one worker.
+ */
+class MatchingBook
+{
+   public:
+    /**
+     * @brief Match an order and rest its remainder if it is a limit or untriggered stop order
+     *
+     * @param order Validated order with a positive quantity
+     * @param reports Receives the fills and cancellations caused by the order
+     */
+    void submit(const EngineOrder& order, std::vector< ExecutionReport >& reports);
+
+    /**
+     * @brief Cancel a resting limit or stop order
+     *
+     * @return bool False if the order is not resting in this book
+     */
+    bool cancel(uint64_t order_id, std::vector< ExecutionReport >& reports);
+
+    /**
+     * @brief Replay a public trade as liquidity
+     */
+    void onPublicTrade(double price, double qty, std::vector< ExecutionReport >& reports);
+
+    std::optional< double > getBestBid() const;
+    std::optional< double > getBestAsk() const;
+    std::optional< double > getLastPrice() const;
+
+    size_t countResting() const { return locations_.size(); }
+
+   private:
+    struct Resting
+    {
+        uint64_t id_;
+        double qty_;
+    };
+
+    using Level = std::deque< Resting >;
+    using Bids  = std::map< double, Level, std::greater< double > >;
+    using Asks  = std::map< double, Level >;
+
+    // Buy stops trigger once the price rises to them, sell stops once it falls to them
+    using BuyStops  = std::multimap< double, EngineOrder >;
+    using SellStops = std::multimap< double, EngineOrder, std::greater< double > >;
+
+    enum class Where
+    {
+        BID,
+        ASK,
+        BUY_STOP,
+        SELL_STOP,
+    };
+
+    struct Location
+    {
+        Where where_;
+        double price_;
+    };
+
+    template < typename Book >
+    void take(Book& book, EngineOrder& taker, std::vector< ExecutionReport >& reports);
+
+    template < typename Book >
+    void fillAgainstPublic(Book& book, double price, double qty, std::vector< ExecutionReport >& reports);
+
+    template < typename Book >
+    void rest(Book& book, Where where, const EngineOrder& order);
+
+    // Both return the unfilled quantity of the erased order
+    template < typename Book >
+    double eraseResting(Book& book, double price, uint64_t order_id);
+
+    template < typename Stops >
+    double eraseStop(Stops& stops, double price, uint64_t order_id);
+
+    void match(EngineOrder& order, std::vector< ExecutionReport >& reports);
+    void triggerStops(std::vector< ExecutionReport >& reports);
+
+    Bids bids_;
+    Asks asks_;
+    BuyStops buy_stops_;
+    SellStops sell_stops_;
+
+    std::unordered_map< uint64_t, Location > locations_;
+
+    double last_price_ = std::numeric_limits< double >::quiet_NaN();
+    // Quantity of the public trade being replayed still available to triggered stops
+    double public_qty_ = 0.0;
+};
+
+/**
+ * @brief In-process matching engine sharding symbols across worker threads
+ *
+ * Every symbol belongs to one worker, chosen by hashing the symbol. Commands are posted to the worker through a
+ * lock-free MPSC queue and its books are only ever touched by that worker, so symbols match in parallel while
+ * the commands of one symbol are applied in the order they were posted.
+ *
+ * This is the offline stand-in for live exchanges in load tests. Orders submitted directly never reach
+ * OrdersState, Sandbox maps the fills and cancellations of the orders it places back onto them.
+ */
+class MatchingEngine
+{
+   public:
+    /**
+     * @brief Receives execution reports on the worker thread of the symbol, must be thread-safe
+     */
+    using ReportHandler = std::function< void(const std::string& symbol, const ExecutionReport& report) >;
+
+    /**
+     * @param workers Number of worker threads, at least 1
+     * @param queue_capacity Command queue size of every worker, a power of two
+     * @throws std::invalid_argument If workers is 0 or queue_capacity is not a power of two
+     */
+    explicit MatchingEngine(size_t workers = 4, size_t queue_capacity = 65536);
+    ~MatchingEngine();
+
+    MatchingEngine(const MatchingEngine&)            = delete;
+    MatchingEngine& operator=(const MatchingEngine&) = delete;
+
+    /**
+     * @brief Replace the report handler, must not be called while running
+     */
+    void setReportHandler(ReportHandler handler);
+
+    void start();
+
+    /**
+     * @brief Apply the commands still queued and join the workers
+     */
+    void stop();
+
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Submit an order, safe to call from any thread
+     *
+     * @param symbol Trading pair
+     * @param side Order side
+     * @param type MARKET, LIMIT or STOP
+     * @param qty Positive quantity
+     * @param price Limit or stop price, ignored for market orders
+     * @return uint64_t Id of the order in the execution reports
+     * @throws std::invalid_argument If the type is not supported or the quantity or price is not positive
+     */
+    uint64_t submit(const std::string& symbol,
+                    const enums::OrderSide& side,
+                    const enums::OrderType& type,
+                    double qty,
+                    double price = 0.0);
+
+    /**
+     * @brief Cancel a resting order, unknown ids are ignored
+     */
+    void cancel(const std::string& symbol, uint64_t order_id);
+
+    /**
+     * @brief Replay a public trade of a symbol as liquidity
+     */
+    void onPublicTrade(const std::string& symbol, double price, double qty);
+
+    /**
+     * @brief Block until every command posted so far has been applied
+     */
+    void drain() const;
+
+    size_t countWorkers() const { return shards_.size(); }
+    size_t getShardIndex(const std::string& symbol) const;
+
+    uint64_t countCommands() const;
+    uint64_t countFills() const;
+
+    /**
+     * @brief Book of a symbol, only safe to read after drain while nothing else is posted
+     *
+     * @return const MatchingBook* Null if the symbol never received a command
+     */
+    const MatchingBook* getBook(const std::string& symbol) const;
+
+   private:
+    enum class CommandType
+    {
+        SUBMIT,
+        CANCEL,
+        PUBLIC_TRADE,
+    };
+
+    struct Command
+    {
+        CommandType type_ = CommandType::SUBMIT;
+        std::string symbol_;
+        EngineOrder order_;
+    };
+
+    struct Shard
+    {
+        explicit Shard(size_t capacity) : queue_(capacity) {}
+
+        datastructure::MpscQueue< Command > queue_;
+        std::unique_ptr< std::thread > thread_;
+        std::unordered_map< std::string, MatchingBook > books_;
+
+        alignas(64) std::atomic< uint64_t > posted_{0};
+        alignas(64) std::atomic< uint64_t > applied_{0};
+        std::atomic< uint64_t > fills_{0};
+    };
+
+    void post(Command command);
+    void run(Shard& shard);
+    void apply(Shard& shard, const Command& command, std::vector< ExecutionReport >& reports);
+
+    std::vector< std::unique_ptr< Shard > > shards_;
+    ReportHandler handler_;
+
+    std::atomic< bool > running_{false};
+    std::atomic< uint64_t > next_order_id_{1};
+};
+
+} // namespace matching
+} // namespace ct
+
+#endif // CT_MATCHING_ENGINE_HPP
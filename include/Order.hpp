@@ -2,13 +2,149 @@
 #define CT_ORDER_HPP
 
 #include "DB.hpp"
+#include "PendingOrderBook.hpp"
 
 namespace ct
 {
 namespace order
 {
 
-class OrdersState
+/**
+ * @brief Hashes the 16 raw bytes of a uuid, no string formatting involved
+ */
+struct UuidHash
+{
+    size_t operator()(const boost::uuids::uuid& id) const noexcept
+    {
+        uint64_t high;
+        uint64_t low;
+        std::memcpy(&high, id.begin(), sizeof(high));
+        std::memcpy(&low, id.begin() + sizeof(high), sizeof(low));
+        return static_cast< size_t >(high ^ (low * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+/**
+ * @brief Non-owning view over the orders of a pair, optionally filtered by side
+ *
+ * Iterating yields references to the stored shared pointers, so nothing is allocated and no
+ * reference count is touched. The view is invalidated by any call that adds or removes orders.
+ */
+class OrdersView
+{
+   public:
+    using Storage = std::vector< std::shared_ptr< db::Order > >;
+
+    class Iterator
+    {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::shared_ptr< db::Order >;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+        Iterator(const OrdersView* view, size_t index) : view_(view), index_(index) { skip(); }
+
+        reference operator*() const { return (*view_->orders_)[index_]; }
+        pointer operator->() const { return &(*view_->orders_)[index_]; }
+
+        Iterator& operator++()
+        {
+            ++index_;
+            skip();
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++(*this);
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+       private:
+        void skip()
+        {
+            while (index_ < view_->total() && !view_->matches(*(*view_->orders_)[index_]))
+            {
+                ++index_;
+            }
+        }
+
+        const OrdersView* view_;
+        size_t index_;
+    };
+
+    /**
+     * @brief Empty view
+     */
+    OrdersView() = default;
+
+    /**
+     * @brief View over all given orders
+     */
+    explicit OrdersView(const Storage& orders) : orders_(&orders) {}
+
+    /**
+     * @brief View over the orders that are not canceled and whose side is (or is not) the given one
+     *
+     * @param orders Orders to filter
+     * @param side Order side to compare to
+     * @param same_side Keep orders on the given side if true, on the opposite side otherwise
+     */
+    OrdersView(const Storage& orders, enums::OrderSide side, bool same_side)
+        : orders_(&orders), side_(side), same_side_(same_side)
+    {
+    }
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, total()); }
+
+    bool empty() const { return begin() == end(); }
+
+    /**
+     * @brief Number of matching orders, counted without allocating
+     */
+    size_t count() const { return std::distance(begin(), end()); }
+
+    /**
+     * @brief Copy the matching orders, for callers that need to own them
+     */
+    Storage toVector() const { return Storage(begin(), end()); }
+
+   private:
+    size_t total() const { return orders_ ? orders_->size() : 0; }
+
+    bool matches(const db::Order& order) const
+    {
+        if (!side_)
+        {
+            return true;
+        }
+        return (order.getOrderSide() == *side_) == same_side_ && !order.isCanceled();
+    }
+
+    const Storage* orders_ = nullptr;
+    std::optional< enums::OrderSide > side_;
+    bool same_side_ = true;
+};
+
+/**
+ * @brief State for managing orders
+ *
+ * Besides the per-pair vectors, every tracked order is indexed by its binary id, by its exchange id
+ * and by its status. The state attaches itself as the listener of the orders it tracks, only those
+ * report their id, exchange id, price and status changes, so the indexes stay in sync wherever a
+ * tracked order is mutated. Copies and untracked orders leave the indexes alone.
+ *
+ * The indexes are guarded by a mutex since a tracked order may change on any thread. The pair
+ * getters returning references and views are meant for the trading thread.
+ */
+class OrdersState : private db::OrderListener
 {
    public:
     // Singleton access
@@ -16,6 +152,7 @@ class OrdersState
 
     // Constructor
     OrdersState();
+    ~OrdersState();
 
     // Reset methods
     void reset();
@@ -27,11 +164,11 @@ class OrdersState
     void removeOrder(const std::shared_ptr< db::Order > order);
     void executePendingMarketOrders();
 
-    // Getters
-    std::vector< std::shared_ptr< db::Order > > getOrders(const enums::ExchangeName& exchange_name,
-                                                          const std::string& symbol) const;
-    std::vector< std::shared_ptr< db::Order > > getActiveOrders(const enums::ExchangeName& exchange_name,
-                                                                const std::string& symbol) const;
+    // Getters, the pair getters return the stored orders without copying them
+    const std::vector< std::shared_ptr< db::Order > >& getOrders(const enums::ExchangeName& exchange_name,
+                                                                 const std::string& symbol) const;
+    const std::vector< std::shared_ptr< db::Order > >& getActiveOrders(const enums::ExchangeName& exchange_name,
+                                                                       const std::string& symbol) const;
     std::vector< std::shared_ptr< db::Order > > getOrders(const enums::ExchangeName& exchange_name) const;
 
     int countActiveOrders() const;
@@ -43,6 +180,47 @@ class OrdersState
                                               const std::string& id,
                                               bool use_exchange_id = false) const;
 
+    /**
+     * @brief Find an order by its client id, a part of it, or its exchange id
+     *
+     * @return std::shared_ptr< db::Order > The order, or null if no order of the pair matches
+     */
+    std::shared_ptr< db::Order > findOrderById(const enums::ExchangeName& exchange_name,
+                                               const std::string& symbol,
+                                               const std::string& id,
+                                               bool use_exchange_id = false) const;
+
+    /**
+     * @brief Find an order by its binary id in O(1)
+     *
+     * @return std::shared_ptr< db::Order > The order, or an empty order if not found
+     */
+    std::shared_ptr< db::Order > getOrderById(const enums::ExchangeName& exchange_name,
+                                              const std::string& symbol,
+                                              const boost::uuids::uuid& id) const;
+
+    /**
+     * @brief Get the orders of a pair that currently have the given status, in no particular order
+     */
+    std::vector< std::shared_ptr< db::Order > > getOrdersByStatus(const enums::ExchangeName& exchange_name,
+                                                                  const std::string& symbol,
+                                                                  const enums::OrderStatus& status) const;
+
+    /**
+     * @brief Count the orders of a pair that currently have the given status in O(1)
+     */
+    int countOrdersByStatus(const enums::ExchangeName& exchange_name,
+                            const std::string& symbol,
+                            const enums::OrderStatus& status) const;
+
+    /**
+     * @brief Get the resting limit and stop orders of a pair sorted by price
+     *
+     * The book follows price and status changes of the orders, so it is valid at any time.
+     */
+    const PendingOrderBook& getPendingOrders(const enums::ExchangeName& exchange_name,
+                                             const std::string& symbol) const;
+
     // return all orders if position is not opened yet
     std::vector< std::shared_ptr< db::Order > > getEntryOrders(const enums::ExchangeName& exchange_name,
                                                                const std::string& symbol) const;
@@ -51,17 +229,73 @@ class OrdersState
     std::vector< std::shared_ptr< db::Order > > getActiveExitOrders(const enums::ExchangeName& exchange_name,
                                                                     const std::string& symbol) const;
 
+    // Allocation free counterparts of the getters above, meant for hot paths
+    OrdersView viewEntryOrders(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+    OrdersView viewExitOrders(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+    OrdersView viewActiveExitOrders(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
     void updateActiveOrders(const enums::ExchangeName& exchange_name, const std::string& symbol);
 
     void clearOrders(const enums::ExchangeName& exchange_name, const std::string& symbol);
 
    private:
+    // What an order was indexed under, used to find the stale entries after it changed
+    struct IndexEntry
+    {
+        std::shared_ptr< db::Order > order_;
+        std::string key_;
+        boost::uuids::uuid id_;
+        std::optional< std::string > exchange_id_;
+        enums::OrderStatus status_;
+        size_t status_slot_ = 0;
+        // Price the order rests at in the pending book of its pair, if it does
+        std::optional< double > pending_price_;
+    };
+
+    using StatusBuckets = std::unordered_map< enums::OrderStatus, std::vector< std::shared_ptr< db::Order > > >;
+
+    // Storage of a pair, reachable without building its string key
+    struct PairStorage
+    {
+        std::vector< std::shared_ptr< db::Order > >* orders_ = nullptr;
+        std::vector< std::shared_ptr< db::Order > >* active_ = nullptr;
+        StatusBuckets* statuses_                             = nullptr;
+        PendingOrderBook* pending_                           = nullptr;
+    };
+
+    void registerPair(const enums::ExchangeName& exchange_name, const std::string& symbol, const std::string& key);
+    const PairStorage* findPair(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
+    void indexOrder(const std::shared_ptr< db::Order >& order, const std::string& key);
+    void unindexOrder(const db::Order* order);
+    void onOrderChanged(const db::Order& order) override;
+    std::shared_ptr< db::Order > findById(const boost::uuids::uuid& id) const;
+
+    void insertStatus(IndexEntry& entry);
+    void eraseStatus(const IndexEntry& entry);
+    void eraseExchangeId(const IndexEntry& entry);
+    void syncPending(IndexEntry& entry);
+
     // Used in simulation only
     std::vector< std::shared_ptr< db::Order > > to_execute_;
 
     // Storage maps
     std::map< std::string, std::vector< std::shared_ptr< db::Order > > > storage_;
     std::map< std::string, std::vector< std::shared_ptr< db::Order > > > active_storage_;
+    std::map< enums::ExchangeName, std::map< std::string, PairStorage > > pairs_;
+
+    // Indexes over all tracked orders
+    std::unordered_map< const db::Order*, IndexEntry > entries_;
+    std::unordered_map< boost::uuids::uuid, std::shared_ptr< db::Order >, UuidHash > by_id_;
+    std::unordered_multimap< std::string, std::shared_ptr< db::Order > > by_exchange_id_;
+    std::unordered_map< std::string, StatusBuckets > by_status_;
+    std::map< std::string, PendingOrderBook > pending_;
+
+    // Number of tracked orders per status over all pairs
+    std::unordered_map< enums::OrderStatus, int > status_totals_;
+
+    // Guards the storage and the indexes
+    mutable std::mutex mutex_;
 
     // Deleted to enforce Singleton
     OrdersState(const OrdersState&)            = delete;
@@ -3,17 +3,34 @@
 #include "DynamicArray.hpp"
 #include "Enum.hpp"
 #include "LimitOrderbook.hpp"
+#include "Seqlock.hpp"
 
 namespace ct
 {
 namespace orderbook
 {
 
+/**
+ * @brief Latest formatted orderbook of a symbol as seen by readers
+ */
+struct PublishedOrderbook
+{
+    int64_t timestamp_ = 0;
+    lob::LimitOrderbook< lob::R_, lob::C_ > asks_;
+    lob::LimitOrderbook< lob::R_, lob::C_ > bids_;
+};
+
 /**
  * @brief State for managing orderbook state
  *
  * This class stores and manages orderbook data for different exchange/symbol pairs.
  * It aggregates orderbook data into time-based buckets for analysis.
+ *
+ * Every pair has one writer (the thread calling addOrderbook). The latest orderbook is
+ * published through a seqlock, so getSnapshot, getCurrentAsks/Bids and getBestAsk/Bid may be
+ * called from other threads without locking. The history returned by getOrderbooks is not
+ * synchronised and must be read from the writer thread. init/initSymbol must complete before
+ * readers start.
  */
 class OrderbooksState
 {
@@ -34,6 +51,14 @@ class OrderbooksState
      */
     void init();
 
+    /**
+     * @brief Create (or reset) storage for a single exchange/symbol pair
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     */
+    void initSymbol(const enums::ExchangeName& exchange_name, const std::string& symbol);
+
     /**
      * @brief Format orderbook data for storage
      *
@@ -57,6 +82,31 @@ class OrderbooksState
                       const std::vector< std::array< double, 2 > >& asks,
                       const std::vector< std::array< double, 2 > >& bids);
 
+    /**
+     * @brief Append an already formatted orderbook, bypassing trimming and the one second throttle
+     *
+     * Used when replaying stored snapshots, which are formatted and throttled at capture time.
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param timestamp Snapshot timestamp in milliseconds
+     * @param orderbook Formatted orderbook [asks, bids]
+     */
+    void addFormattedOrderbook(
+        const enums::ExchangeName& exchange_name,
+        const std::string& symbol,
+        int64_t timestamp,
+        const blaze::StaticVector< lob::LimitOrderbook< lob::R_, lob::C_ >, 2UL, blaze::rowVector >& orderbook);
+
+    /**
+     * @brief Get a consistent copy of the latest orderbook, safe to call from any thread
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @return PublishedOrderbook Latest asks and bids with their timestamp
+     */
+    PublishedOrderbook getSnapshot(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
     /**
      * @brief Get the current orderbook for a specific exchange and symbol
      *
@@ -137,6 +187,13 @@ class OrderbooksState
 
     std::unordered_map< std::string, TempOrderbookData > temp_storage_;
 
+    // Latest orderbook per pair, published for lock-free readers
+    std::unordered_map< std::string, std::unique_ptr< datastructure::Seqlock< PublishedOrderbook > > > published_;
+
+    void publish(const std::string& key,
+                 int64_t timestamp,
+                 const blaze::StaticVector< lob::LimitOrderbook< lob::R_, lob::C_ >, 2UL, blaze::rowVector >& orderbook);
+
     /**
      * @brief Trim orderbook to specified precision
      *
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "DB.hpp"
+#include "DynamicArray.hpp"
+#include "Enum.hpp"
+#include "LimitOrderbook.hpp"
+
+namespace ct
+{
+namespace orderbook
+{
+
+/**
+ * @brief One formatted orderbook snapshot: [asks, bids], each side holding prices in row 0 and quantities in row 1
+ */
+using OrderbookSnapshot = blaze::StaticVector< lob::LimitOrderbook< lob::R_, lob::C_ >, 2UL, blaze::rowVector >;
+
+/**
+ * @brief Integer grid used to delta-encode prices (ticks) and quantities (lots)
+ */
+struct ArchivePrecision
+{
+    double tick_size_ = 1e-8;
+    double lot_size_  = 1e-8;
+};
+
+/**
+ * @brief Orderbook history decoded from the archive
+ */
+struct OrderbookSeries
+{
+    std::vector< int64_t > timestamps_;
+    datastructure::DynamicBlazeArray< lob::LimitOrderbook< lob::R_, lob::C_ > > orderbooks_{{1, 2}};
+};
+
+/**
+ * @brief Delta-encoded, compressed persistence for one-second orderbook snapshots
+ *
+ * Snapshots are grouped into per-symbol batches. Each batch is stored as a single row
+ * of the orderbooks table whose timestamp is the timestamp of the first snapshot. Inside
+ * a batch, every level is converted to integer ticks/lots and written as a zigzag varint
+ * delta against the same level of the previous snapshot, and the result is compressed
+ * with a fast zlib level. Completed batches are written with one multi-row insert.
+ *
+ * add() only encodes and queues, a background writer started with start() stores the rows. The queue is bounded,
+ * when the database falls behind the oldest rows are dropped and counted. stop() runs as a DatabaseShutdownManager
+ * hook, the writer keeps a pooled connection checked out so its final flush still works while the pool shuts down.
+ */
+class OrderbookArchive
+{
+   public:
+    /**
+     * @brief Get the singleton instance
+     *
+     * @return OrderbookArchive& Reference to the singleton instance
+     */
+    static OrderbookArchive& getInstance()
+    {
+        static OrderbookArchive instance;
+        return instance;
+    }
+
+    /**
+     * @brief Set the tick and lot sizes used for a symbol
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param precision Tick and lot sizes
+     */
+    void setPrecision(const enums::ExchangeName& exchange_name,
+                      const std::string& symbol,
+                      const ArchivePrecision& precision);
+
+    /**
+     * @brief Largest batch size setBatching accepts, bounds the span of every stored row
+     */
+    static constexpr size_t MAX_BATCH_SIZE = 600;
+
+    /**
+     * @brief Set batching parameters
+     *
+     * @param batch_size Maximum number of snapshots per stored row, at most MAX_BATCH_SIZE
+     * @param rows_per_write Number of completed rows written per bulk insert
+     * @param max_queued_rows Number of encoded rows kept while the writer lags, the oldest are dropped beyond it
+     */
+    void setBatching(size_t batch_size, size_t rows_per_write, size_t max_queued_rows = 1024);
+
+    /**
+     * @brief Get the maximum time span covered by one stored row
+     *
+     * Derived from MAX_BATCH_SIZE rather than the current batch size, so it also covers rows written
+     * under a larger batch size set earlier.
+     *
+     * @return int64_t Span in milliseconds
+     */
+    static int64_t getBatchSpan() { return static_cast< int64_t >(MAX_BATCH_SIZE) * 1000; }
+
+    /**
+     * @brief Start the background writer, does nothing if it is already running
+     *
+     * @param retry_interval Time to wait before writing again after a failed write
+     */
+    void start(std::chrono::milliseconds retry_interval = std::chrono::milliseconds(1000));
+
+    /**
+     * @brief Encode the pending batches, write every queued row and join the writer
+     */
+    void stop();
+
+    bool isRunning() const { return running_.load(); }
+
+    /**
+     * @brief Add a formatted snapshot to the pending batch of a symbol
+     *
+     * Encodes the batch when it is full and wakes the writer once enough completed rows are queued. Nothing is
+     * written on the calling thread.
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param timestamp Snapshot timestamp in milliseconds
+     * @param snapshot Formatted orderbook
+     */
+    void add(const enums::ExchangeName& exchange_name,
+             const std::string& symbol,
+             int64_t timestamp,
+             const OrderbookSnapshot& snapshot);
+
+    /**
+     * @brief Encode all pending batches and write every queued row on the calling thread
+     *
+     * @param conn_ptr Optional database connection
+     * @throws std::exception If the write failed, the rows stay queued
+     */
+    void flush(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr = nullptr);
+
+    /**
+     * @brief Drop all pending batches and queued rows
+     */
+    void reset();
+
+    /**
+     * @brief Number of encoded rows waiting to be written
+     */
+    size_t countQueuedRows() const;
+
+    /**
+     * @brief Number of encoded rows dropped because the queue was full or the final write failed
+     */
+    uint64_t countDroppedRows() const;
+
+    /**
+     * @brief Load and decode the stored history of a symbol
+     *
+     * @param conn_ptr Optional database connection
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param start_timestamp Inclusive start in milliseconds
+     * @param finish_timestamp Inclusive end in milliseconds
+     * @return OrderbookSeries Snapshots ordered by timestamp
+     */
+    OrderbookSeries load(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                         const enums::ExchangeName& exchange_name,
+                         const std::string& symbol,
+                         int64_t start_timestamp,
+                         int64_t finish_timestamp) const;
+
+    /**
+     * @brief Encode and compress a batch of snapshots
+     *
+     * @param timestamps Snapshot timestamps
+     * @param snapshots Snapshots, same length as timestamps
+     * @param precision Tick and lot sizes
+     * @param level zlib compression level
+     * @return std::vector< uint8_t > Encoded batch
+     */
+    static std::vector< uint8_t > encodeBatch(const std::vector< int64_t >& timestamps,
+                                              const std::vector< OrderbookSnapshot >& snapshots,
+                                              const ArchivePrecision& precision,
+                                              int level = Z_BEST_SPEED);
+
+    /**
+     * @brief Decompress and decode a batch produced by encodeBatch
+     *
+     * @param data Encoded batch
+     * @param timestamps Output timestamps, appended to
+     * @param snapshots Output snapshots, appended to
+     */
+    static void decodeBatch(const std::vector< uint8_t >& data,
+                            std::vector< int64_t >& timestamps,
+                            std::vector< OrderbookSnapshot >& snapshots);
+
+   private:
+    OrderbookArchive() = default;
+    ~OrderbookArchive();
+    OrderbookArchive(const OrderbookArchive&)            = delete;
+    OrderbookArchive& operator=(const OrderbookArchive&) = delete;
+
+    struct PendingBatch
+    {
+        enums::ExchangeName exchange_name_;
+        std::string symbol_;
+        std::vector< int64_t > timestamps_;
+        std::vector< OrderbookSnapshot > snapshots_;
+    };
+
+    void encodePending(PendingBatch& batch);
+
+    // Put rows that failed to be written back in front of the queue, mutex_ must be held
+    void requeue(std::vector< db::Orderbook >& rows);
+    // Drop the oldest rows beyond max_queued_rows_, mutex_ must be held
+    void trimQueue();
+
+    void runWriter();
+
+    ArchivePrecision getPrecision(const std::string& key) const;
+
+    mutable std::mutex mutex_;
+    size_t batch_size_      = 60;
+    size_t rows_per_write_  = 10;
+    size_t max_queued_rows_ = 1024;
+    uint64_t dropped_rows_  = 0;
+    std::unordered_map< std::string, ArchivePrecision > precisions_;
+    std::unordered_map< std::string, PendingBatch > pending_;
+    std::deque< db::Orderbook > queued_rows_;
+
+    std::thread writer_;
+    std::condition_variable wake_;
+    std::chrono::milliseconds retry_interval_{1000};
+    bool stopping_ = false;
+    std::atomic< bool > running_{false};
+
+    // Serializes start and stop, mutex_ guards the queue and the wait of the writer
+    std::mutex lifecycle_mutex_;
+    bool hook_registered_ = false;
+};
+
+} // namespace orderbook
+} // namespace ct
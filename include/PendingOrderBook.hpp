@@ -0,0 +1,84 @@
+#ifndef CT_PENDING_ORDER_BOOK_HPP
+#define CT_PENDING_ORDER_BOOK_HPP
+
+#include "DB.hpp"
+
+namespace ct
+{
+namespace order
+{
+
+/**
+ * @brief Resting orders of one pair, sorted by trigger price
+ *
+ * Orders are split by the direction the market has to move to reach them:
+ * - falling: buy limits and fill-or-kills, sell stops and stop-limits, triggered when the price drops to their price
+ * - rising: sell limits and fill-or-kills, buy stops and stop-limits, triggered when the price climbs to their price
+ *
+ * Finding the orders a candle touched is a range query in O(log n + k).
+ */
+class PendingOrderBook
+{
+   public:
+    using Orders = std::vector< std::shared_ptr< db::Order > >;
+
+    /**
+     * @brief Whether an order rests in the book: an active or partially filled non-market order with a price
+     */
+    static bool isPending(const db::Order& order);
+
+    /**
+     * @brief Whether an order is triggered by a falling price
+     */
+    static bool triggersOnFall(const db::Order& order);
+
+    /**
+     * @brief Add an order at its current price, the caller checks isPending
+     */
+    void add(const std::shared_ptr< db::Order >& order);
+
+    /**
+     * @brief Remove an order that was added at the given price
+     *
+     * @return bool Whether the order was found
+     */
+    bool remove(const db::Order* order, double price);
+
+    void clear();
+
+    size_t size() const { return falling_.size() + rising_.size(); }
+    bool empty() const { return falling_.empty() && rising_.empty(); }
+
+    /**
+     * @brief Append the falling-side orders priced within [low, high], highest price first
+     *
+     * This is the order in which a price moving down from high to low reaches them.
+     */
+    void collectFalling(double low, double high, Orders& out) const;
+
+    /**
+     * @brief Append the rising-side orders priced within [low, high], lowest price first
+     *
+     * This is the order in which a price moving up from low to high reaches them.
+     */
+    void collectRising(double low, double high, Orders& out) const;
+
+    /**
+     * @brief All orders priced within [low, high], falling side first
+     */
+    Orders getTriggered(double low, double high) const;
+
+   private:
+    // Equal prices keep their insertion order, which gives time priority within a level
+    using Side = std::multimap< double, std::shared_ptr< db::Order > >;
+
+    static bool eraseFrom(Side& side, const db::Order* order, double price);
+
+    Side falling_;
+    Side rising_;
+};
+
+} // namespace order
+} // namespace ct
+
+#endif // CT_PENDING_ORDER_BOOK_HPP
@@ -18,6 +18,55 @@ enum class Operation
     SUBTRACT,
 };
 
+/**
+ * @brief Derived metrics of a position, memoised until one of their inputs changes
+ *
+ * Every mutation of the quantity, entry, current, mark or liquidation price bumps the position version. A
+ * metric is computed on first access and served from the snapshot until the version moves on.
+ */
+struct PositionSnapshot
+{
+    enum Metric : uint8_t
+    {
+        VALUE             = 1 << 0,
+        PNL               = 1 << 1,
+        ROI               = 1 << 2,
+        TOTAL_COST        = 1 << 3,
+        LEVERAGE          = 1 << 4,
+        LIQUIDATION_PRICE = 1 << 5,
+        ALL               = (1 << 6) - 1,
+    };
+
+    // Position version the metrics were computed at, 0 before the first computation
+    uint64_t version_ = 0;
+    // Metric bits already computed at this version
+    uint8_t computed_ = 0;
+
+    double value_      = 0.0;
+    double pnl_        = 0.0;
+    double roi_        = 0.0;
+    double total_cost_ = 0.0;
+    double leverage_   = 0.0;
+    std::optional< double > liquidation_price_;
+};
+
+/**
+ * @brief Metrics summed over the open positions
+ *
+ * PositionsState keeps these as running totals, overall and per exchange, every stored position adds the
+ * difference of its own metrics whenever it changes.
+ */
+struct PortfolioMetrics
+{
+    int open_positions_ = 0;
+    // Sums skip NaN metrics, e.g. the value of a position without a current price
+    double total_value_ = 0.0;
+    double total_pnl_   = 0.0;
+    double total_cost_  = 0.0;
+    // Absolute qty times entry price, the cost before any leverage
+    double total_entry_value_ = 0.0;
+};
+
 class Position
 {
    public:
@@ -26,31 +75,31 @@ class Position
              const std::string& symbol,
              const std::unordered_map< std::string, std::any >& attributes = {});
 
-    // Rule of five
-    Position(const Position&)                = default;
-    Position(Position&&) noexcept            = default;
-    Position& operator=(const Position&)     = default;
-    Position& operator=(Position&&) noexcept = default;
-    ~Position()                              = default;
+    // Rule of five, assigning into a stored position updates the totals of its PositionsState
+    Position(const Position&)     = default;
+    Position(Position&&) noexcept = default;
+    Position& operator=(const Position& other);
+    Position& operator=(Position&& other);
+    ~Position() = default;
 
     // Getters and setters
     const boost::uuids::uuid& getId() const { return id_; }
     std::string getIdAsString() const;
 
     std::optional< double > getEntryPrice() const { return entry_price_; }
-    void setEntryPrice(double price) { entry_price_ = price; }
-    void clearEntryPrice() { entry_price_.reset(); }
+    void setEntryPrice(double price) { entry_price_ = price; touch(); }
+    void clearEntryPrice() { entry_price_.reset(); touch(); }
 
     std::optional< double > getExitPrice() const { return exit_price_; }
     void setExitPrice(double price) { exit_price_ = price; }
     void clearExitPrice() { exit_price_.reset(); }
 
     std::optional< double > getCurrentPrice() const { return current_price_; }
-    void setCurrentPrice(double price) { current_price_ = price; }
-    void clearCurrentPrice() { current_price_.reset(); }
+    void setCurrentPrice(double price) { current_price_ = price; touch(); }
+    void clearCurrentPrice() { current_price_.reset(); touch(); }
 
     double getQty() const { return qty_; }
-    void setQty(double qty) { qty_ = qty; }
+    void setQty(double qty) { qty_ = qty; touch(); }
 
     double getPreviousQty() const { return previous_qty_; }
 
@@ -65,13 +114,20 @@ class Position
     const enums::ExchangeName& getExchangeName() const { return exchange_name_; }
     void setExchangeName(const enums::ExchangeName& exchange_name) { exchange_name_ = exchange_name; }
 
+    std::shared_ptr< exchange::Exchange > getExchange() const { return exchange_; }
+    void setExchange(const std::shared_ptr< exchange::Exchange >& exchange)
+    {
+        exchange_ = exchange;
+        touch();
+    }
+
     const std::string& getSymbol() const { return symbol_; }
     void setSymbol(const std::string& symbol) { symbol_ = symbol; }
 
     // Futures-specific getters and setters
     std::optional< double > getMarkPrice() const;
-    void setMarkPrice(double price) { mark_price_ = price; }
-    void clearMarkPrice() { mark_price_.reset(); }
+    void setMarkPrice(double price) { mark_price_ = price; touch(); }
+    void clearMarkPrice() { mark_price_.reset(); touch(); }
 
     std::optional< double > getFundingRate() const;
     void setFundingRate(double rate) { funding_rate_ = rate; }
@@ -82,8 +138,8 @@ class Position
     void clearNextFundingTimestamp() { next_funding_timestamp_.reset(); }
 
     std::optional< double > getLiquidationPrice() const;
-    void setLiquidationPrice(double price) { liquidation_price_ = price; }
-    void clearLiquidationPrice() { liquidation_price_.reset(); }
+    void setLiquidationPrice(double price) { liquidation_price_ = price; touch(); }
+    void clearLiquidationPrice() { liquidation_price_.reset(); touch(); }
 
     // Calculated properties
     double getValue() const;
@@ -118,6 +174,18 @@ class Position
     // Convert to JSON
     nlohmann::json toJson() const;
 
+    /**
+     * @brief Version of the position, bumped by every change to an input of the derived metrics
+     */
+    uint64_t getVersion() const { return version_; }
+
+    /**
+     * @brief All derived metrics at the current version
+     *
+     * @return const PositionSnapshot& Snapshot owned by the position, valid until the next mutation
+     */
+    const PositionSnapshot& getSnapshot() const;
+
    private:
     boost::uuids::uuid id_;
     std::optional< double > entry_price_;
@@ -139,7 +207,37 @@ class Position
     std::string symbol_;
     std::optional< std::string > strategy_;
 
+    uint64_t version_ = 1;
+    mutable PositionSnapshot snapshot_;
+
+    // Running totals of the PositionsState storing this position, overall and of the exchange it was stored under,
+    // and what the position currently adds to them. Copies start unbound so only the stored instance feeds the totals.
+    struct TotalsLink
+    {
+        PortfolioMetrics* totals_          = nullptr;
+        PortfolioMetrics* exchange_totals_ = nullptr;
+        PortfolioMetrics contribution_;
+
+        TotalsLink() = default;
+        TotalsLink(const TotalsLink&) noexcept {}
+        TotalsLink& operator=(const TotalsLink&) noexcept { return *this; }
+    };
+    TotalsLink totals_link_;
+
+    friend class PositionsState;
+
     // Helper methods
+    template < typename Other >
+    void assignFields(Other&& other);
+    void touch();
+    void bindTotals(PortfolioMetrics* totals, PortfolioMetrics* exchange_totals);
+    void syncSnapshot() const;
+    double computeValue() const;
+    double computeRoi() const;
+    double computeTotalCost() const;
+    double computeLeverage() const;
+    double computePnl() const;
+    std::optional< double > computeLiquidationPrice() const;
     void close();
     void open();
     void updateQty(double qty, const Operation& operation = Operation::SET);
@@ -158,21 +256,65 @@ class PositionsState
     // Initialize positions state
     void init();
 
-    // Get the number of open positions
-    int countOpenPositions() const;
+    /**
+     * @brief Drop all positions and zero the running totals
+     */
+    void reset();
+
+    /**
+     * @brief Store a position under its exchange and symbol, replacing the one already stored there
+     *
+     * A position without an exchange is bound to the registered exchange of its name.
+     *
+     * @return size_t Route index of the position
+     */
+    size_t addPosition(const std::shared_ptr< Position >& position);
+
+    // Get the number of open positions in O(1)
+    int countOpenPositions() const { return totals_.open_positions_; }
 
     // Get position by exchange and symbol
     std::shared_ptr< Position > getPosition(const enums::ExchangeName& exchange_name, const std::string& symbol);
 
+    /**
+     * @brief Get the route index of a pair, stable until reset
+     *
+     * @throws std::out_of_range If no position is stored for the pair
+     */
+    size_t getRouteIndex(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
+    /**
+     * @brief Get a position by route index without hashing the pair
+     */
+    const std::shared_ptr< Position >& getPosition(size_t route_index) const { return positions_.at(route_index); }
+
+    size_t countRoutes() const { return positions_.size(); }
+
+    /**
+     * @brief Metrics summed over all open positions, kept up to date by the positions themselves
+     */
+    const PortfolioMetrics& getPortfolioMetrics() const { return totals_; }
+
+    /**
+     * @brief Metrics summed over the open positions of one exchange in O(1), zero if it has none
+     */
+    const PortfolioMetrics& getPortfolioMetrics(const enums::ExchangeName& exchange_name) const;
+
    private:
-    PositionsState()  = default;
-    ~PositionsState() = default;
+    PositionsState() = default;
+    ~PositionsState();
 
     // Deleted to enforce Singleton
     PositionsState(const PositionsState&)            = delete;
     PositionsState& operator=(const PositionsState&) = delete;
 
-    std::map< std::string, std::shared_ptr< Position > > storage_;
+    // Dense storage indexed by route, routes_ maps a pair key to its index
+    std::vector< std::shared_ptr< Position > > positions_;
+    std::unordered_map< std::string, size_t > routes_;
+
+    PortfolioMetrics totals_;
+    // Nodes are stable, positions keep pointers to the totals of their exchange
+    std::unordered_map< enums::ExchangeName, PortfolioMetrics > exchange_totals_;
 };
 
 } // namespace position
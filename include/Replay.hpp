@@ -0,0 +1,194 @@
+#pragma once
+
+#include "DB.hpp"
+#include "Enum.hpp"
+#include "OrderbookArchive.hpp"
+
+namespace ct
+{
+namespace replay
+{
+
+enum class EventType
+{
+    ORDERBOOK,
+    TRADE,
+    AGGREGATED_TRADE,
+};
+
+/**
+ * @brief A single event handed to the state singletons during replay
+ */
+struct ReplayEvent
+{
+    int64_t timestamp_;
+    EventType type_;
+    enums::ExchangeName exchange_name_;
+    const std::string* symbol_;
+};
+
+/**
+ * @brief Replays stored orderbook snapshots and trades in timestamp order
+ *
+ * Each exchange/symbol/type combination is a separate stream. Streams are merged with a
+ * min-heap keyed by the timestamp of their next event, so the merge costs O(log k) per event
+ * for k streams. Orderbook streams keep their data as encoded archive batches and decode one
+ * batch at a time, which keeps memory flat regardless of the replayed range.
+ *
+ * Orderbook events go to OrderbooksState::addFormattedOrderbook, raw trades to
+ * TradesState::addTrade and stored (already aggregated) trades to TradesState::addAggregatedTrade.
+ */
+class ReplayEngine
+{
+   public:
+    ReplayEngine()  = default;
+    ~ReplayEngine() = default;
+
+    ReplayEngine(const ReplayEngine&)            = delete;
+    ReplayEngine& operator=(const ReplayEngine&) = delete;
+
+    /**
+     * @brief Add an orderbook stream made of encoded archive batches
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param batches Encoded batches ordered by their first timestamp
+     * @param start_timestamp Events before this timestamp are skipped
+     * @param finish_timestamp Events after this timestamp are skipped
+     */
+    void addOrderbookStream(const enums::ExchangeName& exchange_name,
+                            const std::string& symbol,
+                            std::vector< std::vector< uint8_t > > batches,
+                            int64_t start_timestamp  = std::numeric_limits< int64_t >::min(),
+                            int64_t finish_timestamp = std::numeric_limits< int64_t >::max());
+
+    /**
+     * @brief Add a raw trade stream
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param trades Rows of [timestamp, price, qty, side] where side is 1 for buy and 0 for sell
+     */
+    void addTradeStream(const enums::ExchangeName& exchange_name,
+                        const std::string& symbol,
+                        blaze::DynamicMatrix< double > trades);
+
+    /**
+     * @brief Add a stream of aggregated trades
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param trades Rows of [timestamp, price, buy_qty, sell_qty, buy_count, sell_count]
+     */
+    void addAggregatedTradeStream(const enums::ExchangeName& exchange_name,
+                                  const std::string& symbol,
+                                  blaze::DynamicMatrix< double > trades);
+
+    /**
+     * @brief Load the archived orderbooks of a symbol from the database as a stream
+     */
+    void loadOrderbooks(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                        const enums::ExchangeName& exchange_name,
+                        const std::string& symbol,
+                        int64_t start_timestamp,
+                        int64_t finish_timestamp);
+
+    /**
+     * @brief Load the stored trades of a symbol from the database as an aggregated stream
+     */
+    void loadTrades(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                    const enums::ExchangeName& exchange_name,
+                    const std::string& symbol,
+                    int64_t start_timestamp,
+                    int64_t finish_timestamp);
+
+    /**
+     * @brief Load an orderbook stream from a local file written by writeOrderbookFile
+     */
+    void loadOrderbookFile(const std::filesystem::path& path,
+                           const enums::ExchangeName& exchange_name,
+                           const std::string& symbol,
+                           int64_t start_timestamp  = std::numeric_limits< int64_t >::min(),
+                           int64_t finish_timestamp = std::numeric_limits< int64_t >::max());
+
+    /**
+     * @brief Load a raw trade stream from a local file written by writeTradeFile
+     */
+    void loadTradeFile(const std::filesystem::path& path,
+                       const enums::ExchangeName& exchange_name,
+                       const std::string& symbol);
+
+    /**
+     * @brief Write encoded orderbook batches to a local file
+     *
+     * @param path Output file
+     * @param batches Encoded batches ordered by their first timestamp
+     */
+    static void writeOrderbookFile(const std::filesystem::path& path,
+                                   const std::vector< std::vector< uint8_t > >& batches);
+
+    /**
+     * @brief Write raw trades to a local file
+     *
+     * @param path Output file
+     * @param trades Rows of [timestamp, price, qty, side]
+     */
+    static void writeTradeFile(const std::filesystem::path& path, const blaze::DynamicMatrix< double >& trades);
+
+    /**
+     * @brief Set the replay speed
+     *
+     * @param speed Multiple of real time (1.0 is real time), 0 replays as fast as possible
+     */
+    void setSpeed(double speed);
+
+    /**
+     * @brief Register a callback invoked after every event has been applied
+     */
+    void setOnEvent(std::function< void(const ReplayEvent&) > on_event) { on_event_ = std::move(on_event); }
+
+    /**
+     * @brief Reset the state of every replayed pair and run the replay to completion
+     *
+     * @return size_t Number of events replayed
+     */
+    size_t run();
+
+    /**
+     * @brief Ask a running replay to stop after the current event
+     */
+    void stop() { stopped_.store(true, std::memory_order_relaxed); }
+
+   private:
+    struct Stream
+    {
+        EventType type_;
+        enums::ExchangeName exchange_name_;
+        std::string symbol_;
+
+        // Orderbook streams
+        std::vector< std::vector< uint8_t > > batches_;
+        size_t next_batch_ = 0;
+        std::vector< int64_t > timestamps_;
+        std::vector< orderbook::OrderbookSnapshot > snapshots_;
+        int64_t start_timestamp_  = std::numeric_limits< int64_t >::min();
+        int64_t finish_timestamp_ = std::numeric_limits< int64_t >::max();
+
+        // Trade streams
+        blaze::DynamicMatrix< double > trades_;
+
+        size_t cursor_ = 0;
+    };
+
+    bool advance(Stream& stream);
+    int64_t currentTimestamp(const Stream& stream) const;
+    void apply(const Stream& stream);
+
+    std::vector< Stream > streams_;
+    double speed_ = 0;
+    std::function< void(const ReplayEvent&) > on_event_;
+    std::atomic< bool > stopped_{false};
+};
+
+} // namespace replay
+} // namespace ct
@@ -0,0 +1,123 @@
+#pragma once
+
+namespace ct
+{
+namespace datastructure
+{
+
+/**
+ * @brief Single-writer / multi-reader publication slot based on a sequence lock
+ *
+ * The writer bumps the sequence to an odd value, copies the value in and bumps it to the
+ * next even value. Readers copy the value out and retry if the sequence was odd or changed
+ * meanwhile, so they always observe a complete snapshot without taking a mutex. The payload
+ * is kept in relaxed atomic words, which makes the concurrent copy well defined.
+ *
+ * Only one thread may call store() at a time.
+ *
+ * @tparam T Trivially copyable payload
+ */
+template < typename T >
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable_v< T >, "Seqlock payload must be trivially copyable");
+    static_assert(std::is_default_constructible_v< T >, "Seqlock payload must be default constructible");
+
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+   public:
+    Seqlock()
+    {
+        for (auto& word : words_)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    explicit Seqlock(const T& value) : Seqlock() { store(value); }
+
+    Seqlock(const Seqlock&)            = delete;
+    Seqlock& operator=(const Seqlock&) = delete;
+
+    /**
+     * @brief Publish a new value (writer side)
+     *
+     * @param value Value to publish
+     */
+    void store(const T& value)
+    {
+        uint64_t buffer[WORDS] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        const uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; ++i)
+        {
+            words_[i].store(buffer[i], std::memory_order_relaxed);
+        }
+
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Try to read a consistent copy once
+     *
+     * @param out Destination, only written on success
+     * @return bool False if a write was in progress or happened during the copy
+     */
+    bool tryLoad(T& out) const
+    {
+        const uint64_t before = seq_.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            return false;
+        }
+
+        uint64_t buffer[WORDS];
+        for (size_t i = 0; i < WORDS; ++i)
+        {
+            buffer[i] = words_[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) != before)
+        {
+            return false;
+        }
+
+        std::memcpy(&out, buffer, sizeof(T));
+        return true;
+    }
+
+    /**
+     * @brief Read a consistent copy, retrying while the writer is active
+     *
+     * @return T Latest published value
+     */
+    T load() const
+    {
+        T out;
+        for (size_t spins = 0; !tryLoad(out); ++spins)
+        {
+            if (spins >= 64)
+            {
+                std::this_thread::yield();
+            }
+        }
+        return out;
+    }
+
+    /**
+     * @brief Number of completed publications
+     */
+    uint64_t version() const { return seq_.load(std::memory_order_acquire) / 2; }
+
+   private:
+    alignas(64) std::atomic< uint64_t > seq_{0};
+    alignas(64) std::array< std::atomic< uint64_t >, WORDS > words_;
+};
+
+} // namespace datastructure
+} // namespace ct
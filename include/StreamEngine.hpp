@@ -0,0 +1,143 @@
+#pragma once
+
+#include "EventQueue.hpp"
+#include "Enum.hpp"
+
+namespace ct
+{
+namespace stream
+{
+
+enum class StreamEventType
+{
+    BALANCE,
+    POSITION,
+    ORDER_EXECUTION,
+    ORDER_CANCELLATION,
+};
+
+/**
+ * @brief A message from an exchange stream, applied to the state by the engine thread
+ *
+ * Payloads are the ones the state classes already accept: the exchange onUpdateFromStream data for
+ * BALANCE, the Position::onUpdateFromStream data for POSITION and an object holding the
+ * "exchange_id" of the order for the order events.
+ */
+struct StreamEvent
+{
+    StreamEventType type_ = StreamEventType::BALANCE;
+    enums::ExchangeName exchange_name_;
+    std::string symbol_;
+    nlohmann::json data_;
+    // Steady clock nanoseconds at which the message was received, stamped by post when left at 0
+    int64_t received_at_ = 0;
+};
+
+/**
+ * @brief Latency from message receive to state applied
+ */
+struct LatencyStats
+{
+    uint64_t count_ = 0;
+    double mean_us_ = 0.0;
+    double max_us_  = 0.0;
+    // Upper bounds of the power of two buckets holding the percentiles
+    double p50_us_ = 0.0;
+    double p99_us_ = 0.0;
+};
+
+/**
+ * @brief Serialises stream updates onto a single state-owning thread
+ *
+ * Network threads post events into a lock-free MPSC queue and return immediately. One engine
+ * thread pops them in order and runs the handler of their type, so state mutations never race
+ * each other. Handlers default to the state singletons and can be replaced before start.
+ *
+ * The engine is opt-in: the onUpdateFromStream methods of the exchanges and positions still apply
+ * updates on the calling thread, a stream client that wants them serialised posts here instead.
+ */
+class StreamEngine
+{
+   public:
+    using Handler = std::function< void(const StreamEvent& event) >;
+
+    /**
+     * @param capacity Queue size, a power of two
+     */
+    explicit StreamEngine(size_t capacity = 65536);
+    ~StreamEngine();
+
+    StreamEngine(const StreamEngine&)            = delete;
+    StreamEngine& operator=(const StreamEngine&) = delete;
+
+    /**
+     * @brief Start the engine thread
+     */
+    void start();
+
+    /**
+     * @brief Apply the events still queued and join the engine thread
+     */
+    void stop();
+
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Queue an event, safe to call from any thread
+     *
+     * Events posted before start are applied once the engine runs. While the engine runs and the
+     * queue is full this spins, every wait is counted by countQueueFull.
+     *
+     * @param event Event to apply
+     * @throws std::runtime_error If the queue is full and the engine is not running
+     */
+    void post(StreamEvent event);
+
+    /**
+     * @brief Replace the handler of an event type, must not be called while running
+     */
+    void setHandler(StreamEventType type, Handler handler);
+
+    uint64_t countApplied() const { return applied_.load(std::memory_order_relaxed); }
+    uint64_t countFailed() const { return failed_.load(std::memory_order_relaxed); }
+    uint64_t countQueueFull() const { return queue_full_.load(std::memory_order_relaxed); }
+    size_t countPending() const { return queue_.size(); }
+
+    LatencyStats getLatencyStats() const;
+
+    /**
+     * @brief Steady clock nanoseconds, the time base of StreamEvent::received_at_
+     */
+    static int64_t now();
+
+   private:
+    static constexpr size_t LATENCY_BUCKETS = 64;
+
+    void run();
+    void apply(const StreamEvent& event);
+    void recordLatency(uint64_t latency_ns);
+
+    static void applyBalance(const StreamEvent& event);
+    static void applyPosition(const StreamEvent& event);
+    static void applyOrderExecution(const StreamEvent& event);
+    static void applyOrderCancellation(const StreamEvent& event);
+
+    datastructure::MpscQueue< StreamEvent > queue_;
+    std::array< Handler, 4 > handlers_;
+
+    std::atomic< bool > running_{false};
+    std::unique_ptr< std::thread > thread_;
+
+    std::atomic< uint64_t > applied_{0};
+    std::atomic< uint64_t > failed_{0};
+    std::atomic< uint64_t > queue_full_{0};
+
+    // Written by the engine thread only, atomics so stats can be read from any thread
+    std::atomic< uint64_t > latency_sum_ns_{0};
+    std::atomic< uint64_t > latency_max_ns_{0};
+    // Bucket i counts latencies in [2^i, 2^(i + 1)) nanoseconds
+    std::array< std::atomic< uint64_t >, LATENCY_BUCKETS > latency_buckets_{};
+};
+
+} // namespace stream
+} // namespace ct
@@ -1,6 +1,5 @@
 #pragma once
 
-#include "DynamicArray.hpp"
 #include "Enum.hpp"
 
 namespace ct
@@ -8,26 +7,138 @@ namespace ct
 namespace ticker
 {
 
+/**
+ * @brief Number of columns of a ticker row: [timestamp, last_price, high_price, low_price, volume]
+ */
+constexpr size_t TICKER_COLUMNS = 5;
+
+/**
+ * @brief Default number of tickers kept per pair, enough for getPastTicker(120)
+ */
+constexpr size_t TICKER_CAPACITY = 128;
+
+/**
+ * @brief State for managing ticker state
+ *
+ * Every exchange/symbol pair keeps its tickers in a fixed-capacity ring stored column by
+ * column, so the current ticker is O(1) and nothing is reallocated or shifted on append.
+ * Each pair also records when the last ticker was received (throttled or not), which makes
+ * detecting dead feeds a constant time check.
+ */
 class TickersState
 {
    public:
     TickersState()  = default;
     ~TickersState() = default;
 
+    /**
+     * @brief Get the shared instance
+     *
+     * @return TickersState& Reference to the shared instance
+     */
+    static TickersState& getInstance()
+    {
+        static TickersState instance;
+        return instance;
+    }
+
+    /**
+     * @brief Initialize storage for all routes
+     */
     void init();
 
+    /**
+     * @brief Create (or reset) storage for a single exchange/symbol pair
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param capacity Number of tickers kept
+     */
+    void initSymbol(const enums::ExchangeName& exchange_name,
+                    const std::string& symbol,
+                    size_t capacity = TICKER_CAPACITY);
+
+    /**
+     * @brief Add a ticker, stored at most once per second
+     *
+     * @param ticker [timestamp, last_price, high_price, low_price, volume]
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     */
     void addTicker(const blaze::DynamicVector< double, blaze::rowVector >& ticker,
                    const enums::ExchangeName& exchange_name,
                    const std::string& symbol);
+
+    /**
+     * @brief Get all kept tickers, oldest first
+     */
     blaze::DynamicMatrix< double > getTickers(const enums::ExchangeName& exchange_name,
                                               const std::string& symbol) const;
-    auto getCurrentTicker(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
-    auto getPastTicker(const enums::ExchangeName& exchange_name,
-                       const std::string& symbol,
-                       int numberOfTickersAgo) const;
+
+    /**
+     * @brief Get the latest ticker in O(1)
+     *
+     * @throws std::out_of_range If no ticker was stored yet
+     */
+    blaze::StaticVector< double, TICKER_COLUMNS, blaze::rowVector > getCurrentTicker(
+        const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
+    /**
+     * @brief Get a past ticker
+     *
+     * @param numberOfTickersAgo 0 is the current ticker, at most 120
+     * @throws std::out_of_range If fewer tickers are stored
+     */
+    blaze::StaticVector< double, TICKER_COLUMNS, blaze::rowVector > getPastTicker(
+        const enums::ExchangeName& exchange_name, const std::string& symbol, int numberOfTickersAgo) const;
+
+    /**
+     * @brief Number of stored tickers of a pair
+     */
+    size_t count(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
+    /**
+     * @brief Local time when the last ticker of a pair was received
+     *
+     * @return int64_t Timestamp in milliseconds, 0 if nothing was received yet
+     */
+    int64_t getLastUpdated(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
+    /**
+     * @brief Whether the feed of a pair has been silent for longer than max_age_ms
+     *
+     * @param now Reference time, defaults to the current time
+     */
+    bool isStale(const enums::ExchangeName& exchange_name,
+                 const std::string& symbol,
+                 int64_t max_age_ms,
+                 std::optional< int64_t > now = std::nullopt) const;
+
+    /**
+     * @brief Keys of all pairs whose feed has been silent for longer than max_age_ms
+     */
+    std::vector< std::string > getStaleKeys(int64_t max_age_ms, std::optional< int64_t > now = std::nullopt) const;
 
    private:
-    std::unordered_map< std::string, std::shared_ptr< datastructure::DynamicBlazeArray< double > > > storage_;
+    struct TickerRing
+    {
+        size_t capacity_ = 0;
+        size_t head_     = 0;
+        size_t size_     = 0;
+
+        // Local receive time of the latest ticker, updated even when the ticker is throttled
+        int64_t last_updated_ = 0;
+
+        std::array< std::vector< double >, TICKER_COLUMNS > columns_;
+
+        size_t physical(size_t index) const { return (head_ + index) % capacity_; }
+    };
+
+    const TickerRing& getRing(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
+    blaze::StaticVector< double, TICKER_COLUMNS, blaze::rowVector > rowAt(const TickerRing& ring, size_t index) const;
+
+    std::unordered_map< std::string, TickerRing > storage_;
 };
 
 } // namespace ticker
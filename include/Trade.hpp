@@ -4,6 +4,7 @@
 #include "DynamicArray.hpp"
 #include "Enum.hpp"
 #include "Position.hpp"
+#include "TradeTape.hpp"
 
 namespace ct
 {
@@ -35,6 +36,14 @@ class TradesState
      */
     void init();
 
+    /**
+     * @brief Create (or reset) storage for a single exchange/symbol pair
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     */
+    void initSymbol(const enums::ExchangeName& exchange_name, const std::string& symbol);
+
     /**
      * @brief Add a trade to the state
      *
@@ -46,6 +55,42 @@ class TradesState
                   const enums::ExchangeName& exchange_name,
                   const std::string& symbol);
 
+    /**
+     * @brief Append an already aggregated one second bucket
+     *
+     * Used when replaying stored trades, which are persisted in aggregated form.
+     *
+     * @param trade [timestamp, price, buy_qty, sell_qty, buy_count, sell_count]
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     */
+    void addAggregatedTrade(const blaze::StaticVector< double, 6UL, blaze::rowVector >& trade,
+                            const enums::ExchangeName& exchange_name,
+                            const std::string& symbol);
+
+    /**
+     * @brief Start keeping raw trades of a pair on a tape
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @param capacity Maximum number of raw trades kept
+     * @param retention_ms Maximum age of kept trades relative to the newest one, 0 to bound by capacity only
+     */
+    void enableTape(const enums::ExchangeName& exchange_name,
+                    const std::string& symbol,
+                    size_t capacity,
+                    int64_t retention_ms = 0);
+
+    /**
+     * @brief Get the raw trade tape of a pair
+     *
+     * @param exchange_name Exchange name
+     * @param symbol Trading symbol
+     * @return const TradeTape& The tape
+     * @throws std::runtime_error If no tape was enabled for the pair
+     */
+    const TradeTape& getTape(const enums::ExchangeName& exchange_name, const std::string& symbol) const;
+
     /**
      * @brief Get all trades for a specific exchange and symbol
      *
@@ -82,8 +127,23 @@ class TradesState
     // Storage for aggregated trades data
     std::unordered_map< std::string, std::shared_ptr< datastructure::DynamicBlazeArray< double > > > storage_;
 
-    // Temporary storage for individual trades before aggregation
-    std::unordered_map< std::string, std::shared_ptr< datastructure::DynamicBlazeArray< double > > > temp_storage_;
+    // Running totals of the trades received since the current one second bucket started
+    struct TradeAccumulator
+    {
+        size_t count_           = 0;
+        double first_timestamp_ = 0;
+        double turnover_        = 0;
+        double qty_             = 0;
+        double buy_qty_         = 0;
+        double sell_qty_        = 0;
+        size_t buy_count_       = 0;
+        size_t sell_count_      = 0;
+    };
+
+    std::unordered_map< std::string, TradeAccumulator > accumulators_;
+
+    // Optional raw trade tapes, only for pairs that enabled one
+    std::unordered_map< std::string, std::unique_ptr< TradeTape > > tapes_;
 };
 
 /**
@@ -0,0 +1,118 @@
+#pragma once
+
+namespace ct
+{
+namespace trade
+{
+
+/**
+ * @brief Buy/sell totals over a window of the tape
+ */
+struct TapeVolume
+{
+    double buy_qty_    = 0;
+    double sell_qty_   = 0;
+    size_t buy_count_  = 0;
+    size_t sell_count_ = 0;
+};
+
+/**
+ * @brief Append-only ring of raw trades stored column by column
+ *
+ * Keeps the most recent trades of one symbol, bounded by a fixed capacity and optionally by
+ * a retention window. Timestamps are kept non-decreasing (a late print is stamped with the
+ * last seen timestamp), so time ranges are located with a binary search in O(log n).
+ */
+class TradeTape
+{
+   public:
+    /**
+     * @brief Construct a new tape
+     *
+     * @param capacity Maximum number of trades kept
+     * @param retention_ms Trades older than this relative to the newest one are dropped, 0 keeps up to capacity
+     */
+    explicit TradeTape(size_t capacity, int64_t retention_ms = 0);
+
+    /**
+     * @brief Append a trade, evicting the oldest ones if needed
+     *
+     * @param timestamp Trade timestamp in milliseconds
+     * @param price Trade price
+     * @param qty Trade quantity
+     * @param side 1 for buy, 0 for sell
+     */
+    void append(int64_t timestamp, double price, double qty, double side);
+
+    /**
+     * @brief Remove all trades
+     */
+    void clear();
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    int64_t getRetention() const { return retention_ms_; }
+
+    /**
+     * @brief Access a trade by age, 0 being the oldest kept trade
+     */
+    int64_t getTimestamp(size_t index) const { return timestamps_[physical(index)]; }
+    double getPrice(size_t index) const { return prices_[physical(index)]; }
+    double getQty(size_t index) const { return qtys_[physical(index)]; }
+    double getSide(size_t index) const { return sides_[physical(index)]; }
+
+    /**
+     * @brief Locate the trades with start <= timestamp <= finish
+     *
+     * @return std::pair< size_t, size_t > Half-open [first, last) range of indices
+     */
+    std::pair< size_t, size_t > range(int64_t start_timestamp, int64_t finish_timestamp) const;
+
+    /**
+     * @brief Copy the trades of a time window
+     *
+     * @return blaze::DynamicMatrix< double > Rows of [timestamp, price, qty, side]
+     */
+    blaze::DynamicMatrix< double > getTrades(int64_t start_timestamp, int64_t finish_timestamp) const;
+
+    /**
+     * @brief Volume weighted average price of a time window
+     *
+     * @return double VWAP, NaN when the window holds no quantity
+     */
+    double vwap(int64_t start_timestamp, int64_t finish_timestamp) const;
+
+    /**
+     * @brief Buy and sell totals of a time window
+     */
+    TapeVolume volume(int64_t start_timestamp, int64_t finish_timestamp) const;
+
+    /**
+     * @brief Volume per price level over a time window
+     *
+     * @param start_timestamp Inclusive start in milliseconds
+     * @param finish_timestamp Inclusive end in milliseconds
+     * @param price_step Width of a price level, prices are floored to a multiple of it
+     * @return blaze::DynamicMatrix< double > Rows of [level price, buy qty, sell qty] ordered by price
+     */
+    blaze::DynamicMatrix< double > volumeProfile(int64_t start_timestamp,
+                                                 int64_t finish_timestamp,
+                                                 double price_step) const;
+
+   private:
+    size_t physical(size_t index) const;
+    void dropOldest();
+
+    size_t capacity_;
+    int64_t retention_ms_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+
+    std::vector< int64_t > timestamps_;
+    std::vector< double > prices_;
+    std::vector< double > qtys_;
+    std::vector< double > sides_;
+};
+
+} // namespace trade
+} // namespace ct
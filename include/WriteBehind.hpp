@@ -0,0 +1,343 @@
+#ifndef CT_WRITE_BEHIND_HPP
+#define CT_WRITE_BEHIND_HPP
+
+#include "DB.hpp"
+#include "EventQueue.hpp"
+
+namespace ct
+{
+namespace db
+{
+
+/**
+ * @brief Backpressure and throughput counters of one model queue
+ *
+ * coalesced_ counts writes replaced by a later write of the same row within a batch, rejected_ the tryEnqueue calls
+ * that found the queue full and stalls_ the enqueue calls that had to wait for room, stall_ns_ is the time they
+ * waited.
+ */
+struct WriteBehindStats
+{
+    size_t depth_       = 0;
+    size_t max_depth_   = 0;
+    size_t capacity_    = 0;
+    uint64_t enqueued_  = 0;
+    uint64_t written_   = 0;
+    uint64_t failed_    = 0;
+    uint64_t batches_   = 0;
+    uint64_t coalesced_ = 0;
+    uint64_t rejected_  = 0;
+    uint64_t stalls_    = 0;
+    uint64_t stall_ns_  = 0;
+};
+
+/**
+ * @brief Queue of pending writes of one model, drained by a single writer thread
+ */
+class WriteBehindLane
+{
+   public:
+    explicit WriteBehindLane(const char* name, size_t capacity) : name_(name), capacity_(capacity) {}
+    virtual ~WriteBehindLane() = default;
+
+    const char* getName() const { return name_; }
+
+    /**
+     * @brief Take up to max queued writes and store them, writer thread only
+     *
+     * A failed batch is retried row by row, rows failing again are logged and counted as failed.
+     *
+     * @param conn Connection of the writer, replaced if it broke
+     * @param max Largest number of writes to take
+     * @return size_t Number of writes taken from the queue
+     */
+    virtual size_t writeBatch(std::shared_ptr< sqlpp::postgresql::connection >& conn, size_t max) = 0;
+
+    virtual size_t size() const = 0;
+
+    WriteBehindStats getStats() const;
+
+   protected:
+    void onEnqueued(size_t depth);
+    void onStalled(uint64_t ns);
+    void onRejected();
+    void onWritten(uint64_t written, uint64_t coalesced);
+    void onFailed(uint64_t failed);
+
+   private:
+    const char* name_;
+    const size_t capacity_;
+
+    std::atomic< size_t > max_depth_{0};
+    std::atomic< uint64_t > enqueued_{0};
+    std::atomic< uint64_t > written_{0};
+    std::atomic< uint64_t > coalesced_{0};
+    std::atomic< uint64_t > failed_{0};
+    std::atomic< uint64_t > batches_{0};
+    std::atomic< uint64_t > rejected_{0};
+    std::atomic< uint64_t > stalls_{0};
+    std::atomic< uint64_t > stall_ns_{0};
+};
+
+template < typename ModelType >
+class ModelWriteLane : public WriteBehindLane
+{
+   public:
+    /**
+     * @param name Table name used in log messages
+     * @param capacity Queue size, a power of two
+     */
+    ModelWriteLane(const char* name, size_t capacity) : WriteBehindLane(name, capacity), queue_(capacity) {}
+
+    /**
+     * @brief Queue a write, safe to call from any thread
+     *
+     * @return bool False if the queue is full, the model is left untouched then
+     */
+    bool tryPush(ModelType& model, bool update_on_conflict)
+    {
+        if (insert(model, update_on_conflict))
+        {
+            return true;
+        }
+
+        onRejected();
+        return false;
+    }
+
+    /**
+     * @brief Queue a write, waiting for the writer to make room if the queue is full
+     *
+     * @param wake Called once when the queue is found full so the writer can be woken up
+     */
+    template < typename Wake >
+    void push(ModelType& model, bool update_on_conflict, Wake&& wake);
+
+    size_t writeBatch(std::shared_ptr< sqlpp::postgresql::connection >& conn, size_t max) override;
+
+    // The queue size is approximate while producers are active, it may briefly count a slot twice
+    size_t size() const override { return std::min(queue_.size(), queue_.capacity()); }
+
+   private:
+    struct PendingWrite
+    {
+        std::optional< ModelType > model_;
+        bool update_on_conflict_ = false;
+    };
+
+    bool insert(ModelType& model, bool update_on_conflict);
+
+    datastructure::MpscQueue< PendingWrite > queue_;
+};
+
+/**
+ * @brief Write-behind persistence for the models saved on the trading path
+ *
+ * save() blocks the caller on the pool and on a server round trip. While running, enqueue() hands the model to a
+ * bounded lock-free queue of its model instead and returns. Writer threads drain the queues every interval, or
+ * as soon as a queue holds a full batch, and store every batch at once: candles with a binary COPY merged on the
+ * unique index, the other models with their saves in one transaction. Writes of the same row within a batch are
+ * coalesced so only the last one is stored.
+ *
+ * Every writer thread keeps a pooled connection checked out while running, so the final drain still works once
+ * the pool refuses new checkouts during shutdown. stop() runs as a DatabaseShutdownManager hook before the pool
+ * waits for its connections.
+ *
+ * While stopped, enqueue() saves synchronously on the calling thread.
+ */
+class WriteBehind
+{
+   public:
+    static WriteBehind& getInstance();
+
+    /**
+     * @brief Start the writer threads, the pool must be initialized
+     *
+     * @param writers Number of writer threads, each holds one connection
+     * @param capacity Queue size of every model, a power of two
+     * @param batch_size Largest number of rows written at once
+     * @param interval Longest time a write waits in the queue while the pipeline is idle
+     * @throws std::invalid_argument If writers or batch_size is 0 or capacity is not a power of two
+     * @throws std::runtime_error If already running or a connection cannot be checked out
+     */
+    void start(size_t writers                     = 2,
+               size_t capacity                    = 16384,
+               size_t batch_size                  = 1024,
+               std::chrono::milliseconds interval = std::chrono::milliseconds(50));
+
+    /**
+     * @brief Write everything still queued and join the writers, later writes are saved synchronously
+     */
+    void stop();
+
+    bool isRunning() const { return running_.load(); }
+
+    /**
+     * @brief Queue a save, waits for room if the queue of the model is full
+     *
+     * @param model Model to store
+     * @param update_on_conflict Passed on to save, a candle conflicting without it is skipped instead of failing
+     */
+    template < typename ModelType >
+    void enqueue(ModelType model, bool update_on_conflict = true);
+
+    /**
+     * @brief Queue a save unless the queue of the model is full
+     *
+     * @param model Model to store, moved from once queued and left untouched if the queue is full
+     * @return bool False if the queue is full, the caller decides whether to wait, save or drop the model
+     */
+    template < typename ModelType >
+    bool tryEnqueue(ModelType& model, bool update_on_conflict = true);
+
+    /**
+     * @brief Block until every write enqueued before the call is stored or given up on
+     */
+    void flush();
+
+    template < typename ModelType >
+    WriteBehindStats getStats() const;
+
+    WriteBehind(const WriteBehind&)            = delete;
+    WriteBehind& operator=(const WriteBehind&) = delete;
+
+   private:
+    WriteBehind() = default;
+    ~WriteBehind();
+
+    template < typename ModelType >
+    ModelWriteLane< ModelType >& getLane() const
+    {
+        return *std::get< std::unique_ptr< ModelWriteLane< ModelType > > >(lanes_);
+    }
+
+    void wake();
+    void runWriter(size_t index, std::shared_ptr< sqlpp::postgresql::connection > conn);
+
+    std::tuple< std::unique_ptr< ModelWriteLane< Candle > >,
+                std::unique_ptr< ModelWriteLane< Order > >,
+                std::unique_ptr< ModelWriteLane< ClosedTrade > >,
+                std::unique_ptr< ModelWriteLane< Log > >,
+                std::unique_ptr< ModelWriteLane< DailyBalance > > >
+        lanes_;
+    std::vector< WriteBehindLane* > all_lanes_;
+
+    std::vector< std::thread > writers_;
+    size_t writer_count_ = 0;
+    size_t batch_size_   = 0;
+    std::chrono::milliseconds interval_{0};
+
+    // Producers announce themselves before checking running_, stop waits for them before the final drain
+    std::atomic< bool > running_{false};
+    std::atomic< size_t > producers_{0};
+    std::atomic< bool > stopping_{false};
+
+    // Serializes start and stop, mutex_ only guards the waits of the writers and of flush
+    std::mutex lifecycle_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable written_;
+    bool hook_registered_ = false;
+};
+
+template < typename ModelType >
+template < typename Wake >
+void ModelWriteLane< ModelType >::push(ModelType& model, bool update_on_conflict, Wake&& wake)
+{
+    if (insert(model, update_on_conflict))
+    {
+        return;
+    }
+
+    wake();
+
+    auto started = std::chrono::steady_clock::now();
+    do
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    } while (!insert(model, update_on_conflict));
+
+    onStalled(std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - started)
+                  .count());
+}
+
+template < typename ModelType >
+bool ModelWriteLane< ModelType >::insert(ModelType& model, bool update_on_conflict)
+{
+    PendingWrite pending;
+    pending.model_.emplace(std::move(model));
+    pending.update_on_conflict_ = update_on_conflict;
+
+    if (!queue_.tryPush(std::move(pending)))
+    {
+        // tryPush leaves a rejected value alone, hand the model back
+        model = std::move(*pending.model_);
+        return false;
+    }
+
+    onEnqueued(size());
+    return true;
+}
+
+template < typename ModelType >
+void WriteBehind::enqueue(ModelType model, bool update_on_conflict)
+{
+    ++producers_;
+    if (!running_.load())
+    {
+        --producers_;
+        model.save(nullptr, update_on_conflict);
+        return;
+    }
+
+    auto& lane = getLane< ModelType >();
+    lane.push(model, update_on_conflict, [this] { wake(); });
+    size_t depth = lane.size();
+    --producers_;
+
+    // A full batch is written right away instead of at the next interval
+    if (depth == batch_size_)
+    {
+        wake();
+    }
+}
+
+template < typename ModelType >
+bool WriteBehind::tryEnqueue(ModelType& model, bool update_on_conflict)
+{
+    ++producers_;
+    if (!running_.load())
+    {
+        --producers_;
+        model.save(nullptr, update_on_conflict);
+        return true;
+    }
+
+    auto& lane   = getLane< ModelType >();
+    bool queued  = lane.tryPush(model, update_on_conflict);
+    size_t depth = lane.size();
+    --producers_;
+
+    if (!queued || depth == batch_size_)
+    {
+        wake();
+    }
+
+    return queued;
+}
+
+template < typename ModelType >
+WriteBehindStats WriteBehind::getStats() const
+{
+    if (!std::get< std::unique_ptr< ModelWriteLane< ModelType > > >(lanes_))
+    {
+        return WriteBehindStats();
+    }
+
+    return getLane< ModelType >().getStats();
+}
+
+} // namespace db
+} // namespace ct
+
+#endif // CT_WRITE_BEHIND_HPP
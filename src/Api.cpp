@@ -51,7 +51,7 @@ void ct::api::Api::initDrivers()
         }
         else
         {
-            drivers_[exchangeName] = std::make_shared< exchange::Sandbox >();
+            drivers_[exchangeName] = std::make_shared< exchange::Sandbox >(exchangeName);
         }
     }
 }
@@ -132,3 +132,30 @@ void ct::api::Api::cancelOrder(const enums::ExchangeName& exchange_name,
 
     drivers_[exchange_name]->cancelOrder(symbol, order_id);
 }
+
+std::optional< std::vector< std::shared_ptr< ct::db::Order > > > ct::api::Api::submitOrders(
+    const enums::ExchangeName& exchange_name, const std::vector< exchange::OrderSpec >& specs)
+{
+    if (drivers_.find(exchange_name) == drivers_.end())
+    {
+        logger::LOG.info("Exchange \"" + enums::toString(exchange_name) +
+                         "\" driver not initiated yet. Trying again in the next candle");
+        return std::nullopt;
+    }
+
+    return drivers_[exchange_name]->submitOrders(specs);
+}
+
+void ct::api::Api::cancelOrders(const enums::ExchangeName& exchange_name,
+                                const std::string& symbol,
+                                const std::vector< std::string >& order_ids)
+{
+    if (drivers_.find(exchange_name) == drivers_.end())
+    {
+        logger::LOG.info("Exchange \"" + enums::toString(exchange_name) +
+                         "\" driver not initiated yet. Trying again in the next candle");
+        return;
+    }
+
+    drivers_[exchange_name]->cancelOrders(symbol, order_ids);
+}
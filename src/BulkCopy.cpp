@@ -0,0 +1,384 @@
+#include "BulkCopy.hpp"
+#include "Logger.hpp"
+
+namespace ct
+{
+namespace db
+{
+
+namespace
+{
+
+// Buffered bytes sent to the server at once
+constexpr size_t COPY_CHUNK_BYTES = 1 << 20;
+
+const char COPY_SIGNATURE[] = "PGCOPY\n\377\r\n";
+
+struct CopyTableSpec
+{
+    const char* name_;
+    // Every column in the order the rows are written
+    const char* columns_;
+    // Columns of the unique index the merge resolves conflicts on
+    const char* key_;
+    const char* update_;
+};
+
+const CopyTableSpec& getTableSpec(CopyTable table)
+{
+    static const CopyTableSpec candles{
+        "candles",
+        "id, timestamp, open, close, high, low, volume, exchange_name, symbol, timeframe",
+        "exchange_name, symbol, timeframe, timestamp",
+        "open = EXCLUDED.open, close = EXCLUDED.close, high = EXCLUDED.high, low = EXCLUDED.low, "
+        "volume = EXCLUDED.volume"};
+    static const CopyTableSpec trades{
+        "trades",
+        "id, timestamp, price, buy_qty, sell_qty, buy_count, sell_count, symbol, exchange_name",
+        "exchange_name, symbol, timestamp",
+        "price = EXCLUDED.price, buy_qty = EXCLUDED.buy_qty, sell_qty = EXCLUDED.sell_qty, "
+        "buy_count = EXCLUDED.buy_count, sell_count = EXCLUDED.sell_count"};
+    static const CopyTableSpec tickers{
+        "tickers",
+        "id, timestamp, last_price, volume, high_price, low_price, symbol, exchange_name",
+        "exchange_name, symbol, timestamp",
+        "last_price = EXCLUDED.last_price, volume = EXCLUDED.volume, high_price = EXCLUDED.high_price, "
+        "low_price = EXCLUDED.low_price"};
+    static const CopyTableSpec orderbooks{"orderbooks",
+                                          "id, timestamp, symbol, exchange_name, data",
+                                          "exchange_name, symbol, timestamp",
+                                          "data = EXCLUDED.data"};
+
+    switch (table)
+    {
+        case CopyTable::CANDLES:
+            return candles;
+        case CopyTable::TRADES:
+            return trades;
+        case CopyTable::TICKERS:
+            return tickers;
+        case CopyTable::ORDERBOOKS:
+            return orderbooks;
+    }
+
+    throw std::invalid_argument("Unknown copy table");
+}
+
+using ResultPtr = std::unique_ptr< PGresult, decltype(&PQclear) >;
+
+ResultPtr exec(PGconn* native, const std::string& sql, ExecStatusType expected)
+{
+    ResultPtr result(PQexec(native, sql.c_str()), PQclear);
+    if (!result || PQresultStatus(result.get()) != expected)
+    {
+        throw std::runtime_error(PQerrorMessage(native));
+    }
+
+    return result;
+}
+
+void drainResults(PGconn* native)
+{
+    while (PGresult* result = PQgetResult(native))
+    {
+        PQclear(result);
+    }
+}
+
+void sendBuffered(PGconn* native, BinaryCopyWriter& writer)
+{
+    if (writer.size() == 0)
+    {
+        return;
+    }
+
+    if (PQputCopyData(native, writer.data(), static_cast< int >(writer.size())) != 1)
+    {
+        throw std::runtime_error(PQerrorMessage(native));
+    }
+    writer.clear();
+}
+
+size_t copyIn(PGconn* native, const std::string& sql, const CopyRowSource& next_row)
+{
+    exec(native, sql, PGRES_COPY_IN);
+
+    BinaryCopyWriter writer;
+    try
+    {
+        while (next_row(writer))
+        {
+            if (writer.size() >= COPY_CHUNK_BYTES)
+            {
+                sendBuffered(native, writer);
+            }
+        }
+        writer.finish();
+        sendBuffered(native, writer);
+    }
+    catch (...)
+    {
+        // Leave the copy state so the connection stays usable, the server discards what was sent
+        PQputCopyEnd(native, "copy aborted by the client");
+        drainResults(native);
+        throw;
+    }
+
+    if (PQputCopyEnd(native, nullptr) != 1)
+    {
+        throw std::runtime_error(PQerrorMessage(native));
+    }
+
+    ResultPtr result(PQgetResult(native), PQclear);
+    bool copied = result && PQresultStatus(result.get()) == PGRES_COMMAND_OK;
+    result.reset();
+    drainResults(native);
+
+    if (!copied)
+    {
+        throw std::runtime_error(PQerrorMessage(native));
+    }
+
+    return writer.countRows();
+}
+
+template < typename WriteRow >
+size_t copyMatrix(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                  CopyTable table,
+                  const blaze::DynamicMatrix< double >& rows,
+                  size_t columns,
+                  WriteRow write_row,
+                  CopyConflict on_conflict)
+{
+    if (rows.columns() < columns)
+    {
+        throw std::invalid_argument("Expected " + std::to_string(columns) + " columns to copy into " +
+                                    getTableSpec(table).name_ + ", got " + std::to_string(rows.columns()));
+    }
+
+    size_t i = 0;
+    return copyRows(
+        conn_ptr,
+        table,
+        [&](BinaryCopyWriter& writer)
+        {
+            if (i == rows.rows())
+            {
+                return false;
+            }
+            write_row(writer, blaze::row(rows, i));
+            ++i;
+            return true;
+        },
+        on_conflict);
+}
+
+} // namespace
+
+BinaryCopyWriter::BinaryCopyWriter()
+{
+    buffer_.reserve(COPY_CHUNK_BYTES + 4096);
+
+    // The signature includes its terminating zero byte
+    buffer_.insert(buffer_.end(), COPY_SIGNATURE, COPY_SIGNATURE + sizeof(COPY_SIGNATURE));
+    // Flags, then the length of the header extension
+    writeBigEndian< int32_t >(0);
+    writeBigEndian< int32_t >(0);
+}
+
+template < typename T >
+void BinaryCopyWriter::writeBigEndian(T value)
+{
+    using Bits = std::make_unsigned_t< T >;
+
+    Bits bits = static_cast< Bits >(value);
+    for (int shift = static_cast< int >(sizeof(T) - 1) * 8; shift >= 0; shift -= 8)
+    {
+        buffer_.push_back(static_cast< char >((bits >> shift) & 0xFF));
+    }
+}
+
+void BinaryCopyWriter::beginRow(int16_t fields)
+{
+    writeBigEndian(fields);
+    ++rows_;
+}
+
+void BinaryCopyWriter::writeNull()
+{
+    writeBigEndian< int32_t >(-1);
+}
+
+void BinaryCopyWriter::writeInt32(int32_t value)
+{
+    writeBigEndian< int32_t >(sizeof(value));
+    writeBigEndian(value);
+}
+
+void BinaryCopyWriter::writeInt64(int64_t value)
+{
+    writeBigEndian< int32_t >(sizeof(value));
+    writeBigEndian(value);
+}
+
+void BinaryCopyWriter::writeDouble(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    writeBigEndian< int32_t >(sizeof(bits));
+    writeBigEndian(bits);
+}
+
+void BinaryCopyWriter::writeText(const std::string& value)
+{
+    writeBytes(reinterpret_cast< const uint8_t* >(value.data()), value.size());
+}
+
+void BinaryCopyWriter::writeBytes(const uint8_t* data, size_t size)
+{
+    writeBigEndian(static_cast< int32_t >(size));
+    buffer_.insert(buffer_.end(), data, data + size);
+}
+
+void BinaryCopyWriter::writeUuid(const boost::uuids::uuid& id)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    writeBigEndian< int32_t >(36);
+    for (size_t i = 0; i < id.size(); ++i)
+    {
+        if (i == 4 || i == 6 || i == 8 || i == 10)
+        {
+            buffer_.push_back('-');
+        }
+        buffer_.push_back(digits[id.data[i] >> 4]);
+        buffer_.push_back(digits[id.data[i] & 0x0F]);
+    }
+}
+
+void BinaryCopyWriter::finish()
+{
+    writeBigEndian< int16_t >(-1);
+}
+
+size_t copyRows(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                CopyTable table,
+                const CopyRowSource& next_row,
+                CopyConflict on_conflict)
+{
+    // Keep a pooled connection checked out until the copy is done
+    auto connection  = conn_ptr ? conn_ptr : Database::getInstance().getConnection();
+    auto& conn       = *connection;
+    const auto& spec = getTableSpec(table);
+
+    // Create state guard for this connection
+    ConnectionStateGuard stateGuard(conn);
+
+    const bool merge          = on_conflict != CopyConflict::FAIL;
+    const std::string staging = std::string("ct_copy_") + spec.name_;
+    PGconn* native            = conn.native_handle();
+
+    try
+    {
+        if (!merge)
+        {
+            return copyIn(native,
+                          std::string("COPY ") + spec.name_ + " (" + spec.columns_ + ") FROM STDIN (FORMAT binary)",
+                          next_row);
+        }
+
+        // The staging table has no indexes, so the copy never conflicts and stays cheap
+        exec(native,
+             "DROP TABLE IF EXISTS pg_temp." + staging + "; CREATE TEMP TABLE " + staging + " (LIKE " + spec.name_ +
+                 " INCLUDING DEFAULTS)",
+             PGRES_COMMAND_OK);
+
+        copyIn(native, "COPY " + staging + " (" + spec.columns_ + ") FROM STDIN (FORMAT binary)", next_row);
+
+        // DO UPDATE may not touch a row twice in one statement, so duplicate keys are collapsed first
+        std::ostringstream merge_sql;
+        merge_sql << "INSERT INTO " << spec.name_ << " (" << spec.columns_ << ") SELECT DISTINCT ON (" << spec.key_
+                  << ") " << spec.columns_ << " FROM " << staging << " ORDER BY " << spec.key_ << " ON CONFLICT ("
+                  << spec.key_ << ") DO ";
+        if (on_conflict == CopyConflict::UPDATE)
+        {
+            merge_sql << "UPDATE SET " << spec.update_;
+        }
+        else
+        {
+            merge_sql << "NOTHING";
+        }
+
+        auto result   = exec(native, merge_sql.str(), PGRES_COMMAND_OK);
+        size_t merged = std::stoull(PQcmdTuples(result.get()));
+
+        exec(native, "DROP TABLE " + staging, PGRES_COMMAND_OK);
+
+        return merged;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error copying into " << spec.name_ << ": " << e.what();
+        logger::LOG.error(oss.str());
+
+        // Mark the connection for reset
+        stateGuard.markForReset();
+
+        throw;
+    }
+}
+
+size_t copyCandles(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                   const enums::ExchangeName& exchange_name,
+                   const std::string& symbol,
+                   const timeframe::Timeframe& timeframe,
+                   const blaze::DynamicMatrix< double >& candles,
+                   CopyConflict on_conflict)
+{
+    const std::string exchange = enums::toString(exchange_name);
+    const std::string tf       = timeframe::toString(timeframe);
+    return copyMatrix(
+        conn_ptr,
+        CopyTable::CANDLES,
+        candles,
+        6,
+        [&](BinaryCopyWriter& writer, const auto& row) { detail::writeCandleRow(writer, row, exchange, symbol, tf); },
+        on_conflict);
+}
+
+size_t copyTrades(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                  const enums::ExchangeName& exchange_name,
+                  const std::string& symbol,
+                  const blaze::DynamicMatrix< double >& trades,
+                  CopyConflict on_conflict)
+{
+    const std::string exchange = enums::toString(exchange_name);
+    return copyMatrix(
+        conn_ptr,
+        CopyTable::TRADES,
+        trades,
+        6,
+        [&](BinaryCopyWriter& writer, const auto& row) { detail::writeTradeRow(writer, row, exchange, symbol); },
+        on_conflict);
+}
+
+size_t copyTickers(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                   const enums::ExchangeName& exchange_name,
+                   const std::string& symbol,
+                   const blaze::DynamicMatrix< double >& tickers,
+                   CopyConflict on_conflict)
+{
+    const std::string exchange = enums::toString(exchange_name);
+    return copyMatrix(
+        conn_ptr,
+        CopyTable::TICKERS,
+        tickers,
+        5,
+        [&](BinaryCopyWriter& writer, const auto& row) { detail::writeTickerRow(writer, row, exchange, symbol); },
+        on_conflict);
+}
+
+} // namespace db
+} // namespace ct
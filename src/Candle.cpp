@@ -10,6 +10,7 @@
 #include "Position.hpp"
 #include "Route.hpp"
 #include "Timeframe.hpp"
+#include "WriteBehind.hpp"
 
 int ct::candle::RandomGenerator::randint(int min, int max)
 {
@@ -261,6 +262,95 @@ auto ct::candle::getCandleSource(const blaze::DynamicMatrix< T >& candles, Sourc
     }
 }
 
+bool ct::candle::isBullish(const blaze::DynamicVector< double, blaze::rowVector >& candle)
+{
+    return candle[_CLOSE_] >= candle[_OPEN_];
+}
+
+bool ct::candle::isBearish(const blaze::DynamicVector< double, blaze::rowVector >& candle)
+{
+    return candle[_CLOSE_] < candle[_OPEN_];
+}
+
+bool ct::candle::candleIncludesPrice(const blaze::DynamicVector< double, blaze::rowVector >& candle, double price)
+{
+    return price >= candle[_LOW_] && price <= candle[_HIGH_];
+}
+
+std::pair< blaze::DynamicVector< double, blaze::rowVector >, blaze::DynamicVector< double, blaze::rowVector > >
+ct::candle::splitCandle(const blaze::DynamicVector< double, blaze::rowVector >& candle, double price)
+{
+    // The path inside a candle is assumed to be open -> low -> high -> close for bullish candles and
+    // open -> high -> low -> close for bearish ones. The earlier candle covers the path up to the first
+    // time price is reached, the later one the rest of the path.
+    using Candle = blaze::DynamicVector< double, blaze::rowVector >;
+
+    const double timestamp = candle[_TIMESTAMP_];
+    const double o         = candle[_OPEN_];
+    const double c         = candle[_CLOSE_];
+    const double h         = candle[_HIGH_];
+    const double l         = candle[_LOW_];
+    const double v         = candle[_VOLUME_];
+
+    const bool bullish = isBullish(candle);
+    const bool bearish = !bullish;
+
+    if (bullish && l < price && price < o)
+    {
+        return {Candle{timestamp, o, price, o, price, v}, Candle{timestamp, price, c, h, l, v}};
+    }
+    if (price == o)
+    {
+        return {candle, candle};
+    }
+    if (bearish && o < price && price < h)
+    {
+        return {Candle{timestamp, o, price, price, o, v}, Candle{timestamp, price, c, h, l, v}};
+    }
+    if (bearish && l < price && price < c)
+    {
+        return {Candle{timestamp, o, price, h, price, v}, Candle{timestamp, price, c, c, l, v}};
+    }
+    if (bullish && c < price && price < h)
+    {
+        return {Candle{timestamp, o, price, price, l, v}, Candle{timestamp, price, c, h, c, v}};
+    }
+    if (bearish && price == c)
+    {
+        return {Candle{timestamp, o, c, h, c, v}, Candle{timestamp, price, price, price, price, v}};
+    }
+    if (bullish && price == c)
+    {
+        return {Candle{timestamp, o, c, c, l, v}, Candle{timestamp, price, price, price, price, v}};
+    }
+    if (bullish && price == h)
+    {
+        return {Candle{timestamp, o, h, h, l, v}, Candle{timestamp, h, c, h, l, v}};
+    }
+    if (bearish && price == l)
+    {
+        return {Candle{timestamp, o, l, h, l, v}, Candle{timestamp, l, c, h, l, v}};
+    }
+    if (bullish && price == l)
+    {
+        return {Candle{timestamp, o, l, o, l, v}, Candle{timestamp, l, c, h, l, v}};
+    }
+    if (bearish && price == h)
+    {
+        return {Candle{timestamp, o, h, h, o, v}, Candle{timestamp, h, c, h, l, v}};
+    }
+    if (bullish && o < price && price < c)
+    {
+        return {Candle{timestamp, o, price, price, l, v}, Candle{timestamp, price, c, h, price, v}};
+    }
+    if (bearish && c < price && price < o)
+    {
+        return {Candle{timestamp, o, price, h, price, v}, Candle{timestamp, price, c, price, l, v}};
+    }
+
+    throw std::invalid_argument("Cannot split a candle at a price outside of its range: " + std::to_string(price));
+}
+
 ct::candle::CandlesState& ct::candle::CandlesState::getInstance()
 {
     static CandlesState instance;
@@ -410,8 +500,9 @@ void ct::candle::CandlesState::addCandle(const enums::ExchangeName& exchange_nam
                                 symbol,
                                 timeframe);
 
+            // Queued off the trading thread while the write-behind runs, saved right away otherwise
             auto update_on_conflict = true;
-            c.save(nullptr, update_on_conflict);
+            db::WriteBehind::getInstance().enqueue(std::move(c), update_on_conflict);
         }
     }
 
@@ -641,20 +732,21 @@ void ct::candle::CandlesState::simulateOrderExecution(
         return;
     }
 
-    auto orders = order::OrdersState::getInstance().getOrders(exchange_name, symbol);
+    // Only the resting orders priced between the two closes are visited
+    const auto& pending = order::OrdersState::getInstance().getPendingOrders(exchange_name, symbol);
+    auto low            = std::min(previousCandle[_CLOSE_], new_candle[_CLOSE_]);
+    auto high           = std::max(previousCandle[_CLOSE_], new_candle[_CLOSE_]);
 
-    for (const auto& order : orders)
+    // Executing an order removes it from the book, so a copy of the triggered orders is walked
+    for (const auto& order : pending.getTriggered(low, high))
     {
-        if (!order->isActive())
+        // An earlier execution may have canceled or replaced it
+        if (!order::PendingOrderBook::isPending(*order))
         {
             continue;
         }
-        if (((order->getPrice() >= previousCandle[_CLOSE_]) && (order->getPrice() <= new_candle[_CLOSE_])) ||
-            ((order->getPrice() <= previousCandle[_CLOSE_]) && (order->getPrice() >= new_candle[_CLOSE_])))
-        {
-            // TODO:
-            // order.execute();
-        }
+
+        order->execute();
     }
 }
 
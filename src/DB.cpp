@@ -3,9 +3,12 @@
 #include "Config.hpp"
 #include "DynamicArray.hpp"
 #include "Enum.hpp"
+#include "Exchange.hpp"
 #include "Helper.hpp"
 #include "Logger.hpp"
+#include "Position.hpp"
 #include "Timeframe.hpp"
+#include "WriteBehind.hpp"
 
 ct::db::DatabaseShutdownManager& ct::db::DatabaseShutdownManager::getInstance()
 {
@@ -114,6 +117,20 @@ void ct::db::DatabaseShutdownManager::performShutdown()
     }
 }
 
+namespace
+{
+
+// Slot the calling thread checked out last, tried first on its next checkout
+thread_local size_t lastSlot = 0;
+
+int64_t steadyNowNs()
+{
+    return std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
 // Get singleton instance
 ct::db::ConnectionPool& ct::db::ConnectionPool::getInstance()
 {
@@ -129,28 +146,45 @@ void ct::db::ConnectionPool::init(const std::string& host,
                                   unsigned int port,
                                   size_t poolSize) // Default pool size
 {
-    std::lock_guard< std::mutex > lock(mutex_);
-
     // Store connection parameters for creating new connections
-    host_     = host;
-    dbname_   = dbname;
-    username_ = username;
-    password_ = password;
-    port_     = port;
+    auto config      = std::make_shared< sqlpp::postgresql::connection_config >();
+    config->debug    = false; // TODO: accept as arg
+    config->host     = host;
+    config->dbname   = dbname;
+    config->user     = username;
+    config->password = password;
+    config->port     = port;
+
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        config_ = config;
+    }
+    poolSize_ = std::min(poolSize, MAX_SLOTS);
+
+    // The first connection is opened here so bad parameters surface to the caller
+    size_t index = 0;
+    if (openConnections_.load() == 0)
+    {
+        openConnection(MAX_SLOTS, IDLE, index);
+    }
+    initialized_.store(true, std::memory_order_release);
 
-    // Initialize the pool with connections
-    for (size_t i = 0; i < poolSize; ++i)
+    // The rest of the pool is opened in the background
     {
-        createNewConnection();
+        std::lock_guard< std::mutex > lock(mutex_);
+        if (!maintenance_.joinable())
+        {
+            stopping_    = false;
+            maintenance_ = std::thread(&ConnectionPool::runMaintenance, this);
+        }
     }
+    wakeMaintenance();
 }
 
 // Get a connection from the pool (or create one if pool is empty)
 std::shared_ptr< sqlpp::postgresql::connection > ct::db::ConnectionPool::getConnection()
 {
-    std::unique_lock< std::mutex > lock(mutex_);
-
-    if (!initialized_)
+    if (!initialized_.load(std::memory_order_acquire))
     {
         throw std::runtime_error("Connection pool not initialized");
     }
@@ -161,405 +195,1259 @@ std::shared_ptr< sqlpp::postgresql::connection > ct::db::ConnectionPool::getConn
         throw std::runtime_error("Database is shutting down");
     }
 
-    // Wait for a connection to become available
-    while (availableConnections_.empty())
+    auto started = std::chrono::steady_clock::now();
+
+    // Connections are only opened here while the maintenance thread has not caught up with the pool size
+    size_t index = 0;
+    if (!tryCheckout(index) && !openConnection(maxConnections_.load(), BUSY, index))
+    {
+        waitForCheckout(index);
+    }
+
+    recordWait(std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - started)
+                   .count());
+    return handOut(index);
+}
+
+// Kept for existing callers, idle connections are pinged by the maintenance thread instead
+std::shared_ptr< sqlpp::postgresql::connection > ct::db::ConnectionPool::getConnectionWithHealthCheck()
+{
+    return getConnection();
+}
+
+// Set maximum number of connections
+void ct::db::ConnectionPool::setMaxConnections(size_t maxConnections)
+{
+    if (maxConnections == 0 || maxConnections > MAX_SLOTS)
+    {
+        throw std::invalid_argument("Max connections must be between 1 and " + std::to_string(MAX_SLOTS) + ", got " +
+                                    std::to_string(maxConnections));
+    }
+
+    maxConnections_ = maxConnections;
+
+    // Waiters may open a connection now, idle connections beyond the new maximum are closed in the background
+    notifyAvailable();
+    wakeMaintenance();
+}
+
+void ct::db::ConnectionPool::setHealthCheckInterval(std::chrono::milliseconds interval)
+{
+    if (interval.count() <= 0)
+    {
+        throw std::invalid_argument("Health check interval must be positive");
+    }
+
+    healthCheckIntervalMs_ = interval.count();
+    wakeMaintenance();
+}
+
+void ct::db::ConnectionPool::waitForConnectionsToClose()
+{
+    // No health check or warm up may touch a connection from here on
+    stopMaintenance();
+
+    std::unique_lock< std::mutex > lock(mutex_);
+
+    // Wait until all connections are returned
+    ++waiters_;
+    connectionReturned_.wait(lock, [this] { return activeConnections_.load() == 0; });
+    --waiters_;
+}
+
+ct::db::ConnectionPoolStats ct::db::ConnectionPool::getStats() const
+{
+    ConnectionPoolStats stats;
+
+    size_t used = usedSlots_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < used; ++i)
+    {
+        if (slots_[i].state_.load(std::memory_order_relaxed) == IDLE)
+        {
+            ++stats.idle_;
+        }
+    }
+
+    stats.active_               = activeConnections_.load();
+    stats.open_                 = openConnections_.load();
+    stats.max_                  = maxConnections_.load();
+    stats.checkouts_            = checkouts_.load(std::memory_order_relaxed);
+    stats.waits_                = waits_.load(std::memory_order_relaxed);
+    stats.timeouts_             = timeouts_.load(std::memory_order_relaxed);
+    stats.created_              = created_.load(std::memory_order_relaxed);
+    stats.closed_               = closed_.load(std::memory_order_relaxed);
+    stats.health_checks_        = healthChecks_.load(std::memory_order_relaxed);
+    stats.failed_health_checks_ = failedHealthChecks_.load(std::memory_order_relaxed);
+
+    uint64_t count = 0;
+    for (size_t i = 0; i < ConnectionPoolStats::WAIT_BUCKETS; ++i)
+    {
+        stats.wait_buckets_[i] = waitBuckets_[i].load(std::memory_order_relaxed);
+        count += stats.wait_buckets_[i];
+    }
+
+    if (count == 0)
+    {
+        return stats;
+    }
+
+    stats.wait_max_us_ = static_cast< double >(waitMaxNs_.load(std::memory_order_relaxed)) / 1000.0;
+
+    auto percentile = [&](double fraction)
     {
-        // If we've reached max connections, wait for one to be returned
-        if (activeConnections_ >= maxConnections_)
+        uint64_t rank = static_cast< uint64_t >(std::ceil(fraction * count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < ConnectionPoolStats::WAIT_BUCKETS; ++i)
         {
-            // TODO: Read timeout from config.
-            if (!connectionAvailable_.wait_for(
-                    lock, std::chrono::seconds(5), [this] { return !availableConnections_.empty(); }))
+            seen += stats.wait_buckets_[i];
+            if (seen >= rank)
             {
-                throw std::runtime_error("Timeout waiting for connection");
+                return std::ldexp(1.0, static_cast< int >(i) + 1) / 1000.0;
             }
         }
-        else
+        return stats.wait_max_us_;
+    };
+
+    stats.wait_p50_us_ = percentile(0.50);
+    stats.wait_p99_us_ = percentile(0.99);
+    return stats;
+}
+
+// Private constructor for singleton, the statement cache is created first so it outlives the pool
+ct::db::ConnectionPool::ConnectionPool()
+{
+    PreparedStatementCache::getInstance();
+}
+
+ct::db::ConnectionPool::~ConnectionPool()
+{
+    stopMaintenance();
+
+    for (auto& slot : slots_)
+    {
+        if (slot.conn_)
+        {
+            PreparedStatementCache::getInstance().untrack(*slot.conn_);
+            slot.conn_.reset();
+        }
+    }
+}
+
+bool ct::db::ConnectionPool::tryCheckout(size_t& index)
+{
+    size_t used = usedSlots_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < used; ++i)
+    {
+        size_t candidate = (lastSlot + i) % used;
+        auto& state      = slots_[candidate].state_;
+
+        // Sequentially consistent so a waiter cannot miss a return, see returnConnection
+        uint8_t idle = IDLE;
+        if (state.load() == IDLE && state.compare_exchange_strong(idle, BUSY))
+        {
+            index = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ct::db::ConnectionPool::openConnection(size_t limit, SlotState state, size_t& index)
+{
+    // Count the connection first so concurrent openers cannot exceed the limit together
+    size_t open = openConnections_.load();
+    do
+    {
+        if (open >= limit)
+        {
+            return false;
+        }
+    } while (!openConnections_.compare_exchange_weak(open, open + 1));
+
+    for (size_t i = 0; i < MAX_SLOTS; ++i)
+    {
+        Slot& slot    = slots_[i];
+        uint8_t empty = EMPTY;
+        if (!slot.state_.compare_exchange_strong(empty, RESERVED, std::memory_order_acquire))
+        {
+            continue;
+        }
+
+        try
+        {
+            slot.conn_ = createNewConnection();
+        }
+        catch (...)
+        {
+            slot.state_.store(EMPTY, std::memory_order_release);
+            --openConnections_;
+            throw;
+        }
+
+        size_t used = usedSlots_.load();
+        while (used < i + 1 && !usedSlots_.compare_exchange_weak(used, i + 1))
         {
-            // Create a new connection if below max limit
-            createNewConnection();
         }
+
+        slot.idle_since_.store(steadyNowNs(), std::memory_order_relaxed);
+        slot.state_.store(state);
+        index = i;
+        return true;
     }
 
-    // Get a connection from the pool
-    auto conn = std::move(availableConnections_.front());
-    availableConnections_.pop();
+    --openConnections_;
+    return false;
+}
+
+void ct::db::ConnectionPool::waitForCheckout(size_t& index)
+{
+    ++waits_;
+
+    // TODO: Read timeout from config.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+    bool checkedOut = false;
+    auto ready      = [&]
+    {
+        checkedOut = tryCheckout(index);
+        return checkedOut || openConnections_.load() < maxConnections_.load();
+    };
+
+    std::unique_lock< std::mutex > lock(mutex_);
+    ++waiters_;
+
+    while (true)
+    {
+        if (!connectionAvailable_.wait_until(lock, deadline, ready))
+        {
+            --waiters_;
+            ++timeouts_;
+            throw std::runtime_error("Timeout waiting for connection");
+        }
+
+        if (checkedOut)
+        {
+            break;
+        }
+
+        // A connection was closed or the maximum raised, the new one is opened without holding the lock
+        lock.unlock();
+        bool opened = false;
+        try
+        {
+            opened = openConnection(maxConnections_.load(), BUSY, index);
+        }
+        catch (...)
+        {
+            --waiters_;
+            throw;
+        }
+        lock.lock();
+
+        if (opened)
+        {
+            break;
+        }
+    }
 
-    // Save the raw pointer before transferring ownership
-    sqlpp::postgresql::connection* rawConn = conn.get();
+    --waiters_;
+}
 
-    // IMPORTANT: Add to managed connections before creating the shared_ptr
-    managedConnections_.push_back(std::move(conn));
-    activeConnections_++;
+std::shared_ptr< sqlpp::postgresql::connection > ct::db::ConnectionPool::handOut(size_t index)
+{
+    lastSlot = index;
+    ++activeConnections_;
+    checkouts_.fetch_add(1, std::memory_order_relaxed);
 
     // Create a wrapper that returns the connection to the pool when it's destroyed
     return std::shared_ptr< sqlpp::postgresql::connection >(
-        rawConn, [this](sqlpp::postgresql::connection* conn) { this->returnConnection(conn); });
+        slots_[index].conn_.get(), [this, index](sqlpp::postgresql::connection*) { this->returnConnection(index); });
 }
 
-// Get a connection from the pool with health check
-std::shared_ptr< sqlpp::postgresql::connection > ct::db::ConnectionPool::getConnectionWithHealthCheck()
+// Return a connection to the pool
+void ct::db::ConnectionPool::returnConnection(size_t index)
 {
-    auto conn = getConnection();
+    Slot& slot = slots_[index];
 
-    // Test if the connection is still valid
-    try
+    // Only the local libpq state is looked at, pinging the server is left to the maintenance thread. A connection
+    // left inside a transaction would hand that transaction to the next caller.
+    PGconn* native = slot.conn_->native_handle();
+    bool reusable  = PQstatus(native) == CONNECTION_OK && PQtransactionStatus(native) == PQTRANS_IDLE;
+    if (!reusable)
     {
-        conn->execute("SELECT 1");
+        logger::LOG.error("Closing a connection returned broken or inside a transaction");
     }
-    catch (const std::exception& e)
+
+    // Statements prepared by sqlpp11 are deallocated by their handles, the ones in PreparedStatementCache are kept
+    // so they can be reused by the next checkout.
+
+    if (reusable && !DatabaseShutdownManager::getInstance().isShuttingDown() &&
+        openConnections_.load() <= maxConnections_.load())
+    {
+        slot.idle_since_.store(steadyNowNs(), std::memory_order_relaxed);
+
+        // Sequentially consistent like the waiters_ load below, a waiter either sees this connection or is notified
+        slot.state_.store(IDLE);
+    }
+    else
+    {
+        closeSlot(slot);
+        if (!reusable)
+        {
+            wakeMaintenance();
+        }
+    }
+
+    size_t active = --activeConnections_;
+
+    // Notify both waiting threads and shutdown manager
+    if (waiters_.load() > 0)
     {
-        // Connection is dead, get a new one
-        std::cerr << "Detected dead connection, getting a new one: " << e.what() << std::endl;
+        std::lock_guard< std::mutex > lock(mutex_);
+        connectionAvailable_.notify_one();
+        if (active == 0)
+        {
+            connectionReturned_.notify_all();
+        }
+    }
+}
 
-        // This will release the dead connection and get a new one
-        // The connection pool's returnConnection will handle creating a replacement
-        conn = getConnection();
+// Create a new database connection
+std::unique_ptr< sqlpp::postgresql::connection > ct::db::ConnectionPool::createNewConnection()
+{
+    std::shared_ptr< sqlpp::postgresql::connection_config > config;
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        config = config_;
     }
 
+    auto conn = std::make_unique< sqlpp::postgresql::connection >(config);
+    PreparedStatementCache::getInstance().track(*conn);
+    created_.fetch_add(1, std::memory_order_relaxed);
     return conn;
 }
 
-// Set maximum number of connections
-void ct::db::ConnectionPool::setMaxConnections(size_t maxConnections)
+void ct::db::ConnectionPool::closeSlot(Slot& slot)
+{
+    // The connection is closed below, its cached statements have to go first
+    PreparedStatementCache::getInstance().untrack(*slot.conn_);
+    slot.conn_.reset();
+
+    // Freed before it is uncounted, so openConnection always finds an empty slot below the limit
+    slot.state_.store(EMPTY, std::memory_order_release);
+    --openConnections_;
+    closed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ct::db::ConnectionPool::recordWait(uint64_t wait_ns)
+{
+    size_t bucket = 0;
+    for (uint64_t rest = wait_ns >> 1; rest != 0; rest >>= 1)
+    {
+        ++bucket;
+    }
+
+    waitBuckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = waitMaxNs_.load(std::memory_order_relaxed);
+    while (wait_ns > max && !waitMaxNs_.compare_exchange_weak(max, wait_ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void ct::db::ConnectionPool::notifyAvailable()
 {
+    if (waiters_.load() == 0)
+    {
+        return;
+    }
+
     std::lock_guard< std::mutex > lock(mutex_);
-    maxConnections_ = maxConnections;
+    connectionAvailable_.notify_all();
 }
 
-void ct::db::ConnectionPool::waitForConnectionsToClose()
+void ct::db::ConnectionPool::wakeMaintenance()
 {
-    std::unique_lock< std::mutex > lock(mutex_);
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        maintenanceRequested_ = true;
+    }
+    maintenanceWake_.notify_one();
+}
 
-    // Wait until all connections are returned
-    while (activeConnections_ > 0)
+void ct::db::ConnectionPool::stopMaintenance()
+{
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        stopping_ = true;
+    }
+    maintenanceWake_.notify_one();
+
+    if (maintenance_.joinable())
     {
-        connectionReturned_.wait(lock);
+        maintenance_.join();
     }
 }
 
-// Private constructor for singleton
-ct::db::ConnectionPool::ConnectionPool() : activeConnections_(0), maxConnections_(20), initialized_(false) {}
+void ct::db::ConnectionPool::runMaintenance()
+{
+    std::unique_lock< std::mutex > lock(mutex_);
+    while (!stopping_)
+    {
+        maintenanceRequested_ = false;
+        lock.unlock();
+
+        if (!DatabaseShutdownManager::getInstance().isShuttingDown())
+        {
+            trimIdleConnections();
+            checkIdleConnections();
+            warmUp();
+        }
 
-// Return a connection to the pool
-void ct::db::ConnectionPool::returnConnection(sqlpp::postgresql::connection* conn)
+        lock.lock();
+        maintenanceWake_.wait_for(lock,
+                                  std::chrono::milliseconds(healthCheckIntervalMs_.load()),
+                                  [this] { return stopping_ || maintenanceRequested_; });
+    }
+}
+
+void ct::db::ConnectionPool::checkIdleConnections()
 {
-    std::lock_guard< std::mutex > lock(mutex_);
+    const int64_t interval = healthCheckIntervalMs_.load() * 1000000;
+    const int64_t now      = steadyNowNs();
+    bool checked           = false;
+
+    size_t used = usedSlots_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < used; ++i)
+    {
+        Slot& slot = slots_[i];
+        if (now - slot.idle_since_.load(std::memory_order_relaxed) < interval)
+        {
+            continue;
+        }
+
+        // A connection checked out in the meantime is not pinged
+        uint8_t idle = IDLE;
+        if (!slot.state_.compare_exchange_strong(idle, RESERVED, std::memory_order_acquire))
+        {
+            continue;
+        }
+
+        checked = true;
+        healthChecks_.fetch_add(1, std::memory_order_relaxed);
+        try
+        {
+            slot.conn_->execute("SELECT 1");
+            slot.idle_since_.store(steadyNowNs(), std::memory_order_relaxed);
+            slot.state_.store(IDLE);
+            continue;
+        }
+        catch (const std::exception& e)
+        {
+            failedHealthChecks_.fetch_add(1, std::memory_order_relaxed);
+
+            std::ostringstream oss;
+            oss << "Closing a pooled connection that failed its health check: " << e.what();
+            logger::LOG.error(oss.str());
+        }
+
+        closeSlot(slot);
+    }
+
+    // Waiters may have found every connection reserved
+    if (checked)
+    {
+        notifyAvailable();
+    }
+}
+
+void ct::db::ConnectionPool::warmUp()
+{
+    const size_t target = std::min(poolSize_.load(), maxConnections_.load());
+    size_t index        = 0;
+    bool opened         = false;
 
-    // Check if connection is still valid before trying to clean it up
-    bool connectionValid = true;
     try
     {
-        // A simple ping to test if connection is alive
-        conn->execute("SELECT 1");
+        while (openConnections_.load() < target && openConnection(target, IDLE, index))
+        {
+            opened = true;
+        }
     }
     catch (const std::exception& e)
     {
-        // Connection is dead, mark it as invalid
-        connectionValid = false;
-        std::cerr << "Detected dead connection during return: " << e.what() << std::endl;
+        // Retried at the next health check interval
+        std::ostringstream oss;
+        oss << "Error opening a pooled connection: " << e.what();
+        logger::LOG.error(oss.str());
+    }
+
+    if (opened)
+    {
+        notifyAvailable();
+    }
+}
+
+void ct::db::ConnectionPool::trimIdleConnections()
+{
+    size_t used = usedSlots_.load(std::memory_order_acquire);
+    for (size_t i = used; i-- > 0 && openConnections_.load() > maxConnections_.load();)
+    {
+        uint8_t idle = IDLE;
+        if (slots_[i].state_.compare_exchange_strong(idle, RESERVED, std::memory_order_acquire))
+        {
+            closeSlot(slots_[i]);
+        }
+    }
+}
+
+// Get singleton instance
+ct::db::Database& ct::db::Database::getInstance()
+{
+    static Database instance;
+    return instance;
+}
+
+// Initialize the database with connection parameters
+void ct::db::Database::init(const std::string& host,
+                            const std::string& dbname,
+                            const std::string& username,
+                            const std::string& password,
+                            unsigned int port)
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    // Initialize connection pool
+    ConnectionPool::getInstance().init(host, dbname, username, password, port);
+
+    // Initialize shutdown manager
+    auto& shutdownManager = DatabaseShutdownManager::getInstance();
+    shutdownManager.initSignalHandlers();
+
+    // Register shutdown hooks
+    shutdownManager.registerShutdownHook([] { std::cout << "Database shutdown initiated..." << std::endl; });
+
+    shutdownManager.registerCompletionHook([] { std::cout << "Database shutdown completed." << std::endl; });
+
+    // Saves on the trading path are queued in live mode, start registers the final drain as a shutdown hook
+    if (helper::isLive() && !WriteBehind::getInstance().isRunning())
+    {
+        WriteBehind::getInstance().start();
+    }
+}
+
+// Get a connection from the pool
+// sqlpp::postgresql::connection& ct::db::Database::getConnection()
+// {
+//     // Get connection from pool and cache it in thread_local storage
+//     thread_local std::shared_ptr< sqlpp::postgresql::connection > conn =
+//     ConnectionPool::getInstance().getConnection();
+
+// return *conn;
+// }
+
+std::shared_ptr< sqlpp::postgresql::connection > ct::db::Database::getConnection()
+{
+    return ConnectionPool::getInstance().getConnection();
+}
+
+void ct::db::Database::shutdown()
+{
+    DatabaseShutdownManager::getInstance().shutdown();
+    DatabaseShutdownManager::getInstance().waitForShutdown();
+}
+
+// Start a new transaction
+std::shared_ptr< sqlpp::transaction_t< sqlpp::postgresql::connection > > ct::db::TransactionManager::startTransaction()
+{
+    auto db = db::Database::getInstance().getConnection();
+    return std::make_shared< sqlpp::transaction_t< sqlpp::postgresql::connection > >(start_transaction(*db));
+}
+
+// Commit the transaction
+bool ct::db::TransactionManager::commitTransaction(
+    std::shared_ptr< sqlpp::transaction_t< sqlpp::postgresql::connection > > tx)
+{
+    if (!tx)
+    {
+        logger::LOG.error("Cannot commit null transaction");
+        return false;
+    }
+
+    try
+    {
+        tx->commit();
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error committing transaction: " << e.what();
+        logger::LOG.error(oss.str());
+        return false;
+    }
+}
+
+// Roll back the transaction
+bool ct::db::TransactionManager::rollbackTransaction(
+    std::shared_ptr< sqlpp::transaction_t< sqlpp::postgresql::connection > > tx)
+{
+    if (!tx)
+    {
+        std::ostringstream oss;
+        oss << "Cannot rollback null transaction";
+        logger::LOG.error(oss.str());
+        return false;
+    }
+
+    try
+    {
+        tx->rollback();
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error rolling back transaction: " << e.what();
+        logger::LOG.error(oss.str());
+        return false;
+    }
+}
+
+ct::db::TransactionGuard::TransactionGuard() : committed_(false)
+{
+    // Check for shutdown before starting transaction
+    if (DatabaseShutdownManager::getInstance().isShuttingDown())
+    {
+        throw std::runtime_error("Cannot start new transaction during shutdown");
+    }
+
+    conn_ = ConnectionPool::getInstance().getConnection();
+
+    if (conn_)
+    {
+        tx_ = std::make_shared< sqlpp::transaction_t< sqlpp::postgresql::connection > >(start_transaction(*conn_));
+    }
+}
+
+ct::db::TransactionGuard::~TransactionGuard()
+{
+    if (tx_ && !committed_)
+    {
+        try
+        {
+            tx_->rollback();
+        }
+        catch (const std::exception& e)
+        {
+            std::ostringstream oss;
+            oss << "Error during auto-rollback: " << e.what();
+            logger::LOG.error(oss.str());
+        }
+    }
+}
+
+bool ct::db::TransactionGuard::commit()
+{
+    if (!tx_)
+        return false;
+
+    try
+    {
+        tx_->commit();
+        committed_ = true;
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error during commit: " << e.what();
+        logger::LOG.error(oss.str());
+        return false;
+    }
+}
+
+bool ct::db::TransactionGuard::rollback()
+{
+    if (!tx_)
+        return false;
+
+    try
+    {
+        tx_->rollback();
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error during rollback: " << e.what();
+        logger::LOG.error(oss.str());
+        return false;
+    }
+}
+
+// Get the connection associated with this transaction
+std::shared_ptr< sqlpp::postgresql::connection > ct::db::TransactionGuard::getConnection()
+{
+    return conn_;
+}
+
+template < typename Func >
+auto ct::db::executeWithRetry(Func&& operation, int maxRetries) -> decltype(operation())
+{
+    int retries = 0;
+    while (true)
+    {
+        try
+        {
+            return operation();
+        }
+        catch (const std::exception& e)
+        {
+            if (++retries > maxRetries)
+            {
+                throw; // Re-throw after max retries
+            }
+
+            std::ostringstream oss;
+            oss << "Operation failed, retrying (" << retries << "/" << maxRetries << "): " << e.what();
+            logger::LOG.error(oss.str());
+
+            // Exponential backoff
+            std::this_thread::sleep_for(std::chrono::milliseconds(100 * retries));
+        }
+    }
+}
+
+ct::db::ConnectionStateGuard::ConnectionStateGuard(sqlpp::postgresql::connection& conn)
+    : conn_(conn), needs_reset_(false)
+{
+}
+
+ct::db::ConnectionStateGuard::~ConnectionStateGuard()
+{
+    if (needs_reset_)
+    {
+        try
+        {
+            // Deallocate all prepared statements
+            PreparedStatementCache::getInstance().invalidate(conn_);
+            conn_.execute("DEALLOCATE ALL");
+
+            // Execute a harmless query to reset the connection state
+            conn_.execute("SELECT 1");
+        }
+        catch (const std::exception& e)
+        {
+            // Nothing we can do in the destructor
+        }
+    }
+}
+
+void ct::db::ConnectionStateGuard::markForReset()
+{
+    needs_reset_ = true;
+}
+
+namespace
+{
+
+using ResultPtr = std::unique_ptr< PGresult, decltype(&PQclear) >;
+
+bool hasSqlState(const ResultPtr& result, const char* state)
+{
+    const char* actual = result ? PQresultErrorField(result.get(), PG_DIAG_SQLSTATE) : nullptr;
+    return actual && std::strcmp(actual, state) == 0;
+}
+
+// SQLSTATE of executing a statement that is not prepared on the connection
+constexpr const char* INVALID_STATEMENT_NAME = "26000";
+// SQLSTATE of preparing a statement under a name already in use
+constexpr const char* DUPLICATE_STATEMENT = "42P05";
+
+// Models providing a single round-trip upsert, save checks the others for conflicts with a select first
+template < typename ModelType, typename = void >
+struct HasUpsert : std::false_type
+{
+};
+
+template < typename ModelType >
+struct HasUpsert< ModelType, std::void_t< decltype(ModelType::upsertStatement()) > > : std::true_type
+{
+};
+
+// The select of findByFilter, before execution
+template < typename Table, typename FilterType >
+auto makeFilterQuery(sqlpp::postgresql::connection& conn, const Table& t, const FilterType& filter)
+{
+    // Build dynamic query with all necessary dynamic components
+    auto query = dynamic_select(conn)
+                     .dynamic_columns()
+                     .dynamic_flags()
+                     .dynamic_from(t)
+                     .dynamic_where()
+                     .dynamic_group_by()
+                     .dynamic_order_by()
+                     .dynamic_limit()
+                     .dynamic_offset();
+
+    // Apply distinct flag if needed
+    if (filter.isDistinct())
+    {
+        query.select_flags.add(sqlpp::distinct);
+    }
+
+    // Apply column selection
+    filter.applyToColumns(query, t);
+
+    // Apply filter conditions
+    filter.applyToQuery(query, t);
+
+    return query;
+}
+
+template < typename Query >
+std::string toSql(sqlpp::postgresql::connection& conn, const Query& query)
+{
+    sqlpp::postgresql::connection::_serializer_context_t context(conn);
+    serialize(query, context);
+    return context.str();
+}
+
+// A row of a text format libpq result, read through the interface fromRow uses on sqlpp11 dynamic rows
+class ResultRow
+{
+   public:
+    class Field
+    {
+       public:
+        Field(const PGresult* result, int row, int column) : result_(result), row_(row), column_(column) {}
+
+        bool is_null() const { return PQgetisnull(result_, row_, column_) == 1; }
+
+        std::string value() const
+        {
+            return std::string(PQgetvalue(result_, row_, column_), PQgetlength(result_, row_, column_));
+        }
+
+       private:
+        const PGresult* result_;
+        int row_;
+        int column_;
+    };
+
+    ResultRow(const PGresult* result, int row) : result_(result), row_(row) {}
+
+    Field at(const std::string& name) const
+    {
+        int column = PQfnumber(result_, name.c_str());
+        if (column < 0)
+        {
+            throw std::out_of_range("No column " + name + " in the result");
+        }
+
+        return Field(result_, row_, column);
+    }
+
+   private:
+    const PGresult* result_;
+    int row_;
+};
+
+std::atomic< uint64_t > cursor_count{0};
+
+/**
+ * @brief Run a query through a server-side cursor and hand every fetched chunk to on_chunk
+ *
+ * @param on_chunk Receives every non-empty chunk, returning false closes the cursor early
+ * @return size_t Number of rows fetched
+ */
+size_t fetchInChunks(sqlpp::postgresql::connection& conn,
+                     const std::string& sql,
+                     size_t chunk_size,
+                     const std::function< bool(const PGresult* chunk) >& on_chunk)
+{
+    if (chunk_size == 0)
+    {
+        throw std::invalid_argument("Chunk size must be at least 1");
+    }
+
+    PGconn* native             = conn.native_handle();
+    const bool own_transaction = PQtransactionStatus(native) == PQTRANS_IDLE;
+    const std::string cursor   = "ct_cursor_" + std::to_string(++cursor_count);
+
+    auto run = [native](const std::string& statement, ExecStatusType expected)
+    {
+        ResultPtr result(PQexec(native, statement.c_str()), PQclear);
+        if (!result || PQresultStatus(result.get()) != expected)
+        {
+            throw std::runtime_error(PQerrorMessage(native));
+        }
+        return result;
+    };
+
+    try
+    {
+        if (own_transaction)
+        {
+            run("BEGIN", PGRES_COMMAND_OK);
+        }
+        run("DECLARE " + cursor + " NO SCROLL CURSOR FOR " + sql, PGRES_COMMAND_OK);
+
+        const std::string fetch = "FETCH FORWARD " + std::to_string(chunk_size) + " FROM " + cursor;
+        size_t fetched          = 0;
+        while (true)
+        {
+            auto result  = run(fetch, PGRES_TUPLES_OK);
+            size_t count = static_cast< size_t >(PQntuples(result.get()));
+            if (count == 0)
+            {
+                break;
+            }
+
+            fetched += count;
+            if (!on_chunk(result.get()) || count < chunk_size)
+            {
+                break;
+            }
+        }
+
+        run("CLOSE " + cursor, PGRES_COMMAND_OK);
+        if (own_transaction)
+        {
+            run("COMMIT", PGRES_COMMAND_OK);
+        }
+
+        return fetched;
+    }
+    catch (...)
+    {
+        // Leave neither the transaction nor the cursor open on the connection
+        const std::string cleanup = own_transaction ? "ROLLBACK" : "CLOSE " + cursor;
+        PQclear(PQexec(native, cleanup.c_str()));
+        throw;
+    }
+}
+
+/**
+ * @brief Execute a NamedStatement on the connection, preparing it first if needed
+ *
+ * @param result_format 0 for text results, 1 for binary
+ */
+ResultPtr runPrepared(sqlpp::postgresql::connection& conn,
+                      const ct::db::NamedStatement& statement,
+                      const ct::db::StatementParams& params,
+                      int result_format)
+{
+    if (params.count() != statement.params_)
+    {
+        throw std::invalid_argument(statement.name_ + " takes " + std::to_string(statement.params_) +
+                                    " parameters, got " + std::to_string(params.count()));
+    }
+
+    auto& cache = ct::db::PreparedStatementCache::getInstance();
+    cache.prepare(conn, statement);
+
+    PGconn* native = conn.native_handle();
+    auto values    = params.getValues();
+    auto lengths   = params.getLengths();
+    auto execute   = [&]
+    {
+        return ResultPtr(PQexecPrepared(native,
+                                        statement.name_.c_str(),
+                                        params.count(),
+                                        values.data(),
+                                        lengths.data(),
+                                        params.getFormats().data(),
+                                        result_format),
+                         PQclear);
+    };
+
+    auto result = execute();
+    if (hasSqlState(result, INVALID_STATEMENT_NAME))
+    {
+        // Deallocated behind the back of the cache, e.g. by a DEALLOCATE ALL outside ConnectionStateGuard
+        cache.invalidate(conn);
+        cache.prepare(conn, statement);
+        result = execute();
+    }
+
+    if (!result ||
+        (PQresultStatus(result.get()) != PGRES_COMMAND_OK && PQresultStatus(result.get()) != PGRES_TUPLES_OK))
+    {
+        throw std::runtime_error("Error executing " + statement.name_ + ": " + PQerrorMessage(native));
+    }
+
+    return result;
+}
+
+// Type OIDs of the binary columns decoded below, from pg_type.h
+constexpr Oid INT4_OID   = 23;
+constexpr Oid INT8_OID   = 20;
+constexpr Oid FLOAT8_OID = 701;
+
+uint64_t readBigEndian(const char* data, int size)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        bits = (bits << 8) | static_cast< uint8_t >(data[i]);
+    }
+    return bits;
+}
+
+/**
+ * @brief Copy a binary format result of int4, int8 and float8 columns into the first rows of a matrix
+ *
+ * The matrix grows if it has fewer rows than the result, NULL becomes NaN.
+ *
+ * @throws std::runtime_error If a column has another type or the matrix is too narrow
+ */
+size_t decodeBinaryMatrix(const PGresult* result, blaze::DynamicMatrix< double >& matrix)
+{
+    const int rows    = PQntuples(result);
+    const int columns = PQnfields(result);
+
+    if (matrix.columns() < static_cast< size_t >(columns))
+    {
+        throw std::runtime_error("Expected at least " + std::to_string(columns) + " columns to decode into, got " +
+                                 std::to_string(matrix.columns()));
     }
 
-    if (connectionValid)
+    std::vector< Oid > types(columns);
+    for (int j = 0; j < columns; ++j)
     {
-        // Only try to clean up if connection is still valid
-        try
-        {
-            conn->execute("DEALLOCATE ALL");
-        }
-        catch (const std::exception& e)
+        types[j] = PQftype(result, j);
+        if (types[j] != INT4_OID && types[j] != INT8_OID && types[j] != FLOAT8_OID)
         {
-            // Log the error but continue
-            std::cerr << "Error cleaning connection during return: " << e.what() << std::endl;
-            connectionValid = false;
+            throw std::runtime_error(std::string("Cannot decode column ") + PQfname(result, j) + " of type " +
+                                     std::to_string(types[j]));
         }
     }
 
-    // Find the connection in our managed connections
-    auto it = std::find_if(managedConnections_.begin(),
-                           managedConnections_.end(),
-                           [conn](const auto& managed) { return managed.get() == conn; });
+    if (matrix.rows() < static_cast< size_t >(rows))
+    {
+        matrix.resize(rows, matrix.columns(), false);
+    }
 
-    if (it != managedConnections_.end())
+    for (int i = 0; i < rows; ++i)
     {
-        if (!DatabaseShutdownManager::getInstance().isShuttingDown())
+        for (int j = 0; j < columns; ++j)
         {
-            if (connectionValid)
+            if (PQgetisnull(result, i, j))
             {
-                // Return to the pool only if valid
-                availableConnections_.push(std::move(*it));
+                matrix(i, j) = std::numeric_limits< double >::quiet_NaN();
+                continue;
             }
-            else
+
+            const char* data = PQgetvalue(result, i, j);
+            switch (types[j])
             {
-                // Connection is invalid, create a new one to replace it
-                createNewConnection();
+                case INT4_OID:
+                    matrix(i, j) = static_cast< double >(static_cast< int32_t >(readBigEndian(data, 4)));
+                    break;
+                case INT8_OID:
+                    matrix(i, j) = static_cast< double >(static_cast< int64_t >(readBigEndian(data, 8)));
+                    break;
+                default:
+                {
+                    uint64_t bits = readBigEndian(data, 8);
+                    double value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    matrix(i, j) = value;
+                }
             }
         }
-
-        managedConnections_.erase(it);
-        activeConnections_--;
-
-        // Notify both waiting threads and shutdown manager
-        connectionAvailable_.notify_one();
-        connectionReturned_.notify_all();
     }
+
+    return rows;
 }
 
-// Create a new database connection
-void ct::db::ConnectionPool::createNewConnection()
+} // namespace
+
+ct::db::NamedStatement ct::db::makeUpsertStatement(const std::string& table,
+                                                   const std::vector< std::string >& columns,
+                                                   const std::vector< std::string >& key)
 {
-    auto config      = std::make_shared< sqlpp::postgresql::connection_config >();
-    config->debug    = false; // TODO: accept as arg
-    config->host     = host_;
-    config->dbname   = dbname_;
-    config->user     = username_;
-    config->password = password_;
-    config->port     = port_;
+    std::ostringstream sql;
+    sql << "INSERT INTO " << table << " (" << boost::algorithm::join(columns, ", ") << ") VALUES (";
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        sql << (i == 0 ? "$" : ", $") << i + 1;
+    }
+    sql << ") ON CONFLICT (" << boost::algorithm::join(key, ", ") << ") DO UPDATE SET ";
 
-    auto conn = std::make_unique< sqlpp::postgresql::connection >(config);
-    availableConnections_.push(std::move(conn));
-    initialized_ = true;
+    bool first = true;
+    for (const auto& column : columns)
+    {
+        if (column == "id")
+        {
+            continue;
+        }
+        sql << (first ? "" : ", ") << column << " = EXCLUDED." << column;
+        first = false;
+    }
+
+    NamedStatement statement;
+    statement.name_   = "ct_upsert_" + table;
+    statement.sql_    = sql.str();
+    statement.params_ = static_cast< int >(columns.size());
+    return statement;
 }
 
-// Get singleton instance
-ct::db::Database& ct::db::Database::getInstance()
+void ct::db::StatementParams::addNull()
 {
-    static Database instance;
-    return instance;
+    values_.emplace_back(std::nullopt);
+    formats_.push_back(0);
 }
 
-// Initialize the database with connection parameters
-void ct::db::Database::init(const std::string& host,
-                            const std::string& dbname,
-                            const std::string& username,
-                            const std::string& password,
-                            unsigned int port)
+void ct::db::StatementParams::add(int32_t value)
 {
-    std::lock_guard< std::mutex > lock(mutex_);
-
-    // Initialize connection pool
-    ConnectionPool::getInstance().init(host, dbname, username, password, port);
-
-    // Initialize shutdown manager
-    auto& shutdownManager = DatabaseShutdownManager::getInstance();
-    shutdownManager.initSignalHandlers();
-
-    // Register shutdown hooks
-    shutdownManager.registerShutdownHook([] { std::cout << "Database shutdown initiated..." << std::endl; });
-
-    shutdownManager.registerCompletionHook([] { std::cout << "Database shutdown completed." << std::endl; });
+    values_.emplace_back(std::to_string(value));
+    formats_.push_back(0);
 }
 
-// Get a connection from the pool
-// sqlpp::postgresql::connection& ct::db::Database::getConnection()
-// {
-//     // Get connection from pool and cache it in thread_local storage
-//     thread_local std::shared_ptr< sqlpp::postgresql::connection > conn =
-//     ConnectionPool::getInstance().getConnection();
-
-// return *conn;
-// }
-
-std::shared_ptr< sqlpp::postgresql::connection > ct::db::Database::getConnection()
+void ct::db::StatementParams::add(int64_t value)
 {
-    return ConnectionPool::getInstance().getConnection();
+    values_.emplace_back(std::to_string(value));
+    formats_.push_back(0);
 }
 
-void ct::db::Database::shutdown()
+void ct::db::StatementParams::add(double value)
 {
-    DatabaseShutdownManager::getInstance().shutdown();
-    DatabaseShutdownManager::getInstance().waitForShutdown();
+    // 17 significant digits round-trip every double, nan and inf are accepted by float8 input as well
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    values_.emplace_back(std::string(buffer));
+    formats_.push_back(0);
 }
 
-// Start a new transaction
-std::shared_ptr< sqlpp::transaction_t< sqlpp::postgresql::connection > > ct::db::TransactionManager::startTransaction()
+void ct::db::StatementParams::add(const std::string& value)
 {
-    auto db = db::Database::getInstance().getConnection();
-    return std::make_shared< sqlpp::transaction_t< sqlpp::postgresql::connection > >(start_transaction(*db));
+    values_.emplace_back(value);
+    formats_.push_back(0);
 }
 
-// Commit the transaction
-bool ct::db::TransactionManager::commitTransaction(
-    std::shared_ptr< sqlpp::transaction_t< sqlpp::postgresql::connection > > tx)
+void ct::db::StatementParams::add(const std::vector< uint8_t >& value)
 {
-    if (!tx)
-    {
-        logger::LOG.error("Cannot commit null transaction");
-        return false;
-    }
-
-    try
-    {
-        tx->commit();
-        return true;
-    }
-    catch (const std::exception& e)
-    {
-        std::ostringstream oss;
-        oss << "Error committing transaction: " << e.what();
-        logger::LOG.error(oss.str());
-        return false;
-    }
+    // Binary format spares escaping bytea
+    values_.emplace_back(std::string(value.begin(), value.end()));
+    formats_.push_back(1);
 }
 
-// Roll back the transaction
-bool ct::db::TransactionManager::rollbackTransaction(
-    std::shared_ptr< sqlpp::transaction_t< sqlpp::postgresql::connection > > tx)
+std::vector< const char* > ct::db::StatementParams::getValues() const
 {
-    if (!tx)
-    {
-        std::ostringstream oss;
-        oss << "Cannot rollback null transaction";
-        logger::LOG.error(oss.str());
-        return false;
-    }
-
-    try
-    {
-        tx->rollback();
-        return true;
-    }
-    catch (const std::exception& e)
+    std::vector< const char* > values;
+    values.reserve(values_.size());
+    for (const auto& value : values_)
     {
-        std::ostringstream oss;
-        oss << "Error rolling back transaction: " << e.what();
-        logger::LOG.error(oss.str());
-        return false;
+        values.push_back(value ? value->data() : nullptr);
     }
+    return values;
 }
 
-ct::db::TransactionGuard::TransactionGuard() : committed_(false)
+std::vector< int > ct::db::StatementParams::getLengths() const
 {
-    // Check for shutdown before starting transaction
-    if (DatabaseShutdownManager::getInstance().isShuttingDown())
-    {
-        throw std::runtime_error("Cannot start new transaction during shutdown");
-    }
-
-    conn_ = ConnectionPool::getInstance().getConnection();
-
-    if (conn_)
+    std::vector< int > lengths;
+    lengths.reserve(values_.size());
+    for (const auto& value : values_)
     {
-        tx_ = std::make_shared< sqlpp::transaction_t< sqlpp::postgresql::connection > >(start_transaction(*conn_));
+        lengths.push_back(value ? static_cast< int >(value->size()) : 0);
     }
+    return lengths;
 }
 
-ct::db::TransactionGuard::~TransactionGuard()
+ct::db::PreparedStatementCache& ct::db::PreparedStatementCache::getInstance()
 {
-    if (tx_ && !committed_)
-    {
-        try
-        {
-            tx_->rollback();
-        }
-        catch (const std::exception& e)
-        {
-            std::ostringstream oss;
-            oss << "Error during auto-rollback: " << e.what();
-            logger::LOG.error(oss.str());
-        }
-    }
+    static PreparedStatementCache instance;
+    return instance;
 }
 
-bool ct::db::TransactionGuard::commit()
+void ct::db::PreparedStatementCache::prepare(sqlpp::postgresql::connection& conn, const NamedStatement& statement)
 {
-    if (!tx_)
-        return false;
-
-    try
+    if (isPrepared(conn, statement.name_))
     {
-        tx_->commit();
-        committed_ = true;
-        return true;
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
-    catch (const std::exception& e)
+    misses_.fetch_add(1, std::memory_order_relaxed);
+
+    // A connection is used by one thread at a time, so nobody else prepares on it meanwhile
+    PGconn* native = conn.native_handle();
+    ResultPtr result(
+        PQprepare(native, statement.name_.c_str(), statement.sql_.c_str(), statement.params_, nullptr), PQclear);
+
+    // A statement left behind by a failed DEALLOCATE ALL has the same text, since names are derived from it
+    if (!result || (PQresultStatus(result.get()) != PGRES_COMMAND_OK && !hasSqlState(result, DUPLICATE_STATEMENT)))
     {
-        std::ostringstream oss;
-        oss << "Error during commit: " << e.what();
-        logger::LOG.error(oss.str());
-        return false;
+        throw std::runtime_error("Error preparing " + statement.name_ + ": " + PQerrorMessage(native));
     }
+
+    std::lock_guard< std::mutex > lock(mutex_);
+    entries_[&conn].names_.insert(statement.name_);
 }
 
-bool ct::db::TransactionGuard::rollback()
+bool ct::db::PreparedStatementCache::isPrepared(sqlpp::postgresql::connection& conn, const std::string& name)
 {
-    if (!tx_)
-        return false;
+    std::lock_guard< std::mutex > lock(mutex_);
 
-    try
-    {
-        tx_->rollback();
-        return true;
-    }
-    catch (const std::exception& e)
-    {
-        std::ostringstream oss;
-        oss << "Error during rollback: " << e.what();
-        logger::LOG.error(oss.str());
-        return false;
-    }
+    auto it = entries_.find(&conn);
+    return it != entries_.end() && it->second.names_.count(name) > 0;
 }
 
-// Get the connection associated with this transaction
-std::shared_ptr< sqlpp::postgresql::connection > ct::db::TransactionGuard::getConnection()
+void ct::db::PreparedStatementCache::track(sqlpp::postgresql::connection& conn)
 {
-    return conn_;
+    std::lock_guard< std::mutex > lock(mutex_);
+    entries_[&conn].tracked_ = true;
 }
 
-template < typename Func >
-auto ct::db::executeWithRetry(Func&& operation, int maxRetries) -> decltype(operation())
+void ct::db::PreparedStatementCache::untrack(sqlpp::postgresql::connection& conn)
 {
-    int retries = 0;
-    while (true)
+    std::map< std::string, std::shared_ptr< void > > released;
     {
-        try
-        {
-            return operation();
-        }
-        catch (const std::exception& e)
-        {
-            if (++retries > maxRetries)
-            {
-                throw; // Re-throw after max retries
-            }
-
-            std::ostringstream oss;
-            oss << "Operation failed, retrying (" << retries << "/" << maxRetries << "): " << e.what();
-            logger::LOG.error(oss.str());
+        std::lock_guard< std::mutex > lock(mutex_);
 
-            // Exponential backoff
-            std::this_thread::sleep_for(std::chrono::milliseconds(100 * retries));
+        auto it = entries_.find(&conn);
+        if (it == entries_.end())
+        {
+            return;
         }
+        released.swap(it->second.statements_);
+        entries_.erase(it);
     }
-}
 
-ct::db::ConnectionStateGuard::ConnectionStateGuard(sqlpp::postgresql::connection& conn)
-    : conn_(conn), needs_reset_(false)
-{
+    // Deallocating talks to the server, so it happens outside the lock
+    released.clear();
 }
 
-ct::db::ConnectionStateGuard::~ConnectionStateGuard()
+void ct::db::PreparedStatementCache::invalidate(sqlpp::postgresql::connection& conn)
 {
-    if (needs_reset_)
+    std::map< std::string, std::shared_ptr< void > > released;
     {
-        try
-        {
-            // Deallocate all prepared statements
-            conn_.execute("DEALLOCATE ALL");
+        std::lock_guard< std::mutex > lock(mutex_);
 
-            // Execute a harmless query to reset the connection state
-            conn_.execute("SELECT 1");
-        }
-        catch (const std::exception& e)
+        auto it = entries_.find(&conn);
+        if (it == entries_.end())
         {
-            // Nothing we can do in the destructor
+            return;
         }
+        released.swap(it->second.statements_);
+        it->second.names_.clear();
     }
+
+    // Deallocating talks to the server, so it happens outside the lock
+    released.clear();
 }
 
-void ct::db::ConnectionStateGuard::markForReset()
+size_t ct::db::executePrepared(sqlpp::postgresql::connection& conn,
+                               const NamedStatement& statement,
+                               const StatementParams& params)
 {
-    needs_reset_ = true;
+    auto result = runPrepared(conn, statement, params, 0);
+
+    const char* affected = PQcmdTuples(result.get());
+    return affected[0] == '\0' ? 0 : std::stoull(affected);
 }
 
 template < typename ModelType >
@@ -575,25 +1463,32 @@ std::optional< ModelType > ct::db::findById(std::shared_ptr< sqlpp::postgresql::
 
     try
     {
-        auto query = dynamic_select(conn)
-                         .dynamic_columns()
-                         .dynamic_flags()
-                         .dynamic_from(t)
-                         .dynamic_where()
-                         .dynamic_group_by()
-                         .dynamic_order_by()
-                         .dynamic_limit()
-                         .dynamic_offset();
+        auto filter = typename ModelType::Filter();
 
-        auto filter = typename ModelType::Filter().withId(id);
+        // The id is a parameter, so one prepared statement per connection serves every lookup
+        auto query = PreparedStatementCache::getInstance().getPrepared(
+            conn,
+            ModelType::modelName() + ":findById",
+            [&]
+            {
+                auto select = dynamic_select(conn)
+                                  .dynamic_columns()
+                                  .dynamic_flags()
+                                  .dynamic_from(t)
+                                  .dynamic_where(t.id == parameter(t.id))
+                                  .dynamic_group_by()
+                                  .dynamic_order_by()
+                                  .dynamic_limit()
+                                  .dynamic_offset();
 
-        // Apply column selection
-        filter.applyToColumns(query, t);
+                // Apply column selection
+                filter.applyToColumns(select, t);
 
-        // Apply filter conditions
-        filter.applyToQuery(query, t);
+                return conn.prepare(select);
+            });
 
-        auto result = conn(query);
+        query->params.id = boost::uuids::to_string(id);
+        auto result      = conn(*query);
 
         if (result.empty())
         {
@@ -630,28 +1525,7 @@ std::optional< std::vector< ModelType > > ct::db::findByFilter(
 
     try
     {
-        // Build dynamic query with all necessary dynamic components
-        auto query = dynamic_select(conn)
-                         .dynamic_columns()
-                         .dynamic_flags()
-                         .dynamic_from(t)
-                         .dynamic_where()
-                         .dynamic_group_by()
-                         .dynamic_order_by()
-                         .dynamic_limit()
-                         .dynamic_offset();
-
-        // Apply distinct flag if needed
-        if (filter.isDistinct())
-        {
-            query.select_flags.add(sqlpp::distinct);
-        }
-
-        // Apply column selection
-        filter.applyToColumns(query, t);
-
-        // Apply filter conditions
-        filter.applyToQuery(query, t);
+        auto query = makeFilterQuery(conn, t, filter);
 
         // Execute query
         auto rows = conn(query);
@@ -692,6 +1566,53 @@ std::optional< std::vector< ModelType > > ct::db::findByFilter(
     }
 }
 
+template < typename ModelType, typename FilterType >
+size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                              const FilterType& filter,
+                              const std::function< bool(std::vector< ModelType >& chunk) >& on_chunk,
+                              size_t chunk_size)
+{
+    // Keep a pooled connection checked out until the cursor is closed
+    auto connection = conn_ptr ? conn_ptr : Database::getInstance().getConnection();
+    auto& conn      = *connection;
+    const auto& t   = ModelType::table();
+
+    // Create state guard for this connection
+    ConnectionStateGuard stateGuard(conn);
+
+    try
+    {
+        auto query = makeFilterQuery(conn, t, filter);
+
+        std::vector< ModelType > chunk;
+        chunk.reserve(std::min< size_t >(chunk_size, 4096));
+
+        return fetchInChunks(conn,
+                             toSql(conn, query),
+                             chunk_size,
+                             [&](const PGresult* result)
+                             {
+                                 chunk.clear();
+                                 for (int i = 0; i < PQntuples(result); ++i)
+                                 {
+                                     chunk.push_back(ModelType::fromRow(ResultRow(result, i), filter));
+                                 }
+                                 return on_chunk(chunk);
+                             });
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error in streamByFilter for " << ModelType::modelName() << ": " << e.what();
+        logger::LOG.error(oss.str());
+
+        // Mark the connection for reset
+        stateGuard.markForReset();
+
+        throw;
+    }
+}
+
 // Generic save implementation
 template < typename ModelType >
 void ct::db::save(ModelType& model,
@@ -707,9 +1628,27 @@ void ct::db::save(ModelType& model,
 
     try
     {
-        auto stmt  = model.prepareSelectStatementForConflictCheck(t, conn);
-        auto query = conn.prepare(stmt);
-        auto rows  = conn(query);
+        if constexpr (HasUpsert< ModelType >::value)
+        {
+            if (update_on_conflict)
+            {
+                StatementParams params;
+                model.bindUpsertParams(params);
+                executePrepared(conn, ModelType::upsertStatement(), params);
+            }
+            else
+            {
+                // A conflict fails the insert just like it would after a select found it
+                auto insert_stmt = model.prepareInsertStatement(t, conn);
+                conn(insert_stmt);
+            }
+
+            return;
+        }
+
+        // The conflict check carries its values as literals, preparing it would not be reused
+        auto stmt = model.prepareSelectStatementForConflictCheck(t, conn);
+        auto rows = conn(stmt);
 
         std::vector< ModelType > retrieved;
 
@@ -812,7 +1751,7 @@ void ct::db::batchSave(const std::vector< ModelType >& models,
 
 // Default constructor
 ct::db::Order::Order(bool should_silent)
-    : id_(boost::uuids::random_generator()()), session_id_(boost::uuids::random_generator()())
+    : id_(helper::generateFastUUID()), session_id_(helper::generateFastUUID())
 {
     created_at_ = helper::nowToTimestamp();
 
@@ -843,10 +1782,6 @@ ct::db::Order::Order(bool should_silent)
             logger::LOG.info(txt);
         }
     }
-
-    // TODO: Handle exchange balance for ordered asset
-    // e = selectors.get_exchange(exchange_);
-    // e.on_order_submission(*this);
 }
 
 // Constructor with attributes
@@ -976,7 +1911,7 @@ ct::db::Order::Order(std::optional< boost::uuids::uuid > trade_id,
                      std::optional< int64_t > canceled_at,
                      nlohmann::json vars,
                      std::optional< enums::OrderSubmittedVia > submitted_via)
-    : id_(boost::uuids::random_generator()())
+    : id_(helper::generateFastUUID())
     , trade_id_(trade_id)
     , session_id_(session_id)
     , exchange_id_(exchange_id)
@@ -998,6 +1933,50 @@ ct::db::Order::Order(std::optional< boost::uuids::uuid > trade_id,
 }
 
 // Calculated properties
+ct::db::Order& ct::db::Order::operator=(const Order& other)
+{
+    if (this != &other)
+    {
+        assignFields(other);
+    }
+    return *this;
+}
+
+ct::db::Order& ct::db::Order::operator=(Order&& other)
+{
+    if (this != &other)
+    {
+        assignFields(std::move(other));
+    }
+    return *this;
+}
+
+// The listener stays with this order and learns about the new fields
+template < typename Other >
+void ct::db::Order::assignFields(Other&& other)
+{
+    id_            = std::forward< Other >(other).id_;
+    trade_id_      = std::forward< Other >(other).trade_id_;
+    session_id_    = std::forward< Other >(other).session_id_;
+    exchange_id_   = std::forward< Other >(other).exchange_id_;
+    symbol_        = std::forward< Other >(other).symbol_;
+    exchange_name_ = std::forward< Other >(other).exchange_name_;
+    order_side_    = std::forward< Other >(other).order_side_;
+    order_type_    = std::forward< Other >(other).order_type_;
+    reduce_only_   = std::forward< Other >(other).reduce_only_;
+    qty_           = std::forward< Other >(other).qty_;
+    filled_qty_    = std::forward< Other >(other).filled_qty_;
+    price_         = std::forward< Other >(other).price_;
+    status_        = std::forward< Other >(other).status_;
+    created_at_    = std::forward< Other >(other).created_at_;
+    executed_at_   = std::forward< Other >(other).executed_at_;
+    canceled_at_   = std::forward< Other >(other).canceled_at_;
+    vars_          = std::forward< Other >(other).vars_;
+    submitted_via_ = std::forward< Other >(other).submitted_via_;
+
+    notifyChanged();
+}
+
 double ct::db::Order::getValue() const
 {
     if (!price_)
@@ -1012,12 +1991,66 @@ double ct::db::Order::getRemainingQty() const
     return helper::prepareQty(std::abs(qty_) - std::abs(filled_qty_), enums::toString(order_side_));
 }
 
+namespace
+{
+
+std::shared_ptr< ct::exchange::Exchange > findRegisteredExchange(const ct::enums::ExchangeName& exchange_name)
+{
+    auto& exchangesState = ct::exchange::ExchangesState::getInstance();
+    return exchangesState.hasExchange(exchange_name) ? exchangesState.getExchange(exchange_name) : nullptr;
+}
+
+// Open, grow, shrink or close the position of an order by its executed part
+void applyToPosition(const ct::db::Order& executed, const std::shared_ptr< ct::exchange::Exchange >& exchange)
+{
+    auto position =
+        ct::position::PositionsState::getInstance().getPosition(executed.getExchangeName(), executed.getSymbol());
+    if (!position)
+    {
+        return;
+    }
+
+    if (!position->getExchange())
+    {
+        // The position was created before its exchange was registered
+        position->setExchange(exchange);
+    }
+
+    if (position->getExchange())
+    {
+        position->onExecutedOrder(executed);
+    }
+}
+
+} // namespace
+
 // Order state transitions
+void ct::db::Order::submitToExchange()
+{
+    if (exchange_link_.submitted_)
+    {
+        return;
+    }
+
+    auto exchange = findRegisteredExchange(exchange_name_);
+    if (!exchange)
+    {
+        return;
+    }
+
+    exchange->onOrderSubmission(*this);
+    exchange_link_.submitted_ = true;
+}
+
 void ct::db::Order::queueIt()
 {
+    // A rejected order is left as it was
+    submitToExchange();
+
     // NOTE: Precondition?
     status_ = enums::OrderStatus::QUEUED;
     canceled_at_.reset();
+    notifyChanged();
 
     if (helper::isDebuggable("order_submission"))
     {
@@ -1044,10 +2077,13 @@ void ct::db::Order::resubmit()
                                  enums::toString(status_));
     }
 
+    submitToExchange();
+
     // Regenerate the order id to avoid errors on the exchange's side
-    id_     = boost::uuids::random_generator()();
+    id_     = helper::generateFastUUID();
     status_ = enums::OrderStatus::ACTIVE;
     canceled_at_.reset();
+    notifyChanged();
 
     if (helper::isDebuggable("order_submission"))
     {
@@ -1080,12 +2116,13 @@ void ct::db::Order::cancel(bool silent, const std::string& source)
 
     canceled_at_ = helper::nowToTimestamp();
     status_      = enums::OrderStatus::CANCELED;
+    notifyChanged();
 
-    // TODO:
-    // if (helper::isLive())
-    // {
-    //     save();
-    // }
+    if (helper::isLive())
+    {
+        // A copy is queued, so the order keeps changing without touching the pending write
+        WriteBehind::getInstance().enqueue(*this);
+    }
 
     if (!silent)
     {
@@ -1112,9 +2149,14 @@ void ct::db::Order::cancel(bool silent, const std::string& source)
         }
     }
 
-    // TODO: Handle exchange balance
-    // auto e = selectors.get_exchange(exchange_);
-    // e.on_order_cancellation(*this);
+    if (exchange_link_.submitted_)
+    {
+        exchange_link_.submitted_ = false;
+        if (auto exchange = findRegisteredExchange(exchange_name_))
+        {
+            exchange->onOrderCancellation(*this);
+        }
+    }
 }
 
 void ct::db::Order::execute(bool silent)
@@ -1124,14 +2166,80 @@ void ct::db::Order::execute(bool silent)
         return;
     }
 
+    bool partiallyFilled = isPartiallyFilled();
+
+    markExecuted(silent);
+
+    // TODO: Log the order of the trade for metrics
+    // store.completed_trades.add_executed_order(*this);
+
+    // Every fill goes through here or fill, so the exchange balance and the position are updated exactly once
+    auto exchange = findRegisteredExchange(exchange_name_);
+    if (exchange && exchange_link_.submitted_)
+    {
+        exchange_link_.submitted_ = false;
+        exchange->onOrderExecution(*this);
+    }
+
+    if (!partiallyFilled)
+    {
+        applyToPosition(*this, exchange);
+        return;
+    }
+
+    // Earlier fills reached the position already, what they left is executed at the order price
+    Order executed(*this);
+    executed.qty_        = getRemainingQty();
+    executed.filled_qty_ = 0.0;
+    applyToPosition(executed, exchange);
+}
+
+void ct::db::Order::fill(double qty, double price, bool silent)
+{
+    if (isCanceled() || isExecuted())
+    {
+        return;
+    }
+
+    // Never more than what is left, signed like the order
+    qty = helper::prepareQty(std::min(std::abs(qty), std::abs(getRemainingQty())), enums::toString(order_side_));
+
+    auto exchange = findRegisteredExchange(exchange_name_);
+    if (exchange && exchange_link_.submitted_)
+    {
+        exchange->onOrderFill(*this, qty, price);
+    }
+
+    Order filled(*this);
+    filled.qty_        = qty;
+    filled.filled_qty_ = 0.0;
+    filled.price_      = price;
+
+    filled_qty_ += qty;
+    if (std::abs(filled_qty_) >= std::abs(qty_))
+    {
+        // The last fill settled what the exchange still held
+        exchange_link_.submitted_ = false;
+        markExecuted(silent);
+    }
+    else
+    {
+        executePartially(silent);
+    }
+
+    applyToPosition(filled, exchange);
+}
+
+void ct::db::Order::markExecuted(bool silent)
+{
     executed_at_ = helper::nowToTimestamp();
     status_      = enums::OrderStatus::EXECUTED;
+    notifyChanged();
 
-    // TODO:
-    // if (helper::isLive())
-    // {
-    //     save();
-    // }
+    if (helper::isLive())
+    {
+        WriteBehind::getInstance().enqueue(*this);
+    }
 
     if (!silent)
     {
@@ -1157,19 +2265,6 @@ void ct::db::Order::execute(bool silent)
             }
         }
     }
-
-    // TODO: Log the order of the trade for metrics
-    // store.completed_trades.add_executed_order(*this);
-
-    // TODO: Handle exchange balance
-    // auto e = selectors.get_exchange(exchange_);
-    // e.on_order_execution(*this);
-
-    // TODO: Update position
-    // auto p = selectors.get_position(exchange_, symbol_);
-    // if (p) {
-    //     p._on_executed_order(*this);
-    // }
 }
 
 void ct::db::Order::executePartially(bool silent)
@@ -1177,12 +2272,12 @@ void ct::db::Order::executePartially(bool silent)
     // NOTE: preconditions?
     executed_at_ = helper::nowToTimestamp();
     status_      = enums::OrderStatus::PARTIALLY_FILLED;
+    notifyChanged();
 
-    // TODO:
-    // if (helper::isLive())
-    // {
-    //     save();
-    // }
+    if (helper::isLive())
+    {
+        WriteBehind::getInstance().enqueue(*this);
+    }
 
     if (!silent)
     {
@@ -1212,12 +2307,6 @@ void ct::db::Order::executePartially(bool silent)
 
     // TODO: Log the order of the trade for metrics
     // store.completed_trades.add_executed_order(*this);
-
-    // TODO: Update position
-    // auto p = selectors.get_position(exchange_, symbol_);
-    // if (p) {
-    //     p._on_executed_order(*this);
-    // }
 }
 
 // Notification methods
@@ -1708,6 +2797,29 @@ auto ct::db::Candle::prepareUpdateStatement(const CandlesTable& t, sqlpp::postgr
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::Candle::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "candles",
+        {"id", "timestamp", "open", "close", "high", "low", "volume", "exchange_name", "symbol", "timeframe"},
+        {"exchange_name", "symbol", "timeframe", "timestamp"});
+    return statement;
+}
+
+void ct::db::Candle::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(timestamp_);
+    params.add(open_);
+    params.add(close_);
+    params.add(high_);
+    params.add(low_);
+    params.add(volume_);
+    params.add(enums::toString(exchange_name_));
+    params.add(symbol_);
+    params.add(timeframe::toString(timeframe_));
+}
+
 template < typename Query, typename Table >
 void ct::db::Candle::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -1890,6 +3002,133 @@ void ct::db::saveCandles(std::shared_ptr< sqlpp::postgresql::connection > conn_p
     }
 }
 
+size_t ct::db::loadCandles(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                           const enums::ExchangeName& exchange_name,
+                           const std::string& symbol,
+                           const timeframe::Timeframe& timeframe,
+                           int64_t start_timestamp,
+                           int64_t finish_timestamp,
+                           blaze::DynamicMatrix< double >& candles,
+                           size_t chunk_size)
+{
+    if (candles.columns() < 6)
+    {
+        throw std::invalid_argument("Expected at least 6 columns to load candles into, got " +
+                                    std::to_string(candles.columns()));
+    }
+
+    // Keep a pooled connection checked out until the cursor is closed
+    auto connection = conn_ptr ? conn_ptr : Database::getInstance().getConnection();
+    auto& conn      = *connection;
+    const auto& t   = Candle::table();
+
+    // Create state guard for this connection
+    ConnectionStateGuard stateGuard(conn);
+
+    try
+    {
+        // Selected in the column order of the matrix
+        auto filter = Candle::Filter()
+                          .withExchangeName(exchange_name)
+                          .withSymbol(symbol)
+                          .withTimeframe(timeframe)
+                          .withTimestampRange(start_timestamp, finish_timestamp)
+                          .withOrderBy("timestamp", OrderBy::ASC)
+                          .withColumns({"timestamp", "open", "close", "high", "low", "volume"});
+        auto query = makeFilterQuery(conn, t, filter);
+
+        size_t filled = 0;
+        fetchInChunks(conn,
+                      toSql(conn, query),
+                      chunk_size,
+                      [&](const PGresult* result)
+                      {
+                          const int count = PQntuples(result);
+                          if (filled + static_cast< size_t >(count) > candles.rows())
+                          {
+                              candles.resize(
+                                  std::max(filled + count, candles.rows() * 2), candles.columns(), true);
+                          }
+
+                          for (int i = 0; i < count; ++i, ++filled)
+                          {
+                              const char* timestamp = PQgetvalue(result, i, 0);
+                              candles(filled, 0)    = static_cast< double >(std::strtoll(timestamp, nullptr, 10));
+                              for (int j = 1; j < 6; ++j)
+                              {
+                                  candles(filled, j) = std::strtod(PQgetvalue(result, i, j), nullptr);
+                              }
+                          }
+                          return true;
+                      });
+
+        return filled;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error loading candles: " << e.what();
+        logger::LOG.error(oss.str());
+
+        // Mark the connection for reset
+        stateGuard.markForReset();
+
+        throw;
+    }
+}
+
+size_t ct::db::loadCandlesBinary(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                 const enums::ExchangeName& exchange_name,
+                                 const std::string& symbol,
+                                 const timeframe::Timeframe& timeframe,
+                                 int64_t start_timestamp,
+                                 int64_t finish_timestamp,
+                                 blaze::DynamicMatrix< double >& candles)
+{
+    static const NamedStatement statement{
+        "ct_candles_range",
+        "SELECT timestamp, open, close, high, low, volume FROM candles WHERE exchange_name = $1 AND symbol = $2 AND "
+        "timeframe = $3 AND timestamp >= $4 AND timestamp <= $5 ORDER BY timestamp",
+        5};
+
+    if (candles.columns() < 6)
+    {
+        throw std::invalid_argument("Expected at least 6 columns to load candles into, got " +
+                                    std::to_string(candles.columns()));
+    }
+
+    // Keep a pooled connection checked out until the result is decoded
+    auto connection = conn_ptr ? conn_ptr : Database::getInstance().getConnection();
+    auto& conn      = *connection;
+
+    // Create state guard for this connection
+    ConnectionStateGuard stateGuard(conn);
+
+    try
+    {
+        StatementParams params;
+        params.add(enums::toString(exchange_name));
+        params.add(symbol);
+        params.add(timeframe::toString(timeframe));
+        params.add(start_timestamp);
+        params.add(finish_timestamp);
+
+        auto result = runPrepared(conn, statement, params, 1);
+        return decodeBinaryMatrix(result.get(), candles);
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error loading candles: " << e.what();
+        logger::LOG.error(oss.str());
+
+        // Mark the connection for reset
+        stateGuard.markForReset();
+
+        throw;
+    }
+}
+
 // Default constructor
 ct::db::ClosedTrade::ClosedTrade()
     : id_(boost::uuids::random_generator()())
@@ -2175,6 +3414,36 @@ auto ct::db::ClosedTrade::prepareUpdateStatement(const ClosedTradesTable& t, sql
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::ClosedTrade::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "closed_trades",
+        {"id",
+         "strategy_name",
+         "symbol",
+         "exchange_name",
+         "position_type",
+         "timeframe",
+         "opened_at",
+         "closed_at",
+         "leverage"},
+        {"id"});
+    return statement;
+}
+
+void ct::db::ClosedTrade::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(strategy_name_);
+    params.add(symbol_);
+    params.add(enums::toString(exchange_name_));
+    params.add(enums::toString(position_type_));
+    params.add(timeframe::toString(timeframe_));
+    params.add(opened_at_);
+    params.add(closed_at_);
+    params.add(static_cast< int32_t >(leverage_));
+}
+
 template < typename Query, typename Table >
 void ct::db::ClosedTrade::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -2443,6 +3712,26 @@ auto ct::db::ExchangeApiKeys::prepareUpdateStatement(const ExchangeApiKeysTable&
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::ExchangeApiKeys::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "exchange_api_keys",
+        {"id", "exchange_name", "name", "api_key", "api_secret", "additional_fields", "created_at"},
+        {"name"});
+    return statement;
+}
+
+void ct::db::ExchangeApiKeys::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(enums::toString(exchange_name_));
+    params.add(name_);
+    params.add(api_key_);
+    params.add(api_secret_);
+    params.add(additional_fields_);
+    params.add(created_at_);
+}
+
 template < typename Query, typename Table >
 void ct::db::ExchangeApiKeys::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -2541,6 +3830,24 @@ auto ct::db::Log::prepareUpdateStatement(const LogTable& t, sqlpp::postgresql::c
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::Log::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "logs",
+        {"id", "session_id", "timestamp", "message", "level"},
+        {"id"});
+    return statement;
+}
+
+void ct::db::Log::bindUpsertParams(StatementParams& params) const
+{
+    params.add(boost::uuids::to_string(id_));
+    params.add(boost::uuids::to_string(session_id_));
+    params.add(timestamp_);
+    params.add(message_);
+    params.add(static_cast< int32_t >(level_));
+}
+
 template < typename Query, typename Table >
 void ct::db::Log::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -2640,6 +3947,24 @@ auto ct::db::NotificationApiKeys::prepareUpdateStatement(const NotificationApiKe
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::NotificationApiKeys::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "notification_api_keys",
+        {"id", "name", "driver", "fields", "created_at"},
+        {"name"});
+    return statement;
+}
+
+void ct::db::NotificationApiKeys::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(name_);
+    params.add(driver_);
+    params.add(fields_json_);
+    params.add(created_at_);
+}
+
 template < typename Query, typename Table >
 void ct::db::NotificationApiKeys::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -2738,6 +4063,23 @@ auto ct::db::Option::prepareUpdateStatement(const OptionsTable& t, sqlpp::postgr
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::Option::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "options",
+        {"id", "updated_at", "option_type", "value"},
+        {"id"});
+    return statement;
+}
+
+void ct::db::Option::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(updated_at_);
+    params.add(option_type_);
+    params.add(value_);
+}
+
 template < typename Query, typename Table >
 void ct::db::Option::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -2833,6 +4175,24 @@ auto ct::db::Orderbook::prepareUpdateStatement(const OrderbooksTable& t, sqlpp::
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::Orderbook::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "orderbooks",
+        {"id", "timestamp", "symbol", "exchange_name", "data"},
+        {"exchange_name", "symbol", "timestamp"});
+    return statement;
+}
+
+void ct::db::Orderbook::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(timestamp_);
+    params.add(symbol_);
+    params.add(enums::toString(exchange_name_));
+    params.add(data_);
+}
+
 template < typename Query, typename Table >
 void ct::db::Orderbook::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -2867,6 +4227,49 @@ void ct::db::Orderbook::Filter::applyToQuery(Query& query, const Table& t) const
     }
 }
 
+void ct::db::saveOrderbooks(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                            const std::vector< Orderbook >& orderbooks)
+{
+    if (orderbooks.empty())
+    {
+        return;
+    }
+
+    // Use the provided connection if available, otherwise get the default connection
+    auto& conn    = *(conn_ptr ? conn_ptr : Database::getInstance().getConnection());
+    const auto& t = Orderbook::table();
+
+    // Create state guard for this connection
+    ConnectionStateGuard stateGuard(conn);
+
+    auto stmt = sqlpp::insert_into(t).columns(t.id, t.timestamp, t.symbol, t.exchange_name, t.data);
+
+    for (const auto& orderbook : orderbooks)
+    {
+        stmt.values.add(t.id            = orderbook.getIdAsString(),
+                        t.timestamp     = orderbook.getTimestamp(),
+                        t.symbol        = orderbook.getSymbol(),
+                        t.exchange_name = enums::toString(orderbook.getExchangeName()),
+                        t.data          = orderbook.getData());
+    }
+
+    try
+    {
+        conn(stmt);
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error saving orderbooks: " << e.what();
+        logger::LOG.error(oss.str());
+
+        // Mark the connection for reset
+        stateGuard.markForReset();
+
+        throw;
+    }
+}
+
 ct::db::Ticker::Ticker() : id_(boost::uuids::random_generator()()) {}
 
 ct::db::Ticker::Ticker(const std::unordered_map< std::string, std::any >& attributes) : Ticker()
@@ -2951,6 +4354,27 @@ auto ct::db::Ticker::prepareUpdateStatement(const TickersTable& t, sqlpp::postgr
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::Ticker::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "tickers",
+        {"id", "timestamp", "last_price", "volume", "high_price", "low_price", "symbol", "exchange_name"},
+        {"exchange_name", "symbol", "timestamp"});
+    return statement;
+}
+
+void ct::db::Ticker::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(timestamp_);
+    params.add(last_price_);
+    params.add(volume_);
+    params.add(high_price_);
+    params.add(low_price_);
+    params.add(symbol_);
+    params.add(enums::toString(exchange_name_));
+}
+
 template < typename Query, typename Table >
 void ct::db::Ticker::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -3092,6 +4516,28 @@ auto ct::db::Trade::prepareUpdateStatement(const TradesTable& t, sqlpp::postgres
         .dynamic_where(t.id == parameter(t.id));
 }
 
+const ct::db::NamedStatement& ct::db::Trade::upsertStatement()
+{
+    static const NamedStatement statement = makeUpsertStatement(
+        "trades",
+        {"id", "timestamp", "price", "buy_qty", "sell_qty", "buy_count", "sell_count", "symbol", "exchange_name"},
+        {"exchange_name", "symbol", "timestamp"});
+    return statement;
+}
+
+void ct::db::Trade::bindUpsertParams(StatementParams& params) const
+{
+    params.add(getIdAsString());
+    params.add(timestamp_);
+    params.add(price_);
+    params.add(buy_qty_);
+    params.add(sell_qty_);
+    params.add(static_cast< int32_t >(buy_count_));
+    params.add(static_cast< int32_t >(sell_count_));
+    params.add(symbol_);
+    params.add(enums::toString(exchange_name_));
+}
+
 template < typename Query, typename Table >
 void ct::db::Trade::Filter::applyToQuery(Query& query, const Table& t) const
 {
@@ -4189,6 +5635,56 @@ ct::db::Trade ct::db::Trade::fromRow(const ROW& row, const Filter& filter)
     return trade;
 }
 
+size_t ct::db::loadTradesBinary(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                const enums::ExchangeName& exchange_name,
+                                const std::string& symbol,
+                                int64_t start_timestamp,
+                                int64_t finish_timestamp,
+                                blaze::DynamicMatrix< double >& trades)
+{
+    static const NamedStatement statement{
+        "ct_trades_range",
+        "SELECT timestamp, price, buy_qty, sell_qty, buy_count, sell_count FROM trades WHERE exchange_name = $1 AND "
+        "symbol = $2 AND timestamp >= $3 AND timestamp <= $4 ORDER BY timestamp",
+        4};
+
+    if (trades.columns() < 6)
+    {
+        throw std::invalid_argument("Expected at least 6 columns to load trades into, got " +
+                                    std::to_string(trades.columns()));
+    }
+
+    // Keep a pooled connection checked out until the result is decoded
+    auto connection = conn_ptr ? conn_ptr : Database::getInstance().getConnection();
+    auto& conn      = *connection;
+
+    // Create state guard for this connection
+    ConnectionStateGuard stateGuard(conn);
+
+    try
+    {
+        StatementParams params;
+        params.add(enums::toString(exchange_name));
+        params.add(symbol);
+        params.add(start_timestamp);
+        params.add(finish_timestamp);
+
+        auto result = runPrepared(conn, statement, params, 1);
+        return decodeBinaryMatrix(result.get(), trades);
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error loading trades: " << e.what();
+        logger::LOG.error(oss.str());
+
+        // Mark the connection for reset
+        stateGuard.markForReset();
+
+        throw;
+    }
+}
+
 template std::optional< ct::db::Candle > ct::db::findById(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
                                                           const boost::uuids::uuid& id);
 
@@ -4255,6 +5751,64 @@ template std::optional< std::vector< ct::db::Trade > > ct::db::findByFilter(
 template std::optional< std::vector< ct::db::Order > > ct::db::findByFilter(
     std::shared_ptr< sqlpp::postgresql::connection > conn_ptr, const ct::db::Order::Filter& filter);
 
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::Candle::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::Candle >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::ClosedTrade::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::ClosedTrade >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
+template size_t ct::db::streamByFilter(
+    std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+    const ct::db::DailyBalance::Filter& filter,
+    const std::function< bool(std::vector< ct::db::DailyBalance >& chunk) >& on_chunk,
+    size_t chunk_size);
+
+template size_t ct::db::streamByFilter(
+    std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+    const ct::db::ExchangeApiKeys::Filter& filter,
+    const std::function< bool(std::vector< ct::db::ExchangeApiKeys >& chunk) >& on_chunk,
+    size_t chunk_size);
+
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::Log::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::Log >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
+template size_t ct::db::streamByFilter(
+    std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+    const ct::db::NotificationApiKeys::Filter& filter,
+    const std::function< bool(std::vector< ct::db::NotificationApiKeys >& chunk) >& on_chunk,
+    size_t chunk_size);
+
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::Option::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::Option >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::Orderbook::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::Orderbook >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::Ticker::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::Ticker >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::Trade::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::Trade >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
+template size_t ct::db::streamByFilter(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const ct::db::Order::Filter& filter,
+                                       const std::function< bool(std::vector< ct::db::Order >& chunk) >& on_chunk,
+                                       size_t chunk_size);
+
 template void ct::db::save(ct::db::Candle& model,
                            std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
                            const bool update_on_conflict);
@@ -68,13 +68,49 @@ void ct::exchange::Exchange::setAsset(const std::string& asset, double balance)
     assets_[asset] = balance;
 }
 
+std::vector< std::shared_ptr< ct::db::Order > > ct::exchange::Exchange::submitOrders(
+    const std::vector< OrderSpec >& specs)
+{
+    std::vector< std::shared_ptr< db::Order > > orders;
+    orders.reserve(specs.size());
+
+    for (const auto& spec : specs)
+    {
+        std::shared_ptr< db::Order > order;
+
+        switch (spec.order_type_)
+        {
+            case enums::OrderType::MARKET:
+                order = marketOrder(spec.symbol_, spec.qty_, spec.price_, spec.order_side_, spec.reduce_only_);
+                break;
+            case enums::OrderType::LIMIT:
+                order = limitOrder(spec.symbol_, spec.qty_, spec.price_, spec.order_side_, spec.reduce_only_);
+                break;
+            case enums::OrderType::STOP:
+                order = stopOrder(spec.symbol_, spec.qty_, spec.price_, spec.order_side_, spec.reduce_only_);
+                break;
+            default:
+                throw std::invalid_argument("Unsupported order type in a batch: " + enums::toString(spec.order_type_));
+        }
+
+        orders.push_back(order);
+    }
+
+    return orders;
+}
+
+void ct::exchange::Exchange::cancelOrders(const std::string& symbol, const std::vector< std::string >& order_ids)
+{
+    for (const auto& orderId : order_ids)
+    {
+        cancelOrder(symbol, orderId);
+    }
+}
+
 ct::exchange::SpotExchange::SpotExchange(const enums::ExchangeName& name, double starting_balance, double fee_rate)
     : Exchange(name, starting_balance, fee_rate, enums::ExchangeType::SPOT)
+    , fee_complement_units_(fee_scale_.toUnits(1.0 - fee_rate))
 {
-    // Initialize the orders sum maps
-    stop_sell_orders_qty_sum_  = {};
-    limit_sell_orders_qty_sum_ = {};
-
     // TODO:
     // live-trading only
     // starting_balance_ = 0;
@@ -133,90 +169,75 @@ void ct::exchange::SpotExchange::onOrderSubmission(const ct::db::Order& order)
         return;
     }
 
-    // Save original state before making any changes
-    std::string symbol     = order.getSymbol();
-    std::string base_asset = helper::getBaseAsset(symbol);
-
-    // Save original balances and order sums
-    double original_settlement_balance = assets_[settlement_currency_];
-    double original_stop_sum           = stop_sell_orders_qty_sum_[symbol];
-    double original_limit_sum          = limit_sell_orders_qty_sum_[symbol];
+    const auto& symbol = order.getSymbol();
+    auto base_asset    = helper::getBaseAsset(symbol);
 
-    try
+    // Balances are only written once every check passed, a rejected order leaves no trace
+    if (order.getOrderSide() == enums::OrderSide::SELL)
     {
-        if (order.getOrderSide() == enums::OrderSide::SELL)
-        {
-            if (order.getOrderType() == enums::OrderType::STOP)
-            {
-                stop_sell_orders_qty_sum_[symbol] =
-                    helper::addFloatsMaintainPrecesion(stop_sell_orders_qty_sum_[symbol], std::abs(order.getQty()));
-            }
-            else if (order.getOrderType() == enums::OrderType::LIMIT)
-            {
-                limit_sell_orders_qty_sum_[symbol] =
-                    helper::addFloatsMaintainPrecesion(limit_sell_orders_qty_sum_[symbol], std::abs(order.getQty()));
-            }
+        const auto& baseScale = getAssetScale(base_asset);
+        auto qty              = getOrderQtyUnits(order);
+        auto& stopSum         = stop_sell_orders_qty_sum_[symbol];
+        auto& limitSum        = limit_sell_orders_qty_sum_[symbol];
+        auto baseBalance      = getAssetUnits(base_asset);
 
-            double base_balance = assets_[base_asset];
+        // Sell order's qty cannot be bigger than the amount of existing base asset
+        int64_t orderQty = 0;
 
-            // Sell order's qty cannot be bigger than the amount of existing base asset
-            double order_qty = 0.0;
-
-            if (order.getOrderType() == enums::OrderType::MARKET)
-            {
-                order_qty =
-                    helper::addFloatsMaintainPrecesion(std::abs(order.getQty()), limit_sell_orders_qty_sum_[symbol]);
-            }
-            else if (order.getOrderType() == enums::OrderType::STOP)
-            {
-                order_qty = stop_sell_orders_qty_sum_[symbol];
-            }
-            else if (order.getOrderType() == enums::OrderType::LIMIT)
-            {
-                order_qty = limit_sell_orders_qty_sum_[symbol];
-            }
-            else
-            {
-                throw std::runtime_error("Unknown order type " + enums::toString(order.getOrderType()));
-            }
-
-            // Validate that the total selling amount is not bigger than the amount of the existing base asset
-            if (order_qty > base_balance)
-            {
-                auto msg = "InsufficientBalance: Not enough balance. Available balance at " + enums::toString(name_) +
-                           " for " + base_asset + " is " + std::to_string(base_balance) +
-                           " but you're trying to sell " + std::to_string(order_qty);
-
-                throw exception::InsufficientBalance(msg);
-            }
+        if (order.getOrderType() == enums::OrderType::MARKET)
+        {
+            orderQty = qty + limitSum;
+        }
+        else if (order.getOrderType() == enums::OrderType::STOP)
+        {
+            orderQty = stopSum + qty;
+        }
+        else if (order.getOrderType() == enums::OrderType::LIMIT)
+        {
+            orderQty = limitSum + qty;
         }
         else
         {
-            // Cannot buy if we don't have enough balance (of the settlement currency)
-            auto rem = helper::subtractFloatsMaintainPrecesion(assets_[settlement_currency_], order.getValue());
+            throw std::runtime_error("Unknown order type " + enums::toString(order.getOrderType()));
+        }
 
-            if (rem < 0)
-            {
-                auto msg = "InsufficientBalance: Not enough balance. Available balance at " + enums::toString(name_) +
-                           " for " + std::string(settlement_currency_) + " is " +
-                           std::to_string(original_settlement_balance) + " but you're trying to spend " +
-                           std::to_string(order.getValue());
+        // Validate that the total selling amount is not bigger than the amount of the existing base asset
+        if (orderQty > baseBalance)
+        {
+            auto msg = "InsufficientBalance: Not enough balance. Available balance at " + enums::toString(name_) +
+                       " for " + base_asset + " is " + std::to_string(baseScale.toDouble(baseBalance)) +
+                       " but you're trying to sell " + std::to_string(baseScale.toDouble(orderQty));
 
-                throw exception::InsufficientBalance(msg);
-            }
+            throw exception::InsufficientBalance(msg);
+        }
 
-            assets_[settlement_currency_] = rem;
+        if (order.getOrderType() == enums::OrderType::STOP)
+        {
+            stopSum = orderQty;
+        }
+        else if (order.getOrderType() == enums::OrderType::LIMIT)
+        {
+            limitSum = orderQty;
         }
     }
-    catch (...)
+    else
     {
-        // Revert to original state in case of any exception
-        assets_[settlement_currency_]      = original_settlement_balance;
-        stop_sell_orders_qty_sum_[symbol]  = original_stop_sum;
-        limit_sell_orders_qty_sum_[symbol] = original_limit_sum;
+        // Cannot buy if we don't have enough balance (of the settlement currency)
+        auto balance = getAssetUnits(settlement_currency_);
+        auto rem     = balance - getOrderValueUnits(order);
+
+        if (rem < 0)
+        {
+            const auto& scale = getAssetScale(settlement_currency_);
+
+            auto msg = "InsufficientBalance: Not enough balance. Available balance at " + enums::toString(name_) +
+                       " for " + std::string(settlement_currency_) + " is " + std::to_string(scale.toDouble(balance)) +
+                       " but you're trying to spend " + std::to_string(order.getValue());
+
+            throw exception::InsufficientBalance(msg);
+        }
 
-        // Re-throw the exception
-        throw;
+        setAssetUnits(settlement_currency_, rem);
     }
 }
 
@@ -229,67 +250,61 @@ void ct::exchange::SpotExchange::onOrderExecution(const ct::db::Order& order)
         return;
     }
 
-    std::string symbol     = order.getSymbol();
-    std::string base_asset = helper::getBaseAsset(symbol);
+    applyExecution(order, getOrderQtyUnits(order), order.getPrice().value_or(0.0));
+}
 
-    // Save original values
-    double original_stop_sum           = stop_sell_orders_qty_sum_[symbol];
-    double original_limit_sum          = limit_sell_orders_qty_sum_[symbol];
-    double original_base_balance       = assets_[base_asset];
-    double original_settlement_balance = assets_[settlement_currency_];
+void ct::exchange::SpotExchange::onOrderFill(const ct::db::Order& order, double qty, double price)
+{
+    std::lock_guard< std::mutex > lock(mutex_);
 
-    try
+    if (helper::isLiveTrading())
     {
-        if (order.getOrderSide() == enums::OrderSide::SELL)
-        {
-            if (order.getOrderType() == enums::OrderType::STOP)
-            {
-                stop_sell_orders_qty_sum_[symbol] = helper::subtractFloatsMaintainPrecesion(
-                    stop_sell_orders_qty_sum_[symbol], std::abs(order.getQty()));
-            }
-            else if (order.getOrderType() == enums::OrderType::LIMIT)
-            {
-                limit_sell_orders_qty_sum_[symbol] = helper::subtractFloatsMaintainPrecesion(
-                    limit_sell_orders_qty_sum_[symbol], std::abs(order.getQty()));
-            }
+        return;
+    }
 
-            double current_balance = assets_[base_asset];
-            double order_qty;
+    applyExecution(order, getAssetScale(helper::getBaseAsset(order.getSymbol())).toUnits(std::abs(qty)), price);
+}
 
-            if (std::abs(order.getQty()) > current_balance)
-            {
-                double adjusted_qty = current_balance;
-                order_qty           = std::abs(adjusted_qty);
-            }
-            else
-            {
-                order_qty = std::abs(order.getQty());
-            }
+void ct::exchange::SpotExchange::applyExecution(const ct::db::Order& order, int64_t qty, double fill_price)
+{
+    const auto& symbol    = order.getSymbol();
+    auto base_asset       = helper::getBaseAsset(symbol);
+    const auto& baseScale = getAssetScale(base_asset);
+    auto baseBalance      = getAssetUnits(base_asset);
+
+    if (order.getOrderSide() == enums::OrderSide::SELL)
+    {
+        const auto& settlementScale = getAssetScale(settlement_currency_);
+        const auto& priceScale      = getPriceScale(symbol);
 
-            // Settlement currency's balance is increased by the amount of the order's qty after fees are deducted
-            assets_[settlement_currency_] = helper::addFloatsMaintainPrecesion(
-                assets_[settlement_currency_], (order_qty * order.getPrice().value_or(0.0)) * (1 - fee_rate_));
+        // Cannot sell more than the existing base asset
+        auto orderQty = qty > baseBalance ? std::abs(baseBalance) : qty;
+        auto price    = priceScale.toUnits(fill_price);
 
-            // Now reduce base asset's balance by the amount of the order's qty
-            assets_[base_asset] = helper::subtractFloatsMaintainPrecesion(assets_[base_asset], order_qty);
+        // Settlement currency's balance is increased by the amount of the order's qty after fees are deducted
+        auto value    = settlementScale.multiply(orderQty, baseScale, price, priceScale);
+        auto proceeds = settlementScale.multiply(value, settlementScale, fee_complement_units_, fee_scale_);
+        auto balance  = getAssetUnits(settlement_currency_) + proceeds;
+
+        if (order.getOrderType() == enums::OrderType::STOP)
+        {
+            stop_sell_orders_qty_sum_[symbol] -= qty;
         }
-        else
+        else if (order.getOrderType() == enums::OrderType::LIMIT)
         {
-            // Asset's balance is increased by the amount of the order's qty after fees are deducted
-            assets_[base_asset] =
-                helper::addFloatsMaintainPrecesion(assets_[base_asset], std::abs(order.getQty()) * (1 - fee_rate_));
+            limit_sell_orders_qty_sum_[symbol] -= qty;
         }
+
+        setAssetUnits(settlement_currency_, balance);
+
+        // Now reduce base asset's balance by the amount of the order's qty
+        setAssetUnits(base_asset, baseBalance - orderQty);
     }
-    catch (...)
+    else
     {
-        // Restore original state in case of any exception
-        stop_sell_orders_qty_sum_[symbol]  = original_stop_sum;
-        limit_sell_orders_qty_sum_[symbol] = original_limit_sum;
-        assets_[base_asset]                = original_base_balance;
-        assets_[settlement_currency_]      = original_settlement_balance;
-
-        // Re-throw the exception
-        throw;
+        // Asset's balance is increased by the amount of the order's qty after fees are deducted
+        auto received = baseScale.multiply(qty, baseScale, fee_complement_units_, fee_scale_);
+        setAssetUnits(base_asset, baseBalance + received);
     }
 }
 
@@ -302,63 +317,29 @@ void ct::exchange::SpotExchange::onOrderCancellation(const ct::db::Order& order)
         return;
     }
 
-    // Store original state
-    std::string symbol     = order.getSymbol();
-    std::string base_asset = helper::getBaseAsset(symbol);
+    const auto& symbol = order.getSymbol();
 
-    // Save original values
-    double original_stop_sum           = stop_sell_orders_qty_sum_[symbol];
-    double original_limit_sum          = limit_sell_orders_qty_sum_[symbol];
-    double original_settlement_balance = assets_[settlement_currency_];
-
-    // FIXME: Duplicate subtraction?
-    // if (order.getSide() == enums::OrderSide::SELL)
-    // {
-    //     if (order.getType() == enums::OrderType::STOP)
-    //     {
-    //         stop_sell_orders_qty_sum_[order.getSymbol()] = helper::subtractFloatsMaintainPrecesion(
-    //             stop_sell_orders_qty_sum_[order.getSymbol()], std::abs(order.getQty()));
-    //     }
-    //     else if (order.getType() == enums::OrderType::LIMIT)
-    //     {
-    //         limit_sell_orders_qty_sum_[order.getSymbol()] = helper::subtractFloatsMaintainPrecesion(
-    //             limit_sell_orders_qty_sum_[order.getSymbol()], std::abs(order.getQty()));
-    //     }
-    // }
-
-    try
+    // Buy order
+    if (order.getOrderSide() == enums::OrderSide::BUY)
     {
-        // Buy order
-        if (order.getOrderSide() == enums::OrderSide::BUY)
+        // The value is computed the same way as on submission, the reserved amount is returned exactly
+        auto value = getOrderValueUnits(order);
+        setAssetUnits(settlement_currency_, getAssetUnits(settlement_currency_) + value);
+    }
+    // Sell order
+    else
+    {
+        auto qty = getOrderQtyUnits(order);
+
+        if (order.getOrderType() == enums::OrderType::STOP)
         {
-            assets_[settlement_currency_] =
-                helper::addFloatsMaintainPrecesion(assets_[settlement_currency_], std::abs(order.getValue()));
+            stop_sell_orders_qty_sum_[symbol] -= qty;
         }
-        // Sell order
-        else
+        else if (order.getOrderType() == enums::OrderType::LIMIT)
         {
-            if (order.getOrderType() == enums::OrderType::STOP)
-            {
-                stop_sell_orders_qty_sum_[symbol] = helper::subtractFloatsMaintainPrecesion(
-                    stop_sell_orders_qty_sum_[symbol], std::abs(order.getQty()));
-            }
-            else if (order.getOrderType() == enums::OrderType::LIMIT)
-            {
-                limit_sell_orders_qty_sum_[symbol] = helper::subtractFloatsMaintainPrecesion(
-                    limit_sell_orders_qty_sum_[symbol], std::abs(order.getQty()));
-            }
+            limit_sell_orders_qty_sum_[symbol] -= qty;
         }
     }
-    catch (...)
-    {
-        // Restore original state in case of any exception
-        stop_sell_orders_qty_sum_[symbol]  = original_stop_sum;
-        limit_sell_orders_qty_sum_[symbol] = original_limit_sum;
-        assets_[settlement_currency_]      = original_settlement_balance;
-
-        // Re-throw the exception
-        throw;
-    }
 }
 
 void ct::exchange::SpotExchange::onUpdateFromStream(const nlohmann::json& data)
@@ -370,11 +351,12 @@ void ct::exchange::SpotExchange::onUpdateFromStream(const nlohmann::json& data)
         throw std::runtime_error("This method is only for live trading");
     }
 
-    assets_[settlement_currency_] = data["balance"].get< double >();
+    auto balance = data["balance"].get< double >();
+    setAssetUnits(settlement_currency_, getAssetScale(settlement_currency_).toUnits(balance));
 
     if (started_balance_ == 0)
     {
-        started_balance_ = data["balance"].get< double >();
+        started_balance_ = balance;
     }
 }
 
@@ -421,6 +403,93 @@ void ct::exchange::SpotExchange::fetchPrecisions()
     throw std::runtime_error("Not implemented!");
 }
 
+void ct::exchange::SpotExchange::setAsset(const std::string& asset, double balance)
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+    setAssetUnits(asset, getAssetScale(asset).toUnits(balance));
+}
+
+const ct::helper::FixedScale& ct::exchange::SpotExchange::getAssetScale(const std::string& asset)
+{
+    auto it = asset_scales_.find(asset);
+    if (it != asset_scales_.end())
+    {
+        return it->second;
+    }
+
+    int decimals = helper::FixedScale::DEFAULT_DECIMALS;
+    if (vars_.contains("precisions"))
+    {
+        for (const auto& [symbol, precision] : vars_["precisions"].items())
+        {
+            if (precision.contains("qty_precision") && helper::getBaseAsset(symbol) == asset)
+            {
+                decimals = std::max(decimals, precision["qty_precision"].get< int >());
+            }
+        }
+    }
+
+    return asset_scales_.emplace(asset, helper::FixedScale(decimals)).first->second;
+}
+
+const ct::helper::FixedScale& ct::exchange::SpotExchange::getPriceScale(const std::string& symbol)
+{
+    auto it = price_scales_.find(symbol);
+    if (it != price_scales_.end())
+    {
+        return it->second;
+    }
+
+    int decimals = helper::FixedScale::DEFAULT_DECIMALS;
+    if (vars_.contains("precisions") && vars_["precisions"].contains(symbol) &&
+        vars_["precisions"][symbol].contains("price_precision"))
+    {
+        decimals = std::max(decimals, vars_["precisions"][symbol]["price_precision"].get< int >());
+    }
+
+    return price_scales_.emplace(symbol, helper::FixedScale(decimals)).first->second;
+}
+
+int64_t ct::exchange::SpotExchange::getAssetUnits(const std::string& asset)
+{
+    auto it = asset_units_.find(asset);
+    if (it != asset_units_.end())
+    {
+        return it->second;
+    }
+
+    // First use of a balance that was set through assets_, e.g. the starting balance
+    auto units = getAssetScale(asset).toUnits(getAsset(asset));
+    asset_units_.emplace(asset, units);
+    return units;
+}
+
+void ct::exchange::SpotExchange::setAssetUnits(const std::string& asset, int64_t units)
+{
+    asset_units_[asset] = units;
+    assets_[asset]      = getAssetScale(asset).toDouble(units);
+}
+
+int64_t ct::exchange::SpotExchange::getOrderQtyUnits(const db::Order& order)
+{
+    return getAssetScale(helper::getBaseAsset(order.getSymbol())).toUnits(std::abs(order.getRemainingQty()));
+}
+
+int64_t ct::exchange::SpotExchange::getOrderValueUnits(const db::Order& order)
+{
+    if (!order.getPrice())
+    {
+        return 0;
+    }
+
+    const auto& symbol     = order.getSymbol();
+    const auto& baseScale  = getAssetScale(helper::getBaseAsset(symbol));
+    const auto& priceScale = getPriceScale(symbol);
+
+    return getAssetScale(settlement_currency_)
+        .multiply(getOrderQtyUnits(order), baseScale, priceScale.toUnits(*order.getPrice()), priceScale);
+}
+
 ct::exchange::FuturesExchange::FuturesExchange(const enums::ExchangeName& name,
                                                double starting_balance,
                                                double fee_rate,
@@ -471,71 +540,8 @@ double ct::exchange::FuturesExchange::getAvailableMargin() const
         return available_margin_;
     }
 
-    // Start with the wallet balance
-    // In both live trading and backtesting/paper trading, we start with the balance
-    double margin = getAsset(settlement_currency_);
-
-    // Calculate the total spent amount considering leverage
-    // Here we need to calculate the total cost of all open positions and orders, considering leverage
-    double total_spent = 0.0;
-
-    // For now, a simplified implementation:
-    for (const auto& [asset, balance] : assets_)
-    {
-        if (asset == settlement_currency_)
-            continue;
-
-        // TODO: Position handling
-        // auto position = selectors.get_position(name_, asset + "-" + settlement_currency_);
-        auto position = std::make_optional< position::Position >(enums::ExchangeName::BINANCE_SPOT, "");
-
-        if (position && position->isOpen())
-        {
-            total_spent += position->getTotalCost();
-            total_spent -= position->getPnl();
-        }
-
-        // Summing up the cost of open orders (buy and sell), considering leverage
-
-        // Calculate the sum of buy orders (qty * price) for the asset
-        double sum_buy_orders = 0.0;
-        if (buy_orders_.find(asset) != buy_orders_.end() && buy_orders_.at(asset)->size() > 0)
-        {
-            const auto& mt = buy_orders_.at(asset);
-
-            // Get a view of the entire data for the calculation
-            const auto& data = mt->rows(0, mt->size());
-
-            // Calculate the element-wise product of column 0 (qty) and column 1 (price)
-            auto products = blaze::column(data, 0) * blaze::column(data, 1);
-
-            // Sum all the products
-            sum_buy_orders = blaze::sum(products);
-        }
-
-        // Calculate the sum of sell orders (qty * price) for the asset
-        double sum_sell_orders = 0.0;
-        if (sell_orders_.find(asset) != sell_orders_.end() && sell_orders_.at(asset)->size() > 0)
-        {
-            const auto& tm = sell_orders_.at(asset);
-            // Get a view of the entire data for the calculation
-            const auto& data = tm->rows(0, tm->size());
-
-            // Calculate the element-wise product of column 0 (qty) and column 1 (price)
-            auto products = blaze::column(data, 0) * blaze::column(data, 1);
-
-            // Sum all the products
-            sum_sell_orders = blaze::sum(products);
-        }
-
-        total_spent +=
-            std::max(std::abs(sum_buy_orders) / futures_leverage_, std::abs(sum_sell_orders) / futures_leverage_);
-    }
-
-    // Subtract the total spent from the margin
-    margin -= total_spent;
-
-    return margin;
+    // Open orders are accounted for incrementally on every order event, positions are read as they are now
+    return getAsset(settlement_currency_) - used_margin_ - computePositionsMargin();
 }
 
 void ct::exchange::FuturesExchange::addRealizedPnl(double realized_pnl)
@@ -595,23 +601,25 @@ void ct::exchange::FuturesExchange::onOrderSubmission(const ct::db::Order& order
         return;
     }
 
-    // Store the original state for rollback in case of exceptions
     std::string symbol     = order.getSymbol();
     std::string base_asset = helper::getBaseAsset(symbol);
 
+    double value = std::abs(order.getQty() * order.getPrice().value_or(0.0));
+
     // Check margin availability if not a reduce-only order
     // make sure we don't spend more than we're allowed considering current allowed leverage
     if (!order.isReduceOnly())
     {
         // Calculate effective order size considering leverage
-        double effective_order_size = std::abs(order.getQty() * order.getPrice().value_or(0.0)) / futures_leverage_;
+        double effective_order_size = value / futures_leverage_;
+        double available_margin     = getAsset(settlement_currency_) - used_margin_ - computePositionsMargin();
 
-        if (effective_order_size > getAvailableMargin())
+        if (effective_order_size > available_margin)
         {
             throw exception::InsufficientMargin(
                 "Cannot submit an order with a value of $" +
                 std::to_string(std::round(order.getQty() * order.getPrice().value_or(0.0) * 100) / 100) +
-                " when your available margin is $" + std::to_string(std::round(getAvailableMargin() * 100) / 100) +
+                " when your available margin is $" + std::to_string(std::round(available_margin * 100) / 100) +
                 ". Consider increasing leverage number from the settings or reducing the order size.");
         }
     }
@@ -622,16 +630,33 @@ void ct::exchange::FuturesExchange::onOrderSubmission(const ct::db::Order& order
     // Track the order for margin calculations
     if (!order.isReduceOnly())
     {
-        blaze::StaticVector< double, 2UL, blaze::rowVector > row = {order.getQty(), order.getPrice().value_or(.0)};
+        auto& margin = margins_[base_asset];
 
         if (order.getOrderSide() == enums::OrderSide::BUY)
         {
-            buy_orders_.at(base_asset)->append(row);
+            margin.buy_orders_value_ += value;
+            ++margin.buy_orders_count_;
         }
         else
         {
-            sell_orders_.at(base_asset)->append(row);
+            margin.sell_orders_value_ += value;
+            ++margin.sell_orders_count_;
         }
+
+        refreshUsedMargin(margin);
+
+        // Ledger of every open order, the running sums are checked against it
+        auto& ledger =
+            order.getOrderSide() == enums::OrderSide::BUY ? buy_orders_[base_asset] : sell_orders_[base_asset];
+        if (!ledger)
+        {
+            ledger = std::make_shared< datastructure::DynamicBlazeArray< double > >(std::array< size_t, 2 >{10, 2});
+        }
+        ledger->append(blaze::DynamicVector< double, blaze::rowVector >{order.getQty(), order.getPrice().value_or(.0)});
+
+#ifndef NDEBUG
+        verifyMargin();
+#endif
     }
 }
 
@@ -644,23 +669,17 @@ void ct::exchange::FuturesExchange::onOrderExecution(const ct::db::Order& order)
         return;
     }
 
-    // Store original state for exception handling
     std::string symbol     = order.getSymbol();
     std::string base_asset = helper::getBaseAsset(symbol);
 
-
+    // The position itself is updated by the order execution and read from PositionsState
     if (!order.isReduceOnly())
     {
-        blaze::StaticVector< double, 2, blaze::rowVector > row = {order.getQty(), order.getPrice().value_or(.0)};
-
-        auto& tm =
-            (order.getOrderSide() == enums::OrderSide::BUY) ? buy_orders_.at(base_asset) : sell_orders_.at(base_asset);
+        removeOpenOrder(margins_[base_asset], base_asset, order);
 
-        auto index = tm->find(row, 1);
-        if (index >= 0)
-        {
-            tm->deleteRow(index);
-        }
+#ifndef NDEBUG
+        verifyMargin();
+#endif
     }
 }
 
@@ -673,26 +692,73 @@ void ct::exchange::FuturesExchange::onOrderCancellation(const ct::db::Order& ord
         return;
     }
 
-    // Store original state for exception handling
     std::string symbol     = order.getSymbol();
     std::string base_asset = helper::getBaseAsset(symbol);
 
     // Update available assets
-    available_assets_[base_asset] -= order.getQty();
+    available_assets_[base_asset] -= order.getRemainingQty();
 
     if (!order.isReduceOnly())
     {
-        blaze::StaticVector< double, 2, blaze::rowVector > row = {order.getQty(), order.getPrice().value_or(.0)};
+        removeOpenOrder(margins_[base_asset], base_asset, order);
+
+#ifndef NDEBUG
+        verifyMargin();
+#endif
+    }
+}
+
+void ct::exchange::FuturesExchange::onOrderFill(const ct::db::Order& order, double qty, [[maybe_unused]] double price)
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    if (helper::isLiveTrading() || order.isReduceOnly())
+    {
+        return;
+    }
+
+    std::string base_asset = helper::getBaseAsset(order.getSymbol());
+    auto& margin           = margins_[base_asset];
+
+    // The position itself is updated by the order fill, the open order only shrinks
+    double remaining = order.getRemainingQty();
+    if (std::abs(qty) >= std::abs(remaining))
+    {
+        removeOpenOrder(margin, base_asset, order);
+    }
+    else
+    {
+        double orderPrice = order.getPrice().value_or(.0);
+        double value      = std::abs(qty * orderPrice);
+        if (order.getOrderSide() == enums::OrderSide::BUY)
+        {
+            margin.buy_orders_value_ -= value;
+        }
+        else
+        {
+            margin.sell_orders_value_ -= value;
+        }
+
+        refreshUsedMargin(margin);
 
-        auto& tm =
-            (order.getOrderSide() == enums::OrderSide::BUY) ? buy_orders_.at(base_asset) : sell_orders_.at(base_asset);
+        // Computed like Order::getRemainingQty will be after the fill, so the next lookup matches exactly
+        double left = helper::prepareQty(std::abs(order.getQty()) - std::abs(order.getFilledQty() + qty),
+                                         enums::toString(order.getOrderSide()));
 
-        auto index = tm->find(row, 1);
+        auto& ledger =
+            order.getOrderSide() == enums::OrderSide::BUY ? buy_orders_[base_asset] : sell_orders_[base_asset];
+        auto index =
+            ledger ? ledger->find(blaze::DynamicVector< double, blaze::rowVector >{remaining, orderPrice}, 0) : -1;
         if (index >= 0)
         {
-            tm->deleteRow(index);
+            ledger->deleteRow(index);
+            ledger->append(blaze::DynamicVector< double, blaze::rowVector >{left, orderPrice});
         }
     }
+
+#ifndef NDEBUG
+    verifyMargin();
+#endif
 }
 
 // Used for updating the exchange from the WS stream (only for live trading)
@@ -766,6 +832,121 @@ void ct::exchange::FuturesExchange::fetchPrecisions()
     throw std::runtime_error("Not implemented!");
 }
 
+void ct::exchange::FuturesExchange::checkMarginConsistency() const
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+    verifyMargin();
+}
+
+double ct::exchange::FuturesExchange::computeUsedMargin(const AssetMargin& margin) const
+{
+    return std::max(margin.buy_orders_value_, margin.sell_orders_value_) / futures_leverage_;
+}
+
+double ct::exchange::FuturesExchange::computePositionsMargin() const
+{
+    // Running totals of the open positions of this exchange, kept up to date by the positions themselves
+    const auto& totals = position::PositionsState::getInstance().getPortfolioMetrics(name_);
+
+    // Cost of the positions minus their unrealized PNL
+    return totals.total_entry_value_ / futures_leverage_ - totals.total_pnl_;
+}
+
+void ct::exchange::FuturesExchange::refreshUsedMargin(AssetMargin& margin)
+{
+    double used = computeUsedMargin(margin);
+    used_margin_ += used - margin.used_;
+    margin.used_ = used;
+}
+
+void ct::exchange::FuturesExchange::removeOpenOrder(AssetMargin& margin,
+                                                    const std::string& base_asset,
+                                                    const db::Order& order)
+{
+    double qty   = order.getRemainingQty();
+    double value = std::abs(qty * order.getPrice().value_or(0.0));
+
+    // Sums are reset exactly once the last order of a side is gone, so rounding errors cannot pile up
+    if (order.getOrderSide() == enums::OrderSide::BUY)
+    {
+        if (margin.buy_orders_count_ > 0 && --margin.buy_orders_count_ > 0)
+        {
+            margin.buy_orders_value_ -= value;
+        }
+        else
+        {
+            margin.buy_orders_value_ = 0.0;
+        }
+    }
+    else
+    {
+        if (margin.sell_orders_count_ > 0 && --margin.sell_orders_count_ > 0)
+        {
+            margin.sell_orders_value_ -= value;
+        }
+        else
+        {
+            margin.sell_orders_value_ = 0.0;
+        }
+    }
+
+    refreshUsedMargin(margin);
+
+    auto& ledger = order.getOrderSide() == enums::OrderSide::BUY ? buy_orders_[base_asset] : sell_orders_[base_asset];
+    if (ledger && ledger->size() > 0)
+    {
+        auto index =
+            ledger->find(blaze::DynamicVector< double, blaze::rowVector >{qty, order.getPrice().value_or(.0)}, 0);
+        if (index >= 0)
+        {
+            ledger->deleteRow(index);
+        }
+    }
+}
+
+void ct::exchange::FuturesExchange::verifyMargin() const
+{
+    auto isClose = [](double a, double b)
+    { return std::abs(a - b) <= 1e-9 * std::max({1.0, std::abs(a), std::abs(b)}); };
+
+    // Full recomputation from the ledger of open orders
+    auto sumOrders = [](const auto& ledgers, const std::string& asset)
+    {
+        auto it = ledgers.find(asset);
+        if (it == ledgers.end() || !it->second || it->second->size() == 0)
+        {
+            return 0.0;
+        }
+
+        const auto& data = it->second->rows(0, it->second->size());
+        return std::abs(blaze::sum(blaze::column(data, 0) * blaze::column(data, 1)));
+    };
+
+    double total = 0.0;
+    for (const auto& [asset, margin] : margins_)
+    {
+        double buyValue  = sumOrders(buy_orders_, asset);
+        double sellValue = sumOrders(sell_orders_, asset);
+
+        if (!isClose(margin.buy_orders_value_, buyValue) || !isClose(margin.sell_orders_value_, sellValue))
+        {
+            throw std::logic_error("Open order value of " + asset + " on " + enums::toString(name_) +
+                                   " does not match its open orders");
+        }
+
+        if (!isClose(margin.used_, std::max(buyValue, sellValue) / futures_leverage_))
+        {
+            throw std::logic_error("Stale margin contribution for " + asset + " on " + enums::toString(name_));
+        }
+        total += margin.used_;
+    }
+
+    if (!isClose(total, used_margin_))
+    {
+        throw std::logic_error("Used margin on " + enums::toString(name_) + " does not match its assets");
+    }
+}
+
 
 ct::exchange::ExchangesState& ct::exchange::ExchangesState::getInstance()
 {
@@ -830,6 +1011,12 @@ void ct::exchange::ExchangesState::reset()
     storage_.clear();
 }
 
+void ct::exchange::ExchangesState::addExchange(const std::shared_ptr< Exchange >& exchange)
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+    storage_[exchange->getName()] = exchange;
+}
+
 std::shared_ptr< ct::exchange::Exchange > ct::exchange::ExchangesState::getExchange(
     const enums::ExchangeName& exchange_name) const
 {
@@ -903,121 +1090,266 @@ void ct::exchange::Sandbox::onOrderCancellation([[maybe_unused]] const db::Order
     // Implementation for sandbox
 }
 
+void ct::exchange::Sandbox::onOrderFill([[maybe_unused]] const db::Order& order,
+                                       [[maybe_unused]] double qty,
+                                       [[maybe_unused]] double price)
+{
+    // Implementation for sandbox
+}
+
 std::shared_ptr< ct::db::Order > ct::exchange::Sandbox::marketOrder(
     const std::string& symbol, double qty, double current_price, const enums::OrderSide& side, bool reduce_only)
+{
+    auto order = createOrder(OrderSpec{symbol, enums::OrderType::MARKET, side, qty, current_price, reduce_only});
+    placeOrder(order);
+    return order;
+}
+
+std::shared_ptr< ct::db::Order > ct::exchange::Sandbox::limitOrder(
+    const std::string& symbol, double qty, double price, const enums::OrderSide& side, bool reduce_only)
+{
+    auto order = createOrder(OrderSpec{symbol, enums::OrderType::LIMIT, side, qty, price, reduce_only});
+    placeOrder(order);
+    return order;
+}
+
+std::shared_ptr< ct::db::Order > ct::exchange::Sandbox::stopOrder(
+    const std::string& symbol, double qty, double price, const enums::OrderSide& side, bool reduce_only)
+{
+    auto order = createOrder(OrderSpec{symbol, enums::OrderType::STOP, side, qty, price, reduce_only});
+    placeOrder(order);
+    return order;
+}
+
+std::vector< std::shared_ptr< ct::db::Order > > ct::exchange::Sandbox::submitOrders(
+    const std::vector< OrderSpec >& specs)
+{
+    for (const auto& spec : specs)
+    {
+        bool knownType = spec.order_type_ == enums::OrderType::MARKET || spec.order_type_ == enums::OrderType::LIMIT ||
+                         spec.order_type_ == enums::OrderType::STOP;
+
+        if (!knownType || !std::isfinite(spec.qty_) || spec.qty_ == 0 || !std::isfinite(spec.price_) ||
+            spec.price_ <= 0)
+        {
+            logger::LOG.error("Rejected a batch of " + std::to_string(specs.size()) + " orders because of an invalid " +
+                              enums::toString(spec.order_type_) + " order for " + spec.symbol_);
+            throw exception::ExchangeRejectedOrder();
+        }
+    }
+
+    // Build everything first so a failure cannot leave part of the batch in the state
+    std::vector< std::shared_ptr< db::Order > > orders;
+    orders.reserve(specs.size());
+    for (const auto& spec : specs)
+    {
+        orders.push_back(createOrder(spec));
+    }
+
+    // Reserve the whole batch before placing any of it, a rejection releases what was already reserved
+    for (size_t i = 0; i < orders.size(); ++i)
+    {
+        try
+        {
+            orders[i]->submitToExchange();
+        }
+        catch (const std::exception&)
+        {
+            for (size_t j = 0; j < i; ++j)
+            {
+                orders[j]->cancel(true);
+            }
+            throw;
+        }
+    }
+
+    for (const auto& order : orders)
+    {
+        placeOrder(order);
+    }
+
+    return orders;
+}
+
+void ct::exchange::Sandbox::cancelOrders(const std::string& symbol, const std::vector< std::string >& order_ids)
+{
+    auto& ordersState = order::OrdersState::getInstance();
+
+    std::vector< std::shared_ptr< db::Order > > orders;
+    orders.reserve(order_ids.size());
+    for (const auto& orderId : order_ids)
+    {
+        auto order = ordersState.findOrderById(name_, symbol, orderId);
+        if (!order)
+        {
+            logger::LOG.error("Order " + orderId + " of " + symbol + " not found, none of the batch was canceled");
+            throw exception::ExchangeOrderNotFound();
+        }
+        orders.push_back(order);
+    }
+
+    for (const auto& order : orders)
+    {
+        cancelPlacedOrder(order);
+    }
+}
+
+std::shared_ptr< ct::db::Order > ct::exchange::Sandbox::createOrder(const OrderSpec& spec) const
 {
     auto tradeId    = boost::uuids::nil_uuid();
     auto sessionId  = boost::uuids::nil_uuid();
     auto exchangeId = std::nullopt;
-    auto orderType  = enums::OrderType::MARKET;
     auto filledQty  = .0;
     auto status     = enums::OrderStatus::QUEUED; // TODO: Proper value?
     auto createdAt  = helper::nowToTimestamp();
     nlohmann::json vars;
     auto submittedVia = std::nullopt;
 
-    auto order = std::make_shared< db::Order >(tradeId,
-                                               sessionId,
-                                               exchangeId,
-                                               symbol,
-                                               name_,
-                                               side,
-                                               orderType,
-                                               reduce_only,
-                                               helper::prepareQty(qty, enums::toString(side)),
-                                               filledQty,
-                                               current_price,
-                                               status,
-                                               createdAt,
-                                               std::nullopt,
-                                               std::nullopt,
-                                               vars,
-                                               submittedVia);
+    return std::make_shared< db::Order >(tradeId,
+                                          sessionId,
+                                          exchangeId,
+                                          spec.symbol_,
+                                          name_,
+                                          spec.order_side_,
+                                          spec.order_type_,
+                                          spec.reduce_only_,
+                                          helper::prepareQty(spec.qty_, enums::toString(spec.order_side_)),
+                                          filledQty,
+                                          spec.price_,
+                                          status,
+                                          createdAt,
+                                          std::nullopt,
+                                          std::nullopt,
+                                          vars,
+                                          submittedVia);
+}
+
+void ct::exchange::Sandbox::placeOrder(const std::shared_ptr< db::Order >& order)
+{
+    // A rejected order never reaches the state
+    order->submitToExchange();
 
     // Add to orders state
     order::OrdersState::getInstance().addOrder(order);
 
+    if (engine_)
+    {
+        auto engineId = engine_->submit(order->getSymbol(),
+                                        order->getOrderSide(),
+                                        order->getOrderType(),
+                                        std::abs(order->getQty()),
+                                        order->getPrice().value_or(0.0));
+
+        engine_orders_[engineId]  = order;
+        engine_ids_[order.get()] = engineId;
+        return;
+    }
+
     // Add to execution queue
-    order::OrdersState::getInstance().addOrderToExecute(order);
+    if (order->getOrderType() == enums::OrderType::MARKET)
+    {
+        order::OrdersState::getInstance().addOrderToExecute(order);
+    }
+}
 
-    return order;
+void ct::exchange::Sandbox::cancelPlacedOrder(const std::shared_ptr< db::Order >& order)
+{
+    order->cancel();
+
+    auto it = engine_ids_.find(order.get());
+    if (it == engine_ids_.end())
+    {
+        return;
+    }
+
+    // Reports still in flight for the order are dropped once it is unmapped
+    engine_->cancel(order->getSymbol(), it->second);
+    engine_orders_.erase(it->second);
+    engine_ids_.erase(it);
 }
 
-std::shared_ptr< ct::db::Order > ct::exchange::Sandbox::limitOrder(
-    const std::string& symbol, double qty, double price, const enums::OrderSide& side, bool reduce_only)
+void ct::exchange::Sandbox::enableMatching(size_t workers)
 {
-    auto tradeId    = boost::uuids::nil_uuid();
-    auto sessionId  = boost::uuids::nil_uuid();
-    auto exchangeId = std::nullopt;
-    auto orderType  = enums::OrderType::STOP;
-    auto filledQty  = .0;
-    auto status     = enums::OrderStatus::QUEUED; // TODO: Proper value?
-    auto createdAt  = helper::nowToTimestamp();
-    nlohmann::json vars;
-    auto submittedVia = std::nullopt;
+    if (engine_)
+    {
+        return;
+    }
 
-    auto order = std::make_shared< db::Order >(tradeId,
-                                               sessionId,
-                                               exchangeId,
-                                               symbol,
-                                               name_,
-                                               side,
-                                               orderType,
-                                               reduce_only,
-                                               helper::prepareQty(qty, enums::toString(side)),
-                                               filledQty,
-                                               price,
-                                               status,
-                                               createdAt,
-                                               std::nullopt,
-                                               std::nullopt,
-                                               vars,
-                                               submittedVia);
-    // Add to orders state
-    order::OrdersState::getInstance().addOrder(order);
+    auto engine = std::make_unique< matching::MatchingEngine >(workers);
+    engine->setReportHandler(
+        [this](const std::string& symbol, const matching::ExecutionReport& report)
+        {
+            std::lock_guard< std::mutex > lock(reports_mutex_);
+            reports_.emplace_back(symbol, report);
+        });
+    engine->start();
 
-    return order;
+    engine_ = std::move(engine);
 }
 
-std::shared_ptr< ct::db::Order > ct::exchange::Sandbox::stopOrder(
-    const std::string& symbol, double qty, double price, const enums::OrderSide& side, bool reduce_only)
+void ct::exchange::Sandbox::onPublicTrade(const std::string& symbol, double price, double qty)
 {
-    auto tradeId    = boost::uuids::nil_uuid();
-    auto sessionId  = boost::uuids::nil_uuid();
-    auto exchangeId = std::nullopt;
-    auto orderType  = enums::OrderType::LIMIT;
-    auto filledQty  = .0;
-    auto status     = enums::OrderStatus::QUEUED; // TODO: Proper value?
-    auto createdAt  = helper::nowToTimestamp();
-    nlohmann::json vars;
-    auto submittedVia = std::nullopt;
+    if (!engine_)
+    {
+        throw std::logic_error("Matching is not enabled for " + enums::toString(name_));
+    }
 
-    auto order = std::make_shared< db::Order >(tradeId,
-                                               sessionId,
-                                               exchangeId,
-                                               symbol,
-                                               name_,
-                                               side,
-                                               orderType,
-                                               reduce_only,
-                                               helper::prepareQty(qty, enums::toString(side)),
-                                               filledQty,
-                                               price,
-                                               status,
-                                               createdAt,
-                                               std::nullopt,
-                                               std::nullopt,
-                                               vars,
-                                               submittedVia);
-    // Add to orders state
-    order::OrdersState::getInstance().addOrder(order);
+    engine_->onPublicTrade(symbol, price, qty);
+}
 
-    return order;
+size_t ct::exchange::Sandbox::applyExecutionReports()
+{
+    if (!engine_)
+    {
+        return 0;
+    }
+
+    engine_->drain();
+
+    std::vector< std::pair< std::string, matching::ExecutionReport > > reports;
+    {
+        std::lock_guard< std::mutex > lock(reports_mutex_);
+        reports.swap(reports_);
+    }
+
+    size_t applied = 0;
+    for (const auto& [symbol, report] : reports)
+    {
+        auto it = engine_orders_.find(report.order_id_);
+        if (it == engine_orders_.end())
+        {
+            continue;
+        }
+
+        auto order = it->second;
+        bool done  = report.type_ == matching::ReportType::CANCEL || report.remaining_qty_ <= 0;
+
+        if (report.type_ == matching::ReportType::CANCEL)
+        {
+            // Market orders cancel whatever the book could not fill, earlier fills stay applied
+            order->cancel();
+        }
+        else
+        {
+            // The last fill takes exactly what is left, so rounding cannot leave the order open
+            double qty = done ? std::abs(order->getRemainingQty()) : report.qty_;
+            order->fill(qty, report.price_);
+        }
+
+        if (done)
+        {
+            engine_ids_.erase(order.get());
+            engine_orders_.erase(it);
+        }
+        ++applied;
+    }
+
+    return applied;
 }
 
 void ct::exchange::Sandbox::cancelAllOrders(const std::string& symbol)
 {
-    // Get active orders for this symbol
+    // Copy the active orders for this symbol, canceling one removes it from the state's list
     auto orders = order::OrdersState::getInstance().getActiveOrders(name_, symbol);
 
     // Cancel each order
@@ -1025,7 +1357,7 @@ void ct::exchange::Sandbox::cancelAllOrders(const std::string& symbol)
     {
         if (order->isNew())
         {
-            order->cancel();
+            cancelPlacedOrder(order);
         }
     }
 
@@ -1039,10 +1371,10 @@ void ct::exchange::Sandbox::cancelAllOrders(const std::string& symbol)
 void ct::exchange::Sandbox::cancelOrder(const std::string& symbol, const std::string& order_id)
 {
     // Get the order and cancel it
-    auto order = order::OrdersState::getInstance().getOrderById(name_, symbol, order_id);
+    auto order = order::OrdersState::getInstance().findOrderById(name_, symbol, order_id);
     if (order)
     {
-        order->cancel();
+        cancelPlacedOrder(order);
     }
 }
 
@@ -0,0 +1,119 @@
+#include "FillSimulator.hpp"
+#include "Helper.hpp"
+
+namespace ct
+{
+namespace simulator
+{
+
+size_t FillSimulator::simulate(const enums::ExchangeName& exchange_name,
+                               const std::string& symbol,
+                               const Candle& candle)
+{
+    auto& ordersState = order::OrdersState::getInstance();
+
+    Candle remaining = candle;
+    size_t executed  = 0;
+
+    while (true)
+    {
+        // Looked up again after every fill, the callback may have added or canceled orders
+        const auto& book = ordersState.getPendingOrders(exchange_name, symbol);
+        if (book.empty())
+        {
+            break;
+        }
+
+        triggered_.clear();
+        book.collectFalling(remaining[candle::_LOW_], remaining[candle::_HIGH_], triggered_);
+        book.collectRising(remaining[candle::_LOW_], remaining[candle::_HIGH_], triggered_);
+        if (triggered_.empty())
+        {
+            break;
+        }
+
+        // Both sides are already sorted along their direction, a stable minimum keeps time priority on ties
+        auto first = std::min_element(triggered_.begin(),
+                                      triggered_.end(),
+                                      [&remaining](const auto& a, const auto& b)
+                                      {
+                                          return getPathDistance(remaining, *a->getPrice()) <
+                                                 getPathDistance(remaining, *b->getPrice());
+                                      });
+
+        auto order            = *first;
+        auto price            = *order->getPrice();
+        auto [earlier, later] = candle::splitCandle(remaining, price);
+
+        execute(getPosition(exchange_name, symbol), order, price);
+        ++executed;
+        ++fills_;
+
+        if (on_fill_)
+        {
+            on_fill_(order, earlier);
+        }
+
+        if (executed >= MAX_FILLS_PER_CANDLE)
+        {
+            throw std::runtime_error("Too many fills in a single candle of " + helper::makeKey(exchange_name, symbol));
+        }
+
+        remaining = std::move(later);
+    }
+
+    return executed;
+}
+
+double FillSimulator::getPathDistance(const Candle& candle, double price)
+{
+    const double o = candle[candle::_OPEN_];
+    const double h = candle[candle::_HIGH_];
+    const double l = candle[candle::_LOW_];
+
+    if (candle::isBullish(candle))
+    {
+        // open -> low -> high
+        return price <= o ? o - price : (o - l) + (price - l);
+    }
+
+    // open -> high -> low
+    return price >= o ? price - o : (h - o) + (h - price);
+}
+
+void FillSimulator::reset()
+{
+    positions_.clear();
+    fills_ = 0;
+}
+
+const std::shared_ptr< position::Position >& FillSimulator::getPosition(const enums::ExchangeName& exchange_name,
+                                                                       const std::string& symbol)
+{
+    auto key = helper::makeKey(exchange_name, symbol);
+
+    auto it = positions_.find(key);
+    if (it != positions_.end())
+    {
+        return it->second;
+    }
+
+    auto position = position::PositionsState::getInstance().getPosition(exchange_name, symbol);
+    return positions_.emplace(key, std::move(position)).first->second;
+}
+
+void FillSimulator::execute(const std::shared_ptr< position::Position >& position,
+                            const std::shared_ptr< db::Order >& order,
+                            double price)
+{
+    if (position)
+    {
+        position->setCurrentPrice(price);
+    }
+
+    // Applies the fill to the exchange and the position of the pair
+    order->execute(silent_);
+}
+
+} // namespace simulator
+} // namespace ct
@@ -0,0 +1,83 @@
+#include "FixedPoint.hpp"
+
+namespace ct
+{
+namespace helper
+{
+
+namespace
+{
+
+__extension__ typedef __int128 Int128;
+
+Int128 pow10(int exponent)
+{
+    Int128 result = 1;
+    while (exponent-- > 0)
+    {
+        result *= 10;
+    }
+    return result;
+}
+
+} // namespace
+
+FixedScale::FixedScale(int decimals) : decimals_(decimals), factor_(1)
+{
+    if (decimals < 0 || decimals > MAX_DECIMALS)
+    {
+        throw std::invalid_argument("Fixed-point decimals must be within [0, " + std::to_string(MAX_DECIMALS) +
+                                    "], got " + std::to_string(decimals));
+    }
+
+    factor_ = static_cast< int64_t >(pow10(decimals));
+}
+
+int64_t FixedScale::toUnits(double value) const
+{
+    // Doubles at or beyond 2^63 do not convert to int64_t
+    constexpr double limit = 9223372036854775808.0;
+
+    double scaled = std::round(value * static_cast< double >(factor_));
+    if (!(scaled > -limit && scaled < limit))
+    {
+        throw std::overflow_error("Value " + std::to_string(value) + " does not fit in a fixed-point amount with " +
+                                  std::to_string(decimals_) + " decimals");
+    }
+
+    return static_cast< int64_t >(scaled);
+}
+
+int64_t FixedScale::multiply(int64_t a, const FixedScale& a_scale, int64_t b, const FixedScale& b_scale) const
+{
+    // |a * b| < 2^126, the product fits before rescaling
+    Int128 product = static_cast< Int128 >(a) * b;
+    int shift      = a_scale.decimals_ + b_scale.decimals_ - decimals_;
+
+    if (shift > 0)
+    {
+        Int128 divisor = pow10(shift);
+        Int128 half    = divisor / 2;
+        product        = (product >= 0 ? product + half : product - half) / divisor;
+    }
+    else if (shift < 0)
+    {
+        Int128 multiplier = pow10(-shift);
+        if (product > std::numeric_limits< int64_t >::max() / multiplier ||
+            product < std::numeric_limits< int64_t >::min() / multiplier)
+        {
+            throw std::overflow_error("Fixed-point product does not fit in 64 bits");
+        }
+        product *= multiplier;
+    }
+
+    if (product > std::numeric_limits< int64_t >::max() || product < std::numeric_limits< int64_t >::min())
+    {
+        throw std::overflow_error("Fixed-point product does not fit in 64 bits");
+    }
+
+    return static_cast< int64_t >(product);
+}
+
+} // namespace helper
+} // namespace ct
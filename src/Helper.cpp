@@ -814,6 +814,32 @@ const boost::uuids::uuid ct::helper::generateUUID()
     return id;
 }
 
+const boost::uuids::uuid ct::helper::generateFastUUID()
+{
+    thread_local uint64_t state = (static_cast< uint64_t >(std::random_device{}()) << 32) ^ std::random_device{}() ^
+                                  static_cast< uint64_t >(std::chrono::steady_clock::now().time_since_epoch().count());
+
+    auto next = []()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z          = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+
+    uint64_t high = next();
+    uint64_t low  = next();
+
+    boost::uuids::uuid id;
+    std::memcpy(id.begin(), &high, sizeof(high));
+    std::memcpy(id.begin() + sizeof(high), &low, sizeof(low));
+
+    // Version 4, RFC 4122 variant
+    id.begin()[6] = static_cast< uint8_t >((id.begin()[6] & 0x0F) | 0x40);
+    id.begin()[8] = static_cast< uint8_t >((id.begin()[8] & 0x3F) | 0x80);
+    return id;
+}
+
 std::string ct::helper::generateShortUniqueId()
 {
     auto full_id = generateUUID();
@@ -0,0 +1,603 @@
+#include "MatchingEngine.hpp"
+#include "Logger.hpp"
+
+namespace ct
+{
+namespace matching
+{
+
+namespace
+{
+
+// Polls of an empty queue before a worker starts sleeping between polls
+constexpr int IDLE_SPINS = 1000;
+
+constexpr auto IDLE_SLEEP = std::chrono::microseconds(50);
+
+ExecutionReport makeFill(uint64_t order_id, uint64_t counter_order_id, double price, double qty, double remaining)
+{
+    ExecutionReport report;
+    report.type_             = ReportType::FILL;
+    report.order_id_         = order_id;
+    report.counter_order_id_ = counter_order_id;
+    report.price_            = price;
+    report.qty_              = qty;
+    report.remaining_qty_    = remaining;
+    return report;
+}
+
+ExecutionReport makeCancel(uint64_t order_id, double remaining)
+{
+    ExecutionReport report;
+    report.type_          = ReportType::CANCEL;
+    report.order_id_      = order_id;
+    report.remaining_qty_ = remaining;
+    return report;
+}
+
+} // namespace
+
+void MatchingBook::submit(const EngineOrder& order, std::vector< ExecutionReport >& reports)
+{
+    EngineOrder taker = order;
+
+    if (taker.type_ == enums::OrderType::STOP)
+    {
+        bool triggered = !std::isnan(last_price_) &&
+                         (taker.side_ == enums::OrderSide::BUY ? last_price_ >= taker.price_
+                                                               : last_price_ <= taker.price_);
+        if (!triggered)
+        {
+            if (taker.side_ == enums::OrderSide::BUY)
+            {
+                buy_stops_.emplace(taker.price_, taker);
+                locations_[taker.id_] = Location{Where::BUY_STOP, taker.price_};
+            }
+            else
+            {
+                sell_stops_.emplace(taker.price_, taker);
+                locations_[taker.id_] = Location{Where::SELL_STOP, taker.price_};
+            }
+            return;
+        }
+
+        taker.type_ = enums::OrderType::MARKET;
+    }
+
+    match(taker, reports);
+    triggerStops(reports);
+}
+
+bool MatchingBook::cancel(uint64_t order_id, std::vector< ExecutionReport >& reports)
+{
+    auto it = locations_.find(order_id);
+    if (it == locations_.end())
+    {
+        return false;
+    }
+
+    double remaining = 0.0;
+    switch (it->second.where_)
+    {
+        case Where::BID:
+            remaining = eraseResting(bids_, it->second.price_, order_id);
+            break;
+        case Where::ASK:
+            remaining = eraseResting(asks_, it->second.price_, order_id);
+            break;
+        case Where::BUY_STOP:
+            remaining = eraseStop(buy_stops_, it->second.price_, order_id);
+            break;
+        case Where::SELL_STOP:
+            remaining = eraseStop(sell_stops_, it->second.price_, order_id);
+            break;
+    }
+
+    locations_.erase(it);
+    reports.push_back(makeCancel(order_id, remaining));
+    return true;
+}
+
+void MatchingBook::onPublicTrade(double price, double qty, std::vector< ExecutionReport >& reports)
+{
+    fillAgainstPublic(bids_, price, qty, reports);
+    fillAgainstPublic(asks_, price, qty, reports);
+
+    last_price_ = price;
+
+    public_qty_ = qty;
+    triggerStops(reports);
+    public_qty_ = 0.0;
+}
+
+std::optional< double > MatchingBook::getBestBid() const
+{
+    if (bids_.empty())
+    {
+        return std::nullopt;
+    }
+    return bids_.begin()->first;
+}
+
+std::optional< double > MatchingBook::getBestAsk() const
+{
+    if (asks_.empty())
+    {
+        return std::nullopt;
+    }
+    return asks_.begin()->first;
+}
+
+std::optional< double > MatchingBook::getLastPrice() const
+{
+    if (std::isnan(last_price_))
+    {
+        return std::nullopt;
+    }
+    return last_price_;
+}
+
+void MatchingBook::match(EngineOrder& order, std::vector< ExecutionReport >& reports)
+{
+    if (order.side_ == enums::OrderSide::BUY)
+    {
+        take(asks_, order, reports);
+    }
+    else
+    {
+        take(bids_, order, reports);
+    }
+
+    // Stops triggered by a public trade may take what is left of it
+    if (order.qty_ > 0 && public_qty_ > 0 && order.type_ == enums::OrderType::MARKET)
+    {
+        double qty = std::min(order.qty_, public_qty_);
+        order.qty_ -= qty;
+        public_qty_ -= qty;
+        reports.push_back(makeFill(order.id_, 0, last_price_, qty, order.qty_));
+    }
+
+    if (order.qty_ <= 0)
+    {
+        return;
+    }
+
+    if (order.type_ == enums::OrderType::LIMIT)
+    {
+        if (order.side_ == enums::OrderSide::BUY)
+        {
+            rest(bids_, Where::BID, order);
+        }
+        else
+        {
+            rest(asks_, Where::ASK, order);
+        }
+    }
+    else
+    {
+        reports.push_back(makeCancel(order.id_, order.qty_));
+    }
+}
+
+void MatchingBook::triggerStops(std::vector< ExecutionReport >& reports)
+{
+    // Every triggered stop may move the price and trigger the next one
+    while (!std::isnan(last_price_))
+    {
+        EngineOrder order;
+
+        if (!buy_stops_.empty() && buy_stops_.begin()->first <= last_price_)
+        {
+            order = buy_stops_.begin()->second;
+            buy_stops_.erase(buy_stops_.begin());
+        }
+        else if (!sell_stops_.empty() && sell_stops_.begin()->first >= last_price_)
+        {
+            order = sell_stops_.begin()->second;
+            sell_stops_.erase(sell_stops_.begin());
+        }
+        else
+        {
+            break;
+        }
+
+        locations_.erase(order.id_);
+        order.type_ = enums::OrderType::MARKET;
+        match(order, reports);
+    }
+}
+
+template < typename Book >
+void MatchingBook::take(Book& book, EngineOrder& taker, std::vector< ExecutionReport >& reports)
+{
+    bool limited = taker.type_ == enums::OrderType::LIMIT;
+
+    while (taker.qty_ > 0 && !book.empty())
+    {
+        auto level = book.begin();
+
+        // The best level is worse than the limit, nothing else crosses either
+        if (limited && book.key_comp()(taker.price_, level->first))
+        {
+            break;
+        }
+
+        Level& queue = level->second;
+        while (taker.qty_ > 0 && !queue.empty())
+        {
+            Resting& maker = queue.front();
+
+            // The smaller side ends at exactly zero
+            double qty = std::min(taker.qty_, maker.qty_);
+            taker.qty_ -= qty;
+            maker.qty_ -= qty;
+
+            reports.push_back(makeFill(maker.id_, taker.id_, level->first, qty, maker.qty_));
+            reports.push_back(makeFill(taker.id_, maker.id_, level->first, qty, taker.qty_));
+            last_price_ = level->first;
+
+            if (maker.qty_ <= 0)
+            {
+                locations_.erase(maker.id_);
+                queue.pop_front();
+            }
+        }
+
+        if (queue.empty())
+        {
+            book.erase(level);
+        }
+    }
+}
+
+template < typename Book >
+void MatchingBook::fillAgainstPublic(Book& book, double price, double qty, std::vector< ExecutionReport >& reports)
+{
+    double budget = qty;
+
+    while (budget > 0 && !book.empty())
+    {
+        auto level = book.begin();
+
+        // Orders behind the printed price would not have traded
+        if (book.key_comp()(price, level->first))
+        {
+            break;
+        }
+
+        Level& queue = level->second;
+        while (budget > 0 && !queue.empty())
+        {
+            Resting& maker = queue.front();
+
+            double filled = std::min(budget, maker.qty_);
+            budget -= filled;
+            maker.qty_ -= filled;
+
+            reports.push_back(makeFill(maker.id_, 0, level->first, filled, maker.qty_));
+
+            if (maker.qty_ <= 0)
+            {
+                locations_.erase(maker.id_);
+                queue.pop_front();
+            }
+        }
+
+        if (queue.empty())
+        {
+            book.erase(level);
+        }
+    }
+}
+
+template < typename Book >
+void MatchingBook::rest(Book& book, Where where, const EngineOrder& order)
+{
+    book[order.price_].push_back(Resting{order.id_, order.qty_});
+    locations_[order.id_] = Location{where, order.price_};
+}
+
+template < typename Book >
+double MatchingBook::eraseResting(Book& book, double price, uint64_t order_id)
+{
+    auto level = book.find(price);
+    if (level == book.end())
+    {
+        return 0.0;
+    }
+
+    Level& queue = level->second;
+    auto it      = std::find_if(
+        queue.begin(), queue.end(), [order_id](const Resting& resting) { return resting.id_ == order_id; });
+    if (it == queue.end())
+    {
+        return 0.0;
+    }
+
+    double remaining = it->qty_;
+    queue.erase(it);
+    if (queue.empty())
+    {
+        book.erase(level);
+    }
+
+    return remaining;
+}
+
+template < typename Stops >
+double MatchingBook::eraseStop(Stops& stops, double price, uint64_t order_id)
+{
+    auto range = stops.equal_range(price);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second.id_ == order_id)
+        {
+            double remaining = it->second.qty_;
+            stops.erase(it);
+            return remaining;
+        }
+    }
+
+    return 0.0;
+}
+
+MatchingEngine::MatchingEngine(size_t workers, size_t queue_capacity)
+{
+    if (workers == 0)
+    {
+        throw std::invalid_argument("Matching engine needs at least one worker");
+    }
+
+    shards_.reserve(workers);
+    for (size_t i = 0; i < workers; ++i)
+    {
+        shards_.push_back(std::make_unique< Shard >(queue_capacity));
+    }
+}
+
+MatchingEngine::~MatchingEngine()
+{
+    stop();
+}
+
+void MatchingEngine::setReportHandler(ReportHandler handler)
+{
+    if (isRunning())
+    {
+        throw std::logic_error("The report handler cannot be replaced while the matching engine is running");
+    }
+
+    handler_ = std::move(handler);
+}
+
+void MatchingEngine::start()
+{
+    if (running_.exchange(true))
+    {
+        return;
+    }
+
+    for (auto& shard : shards_)
+    {
+        shard->thread_ = std::make_unique< std::thread >(&MatchingEngine::run, this, std::ref(*shard));
+    }
+}
+
+void MatchingEngine::stop()
+{
+    running_.store(false, std::memory_order_release);
+
+    for (auto& shard : shards_)
+    {
+        if (shard->thread_ && shard->thread_->joinable())
+        {
+            shard->thread_->join();
+        }
+        shard->thread_.reset();
+    }
+}
+
+uint64_t MatchingEngine::submit(const std::string& symbol,
+                                const enums::OrderSide& side,
+                                const enums::OrderType& type,
+                                double qty,
+                                double price)
+{
+    if (type != enums::OrderType::MARKET && type != enums::OrderType::LIMIT && type != enums::OrderType::STOP)
+    {
+        throw std::invalid_argument("Matching engine supports market, limit and stop orders only");
+    }
+    if (!(qty > 0) || !std::isfinite(qty))
+    {
+        throw std::invalid_argument("Order quantity must be positive, got " + std::to_string(qty));
+    }
+    if (type != enums::OrderType::MARKET && (!(price > 0) || !std::isfinite(price)))
+    {
+        throw std::invalid_argument("Order price must be positive, got " + std::to_string(price));
+    }
+
+    Command command;
+    command.type_         = CommandType::SUBMIT;
+    command.symbol_       = symbol;
+    command.order_.id_    = next_order_id_.fetch_add(1, std::memory_order_relaxed);
+    command.order_.side_  = side;
+    command.order_.type_  = type;
+    command.order_.qty_   = qty;
+    command.order_.price_ = type == enums::OrderType::MARKET ? 0.0 : price;
+
+    uint64_t id = command.order_.id_;
+    post(std::move(command));
+    return id;
+}
+
+void MatchingEngine::cancel(const std::string& symbol, uint64_t order_id)
+{
+    Command command;
+    command.type_      = CommandType::CANCEL;
+    command.symbol_    = symbol;
+    command.order_.id_ = order_id;
+
+    post(std::move(command));
+}
+
+void MatchingEngine::onPublicTrade(const std::string& symbol, double price, double qty)
+{
+    if (!(price > 0) || !(qty > 0))
+    {
+        throw std::invalid_argument("Public trades need a positive price and quantity");
+    }
+
+    Command command;
+    command.type_         = CommandType::PUBLIC_TRADE;
+    command.symbol_       = symbol;
+    command.order_.qty_   = qty;
+    command.order_.price_ = price;
+
+    post(std::move(command));
+}
+
+void MatchingEngine::drain() const
+{
+    for (const auto& shard : shards_)
+    {
+        while (shard->applied_.load(std::memory_order_acquire) < shard->posted_.load(std::memory_order_acquire))
+        {
+            if (!isRunning())
+            {
+                throw std::logic_error("Cannot drain a matching engine that is not running");
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+size_t MatchingEngine::getShardIndex(const std::string& symbol) const
+{
+    return std::hash< std::string >{}(symbol) % shards_.size();
+}
+
+uint64_t MatchingEngine::countCommands() const
+{
+    uint64_t count = 0;
+    for (const auto& shard : shards_)
+    {
+        count += shard->applied_.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t MatchingEngine::countFills() const
+{
+    uint64_t count = 0;
+    for (const auto& shard : shards_)
+    {
+        count += shard->fills_.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+const MatchingBook* MatchingEngine::getBook(const std::string& symbol) const
+{
+    const auto& books = shards_[getShardIndex(symbol)]->books_;
+
+    auto it = books.find(symbol);
+    if (it == books.end())
+    {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+void MatchingEngine::post(Command command)
+{
+    Shard& shard = *shards_[getShardIndex(command.symbol_)];
+
+    shard.posted_.fetch_add(1, std::memory_order_release);
+    while (!shard.queue_.tryPush(std::move(command)))
+    {
+        if (!isRunning())
+        {
+            shard.posted_.fetch_sub(1, std::memory_order_release);
+            throw std::runtime_error("Matching engine queue is full and the engine is not running");
+        }
+        std::this_thread::yield();
+    }
+}
+
+void MatchingEngine::run(Shard& shard)
+{
+    std::vector< ExecutionReport > reports;
+    Command command;
+    int idle = 0;
+
+    // Keeps popping after stop until the queue is drained
+    while (true)
+    {
+        if (!shard.queue_.tryPop(command))
+        {
+            if (!running_.load(std::memory_order_acquire))
+            {
+                break;
+            }
+
+            if (++idle < IDLE_SPINS)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(IDLE_SLEEP);
+            }
+            continue;
+        }
+
+        idle = 0;
+        reports.clear();
+        apply(shard, command, reports);
+
+        uint64_t fills = 0;
+        for (const auto& report : reports)
+        {
+            if (report.type_ == ReportType::FILL)
+            {
+                ++fills;
+            }
+
+            if (handler_)
+            {
+                try
+                {
+                    handler_(command.symbol_, report);
+                }
+                catch (const std::exception& e)
+                {
+                    logger::LOG.error("Execution report handler failed for " + command.symbol_ + ": " + e.what());
+                }
+            }
+        }
+
+        shard.fills_.fetch_add(fills, std::memory_order_relaxed);
+        shard.applied_.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void MatchingEngine::apply(Shard& shard, const Command& command, std::vector< ExecutionReport >& reports)
+{
+    MatchingBook& book = shard.books_[command.symbol_];
+
+    switch (command.type_)
+    {
+        case CommandType::SUBMIT:
+            book.submit(command.order_, reports);
+            break;
+        case CommandType::CANCEL:
+            book.cancel(command.order_.id_, reports);
+            break;
+        case CommandType::PUBLIC_TRADE:
+            book.onPublicTrade(command.order_.price_, command.order_.qty_, reports);
+            break;
+    }
+}
+
+} // namespace matching
+} // namespace ct
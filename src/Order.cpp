@@ -27,28 +27,73 @@ ct::order::OrdersState::OrdersState()
     {
         for (const auto& symbol : tradingSymbols)
         {
-            std::string key      = helper::makeKey(enums::toExchangeName(exchangeName), symbol);
+            auto exchange        = enums::toExchangeName(exchangeName);
+            std::string key      = helper::makeKey(exchange, symbol);
             storage_[key]        = {};
             active_storage_[key] = {};
+            registerPair(exchange, symbol, key);
         }
     }
 }
 
+ct::order::OrdersState::~OrdersState()
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+    for (auto& [order, entry] : entries_)
+    {
+        entry.order_->setChangeListener(nullptr);
+    }
+}
+
 void ct::order::OrdersState::reset()
 {
+    std::lock_guard< std::mutex > lock(mutex_);
+
     // Used for testing
+    for (auto& [order, entry] : entries_)
+    {
+        entry.order_->setChangeListener(nullptr);
+    }
+
     for (auto& [key, orders] : storage_)
     {
         orders.clear();
         storage_[key].clear();
         active_storage_[key].clear();
     }
+
+    entries_.clear();
+    by_id_.clear();
+    by_exchange_id_.clear();
+    status_totals_.clear();
+
+    // Buckets are emptied rather than erased, registered pairs point to them
+    for (auto& [key, buckets] : by_status_)
+    {
+        buckets.clear();
+    }
+    for (auto& [key, book] : pending_)
+    {
+        book.clear();
+    }
 }
 
 void ct::order::OrdersState::resetTradeOrders(const enums::ExchangeName& exchange_name, const std::string& symbol)
 {
     // Used after each completed trade
     std::string key = helper::makeKey(exchange_name, symbol);
+
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    for (const auto& order : storage_[key])
+    {
+        unindexOrder(order.get());
+    }
+    for (const auto& order : active_storage_[key])
+    {
+        unindexOrder(order.get());
+    }
+
     storage_[key].clear();
     active_storage_[key].clear();
 }
@@ -56,8 +101,203 @@ void ct::order::OrdersState::resetTradeOrders(const enums::ExchangeName& exchang
 void ct::order::OrdersState::addOrder(const std::shared_ptr< db::Order > order)
 {
     std::string key = helper::makeKey(order->getExchangeName(), order->getSymbol());
+
+    std::lock_guard< std::mutex > lock(mutex_);
     storage_[key].push_back(order);
     active_storage_[key].push_back(order);
+    registerPair(order->getExchangeName(), order->getSymbol(), key);
+    indexOrder(order, key);
+}
+
+void ct::order::OrdersState::registerPair(const enums::ExchangeName& exchange_name,
+                                          const std::string& symbol,
+                                          const std::string& key)
+{
+    auto& pair = pairs_[exchange_name][symbol];
+    if (pair.orders_)
+    {
+        return;
+    }
+
+    // Map nodes are stable, so the pointers stay valid for the lifetime of the state
+    pair.orders_   = &storage_[key];
+    pair.active_   = &active_storage_[key];
+    pair.statuses_ = &by_status_[key];
+    pair.pending_  = &pending_[key];
+}
+
+const ct::order::OrdersState::PairStorage* ct::order::OrdersState::findPair(const enums::ExchangeName& exchange_name,
+                                                                            const std::string& symbol) const
+{
+    auto exchange = pairs_.find(exchange_name);
+    if (exchange == pairs_.end())
+    {
+        return nullptr;
+    }
+
+    auto pair = exchange->second.find(symbol);
+    return pair == exchange->second.end() ? nullptr : &pair->second;
+}
+
+void ct::order::OrdersState::indexOrder(const std::shared_ptr< db::Order >& order, const std::string& key)
+{
+    auto [it, inserted] = entries_.try_emplace(order.get());
+    if (!inserted)
+    {
+        return;
+    }
+
+    auto& entry        = it->second;
+    entry.order_       = order;
+    entry.key_         = key;
+    entry.id_          = order->getId();
+    entry.exchange_id_ = order->getExchangeId();
+    entry.status_      = order->getStatus();
+
+    by_id_[entry.id_] = order;
+    if (entry.exchange_id_)
+    {
+        by_exchange_id_.emplace(*entry.exchange_id_, order);
+    }
+    insertStatus(entry);
+    syncPending(entry);
+
+    order->setChangeListener(this);
+}
+
+void ct::order::OrdersState::unindexOrder(const db::Order* order)
+{
+    auto it = entries_.find(order);
+    if (it == entries_.end())
+    {
+        return;
+    }
+
+    const auto& entry = it->second;
+    entry.order_->setChangeListener(nullptr);
+
+    auto idIt = by_id_.find(entry.id_);
+    if (idIt != by_id_.end() && idIt->second.get() == order)
+    {
+        by_id_.erase(idIt);
+    }
+    eraseExchangeId(entry);
+    eraseStatus(entry);
+    if (entry.pending_price_)
+    {
+        pending_[entry.key_].remove(order, *entry.pending_price_);
+    }
+
+    entries_.erase(it);
+}
+
+void ct::order::OrdersState::onOrderChanged(const db::Order& order)
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    // The order may have been untracked after the notification started
+    auto it = entries_.find(&order);
+    if (it == entries_.end())
+    {
+        return;
+    }
+
+    auto& entry = it->second;
+
+    if (entry.id_ != order.getId())
+    {
+        auto idIt = by_id_.find(entry.id_);
+        if (idIt != by_id_.end() && idIt->second.get() == &order)
+        {
+            by_id_.erase(idIt);
+        }
+        entry.id_         = order.getId();
+        by_id_[entry.id_] = entry.order_;
+    }
+
+    if (entry.exchange_id_ != order.getExchangeId())
+    {
+        eraseExchangeId(entry);
+        entry.exchange_id_ = order.getExchangeId();
+        if (entry.exchange_id_)
+        {
+            by_exchange_id_.emplace(*entry.exchange_id_, entry.order_);
+        }
+    }
+
+    if (entry.status_ != order.getStatus())
+    {
+        eraseStatus(entry);
+        entry.status_ = order.getStatus();
+        insertStatus(entry);
+    }
+
+    syncPending(entry);
+}
+
+void ct::order::OrdersState::syncPending(IndexEntry& entry)
+{
+    std::optional< double > price;
+    if (PendingOrderBook::isPending(*entry.order_))
+    {
+        price = entry.order_->getPrice();
+    }
+
+    if (price == entry.pending_price_)
+    {
+        return;
+    }
+
+    auto& book = pending_[entry.key_];
+    if (entry.pending_price_)
+    {
+        book.remove(entry.order_.get(), *entry.pending_price_);
+    }
+    if (price)
+    {
+        book.add(entry.order_);
+    }
+    entry.pending_price_ = price;
+}
+
+void ct::order::OrdersState::insertStatus(IndexEntry& entry)
+{
+    auto& bucket       = by_status_[entry.key_][entry.status_];
+    entry.status_slot_ = bucket.size();
+    bucket.push_back(entry.order_);
+    ++status_totals_[entry.status_];
+}
+
+void ct::order::OrdersState::eraseStatus(const IndexEntry& entry)
+{
+    auto& bucket = by_status_[entry.key_][entry.status_];
+
+    // Swap with the last order of the bucket so removal stays O(1)
+    if (entry.status_slot_ + 1 != bucket.size())
+    {
+        bucket[entry.status_slot_]                                 = std::move(bucket.back());
+        entries_.at(bucket[entry.status_slot_].get()).status_slot_ = entry.status_slot_;
+    }
+    bucket.pop_back();
+    --status_totals_[entry.status_];
+}
+
+void ct::order::OrdersState::eraseExchangeId(const IndexEntry& entry)
+{
+    if (!entry.exchange_id_)
+    {
+        return;
+    }
+
+    auto [first, last] = by_exchange_id_.equal_range(*entry.exchange_id_);
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second == entry.order_)
+        {
+            by_exchange_id_.erase(it);
+            return;
+        }
+    }
 }
 
 void ct::order::OrdersState::addOrderToExecute(const std::shared_ptr< db::Order > order)
@@ -67,23 +307,33 @@ void ct::order::OrdersState::addOrderToExecute(const std::shared_ptr< db::Order
 
 void ct::order::OrdersState::removeOrder(const std::shared_ptr< db::Order > order)
 {
-    std::string key = helper::makeKey(order->getExchangeName(), order->getSymbol());
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    // Resolve the tracked instance, the caller may hold a copy with the same id
+    const db::Order* target = order.get();
+    if (entries_.find(target) == entries_.end())
+    {
+        auto it = by_id_.find(order->getId());
+        if (it == by_id_.end())
+        {
+            return;
+        }
+        target = it->second.get();
+    }
+
+    const std::string& key = entries_.at(target).key_;
+
+    auto isTarget = [target](const std::shared_ptr< db::Order >& o) { return o.get() == target; };
 
     // Remove from storage
     auto& storageOrders = storage_[key];
-    storageOrders.erase(
-        std::remove_if(storageOrders.begin(),
-                       storageOrders.end(),
-                       [&order](const std::shared_ptr< db::Order >& o) { return o->getId() == order->getId(); }),
-        storageOrders.end());
+    storageOrders.erase(std::remove_if(storageOrders.begin(), storageOrders.end(), isTarget), storageOrders.end());
 
     // Remove from active storage
     auto& activeOrders = active_storage_[key];
-    activeOrders.erase(
-        std::remove_if(activeOrders.begin(),
-                       activeOrders.end(),
-                       [&order](const std::shared_ptr< db::Order >& o) { return o->getId() == order->getId(); }),
-        activeOrders.end());
+    activeOrders.erase(std::remove_if(activeOrders.begin(), activeOrders.end(), isTarget), activeOrders.end());
+
+    unindexOrder(target);
 }
 
 void ct::order::OrdersState::executePendingMarketOrders()
@@ -101,28 +351,24 @@ void ct::order::OrdersState::executePendingMarketOrders()
     to_execute_.clear();
 }
 
-std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getOrders(
+namespace
+{
+// Returned for pairs without storage, so the getters can hand out references
+const std::vector< std::shared_ptr< ct::db::Order > > EMPTY_ORDERS;
+} // namespace
+
+const std::vector< std::shared_ptr< ct::db::Order > >& ct::order::OrdersState::getOrders(
     const enums::ExchangeName& exchange_name, const std::string& symbol) const
 {
-    std::string key = helper::makeKey(exchange_name, symbol);
-    auto it         = storage_.find(key);
-    if (it != storage_.end())
-    {
-        return it->second;
-    }
-    return {};
+    const auto* pair = findPair(exchange_name, symbol);
+    return pair ? *pair->orders_ : EMPTY_ORDERS;
 }
 
-std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getActiveOrders(
+const std::vector< std::shared_ptr< ct::db::Order > >& ct::order::OrdersState::getActiveOrders(
     const enums::ExchangeName& exchange_name, const std::string& symbol) const
 {
-    std::string key = helper::makeKey(exchange_name, symbol);
-    auto it         = active_storage_.find(key);
-    if (it != active_storage_.end())
-    {
-        return it->second;
-    }
-    return {};
+    const auto* pair = findPair(exchange_name, symbol);
+    return pair ? *pair->active_ : EMPTY_ORDERS;
 }
 
 std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getOrders(
@@ -130,6 +376,7 @@ std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getOrder
 {
     std::vector< std::shared_ptr< db::Order > > result;
 
+    std::lock_guard< std::mutex > lock(mutex_);
     for (const auto& [key, orders] : storage_)
     {
         for (const auto& order : orders)
@@ -146,90 +393,186 @@ std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getOrder
 
 int ct::order::OrdersState::countActiveOrders() const
 {
-    int count = 0;
+    std::lock_guard< std::mutex > lock(mutex_);
+    auto it = status_totals_.find(enums::OrderStatus::ACTIVE);
+    return it == status_totals_.end() ? 0 : it->second;
+}
+
+int ct::order::OrdersState::countActiveOrders(const enums::ExchangeName& exchange_name, const std::string& symbol) const
+{
+    return countOrdersByStatus(exchange_name, symbol, enums::OrderStatus::ACTIVE);
+}
+
+std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getOrdersByStatus(
+    const enums::ExchangeName& exchange_name, const std::string& symbol, const enums::OrderStatus& status) const
+{
+    std::lock_guard< std::mutex > lock(mutex_);
 
-    for (const auto& [key, orders] : active_storage_)
+    const auto* pair = findPair(exchange_name, symbol);
+    if (!pair)
     {
-        for (const auto& order : orders)
-        {
-            if (order->isActive())
-            {
-                count++;
-            }
-        }
+        return {};
+    }
+
+    auto bucket = pair->statuses_->find(status);
+    if (bucket == pair->statuses_->end())
+    {
+        return {};
     }
 
-    return count;
+    return bucket->second;
 }
 
-int ct::order::OrdersState::countActiveOrders(const enums::ExchangeName& exchange_name, const std::string& symbol) const
+const ct::order::PendingOrderBook& ct::order::OrdersState::getPendingOrders(const enums::ExchangeName& exchange_name,
+                                                                             const std::string& symbol) const
 {
-    auto orders = getActiveOrders(exchange_name, symbol);
+    static const PendingOrderBook empty;
 
-    return std::count_if(
-        orders.begin(), orders.end(), [](const std::shared_ptr< db::Order > o) { return o->isActive(); });
+    const auto* pair = findPair(exchange_name, symbol);
+    return pair ? *pair->pending_ : empty;
+}
+
+int ct::order::OrdersState::countOrdersByStatus(const enums::ExchangeName& exchange_name,
+                                                const std::string& symbol,
+                                                const enums::OrderStatus& status) const
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    const auto* pair = findPair(exchange_name, symbol);
+    if (!pair)
+    {
+        return 0;
+    }
+
+    auto bucket = pair->statuses_->find(status);
+    return bucket == pair->statuses_->end() ? 0 : bucket->second.size();
 }
 
 int ct::order::OrdersState::countOrders(const enums::ExchangeName& exchange_name, const std::string& symbol) const
 {
-    return getOrders(exchange_name, symbol).size();
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    const auto* pair = findPair(exchange_name, symbol);
+    return pair ? pair->orders_->size() : 0;
 }
 
-// TODO: Return null if not found?
 std::shared_ptr< ct::db::Order > ct::order::OrdersState::getOrderById(const enums::ExchangeName& exchange_name,
                                                                       const std::string& symbol,
                                                                       const std::string& id,
                                                                       bool use_exchange_id) const
 {
+    auto order = findOrderById(exchange_name, symbol, id, use_exchange_id);
+    return order ? order : std::make_shared< db::Order >(); // Return empty order
+}
+
+std::shared_ptr< ct::db::Order > ct::order::OrdersState::findOrderById(const enums::ExchangeName& exchange_name,
+                                                                       const std::string& symbol,
+                                                                       const std::string& id,
+                                                                       bool use_exchange_id) const
+{
+    auto belongs = [&exchange_name, &symbol](const std::shared_ptr< db::Order >& o)
+    { return o->getExchangeName() == exchange_name && o->getSymbol() == symbol; };
+
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    if (use_exchange_id)
+    {
+        // Find by exchange ID, the same ID may be used by several exchanges
+        auto [first, last] = by_exchange_id_.equal_range(id);
+        for (auto it = first; it != last; ++it)
+        {
+            if (belongs(it->second))
+            {
+                return it->second;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Make sure ID is not empty
+    if (id.empty())
+    {
+        return nullptr;
+    }
+
+    // A complete client ID is looked up in the index
+    if (id.size() == 36)
+    {
+        try
+        {
+            auto order = findById(boost::uuids::string_generator()(id));
+            return order && belongs(order) ? order : nullptr;
+        }
+        catch (const std::runtime_error&)
+        {
+            // Not a valid UUID, fall through to the partial match
+        }
+    }
+
     std::string key = helper::makeKey(exchange_name, symbol);
     auto it         = storage_.find(key);
 
     if (it == storage_.end())
     {
-        return std::make_shared< db::Order >(); // Return empty order
+        return nullptr;
     }
 
     const auto& orders = it->second;
 
-    if (use_exchange_id)
+    // Find by client ID (contains the ID string)
+    for (auto it = orders.rbegin(); it != orders.rend(); ++it)
     {
-        // Find by exchange ID
-        auto it = std::find_if(orders.begin(),
-                               orders.end(),
-                               [&id](const std::shared_ptr< db::Order >& o)
-                               {
-                                   auto exchangeId = o->getExchangeId();
-                                   return exchangeId && *exchangeId == id;
-                               });
-
-        if (it != orders.end())
+        if ((*it)->getIdAsString().find(id) != std::string::npos)
         {
             return *it;
         }
     }
-    else
-    {
-        // Make sure ID is not empty
-        if (id.empty())
-        {
-            return std::make_shared< db::Order >(); // Return empty order
-        }
 
-        // Find by client ID (contains the ID string)
-        for (auto it = orders.rbegin(); it != orders.rend(); ++it)
-        {
-            if ((*it)->getIdAsString().find(id) != std::string::npos)
-            {
-                return *it;
-            }
-        }
+    return nullptr;
+}
+
+std::shared_ptr< ct::db::Order > ct::order::OrdersState::getOrderById(const enums::ExchangeName& exchange_name,
+                                                                      const std::string& symbol,
+                                                                      const boost::uuids::uuid& id) const
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    auto order = findById(id);
+    if (order && order->getExchangeName() == exchange_name && order->getSymbol() == symbol)
+    {
+        return order;
     }
 
     return std::make_shared< db::Order >(); // Return empty order
 }
 
+std::shared_ptr< ct::db::Order > ct::order::OrdersState::findById(const boost::uuids::uuid& id) const
+{
+    auto it = by_id_.find(id);
+    return it == by_id_.end() ? nullptr : it->second;
+}
+
 std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getEntryOrders(
     const enums::ExchangeName& exchange_name, const std::string& symbol) const
+{
+    return viewEntryOrders(exchange_name, symbol).toVector();
+}
+
+std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getExitOrders(
+    const enums::ExchangeName& exchange_name, const std::string& symbol) const
+{
+    return viewExitOrders(exchange_name, symbol).toVector();
+}
+
+std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getActiveExitOrders(
+    const enums::ExchangeName& exchange_name, const std::string& symbol) const
+{
+    return viewActiveExitOrders(exchange_name, symbol).toVector();
+}
+
+ct::order::OrdersView ct::order::OrdersState::viewEntryOrders(const enums::ExchangeName& exchange_name,
+                                                              const std::string& symbol) const
 {
     auto& positionsState = position::PositionsState::getInstance();
     auto position        = positionsState.getPosition(exchange_name, symbol);
@@ -241,26 +584,18 @@ std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getEntry
 
     if (position->isClose())
     {
-        return getOrders(exchange_name, symbol);
+        return OrdersView(getOrders(exchange_name, symbol));
     }
 
-    auto activeOrders = getActiveOrders(exchange_name, symbol);
-    auto pSide        = helper::positionTypeToOrderSide(position->getPositionType());
-
-    std::vector< std::shared_ptr< db::Order > > entryOrders;
-    std::copy_if(activeOrders.begin(),
-                 activeOrders.end(),
-                 std::back_inserter(entryOrders),
-                 [&pSide](const std::shared_ptr< db::Order >& o)
-                 { return o->getOrderSide() == pSide && !o->isCanceled(); });
+    auto pSide = helper::positionTypeToOrderSide(position->getPositionType());
 
-    return entryOrders;
+    return OrdersView(getActiveOrders(exchange_name, symbol), pSide, true);
 }
 
-std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getExitOrders(
-    const enums::ExchangeName& exchange_name, const std::string& symbol) const
+ct::order::OrdersView ct::order::OrdersState::viewExitOrders(const enums::ExchangeName& exchange_name,
+                                                             const std::string& symbol) const
 {
-    auto orders = getOrders(exchange_name, symbol);
+    const auto& orders = getOrders(exchange_name, symbol);
 
     if (orders.empty())
     {
@@ -280,23 +615,15 @@ std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getExitO
         return {};
     }
 
-    std::vector< std::shared_ptr< db::Order > > exitOrders;
     auto pSide = helper::positionTypeToOrderSide(position->getPositionType());
 
-    std::copy_if(orders.begin(),
-                 orders.end(),
-                 std::back_inserter(exitOrders),
-                 [&pSide](const std::shared_ptr< db::Order >& o)
-                 { return o->getOrderSide() != pSide && !o->isCanceled(); });
-
-
-    return exitOrders;
+    return OrdersView(orders, pSide, false);
 }
 
-std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getActiveExitOrders(
-    const enums::ExchangeName& exchange_name, const std::string& symbol) const
+ct::order::OrdersView ct::order::OrdersState::viewActiveExitOrders(const enums::ExchangeName& exchange_name,
+                                                                   const std::string& symbol) const
 {
-    auto activeOrders = getActiveOrders(exchange_name, symbol);
+    const auto& activeOrders = getActiveOrders(exchange_name, symbol);
 
     if (activeOrders.empty())
     {
@@ -316,38 +643,41 @@ std::vector< std::shared_ptr< ct::db::Order > > ct::order::OrdersState::getActiv
         return {};
     }
 
-    std::vector< std::shared_ptr< db::Order > > exitOrders;
     auto pSide = helper::positionTypeToOrderSide(position->getPositionType());
 
-    std::copy_if(activeOrders.begin(),
-                 activeOrders.end(),
-                 std::back_inserter(exitOrders),
-                 [&pSide](const std::shared_ptr< db::Order >& o)
-                 { return o->getOrderSide() != pSide && !o->isCanceled(); });
-
-
-    return exitOrders;
+    return OrdersView(activeOrders, pSide, false);
 }
 
 void ct::order::OrdersState::updateActiveOrders(const enums::ExchangeName& exchange_name, const std::string& symbol)
 {
-    auto activeOrders = getActiveOrders(exchange_name, symbol);
-
-    std::vector< std::shared_ptr< db::Order > > result;
-
-    std::copy_if(activeOrders.begin(),
-                 activeOrders.end(),
-                 std::back_inserter(result),
-                 [](const std::shared_ptr< db::Order >& o) { return !o->isCanceled() && !o->isExecuted(); });
-
     std::string key = helper::makeKey(exchange_name, symbol);
 
-    active_storage_[key] = result;
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    // Pruned in place, no copy of the active orders
+    auto& activeOrders = active_storage_[key];
+    activeOrders.erase(std::remove_if(activeOrders.begin(),
+                                      activeOrders.end(),
+                                      [](const std::shared_ptr< db::Order >& o)
+                                      { return o->isCanceled() || o->isExecuted(); }),
+                       activeOrders.end());
 }
 
 void ct::order::OrdersState::clearOrders(const enums::ExchangeName& exchange_name, const std::string& symbol)
 {
     std::string key = helper::makeKey(exchange_name, symbol);
 
+    std::lock_guard< std::mutex > lock(mutex_);
+
+    for (const auto& order : storage_[key])
+    {
+        unindexOrder(order.get());
+    }
+    for (const auto& order : active_storage_[key])
+    {
+        unindexOrder(order.get());
+    }
+
     storage_[key].clear();
+    active_storage_[key].clear();
 }
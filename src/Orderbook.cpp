@@ -1,6 +1,8 @@
 #include "Orderbook.hpp"
+#include "Exchange.hpp"
 #include "Helper.hpp"
 #include "LimitOrderbook.hpp"
+#include "OrderbookArchive.hpp"
 #include "Route.hpp"
 
 namespace ct
@@ -15,17 +17,40 @@ void OrderbooksState::init()
     {
         auto exchangeName = route["exchange_name"].get< enums::ExchangeName >();
         auto symbol       = route["symbol"].get< std::string >();
-        auto key          = helper::makeKey(exchangeName, symbol);
+        initSymbol(exchangeName, symbol);
+    }
+}
 
-        // Initialize temp storage
-        temp_storage_.at(key) = TempOrderbookData{};
+void OrderbooksState::initSymbol(const enums::ExchangeName& exchange_name, const std::string& symbol)
+{
+    auto key = helper::makeKey(exchange_name, symbol);
+
+    // Initialize temp storage
+    temp_storage_[key] = TempOrderbookData{};
+
+    // Create a dynamic array with shape [60, 2, 50, 2] and drop at 60
+    // This represents 60 timeframes, 2 sides (ask/bid), 50 levels, 2 values (price/qty)
+    std::array< size_t, 2 > shape{60, 2};
+    storage_[key] =
+        std::make_shared< datastructure::DynamicBlazeArray< lob::LimitOrderbook< lob::R_, lob::C_ > > >(shape, 60);
+
+    // Readers see an empty (NaN) book until the first orderbook arrives
+    PublishedOrderbook empty;
+    empty.asks_     = fixLen({}, lob::R_);
+    empty.bids_     = fixLen({}, lob::R_);
+    published_[key] = std::make_unique< datastructure::Seqlock< PublishedOrderbook > >(empty);
+}
 
-        // Create a dynamic array with shape [60, 2, 50, 2] and drop at 60
-        // This represents 60 timeframes, 2 sides (ask/bid), 50 levels, 2 values (price/qty)
-        std::array< size_t, 2 > shape{60, 2};
-        storage_.at(key) =
-            std::make_shared< datastructure::DynamicBlazeArray< lob::LimitOrderbook< lob::R_, lob::C_ > > >(shape, 60);
-    }
+void OrderbooksState::publish(
+    const std::string& key,
+    int64_t timestamp,
+    const blaze::StaticVector< lob::LimitOrderbook< lob::R_, lob::C_ >, 2UL, blaze::rowVector >& orderbook)
+{
+    PublishedOrderbook snapshot;
+    snapshot.timestamp_ = timestamp;
+    snapshot.asks_      = orderbook[0];
+    snapshot.bids_      = orderbook[1];
+    published_.at(key)->store(snapshot);
 }
 
 lob::LimitOrderbook< lob::R_, lob::C_ > OrderbooksState::fixLen(const std::vector< std::array< double, 2 > >& arr,
@@ -38,11 +63,11 @@ lob::LimitOrderbook< lob::R_, lob::C_ > OrderbooksState::fixLen(const std::vecto
         row.fill(nan);
     }
 
-    // Copy available data
+    // Copy available data: row 0 holds prices and row 1 holds quantities
     for (size_t i = 0; i < std::min(arr.size(), target_len); ++i)
     {
-        result[i][0] = arr[i][0];
-        result[i][1] = arr[i][1];
+        result[0][i] = arr[i][0];
+        result[1][i] = arr[i][1];
     }
 
     return result;
@@ -64,6 +89,35 @@ blaze::StaticVector< lob::LimitOrderbook< lob::R_, lob::C_ >, 2UL, blaze::rowVec
     return {formattedAsks, formattedBids};
 }
 
+namespace
+{
+
+// Tick and lot sizes of a symbol from the precisions of its exchange, the archive defaults where they are missing
+ArchivePrecision getArchivePrecision(const enums::ExchangeName& exchange_name, const std::string& symbol)
+{
+    ArchivePrecision precision;
+
+    auto vars = exchange::ExchangesState::getInstance().getExchange(exchange_name)->getVars();
+    if (!vars.contains("precisions") || !vars["precisions"].contains(symbol))
+    {
+        return precision;
+    }
+
+    const auto& symbolPrecision = vars["precisions"][symbol];
+    if (symbolPrecision.contains("price_precision"))
+    {
+        precision.tick_size_ = std::pow(10.0, -symbolPrecision["price_precision"].get< int >());
+    }
+    if (symbolPrecision.contains("qty_precision"))
+    {
+        precision.lot_size_ = std::pow(10.0, -symbolPrecision["qty_precision"].get< int >());
+    }
+
+    return precision;
+}
+
+} // namespace
+
 void OrderbooksState::addOrderbook(const enums::ExchangeName& exchange_name,
                                    const std::string& symbol,
                                    const std::vector< std::array< double, 2 > >& asks,
@@ -76,16 +130,51 @@ void OrderbooksState::addOrderbook(const enums::ExchangeName& exchange_name,
     // Generate new formatted orderbook if it is either the first time,
     // or it has passed 1000 milliseconds since the last time
     int64_t currentTimestamp = helper::nowToTimestamp();
-    if (temp_storage_.at(key).last_updated_timestamp_ == 0 ||
-        currentTimestamp - temp_storage_.at(key).last_updated_timestamp_ >= 1000)
+    bool firstSnapshot       = temp_storage_.at(key).last_updated_timestamp_ == 0;
+    if (firstSnapshot || currentTimestamp - temp_storage_.at(key).last_updated_timestamp_ >= 1000)
     {
         temp_storage_.at(key).last_updated_timestamp_ = currentTimestamp;
 
         auto formattedOrderbook = formatOrderbook(exchange_name, symbol);
         storage_.at(key)->append(formattedOrderbook);
+        publish(key, currentTimestamp, formattedOrderbook);
+
+        if (helper::isLive())
+        {
+            // Stored by the writer thread of the archive, started with the first snapshot
+            auto& archive = OrderbookArchive::getInstance();
+            if (!archive.isRunning())
+            {
+                archive.start();
+            }
+            if (firstSnapshot)
+            {
+                // Encode on the price and qty grid of the exchange instead of the 1e-8 default
+                archive.setPrecision(exchange_name, symbol, getArchivePrecision(exchange_name, symbol));
+            }
+            archive.add(exchange_name, symbol, currentTimestamp, formattedOrderbook);
+        }
     }
 }
 
+void OrderbooksState::addFormattedOrderbook(
+    const enums::ExchangeName& exchange_name,
+    const std::string& symbol,
+    int64_t timestamp,
+    const blaze::StaticVector< lob::LimitOrderbook< lob::R_, lob::C_ >, 2UL, blaze::rowVector >& orderbook)
+{
+    std::string key = helper::makeKey(exchange_name, symbol);
+    storage_.at(key)->append(orderbook);
+    publish(key, timestamp, orderbook);
+}
+
+PublishedOrderbook OrderbooksState::getSnapshot(const enums::ExchangeName& exchange_name,
+                                                const std::string& symbol) const
+{
+    std::string key = helper::makeKey(exchange_name, symbol);
+    return published_.at(key)->load();
+}
+
 auto OrderbooksState::getCurrentOrderbook(const enums::ExchangeName& exchange_name, const std::string& symbol) const
 {
     std::string key = helper::makeKey(exchange_name, symbol);
@@ -95,7 +184,7 @@ auto OrderbooksState::getCurrentOrderbook(const enums::ExchangeName& exchange_na
 lob::LimitOrderbook< lob::R_, lob::C_ > OrderbooksState::getCurrentAsks(const enums::ExchangeName& exchange_name,
                                                                         const std::string& symbol) const
 {
-    return getCurrentOrderbook(exchange_name, symbol)[0];
+    return getSnapshot(exchange_name, symbol).asks_;
 }
 
 blaze::StaticVector< double, 2UL > OrderbooksState::getBestAsk(const enums::ExchangeName& exchange_name,
@@ -110,7 +199,7 @@ blaze::StaticVector< double, 2UL > OrderbooksState::getBestAsk(const enums::Exch
 lob::LimitOrderbook< lob::R_, lob::C_ > OrderbooksState::getCurrentBids(const enums::ExchangeName& exchange_name,
                                                                         const std::string& symbol) const
 {
-    return getCurrentOrderbook(exchange_name, symbol)[1];
+    return getSnapshot(exchange_name, symbol).bids_;
 }
 
 blaze::StaticVector< double, 2UL > OrderbooksState::getBestBid(const enums::ExchangeName& exchange_name,
@@ -0,0 +1,567 @@
+#include "OrderbookArchive.hpp"
+#include "Helper.hpp"
+#include "Logger.hpp"
+
+namespace ct
+{
+namespace orderbook
+{
+
+namespace
+{
+
+constexpr uint8_t ARCHIVE_MAGIC_0 = 'O';
+constexpr uint8_t ARCHIVE_MAGIC_1 = 'B';
+constexpr uint8_t ARCHIVE_VERSION = 1;
+
+uint64_t zigzagEncode(int64_t value)
+{
+    return (static_cast< uint64_t >(value) << 1) ^ static_cast< uint64_t >(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value)
+{
+    return static_cast< int64_t >(value >> 1) ^ -static_cast< int64_t >(value & 1);
+}
+
+void writeVarint(std::vector< uint8_t >& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast< uint8_t >(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast< uint8_t >(value));
+}
+
+uint64_t readVarint(const uint8_t*& cursor, const uint8_t* end)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (cursor == end)
+        {
+            throw std::runtime_error("Truncated orderbook archive");
+        }
+        uint8_t byte = *cursor++;
+        value |= static_cast< uint64_t >(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed varint in orderbook archive");
+}
+
+void writeDouble(std::vector< uint8_t >& out, double value)
+{
+    uint8_t bytes[sizeof(double)];
+    std::memcpy(bytes, &value, sizeof(double));
+    out.insert(out.end(), bytes, bytes + sizeof(double));
+}
+
+double readDouble(const uint8_t*& cursor, const uint8_t* end)
+{
+    if (end - cursor < static_cast< std::ptrdiff_t >(sizeof(double)))
+    {
+        throw std::runtime_error("Truncated orderbook archive");
+    }
+    double value;
+    std::memcpy(&value, cursor, sizeof(double));
+    cursor += sizeof(double);
+    return value;
+}
+
+} // namespace
+
+void OrderbookArchive::setPrecision(const enums::ExchangeName& exchange_name,
+                                    const std::string& symbol,
+                                    const ArchivePrecision& precision)
+{
+    if (precision.tick_size_ <= 0 || precision.lot_size_ <= 0)
+    {
+        throw std::invalid_argument("Tick and lot sizes must be positive");
+    }
+
+    std::lock_guard< std::mutex > lock(mutex_);
+    precisions_[helper::makeKey(exchange_name, symbol)] = precision;
+}
+
+void OrderbookArchive::setBatching(size_t batch_size, size_t rows_per_write, size_t max_queued_rows)
+{
+    if (batch_size == 0 || rows_per_write == 0 || max_queued_rows < rows_per_write)
+    {
+        throw std::invalid_argument(
+            "Batch size and rows per write must be positive and the queue must hold at least one write");
+    }
+    if (batch_size > MAX_BATCH_SIZE)
+    {
+        throw std::invalid_argument("Batch size must not exceed " + std::to_string(MAX_BATCH_SIZE));
+    }
+
+    std::lock_guard< std::mutex > lock(mutex_);
+    batch_size_      = batch_size;
+    rows_per_write_  = rows_per_write;
+    max_queued_rows_ = max_queued_rows;
+    trimQueue();
+}
+
+ArchivePrecision OrderbookArchive::getPrecision(const std::string& key) const
+{
+    auto it = precisions_.find(key);
+    return it != precisions_.end() ? it->second : ArchivePrecision{};
+}
+
+void OrderbookArchive::add(const enums::ExchangeName& exchange_name,
+                           const std::string& symbol,
+                           int64_t timestamp,
+                           const OrderbookSnapshot& snapshot)
+{
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+
+        std::string key = helper::makeKey(exchange_name, symbol);
+        auto& batch     = pending_[key];
+        if (batch.timestamps_.empty())
+        {
+            batch.exchange_name_ = exchange_name;
+            batch.symbol_        = symbol;
+            batch.timestamps_.reserve(batch_size_);
+            batch.snapshots_.reserve(batch_size_);
+        }
+        // A row never spans more than batch_size_ seconds, at most MAX_BATCH_SIZE, which bounds the load lookback
+        else if (timestamp - batch.timestamps_.front() >= static_cast< int64_t >(batch_size_) * 1000)
+        {
+            encodePending(batch);
+        }
+
+        batch.timestamps_.push_back(timestamp);
+        batch.snapshots_.push_back(snapshot);
+
+        if (batch.timestamps_.size() >= batch_size_)
+        {
+            encodePending(batch);
+        }
+
+        if (queued_rows_.size() < rows_per_write_)
+        {
+            return;
+        }
+    }
+
+    // The rows are written by the writer thread, the ingest path never waits for the database
+    wake_.notify_one();
+}
+
+void OrderbookArchive::encodePending(PendingBatch& batch)
+{
+    if (batch.timestamps_.empty())
+    {
+        return;
+    }
+
+    auto data = encodeBatch(
+        batch.timestamps_, batch.snapshots_, getPrecision(helper::makeKey(batch.exchange_name_, batch.symbol_)));
+    queued_rows_.emplace_back(batch.timestamps_.front(), batch.symbol_, batch.exchange_name_, std::move(data));
+    trimQueue();
+
+    batch.timestamps_.clear();
+    batch.snapshots_.clear();
+}
+
+void OrderbookArchive::requeue(std::vector< db::Orderbook >& rows)
+{
+    queued_rows_.insert(
+        queued_rows_.begin(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+    trimQueue();
+}
+
+void OrderbookArchive::trimQueue()
+{
+    if (queued_rows_.size() <= max_queued_rows_)
+    {
+        return;
+    }
+
+    size_t excess = queued_rows_.size() - max_queued_rows_;
+    queued_rows_.erase(queued_rows_.begin(), queued_rows_.begin() + excess);
+
+    // Logged once per power of two, a lagging database would flood the log otherwise
+    uint64_t before = dropped_rows_;
+    dropped_rows_ += excess;
+    if ((before ^ dropped_rows_) > before)
+    {
+        std::ostringstream oss;
+        oss << "Orderbook archive queue is full, " << dropped_rows_ << " rows dropped so far";
+        logger::LOG.error(oss.str());
+    }
+}
+
+void OrderbookArchive::flush(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr)
+{
+    std::vector< db::Orderbook > rows;
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        for (auto& [key, batch] : pending_)
+        {
+            encodePending(batch);
+        }
+        rows.assign(std::make_move_iterator(queued_rows_.begin()), std::make_move_iterator(queued_rows_.end()));
+        queued_rows_.clear();
+    }
+
+    try
+    {
+        db::saveOrderbooks(conn_ptr, rows);
+    }
+    catch (const std::exception&)
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        requeue(rows);
+        throw;
+    }
+}
+
+OrderbookArchive::~OrderbookArchive()
+{
+    stop();
+}
+
+void OrderbookArchive::start(std::chrono::milliseconds retry_interval)
+{
+    std::lock_guard< std::mutex > lifecycle(lifecycle_mutex_);
+    if (running_.load())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        retry_interval_ = retry_interval;
+        stopping_       = false;
+    }
+    running_.store(true);
+    writer_ = std::thread(&OrderbookArchive::runWriter, this);
+
+    if (!hook_registered_)
+    {
+        // Queued rows are stored before the pool waits for its connections to come back
+        db::DatabaseShutdownManager::getInstance().registerShutdownHook([] { OrderbookArchive::getInstance().stop(); });
+        hook_registered_ = true;
+    }
+}
+
+void OrderbookArchive::stop()
+{
+    std::lock_guard< std::mutex > lifecycle(lifecycle_mutex_);
+    if (!running_.load())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    writer_.join();
+    running_.store(false);
+}
+
+void OrderbookArchive::reset()
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+    pending_.clear();
+    queued_rows_.clear();
+    dropped_rows_ = 0;
+}
+
+size_t OrderbookArchive::countQueuedRows() const
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+    return queued_rows_.size();
+}
+
+uint64_t OrderbookArchive::countDroppedRows() const
+{
+    std::lock_guard< std::mutex > lock(mutex_);
+    return dropped_rows_;
+}
+
+void OrderbookArchive::runWriter()
+{
+    // Checked out on the first write and kept, the pool refuses new checkouts once shutdown started
+    std::shared_ptr< sqlpp::postgresql::connection > conn;
+
+    std::unique_lock< std::mutex > lock(mutex_);
+    while (true)
+    {
+        wake_.wait(lock, [this] { return stopping_ || queued_rows_.size() >= rows_per_write_; });
+
+        // The last round also writes the batches that are not full yet
+        bool stopping = stopping_;
+        if (stopping)
+        {
+            for (auto& [key, batch] : pending_)
+            {
+                encodePending(batch);
+            }
+        }
+
+        std::vector< db::Orderbook > rows(std::make_move_iterator(queued_rows_.begin()),
+                                          std::make_move_iterator(queued_rows_.end()));
+        queued_rows_.clear();
+        lock.unlock();
+
+        bool written = true;
+        try
+        {
+            if (!rows.empty())
+            {
+                if (!conn)
+                {
+                    conn = db::Database::getInstance().getConnection();
+                }
+                db::saveOrderbooks(conn, rows);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::ostringstream oss;
+            oss << "Error writing orderbook archive, keeping " << rows.size() << " rows for retry: " << e.what();
+            logger::LOG.error(oss.str());
+
+            // A broken connection goes back to the pool, a new one is checked out for the next attempt
+            conn.reset();
+            written = false;
+        }
+
+        lock.lock();
+        if (stopping)
+        {
+            if (!written)
+            {
+                std::ostringstream oss;
+                oss << "Dropping " << rows.size() << " orderbook archive rows that could not be written on stop";
+                logger::LOG.error(oss.str());
+                dropped_rows_ += rows.size();
+            }
+            break;
+        }
+
+        if (!written)
+        {
+            requeue(rows);
+            wake_.wait_for(lock, retry_interval_, [this] { return stopping_; });
+        }
+    }
+}
+
+std::vector< uint8_t > OrderbookArchive::encodeBatch(const std::vector< int64_t >& timestamps,
+                                                     const std::vector< OrderbookSnapshot >& snapshots,
+                                                     const ArchivePrecision& precision,
+                                                     int level)
+{
+    if (timestamps.size() != snapshots.size())
+    {
+        throw std::invalid_argument("Timestamps and snapshots must have the same length");
+    }
+
+    // Every level is kept as integer ticks/lots, deltas are taken against the same level of the previous snapshot
+    std::array< std::array< int64_t, lob::R_ >, 2 > prevPrices{};
+    std::array< std::array< int64_t, lob::R_ >, 2 > prevQtys{};
+    int64_t prevTimestamp = 0;
+
+    std::vector< uint8_t > raw;
+    raw.reserve(32 + snapshots.size() * 2 * lob::R_ * 3);
+    writeDouble(raw, precision.tick_size_);
+    writeDouble(raw, precision.lot_size_);
+    writeVarint(raw, snapshots.size());
+    writeVarint(raw, lob::R_);
+
+    for (size_t s = 0; s < snapshots.size(); ++s)
+    {
+        writeVarint(raw, zigzagEncode(timestamps[s] - prevTimestamp));
+        prevTimestamp = timestamps[s];
+
+        for (size_t side = 0; side < 2; ++side)
+        {
+            const auto& book = snapshots[s][side];
+
+            // Levels are padded with NaN after the last valid price
+            size_t depth = 0;
+            while (depth < lob::R_ && !std::isnan(book[0][depth]))
+            {
+                ++depth;
+            }
+            writeVarint(raw, depth);
+
+            for (size_t i = 0; i < depth; ++i)
+            {
+                double qty     = std::isnan(book[1][i]) ? 0.0 : book[1][i];
+                int64_t price  = std::llround(book[0][i] / precision.tick_size_);
+                int64_t amount = std::llround(qty / precision.lot_size_);
+
+                writeVarint(raw, zigzagEncode(price - prevPrices[side][i]));
+                writeVarint(raw, zigzagEncode(amount - prevQtys[side][i]));
+
+                prevPrices[side][i] = price;
+                prevQtys[side][i]   = amount;
+            }
+        }
+    }
+
+    uLong destLen = compressBound(raw.size());
+    std::vector< uint8_t > out;
+    out.reserve(3 + 10 + destLen);
+    out.push_back(ARCHIVE_MAGIC_0);
+    out.push_back(ARCHIVE_MAGIC_1);
+    out.push_back(ARCHIVE_VERSION);
+    writeVarint(out, raw.size());
+
+    size_t headerLen = out.size();
+    out.resize(headerLen + destLen);
+    if (compress2(out.data() + headerLen, &destLen, raw.data(), raw.size(), level) != Z_OK)
+    {
+        throw std::runtime_error("Compression failed");
+    }
+    out.resize(headerLen + destLen);
+
+    return out;
+}
+
+void OrderbookArchive::decodeBatch(const std::vector< uint8_t >& data,
+                                   std::vector< int64_t >& timestamps,
+                                   std::vector< OrderbookSnapshot >& snapshots)
+{
+    if (data.size() < 4 || data[0] != ARCHIVE_MAGIC_0 || data[1] != ARCHIVE_MAGIC_1)
+    {
+        throw std::runtime_error("Not an orderbook archive batch");
+    }
+    if (data[2] != ARCHIVE_VERSION)
+    {
+        throw std::runtime_error("Unsupported orderbook archive version: " + std::to_string(data[2]));
+    }
+
+    const uint8_t* cursor = data.data() + 3;
+    const uint8_t* end    = data.data() + data.size();
+    uLong rawLen          = readVarint(cursor, end);
+
+    std::vector< uint8_t > raw(rawLen);
+    if (uncompress(raw.data(), &rawLen, cursor, end - cursor) != Z_OK || rawLen != raw.size())
+    {
+        throw std::runtime_error("Decompression failed");
+    }
+
+    cursor = raw.data();
+    end    = raw.data() + raw.size();
+
+    double tickSize = readDouble(cursor, end);
+    double lotSize  = readDouble(cursor, end);
+    size_t count    = readVarint(cursor, end);
+    size_t levels   = readVarint(cursor, end);
+    if (levels != lob::R_)
+    {
+        throw std::runtime_error("Orderbook archive depth mismatch: " + std::to_string(levels));
+    }
+
+    std::array< std::array< int64_t, lob::R_ >, 2 > prevPrices{};
+    std::array< std::array< int64_t, lob::R_ >, 2 > prevQtys{};
+    int64_t prevTimestamp = 0;
+    auto nan              = std::numeric_limits< double >::quiet_NaN();
+
+    timestamps.reserve(timestamps.size() + count);
+    snapshots.reserve(snapshots.size() + count);
+
+    for (size_t s = 0; s < count; ++s)
+    {
+        prevTimestamp += zigzagDecode(readVarint(cursor, end));
+        timestamps.push_back(prevTimestamp);
+
+        OrderbookSnapshot snapshot;
+        for (size_t side = 0; side < 2; ++side)
+        {
+            auto& book = snapshot[side];
+            for (auto& row : book.data)
+            {
+                row.fill(nan);
+            }
+
+            size_t depth = readVarint(cursor, end);
+            if (depth > lob::R_)
+            {
+                throw std::runtime_error("Malformed orderbook archive depth");
+            }
+
+            for (size_t i = 0; i < depth; ++i)
+            {
+                prevPrices[side][i] += zigzagDecode(readVarint(cursor, end));
+                prevQtys[side][i] += zigzagDecode(readVarint(cursor, end));
+
+                book[0][i] = static_cast< double >(prevPrices[side][i]) * tickSize;
+                book[1][i] = static_cast< double >(prevQtys[side][i]) * lotSize;
+            }
+        }
+        snapshots.push_back(snapshot);
+    }
+}
+
+OrderbookSeries OrderbookArchive::load(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                       const enums::ExchangeName& exchange_name,
+                                       const std::string& symbol,
+                                       int64_t start_timestamp,
+                                       int64_t finish_timestamp) const
+{
+    // Rows are keyed by their first snapshot, so look back one batch span to catch a row straddling the start
+    auto filter = db::Orderbook::Filter()
+                      .withExchangeName(exchange_name)
+                      .withSymbol(symbol)
+                      .withTimestampRange(start_timestamp - getBatchSpan(), finish_timestamp);
+
+    auto rows = db::Orderbook::findByFilter(conn_ptr, filter);
+    if (!rows)
+    {
+        return OrderbookSeries{};
+    }
+
+    std::sort(rows->begin(),
+              rows->end(),
+              [](const db::Orderbook& a, const db::Orderbook& b) { return a.getTimestamp() < b.getTimestamp(); });
+
+    std::vector< int64_t > timestamps;
+    std::vector< OrderbookSnapshot > snapshots;
+    for (const auto& row : *rows)
+    {
+        try
+        {
+            decodeBatch(row.getData(), timestamps, snapshots);
+        }
+        catch (const std::exception& e)
+        {
+            std::ostringstream oss;
+            oss << "Skipping orderbook row " << row.getIdAsString() << ": " << e.what();
+            logger::LOG.error(oss.str());
+        }
+    }
+
+    OrderbookSeries series;
+    series.orderbooks_ = datastructure::DynamicBlazeArray< lob::LimitOrderbook< lob::R_, lob::C_ > >(
+        {std::max< size_t >(snapshots.size(), 1), 2});
+    series.timestamps_.reserve(timestamps.size());
+
+    for (size_t i = 0; i < snapshots.size(); ++i)
+    {
+        if (timestamps[i] < start_timestamp || timestamps[i] > finish_timestamp)
+        {
+            continue;
+        }
+        series.timestamps_.push_back(timestamps[i]);
+        series.orderbooks_.append(snapshots[i]);
+    }
+
+    return series;
+}
+
+} // namespace orderbook
+} // namespace ct
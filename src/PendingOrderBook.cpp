@@ -0,0 +1,106 @@
+#include "PendingOrderBook.hpp"
+
+namespace ct
+{
+namespace order
+{
+
+bool PendingOrderBook::isPending(const db::Order& order)
+{
+    if (!order.isActive() && !order.isPartiallyFilled())
+    {
+        return false;
+    }
+
+    // Every type but market rests until the price reaches it
+    return order.getOrderType() != enums::OrderType::MARKET && order.getPrice().has_value();
+}
+
+bool PendingOrderBook::triggersOnFall(const db::Order& order)
+{
+    // Fill-or-kill orders fill like limits, stop-limit orders are triggered like stops
+    auto type    = order.getOrderType();
+    bool isBuy   = order.getOrderSide() == enums::OrderSide::BUY;
+    bool isLimit = type == enums::OrderType::LIMIT || type == enums::OrderType::FOK;
+    return isBuy == isLimit;
+}
+
+void PendingOrderBook::add(const std::shared_ptr< db::Order >& order)
+{
+    auto& side = triggersOnFall(*order) ? falling_ : rising_;
+    side.emplace(*order->getPrice(), order);
+}
+
+bool PendingOrderBook::remove(const db::Order* order, double price)
+{
+    // The side is not derived from the order, its type or side may have changed since it was added
+    return eraseFrom(falling_, order, price) || eraseFrom(rising_, order, price);
+}
+
+bool PendingOrderBook::eraseFrom(Side& side, const db::Order* order, double price)
+{
+    auto [first, last] = side.equal_range(price);
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second.get() == order)
+        {
+            side.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PendingOrderBook::clear()
+{
+    falling_.clear();
+    rising_.clear();
+}
+
+void PendingOrderBook::collectFalling(double low, double high, Orders& out) const
+{
+    if (low > high)
+    {
+        return;
+    }
+
+    auto first = falling_.lower_bound(low);
+    auto last  = falling_.upper_bound(high);
+
+    // Walk the levels downwards while keeping time priority within a level. A level starts at or
+    // after first because its price is not below low.
+    while (last != first)
+    {
+        auto levelBegin = falling_.lower_bound(std::prev(last)->first);
+        for (auto it = levelBegin; it != last; ++it)
+        {
+            out.push_back(it->second);
+        }
+        last = levelBegin;
+    }
+}
+
+void PendingOrderBook::collectRising(double low, double high, Orders& out) const
+{
+    if (low > high)
+    {
+        return;
+    }
+
+    auto last = rising_.upper_bound(high);
+    for (auto it = rising_.lower_bound(low); it != last; ++it)
+    {
+        out.push_back(it->second);
+    }
+}
+
+PendingOrderBook::Orders PendingOrderBook::getTriggered(double low, double high) const
+{
+    Orders triggered;
+    collectFalling(low, high, triggered);
+    collectRising(low, high, triggered);
+    return triggered;
+}
+
+} // namespace order
+} // namespace ct
@@ -5,13 +5,28 @@
 #include "Exception.hpp"
 #include "Helper.hpp"
 
+namespace
+{
+
+template < typename T, typename Compute >
+T memoise(uint8_t& computed, uint8_t metric, T& slot, Compute&& compute)
+{
+    if (!(computed & metric))
+    {
+        slot = compute();
+        computed |= metric;
+    }
+    return slot;
+}
+
+} // namespace
+
 ct::position::Position::Position(const enums::ExchangeName& exchange_name,
                                  const std::string& symbol,
                                  const std::unordered_map< std::string, std::any >& attributes)
     : id_(boost::uuids::random_generator()()), exchange_name_(exchange_name), symbol_(symbol)
 {
-    // TODO:
-    // self.exchange: Exchange = selectors.get_exchange(self.exchange_name)
+    // The exchange is bound by PositionsState::addPosition or setExchange
 
     // Process attributes if provided
     for (const auto& [key, value] : attributes)
@@ -124,7 +139,199 @@ std::optional< int64_t > ct::position::Position::getNextFundingTimestamp() const
     return next_funding_timestamp_;
 }
 
+ct::position::Position& ct::position::Position::operator=(const Position& other)
+{
+    if (this != &other)
+    {
+        assignFields(other);
+    }
+    return *this;
+}
+
+ct::position::Position& ct::position::Position::operator=(Position&& other)
+{
+    if (this != &other)
+    {
+        assignFields(std::move(other));
+    }
+    return *this;
+}
+
+// The version and the snapshot stay with this position, the link to the totals too: touch bumps the version and
+// replaces the contribution of the previous fields with the new ones
+template < typename Other >
+void ct::position::Position::assignFields(Other&& other)
+{
+    id_                     = std::forward< Other >(other).id_;
+    entry_price_            = std::forward< Other >(other).entry_price_;
+    exit_price_             = std::forward< Other >(other).exit_price_;
+    current_price_          = std::forward< Other >(other).current_price_;
+    qty_                    = std::forward< Other >(other).qty_;
+    previous_qty_           = std::forward< Other >(other).previous_qty_;
+    opened_at_              = std::forward< Other >(other).opened_at_;
+    closed_at_              = std::forward< Other >(other).closed_at_;
+    mark_price_             = std::forward< Other >(other).mark_price_;
+    funding_rate_           = std::forward< Other >(other).funding_rate_;
+    next_funding_timestamp_ = std::forward< Other >(other).next_funding_timestamp_;
+    liquidation_price_      = std::forward< Other >(other).liquidation_price_;
+    exchange_name_          = std::forward< Other >(other).exchange_name_;
+    exchange_               = std::forward< Other >(other).exchange_;
+    symbol_                 = std::forward< Other >(other).symbol_;
+    strategy_               = std::forward< Other >(other).strategy_;
+
+    touch();
+}
+
+namespace
+{
+
+// Replace what a position added to the totals before with what it adds now
+void updateTotals(ct::position::PortfolioMetrics& totals,
+                  const ct::position::PortfolioMetrics& previous,
+                  const ct::position::PortfolioMetrics& contribution)
+{
+    totals.open_positions_ += contribution.open_positions_ - previous.open_positions_;
+
+    if (totals.open_positions_ == 0)
+    {
+        // Nothing is open, drop the rounding error the sums picked up on the way
+        totals = ct::position::PortfolioMetrics{};
+        return;
+    }
+
+    totals.total_value_ += contribution.total_value_ - previous.total_value_;
+    totals.total_pnl_ += contribution.total_pnl_ - previous.total_pnl_;
+    totals.total_cost_ += contribution.total_cost_ - previous.total_cost_;
+    totals.total_entry_value_ += contribution.total_entry_value_ - previous.total_entry_value_;
+}
+
+} // namespace
+
+void ct::position::Position::touch()
+{
+    ++version_;
+
+    if (!totals_link_.totals_)
+    {
+        return;
+    }
+
+    PortfolioMetrics contribution;
+    if (isOpen())
+    {
+        double value = getValue();
+        double pnl   = getPnl();
+        double cost  = getTotalCost();
+
+        contribution.open_positions_    = 1;
+        contribution.total_value_       = std::isnan(value) ? 0.0 : value;
+        contribution.total_pnl_         = std::isnan(pnl) ? 0.0 : pnl;
+        contribution.total_cost_        = std::isnan(cost) ? 0.0 : cost;
+        contribution.total_entry_value_ = std::abs(qty_) * entry_price_.value_or(0.0);
+    }
+
+    auto& previous = totals_link_.contribution_;
+    updateTotals(*totals_link_.totals_, previous, contribution);
+    if (totals_link_.exchange_totals_)
+    {
+        updateTotals(*totals_link_.exchange_totals_, previous, contribution);
+    }
+
+    previous = contribution;
+}
+
+void ct::position::Position::bindTotals(PortfolioMetrics* totals, PortfolioMetrics* exchange_totals)
+{
+    if (totals_link_.totals_)
+    {
+        // Take the current contribution out of the totals being left
+        const PortfolioMetrics none;
+        updateTotals(*totals_link_.totals_, totals_link_.contribution_, none);
+        if (totals_link_.exchange_totals_)
+        {
+            updateTotals(*totals_link_.exchange_totals_, totals_link_.contribution_, none);
+        }
+    }
+
+    totals_link_.totals_          = totals;
+    totals_link_.exchange_totals_ = totals ? exchange_totals : nullptr;
+    totals_link_.contribution_    = PortfolioMetrics{};
+
+    if (totals)
+    {
+        // Adds the current metrics as a fresh contribution
+        touch();
+    }
+}
+
+void ct::position::Position::syncSnapshot() const
+{
+    if (snapshot_.version_ != version_)
+    {
+        snapshot_.version_  = version_;
+        snapshot_.computed_ = 0;
+    }
+}
+
+const ct::position::PositionSnapshot& ct::position::Position::getSnapshot() const
+{
+    syncSnapshot();
+    if (snapshot_.computed_ != PositionSnapshot::ALL)
+    {
+        getValue();
+        getPnl();
+        getRoi();
+        getTotalCost();
+        getLeverage();
+        getLiquidationPrice();
+    }
+    return snapshot_;
+}
+
+double ct::position::Position::getValue() const
+{
+    syncSnapshot();
+    return memoise(snapshot_.computed_, PositionSnapshot::VALUE, snapshot_.value_, [this] { return computeValue(); });
+}
+
+double ct::position::Position::getRoi() const
+{
+    syncSnapshot();
+    return memoise(snapshot_.computed_, PositionSnapshot::ROI, snapshot_.roi_, [this] { return computeRoi(); });
+}
+
+double ct::position::Position::getTotalCost() const
+{
+    syncSnapshot();
+    return memoise(snapshot_.computed_,
+                   PositionSnapshot::TOTAL_COST,
+                   snapshot_.total_cost_,
+                   [this] { return computeTotalCost(); });
+}
+
+double ct::position::Position::getLeverage() const
+{
+    syncSnapshot();
+    return memoise(
+        snapshot_.computed_, PositionSnapshot::LEVERAGE, snapshot_.leverage_, [this] { return computeLeverage(); });
+}
+
+double ct::position::Position::getPnl() const
+{
+    syncSnapshot();
+    return memoise(snapshot_.computed_, PositionSnapshot::PNL, snapshot_.pnl_, [this] { return computePnl(); });
+}
+
 std::optional< double > ct::position::Position::getLiquidationPrice() const
+{
+    syncSnapshot();
+    return memoise(snapshot_.computed_,
+                   PositionSnapshot::LIQUIDATION_PRICE,
+                   snapshot_.liquidation_price_,
+                   [this] { return computeLiquidationPrice(); });
+}
+
+std::optional< double > ct::position::Position::computeLiquidationPrice() const
 {
     if (isClose())
     {
@@ -163,7 +370,7 @@ std::optional< double > ct::position::Position::getLiquidationPrice() const
 }
 
 // The value of open position in the quote currency
-double ct::position::Position::getValue() const
+double ct::position::Position::computeValue() const
 {
     if (isClose())
     {
@@ -192,18 +399,19 @@ ct::enums::PositionType ct::position::Position::getPositionType() const
     return enums::PositionType::CLOSE;
 }
 
-double ct::position::Position::getRoi() const
+double ct::position::Position::computeRoi() const
 {
-    if (getPnl() == 0)
+    double pnl = getPnl();
+    if (pnl == 0)
     {
         return 0.0;
     }
 
-    return getPnl() / getTotalCost() * 100;
+    return pnl / getTotalCost() * 100;
 }
 
 // How much we paid to open this position (currently does not include fees, should we?!)
-double ct::position::Position::getTotalCost() const
+double ct::position::Position::computeTotalCost() const
 {
     if (isClose())
     {
@@ -220,7 +428,7 @@ double ct::position::Position::getTotalCost() const
     return base_cost;
 }
 
-double ct::position::Position::getLeverage() const
+double ct::position::Position::computeLeverage() const
 {
     if (exchange_->getExchangeType() == enums::ExchangeType::SPOT)
     {
@@ -235,7 +443,7 @@ double ct::position::Position::getLeverage() const
     return std::nanf("");
 }
 
-double ct::position::Position::getPnl() const
+double ct::position::Position::computePnl() const
 {
     if (std::abs(qty_) < getMinQty())
     {
@@ -247,12 +455,13 @@ double ct::position::Position::getPnl() const
         return 0.0;
     }
 
-    if (getValue() == 0 || std::isnan(getValue()))
+    double value = getValue();
+    if (value == 0 || std::isnan(value))
     {
         return 0.0;
     }
 
-    double diff = getValue() - std::abs(entry_price_.value() * qty_);
+    double diff = value - std::abs(entry_price_.value() * qty_);
 
     return (getPositionType() == enums::PositionType::SHORT) ? -diff : diff;
 }
@@ -332,6 +541,7 @@ void ct::position::Position::close(double close_price)
     }
 
     entry_price_.reset();
+    touch();
 
     close();
 }
@@ -382,6 +592,7 @@ void ct::position::Position::increase(double qty, double price)
 
     // Calculate new average entry price
     entry_price_ = helper::estimateAveragePrice(qty, price, qty_, entry_price_.value_or(0.0));
+    touch();
 
     if (canMutateQty())
     {
@@ -405,6 +616,7 @@ void ct::position::Position::open(double qty, double price)
 
     entry_price_ = price;
     exit_price_.reset();
+    touch();
 
     if (canMutateQty())
     {
@@ -566,6 +778,8 @@ void ct::position::Position::onUpdateFromStream(const nlohmann::json& data, bool
         qty_          = data["qty"].get< double >();
     }
 
+    touch();
+
     bool opening_position = before_qty <= getMinQty() && after_qty > getMinQty();
     bool closing_position = before_qty > getMinQty() && after_qty <= getMinQty();
 
@@ -612,16 +826,18 @@ nlohmann::json ct::position::Position::toJson() const
         result["current_price"] = nullptr;
     }
 
-    result["value"]          = getValue();
+    const auto& snapshot = getSnapshot();
+
+    result["value"]          = snapshot.value_;
     result["position_type"]  = getPositionType();
     result["exchange_name"]  = exchange_name_;
-    result["pnl"]            = getPnl();
-    result["pnl_percentage"] = getPnlPercentage();
-    result["leverage"]       = getLeverage();
+    result["pnl"]            = snapshot.pnl_;
+    result["pnl_percentage"] = snapshot.roi_;
+    result["leverage"]       = snapshot.leverage_;
 
-    if (getLiquidationPrice().has_value() && !std::isnan(getLiquidationPrice().value()))
+    if (snapshot.liquidation_price_.has_value() && !std::isnan(snapshot.liquidation_price_.value()))
     {
-        result["liquidation_price"] = getLiquidationPrice().value();
+        result["liquidation_price"] = snapshot.liquidation_price_.value();
     }
     else
     {
@@ -702,6 +918,8 @@ void ct::position::Position::updateQty(double qty, const Operation& op)
     {
         throw std::runtime_error("Exchange type not implemented");
     }
+
+    touch();
 }
 
 double ct::position::Position::getMinQty() const
@@ -793,9 +1011,7 @@ void ct::position::PositionsState::init()
         {
             for (const auto& symbol : tradingSymbols)
             {
-                std::string key = helper::makeKey(enums::toExchangeName(exchangeName), symbol);
-                storage_.insert_or_assign(key,
-                                          std::make_shared< Position >(enums::toExchangeName(exchangeName), symbol));
+                addPosition(std::make_shared< Position >(enums::toExchangeName(exchangeName), symbol));
             }
         }
     }
@@ -806,29 +1022,82 @@ void ct::position::PositionsState::init()
     }
 }
 
-int ct::position::PositionsState::countOpenPositions() const
+ct::position::PositionsState::~PositionsState()
+{
+    reset();
+}
+
+void ct::position::PositionsState::reset()
 {
-    int count = 0;
-    for (const auto& [key, position] : storage_)
+    // Positions held elsewhere must stop writing into the totals
+    for (const auto& position : positions_)
     {
-        if (position->isOpen())
-        {
-            ++count;
-        }
+        position->bindTotals(nullptr, nullptr);
     }
-    return count;
+
+    positions_.clear();
+    routes_.clear();
+    totals_ = PortfolioMetrics{};
+    exchange_totals_.clear();
+}
+
+size_t ct::position::PositionsState::addPosition(const std::shared_ptr< Position >& position)
+{
+    auto& exchangesState = exchange::ExchangesState::getInstance();
+    if (!position->getExchange() && exchangesState.hasExchange(position->getExchangeName()))
+    {
+        position->setExchange(exchangesState.getExchange(position->getExchangeName()));
+    }
+
+    std::string key = helper::makeKey(position->getExchangeName(), position->getSymbol());
+
+    auto* exchangeTotals = &exchange_totals_[position->getExchangeName()];
+
+    auto it = routes_.find(key);
+    if (it != routes_.end())
+    {
+        positions_[it->second]->bindTotals(nullptr, nullptr);
+        positions_[it->second] = position;
+        position->bindTotals(&totals_, exchangeTotals);
+        return it->second;
+    }
+
+    size_t route = positions_.size();
+    positions_.push_back(position);
+    routes_.emplace(std::move(key), route);
+    position->bindTotals(&totals_, exchangeTotals);
+    return route;
+}
+
+const ct::position::PortfolioMetrics& ct::position::PositionsState::getPortfolioMetrics(
+    const enums::ExchangeName& exchange_name) const
+{
+    static const PortfolioMetrics none;
+
+    auto it = exchange_totals_.find(exchange_name);
+    return it == exchange_totals_.end() ? none : it->second;
 }
 
 std::shared_ptr< ct::position::Position > ct::position::PositionsState::getPosition(
     const enums::ExchangeName& exchange_name, const std::string& symbol)
 {
-    std::string key = helper::makeKey(exchange_name, symbol);
-
-    auto it = storage_.find(key);
-    if (it == storage_.end())
+    auto it = routes_.find(helper::makeKey(exchange_name, symbol));
+    if (it == routes_.end())
     {
         return nullptr;
     }
 
+    return positions_[it->second];
+}
+
+size_t ct::position::PositionsState::getRouteIndex(const enums::ExchangeName& exchange_name,
+                                                   const std::string& symbol) const
+{
+    auto it = routes_.find(helper::makeKey(exchange_name, symbol));
+    if (it == routes_.end())
+    {
+        throw std::out_of_range("No position for " + enums::toString(exchange_name) + " " + symbol);
+    }
+
     return it->second;
 }
@@ -0,0 +1,418 @@
+#include "Replay.hpp"
+#include "Helper.hpp"
+#include "Logger.hpp"
+#include "Orderbook.hpp"
+#include "Trade.hpp"
+
+namespace ct
+{
+namespace replay
+{
+
+namespace
+{
+
+constexpr char ORDERBOOK_FILE_MAGIC[4] = {'C', 'T', 'O', 'B'};
+constexpr char TRADE_FILE_MAGIC[4]     = {'C', 'T', 'T', 'R'};
+constexpr uint32_t FILE_VERSION        = 1;
+constexpr size_t TRADE_FILE_COLUMNS    = 4;
+
+template < typename T >
+void writeValue(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast< const char* >(&value), sizeof(T));
+}
+
+template < typename T >
+T readValue(std::ifstream& in, const std::filesystem::path& path)
+{
+    T value;
+    if (!in.read(reinterpret_cast< char* >(&value), sizeof(T)))
+    {
+        throw std::runtime_error("Truncated replay file: " + path.string());
+    }
+    return value;
+}
+
+std::ifstream openReplayFile(const std::filesystem::path& path, const char (&magic)[4])
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open replay file: " + path.string());
+    }
+
+    char header[4];
+    if (!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(header)) != 0)
+    {
+        throw std::runtime_error("Not a replay file: " + path.string());
+    }
+
+    auto version = readValue< uint32_t >(in, path);
+    if (version != FILE_VERSION)
+    {
+        throw std::runtime_error("Unsupported replay file version " + std::to_string(version) + ": " + path.string());
+    }
+
+    return in;
+}
+
+std::ofstream createReplayFile(const std::filesystem::path& path, const char (&magic)[4])
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Cannot create replay file: " + path.string());
+    }
+    out.write(magic, sizeof(magic));
+    writeValue(out, FILE_VERSION);
+    return out;
+}
+
+} // namespace
+
+void ReplayEngine::addOrderbookStream(const enums::ExchangeName& exchange_name,
+                                      const std::string& symbol,
+                                      std::vector< std::vector< uint8_t > > batches,
+                                      int64_t start_timestamp,
+                                      int64_t finish_timestamp)
+{
+    Stream stream;
+    stream.type_             = EventType::ORDERBOOK;
+    stream.exchange_name_    = exchange_name;
+    stream.symbol_           = symbol;
+    stream.batches_          = std::move(batches);
+    stream.start_timestamp_  = start_timestamp;
+    stream.finish_timestamp_ = finish_timestamp;
+    streams_.push_back(std::move(stream));
+}
+
+void ReplayEngine::addTradeStream(const enums::ExchangeName& exchange_name,
+                                  const std::string& symbol,
+                                  blaze::DynamicMatrix< double > trades)
+{
+    if (trades.rows() > 0 && trades.columns() < TRADE_FILE_COLUMNS)
+    {
+        throw std::invalid_argument("Trades must have at least 4 columns [timestamp, price, qty, side]");
+    }
+
+    Stream stream;
+    stream.type_          = EventType::TRADE;
+    stream.exchange_name_ = exchange_name;
+    stream.symbol_        = symbol;
+    stream.trades_        = std::move(trades);
+    streams_.push_back(std::move(stream));
+}
+
+void ReplayEngine::addAggregatedTradeStream(const enums::ExchangeName& exchange_name,
+                                            const std::string& symbol,
+                                            blaze::DynamicMatrix< double > trades)
+{
+    if (trades.rows() > 0 && trades.columns() < 6)
+    {
+        throw std::invalid_argument("Aggregated trades must have 6 columns");
+    }
+
+    Stream stream;
+    stream.type_          = EventType::AGGREGATED_TRADE;
+    stream.exchange_name_ = exchange_name;
+    stream.symbol_        = symbol;
+    stream.trades_        = std::move(trades);
+    streams_.push_back(std::move(stream));
+}
+
+void ReplayEngine::loadOrderbooks(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                                  const enums::ExchangeName& exchange_name,
+                                  const std::string& symbol,
+                                  int64_t start_timestamp,
+                                  int64_t finish_timestamp)
+{
+    // Rows are keyed by their first snapshot, so look back one batch span to catch a row straddling the start
+    auto lookback = orderbook::OrderbookArchive::getBatchSpan();
+    auto filter   = db::Orderbook::Filter()
+                      .withExchangeName(exchange_name)
+                      .withSymbol(symbol)
+                      .withTimestampRange(start_timestamp - lookback, finish_timestamp);
+
+    // Streamed so only the timestamp and the encoded batch of every row are held, not whole models
+    std::vector< std::pair< int64_t, std::vector< uint8_t > > > rows;
+    db::streamByFilter< db::Orderbook >(conn_ptr,
+                                        filter,
+                                        [&rows](std::vector< db::Orderbook >& chunk)
+                                        {
+                                            for (const auto& row : chunk)
+                                            {
+                                                rows.emplace_back(row.getTimestamp(), row.getData());
+                                            }
+                                            return true;
+                                        });
+
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector< std::vector< uint8_t > > batches;
+    batches.reserve(rows.size());
+    for (auto& row : rows)
+    {
+        batches.push_back(std::move(row.second));
+    }
+
+    addOrderbookStream(exchange_name, symbol, std::move(batches), start_timestamp, finish_timestamp);
+}
+
+void ReplayEngine::loadTrades(std::shared_ptr< sqlpp::postgresql::connection > conn_ptr,
+                              const enums::ExchangeName& exchange_name,
+                              const std::string& symbol,
+                              int64_t start_timestamp,
+                              int64_t finish_timestamp)
+{
+    // Decoded from a binary result straight into the matrix, already ordered by timestamp
+    blaze::DynamicMatrix< double > trades(0, 6);
+    db::loadTradesBinary(conn_ptr, exchange_name, symbol, start_timestamp, finish_timestamp, trades);
+
+    addAggregatedTradeStream(exchange_name, symbol, std::move(trades));
+}
+
+void ReplayEngine::loadOrderbookFile(const std::filesystem::path& path,
+                                     const enums::ExchangeName& exchange_name,
+                                     const std::string& symbol,
+                                     int64_t start_timestamp,
+                                     int64_t finish_timestamp)
+{
+    auto in = openReplayFile(path, ORDERBOOK_FILE_MAGIC);
+
+    std::vector< std::vector< uint8_t > > batches;
+    while (in.peek() != std::ifstream::traits_type::eof())
+    {
+        auto length = readValue< uint32_t >(in, path);
+        std::vector< uint8_t > batch(length);
+        if (!in.read(reinterpret_cast< char* >(batch.data()), length))
+        {
+            throw std::runtime_error("Truncated replay file: " + path.string());
+        }
+        batches.push_back(std::move(batch));
+    }
+
+    addOrderbookStream(exchange_name, symbol, std::move(batches), start_timestamp, finish_timestamp);
+}
+
+void ReplayEngine::loadTradeFile(const std::filesystem::path& path,
+                                 const enums::ExchangeName& exchange_name,
+                                 const std::string& symbol)
+{
+    auto in   = openReplayFile(path, TRADE_FILE_MAGIC);
+    auto rows = readValue< uint64_t >(in, path);
+
+    blaze::DynamicMatrix< double > trades(rows, TRADE_FILE_COLUMNS);
+    std::vector< double > buffer(TRADE_FILE_COLUMNS);
+    for (size_t i = 0; i < rows; ++i)
+    {
+        if (!in.read(reinterpret_cast< char* >(buffer.data()), TRADE_FILE_COLUMNS * sizeof(double)))
+        {
+            throw std::runtime_error("Truncated replay file: " + path.string());
+        }
+        for (size_t j = 0; j < TRADE_FILE_COLUMNS; ++j)
+        {
+            trades(i, j) = buffer[j];
+        }
+    }
+
+    addTradeStream(exchange_name, symbol, std::move(trades));
+}
+
+void ReplayEngine::writeOrderbookFile(const std::filesystem::path& path,
+                                      const std::vector< std::vector< uint8_t > >& batches)
+{
+    auto out = createReplayFile(path, ORDERBOOK_FILE_MAGIC);
+    for (const auto& batch : batches)
+    {
+        writeValue(out, static_cast< uint32_t >(batch.size()));
+        out.write(reinterpret_cast< const char* >(batch.data()), batch.size());
+    }
+}
+
+void ReplayEngine::writeTradeFile(const std::filesystem::path& path, const blaze::DynamicMatrix< double >& trades)
+{
+    if (trades.rows() > 0 && trades.columns() < TRADE_FILE_COLUMNS)
+    {
+        throw std::invalid_argument("Trades must have at least 4 columns [timestamp, price, qty, side]");
+    }
+
+    auto out = createReplayFile(path, TRADE_FILE_MAGIC);
+    writeValue(out, static_cast< uint64_t >(trades.rows()));
+    for (size_t i = 0; i < trades.rows(); ++i)
+    {
+        for (size_t j = 0; j < TRADE_FILE_COLUMNS; ++j)
+        {
+            writeValue(out, trades(i, j));
+        }
+    }
+}
+
+void ReplayEngine::setSpeed(double speed)
+{
+    if (speed < 0)
+    {
+        throw std::invalid_argument("Replay speed must not be negative");
+    }
+    speed_ = speed;
+}
+
+bool ReplayEngine::advance(Stream& stream)
+{
+    if (stream.type_ != EventType::ORDERBOOK)
+    {
+        return stream.cursor_ < stream.trades_.rows();
+    }
+
+    while (true)
+    {
+        while (stream.cursor_ < stream.timestamps_.size())
+        {
+            auto timestamp = stream.timestamps_[stream.cursor_];
+            if (timestamp > stream.finish_timestamp_)
+            {
+                return false;
+            }
+            if (timestamp >= stream.start_timestamp_)
+            {
+                return true;
+            }
+            ++stream.cursor_;
+        }
+
+        if (stream.next_batch_ >= stream.batches_.size())
+        {
+            return false;
+        }
+
+        // Decode lazily, one batch at a time
+        stream.timestamps_.clear();
+        stream.snapshots_.clear();
+        stream.cursor_ = 0;
+        orderbook::OrderbookArchive::decodeBatch(
+            stream.batches_[stream.next_batch_++], stream.timestamps_, stream.snapshots_);
+    }
+}
+
+int64_t ReplayEngine::currentTimestamp(const Stream& stream) const
+{
+    if (stream.type_ == EventType::ORDERBOOK)
+    {
+        return stream.timestamps_[stream.cursor_];
+    }
+    return static_cast< int64_t >(stream.trades_(stream.cursor_, 0));
+}
+
+void ReplayEngine::apply(const Stream& stream)
+{
+    switch (stream.type_)
+    {
+        case EventType::ORDERBOOK:
+            orderbook::OrderbooksState::getInstance().addFormattedOrderbook(
+                stream.exchange_name_,
+                stream.symbol_,
+                stream.timestamps_[stream.cursor_],
+                stream.snapshots_[stream.cursor_]);
+            break;
+
+        case EventType::TRADE:
+        {
+            blaze::StaticVector< double, 6UL, blaze::rowVector > trade(0.0);
+            for (size_t j = 0; j < TRADE_FILE_COLUMNS; ++j)
+            {
+                trade[j] = stream.trades_(stream.cursor_, j);
+            }
+            trade::TradesState::getInstance().addTrade(trade, stream.exchange_name_, stream.symbol_);
+            break;
+        }
+
+        case EventType::AGGREGATED_TRADE:
+        {
+            blaze::StaticVector< double, 6UL, blaze::rowVector > trade;
+            for (size_t j = 0; j < 6; ++j)
+            {
+                trade[j] = stream.trades_(stream.cursor_, j);
+            }
+            trade::TradesState::getInstance().addAggregatedTrade(trade, stream.exchange_name_, stream.symbol_);
+            break;
+        }
+    }
+}
+
+size_t ReplayEngine::run()
+{
+    stopped_.store(false, std::memory_order_relaxed);
+
+    // Start every replayed pair from empty state
+    std::set< std::string > orderbookKeys;
+    std::set< std::string > tradeKeys;
+    for (const auto& stream : streams_)
+    {
+        auto key = helper::makeKey(stream.exchange_name_, stream.symbol_);
+        if (stream.type_ == EventType::ORDERBOOK && orderbookKeys.insert(key).second)
+        {
+            orderbook::OrderbooksState::getInstance().initSymbol(stream.exchange_name_, stream.symbol_);
+        }
+        else if (stream.type_ != EventType::ORDERBOOK && tradeKeys.insert(key).second)
+        {
+            trade::TradesState::getInstance().initSymbol(stream.exchange_name_, stream.symbol_);
+        }
+    }
+
+    // Min-heap of (next timestamp, stream index); ties keep stream registration order
+    using HeapItem = std::pair< int64_t, size_t >;
+    std::priority_queue< HeapItem, std::vector< HeapItem >, std::greater< HeapItem > > heap;
+    for (size_t i = 0; i < streams_.size(); ++i)
+    {
+        if (advance(streams_[i]))
+        {
+            heap.emplace(currentTimestamp(streams_[i]), i);
+        }
+    }
+
+    if (heap.empty())
+    {
+        return 0;
+    }
+
+    auto wallStart       = std::chrono::steady_clock::now();
+    auto firstTimestamp  = heap.top().first;
+    size_t eventsApplied = 0;
+
+    while (!heap.empty() && !stopped_.load(std::memory_order_relaxed))
+    {
+        auto [timestamp, index] = heap.top();
+        heap.pop();
+        auto& stream = streams_[index];
+
+        if (speed_ > 0)
+        {
+            auto offset = std::chrono::duration< double, std::milli >((timestamp - firstTimestamp) / speed_);
+            std::this_thread::sleep_until(wallStart +
+                                          std::chrono::duration_cast< std::chrono::steady_clock::duration >(offset));
+        }
+
+        apply(stream);
+        ++eventsApplied;
+
+        if (on_event_)
+        {
+            on_event_(ReplayEvent{timestamp, stream.type_, stream.exchange_name_, &stream.symbol_});
+        }
+
+        ++stream.cursor_;
+        if (advance(stream))
+        {
+            heap.emplace(currentTimestamp(stream), index);
+        }
+    }
+
+    std::ostringstream oss;
+    oss << "Replayed " << eventsApplied << " events from " << streams_.size() << " streams";
+    logger::LOG.info(oss.str());
+
+    return eventsApplied;
+}
+
+} // namespace replay
+} // namespace ct
@@ -0,0 +1,274 @@
+#include "StreamEngine.hpp"
+#include "Exchange.hpp"
+#include "Logger.hpp"
+#include "Order.hpp"
+#include "Position.hpp"
+
+namespace ct
+{
+namespace stream
+{
+
+namespace
+{
+
+// Polls of an empty queue before the engine thread starts sleeping between polls
+constexpr int IDLE_SPINS = 1000;
+
+constexpr auto IDLE_SLEEP = std::chrono::microseconds(50);
+
+std::shared_ptr< db::Order > findStreamOrder(const StreamEvent& event)
+{
+    const std::string exchangeId = event.data_.at("exchange_id").get< std::string >();
+
+    auto order =
+        order::OrdersState::getInstance().findOrderById(event.exchange_name_, event.symbol_, exchangeId, true);
+    if (!order)
+    {
+        throw std::runtime_error("No order with exchange id " + exchangeId + " for " +
+                                 enums::toString(event.exchange_name_) + " " + event.symbol_);
+    }
+
+    return order;
+}
+
+} // namespace
+
+StreamEngine::StreamEngine(size_t capacity) : queue_(capacity)
+{
+    setHandler(StreamEventType::BALANCE, applyBalance);
+    setHandler(StreamEventType::POSITION, applyPosition);
+    setHandler(StreamEventType::ORDER_EXECUTION, applyOrderExecution);
+    setHandler(StreamEventType::ORDER_CANCELLATION, applyOrderCancellation);
+}
+
+StreamEngine::~StreamEngine()
+{
+    stop();
+}
+
+int64_t StreamEngine::now()
+{
+    return std::chrono::duration_cast< std::chrono::nanoseconds >(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void StreamEngine::start()
+{
+    if (running_.exchange(true))
+    {
+        return;
+    }
+
+    thread_ = std::make_unique< std::thread >(&StreamEngine::run, this);
+}
+
+void StreamEngine::stop()
+{
+    running_.store(false, std::memory_order_release);
+
+    if (thread_ && thread_->joinable())
+    {
+        thread_->join();
+    }
+    thread_.reset();
+}
+
+void StreamEngine::post(StreamEvent event)
+{
+    if (event.received_at_ == 0)
+    {
+        event.received_at_ = now();
+    }
+
+    // tryPush leaves the event untouched when it fails, it can be offered again
+    while (!queue_.tryPush(std::move(event)))
+    {
+        // Nothing drains the queue, waiting would never end
+        if (!isRunning())
+        {
+            throw std::runtime_error("Stream event queue is full and the engine is not running");
+        }
+
+        queue_full_.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+    }
+}
+
+void StreamEngine::setHandler(StreamEventType type, Handler handler)
+{
+    if (isRunning())
+    {
+        throw std::logic_error("Stream handlers cannot be replaced while the engine is running");
+    }
+
+    handlers_[static_cast< size_t >(type)] = std::move(handler);
+}
+
+void StreamEngine::run()
+{
+    StreamEvent event;
+    int idle = 0;
+
+    // Keeps popping after stop until the queue is drained
+    while (true)
+    {
+        if (queue_.tryPop(event))
+        {
+            apply(event);
+            idle = 0;
+            continue;
+        }
+
+        if (!running_.load(std::memory_order_acquire))
+        {
+            break;
+        }
+
+        if (++idle < IDLE_SPINS)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(IDLE_SLEEP);
+        }
+    }
+}
+
+void StreamEngine::apply(const StreamEvent& event)
+{
+    const auto& handler = handlers_[static_cast< size_t >(event.type_)];
+
+    try
+    {
+        if (handler)
+        {
+            handler(event);
+        }
+        applied_.fetch_add(1, std::memory_order_relaxed);
+    }
+    catch (const std::exception& e)
+    {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        logger::LOG.error("Failed to apply stream event for " + enums::toString(event.exchange_name_) + " " +
+                          event.symbol_ + ": " + e.what());
+    }
+
+    int64_t latency = now() - event.received_at_;
+    recordLatency(latency > 0 ? static_cast< uint64_t >(latency) : 0);
+}
+
+void StreamEngine::recordLatency(uint64_t latency_ns)
+{
+    size_t bucket = 0;
+    for (uint64_t rest = latency_ns >> 1; rest != 0; rest >>= 1)
+    {
+        ++bucket;
+    }
+
+    latency_buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    latency_sum_ns_.fetch_add(latency_ns, std::memory_order_relaxed);
+
+    if (latency_ns > latency_max_ns_.load(std::memory_order_relaxed))
+    {
+        latency_max_ns_.store(latency_ns, std::memory_order_relaxed);
+    }
+}
+
+LatencyStats StreamEngine::getLatencyStats() const
+{
+    std::array< uint64_t, LATENCY_BUCKETS > buckets;
+    uint64_t count = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+    {
+        buckets[i] = latency_buckets_[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    LatencyStats stats;
+    if (count == 0)
+    {
+        return stats;
+    }
+
+    stats.count_   = count;
+    stats.mean_us_ = static_cast< double >(latency_sum_ns_.load(std::memory_order_relaxed)) / count / 1000.0;
+    stats.max_us_  = static_cast< double >(latency_max_ns_.load(std::memory_order_relaxed)) / 1000.0;
+
+    auto percentile = [&](double fraction)
+    {
+        uint64_t rank = static_cast< uint64_t >(std::ceil(fraction * count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                return std::ldexp(1.0, static_cast< int >(i) + 1) / 1000.0;
+            }
+        }
+        return stats.max_us_;
+    };
+
+    stats.p50_us_ = percentile(0.50);
+    stats.p99_us_ = percentile(0.99);
+    return stats;
+}
+
+void StreamEngine::applyBalance(const StreamEvent& event)
+{
+    auto exchange = exchange::ExchangesState::getInstance().getExchange(event.exchange_name_);
+
+    if (auto spot = std::dynamic_pointer_cast< exchange::SpotExchange >(exchange))
+    {
+        spot->onUpdateFromStream(event.data_);
+    }
+    else if (auto futures = std::dynamic_pointer_cast< exchange::FuturesExchange >(exchange))
+    {
+        futures->onUpdateFromStream(event.data_);
+    }
+    else
+    {
+        throw std::runtime_error("Exchange " + enums::toString(event.exchange_name_) +
+                                 " does not accept balance updates");
+    }
+}
+
+void StreamEngine::applyPosition(const StreamEvent& event)
+{
+    auto position = position::PositionsState::getInstance().getPosition(event.exchange_name_, event.symbol_);
+    if (!position)
+    {
+        throw std::runtime_error("No position for " + enums::toString(event.exchange_name_) + " " + event.symbol_);
+    }
+
+    position->onUpdateFromStream(event.data_, event.data_.value("is_initial", false));
+}
+
+void StreamEngine::applyOrderExecution(const StreamEvent& event)
+{
+    auto order = findStreamOrder(event);
+    if (!order->isActive())
+    {
+        return;
+    }
+
+    // Also applies the fill to the exchange and the position of the pair
+    order->execute();
+}
+
+void StreamEngine::applyOrderCancellation(const StreamEvent& event)
+{
+    auto order = findStreamOrder(event);
+    if (order->isCanceled())
+    {
+        return;
+    }
+
+    order->cancel(false, "stream");
+}
+
+} // namespace stream
+} // namespace ct
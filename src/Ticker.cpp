@@ -9,12 +9,27 @@ void ct::ticker::TickersState::init()
     {
         auto exchange = route["exchange_name"].get< enums::ExchangeName >();
         auto symbol   = route["symbol"].get< std::string >();
-        auto key      = helper::makeKey(exchange, symbol);
+        initSymbol(exchange, symbol);
+    }
+}
 
-        // Create a dynamic array with 60 rows and 5 columns, dropping at 120
-        std::array< size_t, 2 > shape = {60, 5};
-        storage_.at(key)              = std::make_shared< datastructure::DynamicBlazeArray< double > >(shape, 120);
+void ct::ticker::TickersState::initSymbol(const enums::ExchangeName& exchange_name,
+                                          const std::string& symbol,
+                                          size_t capacity)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("Ticker capacity must be positive");
+    }
+
+    TickerRing ring;
+    ring.capacity_ = capacity;
+    for (auto& column : ring.columns_)
+    {
+        column.assign(capacity, 0.0);
     }
+
+    storage_[helper::makeKey(exchange_name, symbol)] = std::move(ring);
 }
 
 void ct::ticker::TickersState::addTicker(const blaze::DynamicVector< double, blaze::rowVector >& ticker,
@@ -22,33 +37,81 @@ void ct::ticker::TickersState::addTicker(const blaze::DynamicVector< double, bla
                                          const std::string& symbol)
 {
     std::string key = helper::makeKey(exchange_name, symbol);
+    auto& ring      = storage_.at(key);
+
+    int64_t now        = helper::nowToTimestamp();
+    ring.last_updated_ = now;
 
     // Only process once per second
-    if (storage_.at(key)->size() == 0 || (helper::nowToTimestamp() - (*storage_.at(key))[-1][0]) >= 1000)
+    if (ring.size_ > 0 && now - ring.columns_[0][ring.physical(ring.size_ - 1)] < 1000)
+    {
+        return;
+    }
+
+    size_t slot;
+    if (ring.size_ == ring.capacity_)
     {
-        storage_.at(key)->append(ticker);
+        // Overwrite the oldest ticker
+        slot       = ring.head_;
+        ring.head_ = (ring.head_ + 1) % ring.capacity_;
     }
+    else
+    {
+        slot = ring.physical(ring.size_);
+        ++ring.size_;
+    }
+
+    size_t columns = std::min(TICKER_COLUMNS, static_cast< size_t >(ticker.size()));
+    for (size_t c = 0; c < TICKER_COLUMNS; ++c)
+    {
+        ring.columns_[c][slot] = c < columns ? ticker[c] : 0.0;
+    }
+}
+
+const ct::ticker::TickersState::TickerRing& ct::ticker::TickersState::getRing(const enums::ExchangeName& exchange_name,
+                                                                               const std::string& symbol) const
+{
+    return storage_.at(helper::makeKey(exchange_name, symbol));
+}
+
+blaze::StaticVector< double, ct::ticker::TICKER_COLUMNS, blaze::rowVector > ct::ticker::TickersState::rowAt(
+    const TickerRing& ring, size_t index) const
+{
+    size_t slot = ring.physical(index);
+
+    blaze::StaticVector< double, TICKER_COLUMNS, blaze::rowVector > row;
+    for (size_t c = 0; c < TICKER_COLUMNS; ++c)
+    {
+        row[c] = ring.columns_[c][slot];
+    }
+    return row;
 }
 
 blaze::DynamicMatrix< double > ct::ticker::TickersState::getTickers(const enums::ExchangeName& exchange_name,
                                                                     const std::string& symbol) const
 {
-    std::string key = helper::makeKey(exchange_name, symbol);
+    const auto& ring = getRing(exchange_name, symbol);
 
-    return storage_.at(key)->rows(0, storage_.at(key)->size());
+    blaze::DynamicMatrix< double > tickers(ring.size_, TICKER_COLUMNS);
+    for (size_t i = 0; i < ring.size_; ++i)
+    {
+        size_t slot = ring.physical(i);
+        for (size_t c = 0; c < TICKER_COLUMNS; ++c)
+        {
+            tickers(i, c) = ring.columns_[c][slot];
+        }
+    }
+    return tickers;
 }
 
-auto ct::ticker::TickersState::getCurrentTicker(const enums::ExchangeName& exchange_name,
-                                                const std::string& symbol) const
+blaze::StaticVector< double, ct::ticker::TICKER_COLUMNS, blaze::rowVector > ct::ticker::TickersState::getCurrentTicker(
+    const enums::ExchangeName& exchange_name, const std::string& symbol) const
 {
-    std::string key = helper::makeKey(exchange_name, symbol);
-
-    return storage_.at(key)->row(-1);
+    return getPastTicker(exchange_name, symbol, 0);
 }
 
-auto ct::ticker::TickersState::getPastTicker(const enums::ExchangeName& exchange_name,
-                                             const std::string& symbol,
-                                             int numberOfTickersAgo) const
+blaze::StaticVector< double, ct::ticker::TICKER_COLUMNS, blaze::rowVector > ct::ticker::TickersState::getPastTicker(
+    const enums::ExchangeName& exchange_name, const std::string& symbol, int numberOfTickersAgo) const
 {
     if (numberOfTickersAgo > 120)
     {
@@ -56,7 +119,48 @@ auto ct::ticker::TickersState::getPastTicker(const enums::ExchangeName& exchange
     }
 
     numberOfTickersAgo = std::abs(numberOfTickersAgo);
-    std::string key    = helper::makeKey(exchange_name, symbol);
+    const auto& ring   = getRing(exchange_name, symbol);
+
+    if (static_cast< size_t >(numberOfTickersAgo) >= ring.size_)
+    {
+        throw std::out_of_range("Not enough tickers stored for " + helper::makeKey(exchange_name, symbol));
+    }
+
+    return rowAt(ring, ring.size_ - 1 - numberOfTickersAgo);
+}
+
+size_t ct::ticker::TickersState::count(const enums::ExchangeName& exchange_name, const std::string& symbol) const
+{
+    return getRing(exchange_name, symbol).size_;
+}
+
+int64_t ct::ticker::TickersState::getLastUpdated(const enums::ExchangeName& exchange_name,
+                                                 const std::string& symbol) const
+{
+    return getRing(exchange_name, symbol).last_updated_;
+}
+
+bool ct::ticker::TickersState::isStale(const enums::ExchangeName& exchange_name,
+                                       const std::string& symbol,
+                                       int64_t max_age_ms,
+                                       std::optional< int64_t > now) const
+{
+    int64_t lastUpdated = getLastUpdated(exchange_name, symbol);
+    return lastUpdated == 0 || now.value_or(helper::nowToTimestamp()) - lastUpdated > max_age_ms;
+}
+
+std::vector< std::string > ct::ticker::TickersState::getStaleKeys(int64_t max_age_ms,
+                                                                  std::optional< int64_t > now) const
+{
+    int64_t reference = now.value_or(helper::nowToTimestamp());
 
-    return storage_.at(key)->row(-1 - numberOfTickersAgo);
+    std::vector< std::string > keys;
+    for (const auto& [key, ring] : storage_)
+    {
+        if (ring.last_updated_ == 0 || reference - ring.last_updated_ > max_age_ms)
+        {
+            keys.push_back(key);
+        }
+    }
+    return keys;
 }
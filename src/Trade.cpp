@@ -5,6 +5,7 @@
 #include "Helper.hpp"
 #include "Position.hpp"
 #include "Route.hpp"
+#include "WriteBehind.hpp"
 
 namespace ct
 {
@@ -18,79 +19,119 @@ void TradesState::init()
     {
         auto exchange_name = route["exchange_name"].get< enums::ExchangeName >();
         auto symbol        = route["symbol"].get< std::string >();
-        std::string key    = helper::makeKey(exchange_name, symbol);
-
-        // Create a dynamic array with 60 rows and 6 columns, dropping at 120
-        std::array< size_t, 2 > storageShape = {60, 6};
-        storage_.at(key) = std::make_shared< datastructure::DynamicBlazeArray< double > >(storageShape, 120);
-
-        // Create a temporary storage with 100 rows and 4 columns
-        std::array< size_t, 2 > tempShape = {100, 4};
-        temp_storage_.at(key)             = std::make_shared< datastructure::DynamicBlazeArray< double > >(tempShape);
+        initSymbol(exchange_name, symbol);
     }
 }
 
-void TradesState::addTrade(const blaze::StaticVector< double, 6UL, blaze::rowVector >& trade,
-                           const enums::ExchangeName& exchange_name,
-                           const std::string& symbol)
+void TradesState::initSymbol(const enums::ExchangeName& exchange_name, const std::string& symbol)
 {
     std::string key = helper::makeKey(exchange_name, symbol);
 
-    // Check if we need to aggregate trades
-    if (temp_storage_.at(key)->size() > 0 && trade[0] - (*temp_storage_.at(key))[0][0] >= 1000)
-    {
-        const auto& arr = *temp_storage_.at(key);
-
-        const size_t TIMESTAMP_COL        = 0;
-        const size_t PRICE_COL            = 1;
-        const size_t QTY_COL              = 2;
-        const size_t ORDER_SIDE_COL_INDEX = 3;
-
-        auto timestamp = arr[0][TIMESTAMP_COL];
+    // Create a dynamic array with 60 rows and 6 columns, dropping at 120
+    std::array< size_t, 2 > storageShape = {60, 6};
+    storage_[key] = std::make_shared< datastructure::DynamicBlazeArray< double > >(storageShape, 120);
 
-        auto buyTrades  = arr.filter(ORDER_SIDE_COL_INDEX, 1);
-        auto sellTrades = arr.filter(ORDER_SIDE_COL_INDEX, 0);
+    accumulators_[key] = TradeAccumulator{};
 
-        double avgPrice = arr.applyFunction(
-            [](const blaze::DynamicMatrix< double > data)
-            {
-                auto col1 = blaze::column(data, PRICE_COL);
-                auto col2 = blaze::column(data, QTY_COL);
+    if (auto it = tapes_.find(key); it != tapes_.end())
+    {
+        it->second->clear();
+    }
+}
 
-                // Compute element-wise product and its sum
-                auto turnOver = blaze::sum(col1 * col2);
+void TradesState::enableTape(const enums::ExchangeName& exchange_name,
+                             const std::string& symbol,
+                             size_t capacity,
+                             int64_t retention_ms)
+{
+    std::string key = helper::makeKey(exchange_name, symbol);
+    tapes_[key]     = std::make_unique< TradeTape >(capacity, retention_ms);
+}
 
-                // Compute sum of column 2
-                auto qtySum = blaze::sum(col2);
+const TradeTape& TradesState::getTape(const enums::ExchangeName& exchange_name, const std::string& symbol) const
+{
+    std::string key = helper::makeKey(exchange_name, symbol);
+    auto it         = tapes_.find(key);
+    if (it == tapes_.end())
+    {
+        throw std::runtime_error("Trade tape is not enabled for " + key);
+    }
+    return *it->second;
+}
 
-                // Check for division by zero
-                if (qtySum == 0)
-                {
-                    throw std::runtime_error("Sum of quantities is zero");
-                }
+void TradesState::addTrade(const blaze::StaticVector< double, 6UL, blaze::rowVector >& trade,
+                           const enums::ExchangeName& exchange_name,
+                           const std::string& symbol)
+{
+    const size_t TIMESTAMP_COL        = 0;
+    const size_t PRICE_COL            = 1;
+    const size_t QTY_COL              = 2;
+    const size_t ORDER_SIDE_COL_INDEX = 3;
 
-                return turnOver / qtySum;
-            });
+    std::string key = helper::makeKey(exchange_name, symbol);
+    auto& acc       = accumulators_.at(key);
 
-        auto buyQty  = blaze::sum(blaze::column(buyTrades, QTY_COL));
-        auto sellQty = blaze::sum(blaze::column(sellTrades, QTY_COL));
+    // Emit the aggregate once a trade arrives at least one second after the first trade of the bucket
+    if (acc.count_ > 0 && trade[TIMESTAMP_COL] - acc.first_timestamp_ >= 1000)
+    {
+        // Check for division by zero
+        if (acc.qty_ == 0)
+        {
+            throw std::runtime_error("Sum of quantities is zero");
+        }
 
         blaze::StaticVector< double, 6UL, blaze::rowVector > generated{
-            timestamp,
-            avgPrice,
-            static_cast< double >(buyQty),
-            static_cast< double >(sellQty),
-            static_cast< double >(buyTrades.rows()),
-            static_cast< double >(sellTrades.rows()),
+            acc.first_timestamp_,
+            acc.turnover_ / acc.qty_,
+            acc.buy_qty_,
+            acc.sell_qty_,
+            static_cast< double >(acc.buy_count_),
+            static_cast< double >(acc.sell_count_),
         };
 
-        // Append to storage and clear temp storage
         storage_.at(key)->append(generated);
-        temp_storage_.at(key)->flush();
+        acc = TradeAccumulator{};
+    }
+
+    // Taped only once the trade is accepted, a rejected trade must not show up in the tape
+    if (!tapes_.empty())
+    {
+        if (auto it = tapes_.find(key); it != tapes_.end())
+        {
+            it->second->append(static_cast< int64_t >(trade[TIMESTAMP_COL]),
+                               trade[PRICE_COL],
+                               trade[QTY_COL],
+                               trade[ORDER_SIDE_COL_INDEX]);
+        }
+    }
+
+    // Fold the trade into the running totals
+    if (acc.count_ == 0)
+    {
+        acc.first_timestamp_ = trade[TIMESTAMP_COL];
     }
+    ++acc.count_;
+    acc.turnover_ += trade[PRICE_COL] * trade[QTY_COL];
+    acc.qty_ += trade[QTY_COL];
 
-    // Add the trade to temporary storage
-    temp_storage_.at(key)->append(trade);
+    if (trade[ORDER_SIDE_COL_INDEX] == 1)
+    {
+        acc.buy_qty_ += trade[QTY_COL];
+        ++acc.buy_count_;
+    }
+    else if (trade[ORDER_SIDE_COL_INDEX] == 0)
+    {
+        acc.sell_qty_ += trade[QTY_COL];
+        ++acc.sell_count_;
+    }
+}
+
+void TradesState::addAggregatedTrade(const blaze::StaticVector< double, 6UL, blaze::rowVector >& trade,
+                                     const enums::ExchangeName& exchange_name,
+                                     const std::string& symbol)
+{
+    std::string key = helper::makeKey(exchange_name, symbol);
+    storage_.at(key)->append(trade);
 }
 
 blaze::DynamicMatrix< double > TradesState::getTrades(const enums::ExchangeName& exchange_name,
@@ -236,10 +277,12 @@ void ClosedTradesState::closeTrade(const position::Position& position)
 
     // TODO:
     // position.getStrategy().incrementTradesCount();
-    // if (helper::isLiveTrading())
-    // {
-    //    store_completed_trade_into_db(t)
-    // }
+
+    if (helper::isLiveTrading())
+    {
+        // Closing a trade does not wait for the database
+        db::WriteBehind::getInstance().enqueue(trade);
+    }
 
     // Store the trade into the list
     trades_.push_back(trade);
@@ -0,0 +1,203 @@
+#include "TradeTape.hpp"
+
+namespace ct
+{
+namespace trade
+{
+
+TradeTape::TradeTape(size_t capacity, int64_t retention_ms)
+    : capacity_(capacity)
+    , retention_ms_(retention_ms)
+    , timestamps_(capacity)
+    , prices_(capacity)
+    , qtys_(capacity)
+    , sides_(capacity)
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("Trade tape capacity must be positive");
+    }
+    if (retention_ms < 0)
+    {
+        throw std::invalid_argument("Trade tape retention must not be negative");
+    }
+}
+
+size_t TradeTape::physical(size_t index) const
+{
+    if (index >= size_)
+    {
+        throw std::out_of_range("Trade tape index out of range");
+    }
+    return (head_ + index) % capacity_;
+}
+
+void TradeTape::dropOldest()
+{
+    head_ = (head_ + 1) % capacity_;
+    --size_;
+}
+
+void TradeTape::append(int64_t timestamp, double price, double qty, double side)
+{
+    if (size_ > 0)
+    {
+        // Keep timestamps sorted so range() can binary search
+        timestamp = std::max(timestamp, getTimestamp(size_ - 1));
+    }
+
+    if (size_ == capacity_)
+    {
+        dropOldest();
+    }
+
+    size_t slot       = (head_ + size_) % capacity_;
+    timestamps_[slot] = timestamp;
+    prices_[slot]     = price;
+    qtys_[slot]       = qty;
+    sides_[slot]      = side;
+    ++size_;
+
+    if (retention_ms_ > 0)
+    {
+        while (size_ > 1 && timestamp - timestamps_[head_] > retention_ms_)
+        {
+            dropOldest();
+        }
+    }
+}
+
+void TradeTape::clear()
+{
+    head_ = 0;
+    size_ = 0;
+}
+
+std::pair< size_t, size_t > TradeTape::range(int64_t start_timestamp, int64_t finish_timestamp) const
+{
+    if (size_ == 0 || start_timestamp > finish_timestamp)
+    {
+        return {0, 0};
+    }
+
+    // First index whose timestamp satisfies the predicate, over the logical (oldest first) order
+    auto lowerBound = [this](auto predicate)
+    {
+        size_t lo = 0;
+        size_t hi = size_;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (predicate(timestamps_[(head_ + mid) % capacity_]))
+            {
+                hi = mid;
+            }
+            else
+            {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    };
+
+    size_t first = lowerBound([start_timestamp](int64_t ts) { return ts >= start_timestamp; });
+    size_t last  = lowerBound([finish_timestamp](int64_t ts) { return ts > finish_timestamp; });
+    return {first, last};
+}
+
+blaze::DynamicMatrix< double > TradeTape::getTrades(int64_t start_timestamp, int64_t finish_timestamp) const
+{
+    auto [first, last] = range(start_timestamp, finish_timestamp);
+
+    blaze::DynamicMatrix< double > trades(last - first, 4);
+    for (size_t i = first; i < last; ++i)
+    {
+        size_t slot          = (head_ + i) % capacity_;
+        trades(i - first, 0) = static_cast< double >(timestamps_[slot]);
+        trades(i - first, 1) = prices_[slot];
+        trades(i - first, 2) = qtys_[slot];
+        trades(i - first, 3) = sides_[slot];
+    }
+    return trades;
+}
+
+double TradeTape::vwap(int64_t start_timestamp, int64_t finish_timestamp) const
+{
+    auto [first, last] = range(start_timestamp, finish_timestamp);
+
+    double turnover = 0;
+    double qty      = 0;
+    for (size_t i = first; i < last; ++i)
+    {
+        size_t slot = (head_ + i) % capacity_;
+        turnover += prices_[slot] * qtys_[slot];
+        qty += qtys_[slot];
+    }
+
+    return qty == 0 ? std::numeric_limits< double >::quiet_NaN() : turnover / qty;
+}
+
+TapeVolume TradeTape::volume(int64_t start_timestamp, int64_t finish_timestamp) const
+{
+    auto [first, last] = range(start_timestamp, finish_timestamp);
+
+    TapeVolume result;
+    for (size_t i = first; i < last; ++i)
+    {
+        size_t slot = (head_ + i) % capacity_;
+        if (sides_[slot] == 1)
+        {
+            result.buy_qty_ += qtys_[slot];
+            ++result.buy_count_;
+        }
+        else if (sides_[slot] == 0)
+        {
+            result.sell_qty_ += qtys_[slot];
+            ++result.sell_count_;
+        }
+    }
+    return result;
+}
+
+blaze::DynamicMatrix< double > TradeTape::volumeProfile(int64_t start_timestamp,
+                                                        int64_t finish_timestamp,
+                                                        double price_step) const
+{
+    if (price_step <= 0)
+    {
+        throw std::invalid_argument("Price step must be positive");
+    }
+
+    auto [first, last] = range(start_timestamp, finish_timestamp);
+
+    // Keyed by level index so neighbouring prices never split because of rounding
+    std::map< int64_t, std::pair< double, double > > levels;
+    for (size_t i = first; i < last; ++i)
+    {
+        size_t slot  = (head_ + i) % capacity_;
+        auto level   = static_cast< int64_t >(std::floor(prices_[slot] / price_step));
+        auto& bucket = levels[level];
+        if (sides_[slot] == 1)
+        {
+            bucket.first += qtys_[slot];
+        }
+        else if (sides_[slot] == 0)
+        {
+            bucket.second += qtys_[slot];
+        }
+    }
+
+    blaze::DynamicMatrix< double > profile(levels.size(), 3);
+    size_t row = 0;
+    for (const auto& [level, qty] : levels)
+    {
+        profile(row, 0) = static_cast< double >(level) * price_step;
+        profile(row, 1) = qty.first;
+        profile(row, 2) = qty.second;
+        ++row;
+    }
+    return profile;
+}
+
+} // namespace trade
+} // namespace ct
@@ -0,0 +1,441 @@
+#include "WriteBehind.hpp"
+#include "BulkCopy.hpp"
+#include "Logger.hpp"
+
+namespace ct
+{
+namespace db
+{
+
+namespace
+{
+
+template < typename ModelType >
+using PendingRows = std::vector< std::pair< ModelType, bool > >;
+
+std::string getRowKey(const Candle& candle)
+{
+    return enums::toString(candle.getExchangeName()) + "|" + candle.getSymbol() + "|" +
+           timeframe::toString(candle.getTimeframe()) + "|" + std::to_string(candle.getTimestamp());
+}
+
+template < typename ModelType >
+std::string getRowKey(const ModelType& model)
+{
+    return model.getIdAsString();
+}
+
+/**
+ * @brief Keep only the last write of every row, in the order of those last writes
+ */
+template < typename ModelType >
+void coalesce(PendingRows< ModelType >& rows)
+{
+    std::unordered_map< std::string, size_t > last;
+    last.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        last[getRowKey(rows[i].first)] = i;
+    }
+
+    if (last.size() == rows.size())
+    {
+        return;
+    }
+
+    PendingRows< ModelType > kept;
+    kept.reserve(last.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        if (last[getRowKey(rows[i].first)] == i)
+        {
+            kept.push_back(std::move(rows[i]));
+        }
+    }
+    rows.swap(kept);
+}
+
+void copyCandleRows(std::shared_ptr< sqlpp::postgresql::connection > conn,
+                    const PendingRows< Candle >& rows,
+                    bool update_on_conflict)
+{
+    auto it = rows.begin();
+    copyRows(
+        conn,
+        CopyTable::CANDLES,
+        [&](BinaryCopyWriter& writer)
+        {
+            while (it != rows.end() && it->second != update_on_conflict)
+            {
+                ++it;
+            }
+            if (it == rows.end())
+            {
+                return false;
+            }
+
+            // The id of the model is kept so a later save of it finds the row
+            const Candle& candle = it->first;
+            writer.beginRow(10);
+            writer.writeUuid(candle.getId());
+            writer.writeInt64(candle.getTimestamp());
+            writer.writeDouble(candle.getOpen());
+            writer.writeDouble(candle.getClose());
+            writer.writeDouble(candle.getHigh());
+            writer.writeDouble(candle.getLow());
+            writer.writeDouble(candle.getVolume());
+            writer.writeText(enums::toString(candle.getExchangeName()));
+            writer.writeText(candle.getSymbol());
+            writer.writeText(timeframe::toString(candle.getTimeframe()));
+            ++it;
+            return true;
+        },
+        update_on_conflict ? CopyConflict::UPDATE : CopyConflict::IGNORE);
+}
+
+void storeRows(std::shared_ptr< sqlpp::postgresql::connection > conn, PendingRows< Candle >& rows)
+{
+    bool updates = std::any_of(rows.begin(), rows.end(), [](const auto& row) { return row.second; });
+    bool inserts = std::any_of(rows.begin(), rows.end(), [](const auto& row) { return !row.second; });
+
+    if (updates)
+    {
+        copyCandleRows(conn, rows, true);
+    }
+    if (inserts)
+    {
+        copyCandleRows(conn, rows, false);
+    }
+}
+
+template < typename ModelType >
+void storeRows(std::shared_ptr< sqlpp::postgresql::connection > conn, PendingRows< ModelType >& rows)
+{
+    // One commit for the whole batch, the upserts reuse their prepared statements
+    auto tx = sqlpp::start_transaction(*conn);
+    for (auto& [model, update_on_conflict] : rows)
+    {
+        model.save(conn, update_on_conflict);
+    }
+    tx.commit();
+}
+
+/**
+ * @brief Swap a broken connection for a new one, keep it if the pool has none to give
+ */
+void renewIfBroken(std::shared_ptr< sqlpp::postgresql::connection >& conn)
+{
+    try
+    {
+        conn->execute("SELECT 1");
+        return;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Write-behind connection is broken, checking out a new one: " << e.what();
+        logger::LOG.error(oss.str());
+    }
+
+    try
+    {
+        conn = Database::getInstance().getConnection();
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Cannot replace the write-behind connection: " << e.what();
+        logger::LOG.error(oss.str());
+    }
+}
+
+} // namespace
+
+WriteBehindStats WriteBehindLane::getStats() const
+{
+    WriteBehindStats stats;
+    stats.depth_     = size();
+    stats.max_depth_ = max_depth_.load(std::memory_order_relaxed);
+    stats.capacity_  = capacity_;
+    stats.enqueued_  = enqueued_.load(std::memory_order_relaxed);
+    stats.written_   = written_.load(std::memory_order_relaxed);
+    stats.failed_    = failed_.load(std::memory_order_relaxed);
+    stats.batches_   = batches_.load(std::memory_order_relaxed);
+    stats.coalesced_ = coalesced_.load(std::memory_order_relaxed);
+    stats.rejected_  = rejected_.load(std::memory_order_relaxed);
+    stats.stalls_    = stalls_.load(std::memory_order_relaxed);
+    stats.stall_ns_  = stall_ns_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void WriteBehindLane::onEnqueued(size_t depth)
+{
+    enqueued_.fetch_add(1);
+
+    size_t max = max_depth_.load(std::memory_order_relaxed);
+    while (depth > max && !max_depth_.compare_exchange_weak(max, depth, std::memory_order_relaxed))
+    {
+    }
+}
+
+void WriteBehindLane::onStalled(uint64_t ns)
+{
+    stalls_.fetch_add(1, std::memory_order_relaxed);
+    stall_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void WriteBehindLane::onRejected()
+{
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WriteBehindLane::onWritten(uint64_t written, uint64_t coalesced)
+{
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    coalesced_.fetch_add(coalesced);
+    written_.fetch_add(written);
+}
+
+void WriteBehindLane::onFailed(uint64_t failed)
+{
+    failed_.fetch_add(failed);
+}
+
+template < typename ModelType >
+size_t ModelWriteLane< ModelType >::writeBatch(std::shared_ptr< sqlpp::postgresql::connection >& conn, size_t max)
+{
+    PendingRows< ModelType > rows;
+    PendingWrite pending;
+    while (rows.size() < max && queue_.tryPop(pending))
+    {
+        rows.emplace_back(std::move(*pending.model_), pending.update_on_conflict_);
+        pending.model_.reset();
+    }
+
+    const size_t taken = rows.size();
+    if (taken == 0)
+    {
+        return 0;
+    }
+
+    coalesce(rows);
+    const size_t coalesced = taken - rows.size();
+
+    try
+    {
+        storeRows(conn, rows);
+        onWritten(rows.size(), coalesced);
+        return taken;
+    }
+    catch (const std::exception& e)
+    {
+        std::ostringstream oss;
+        oss << "Error writing a batch of " << rows.size() << " " << getName() << ", retrying row by row: " << e.what();
+        logger::LOG.error(oss.str());
+    }
+
+    renewIfBroken(conn);
+
+    // Row by row, so a single bad row does not cost the rest of the batch
+    size_t written = 0;
+    for (auto& [model, update_on_conflict] : rows)
+    {
+        try
+        {
+            model.save(conn, update_on_conflict);
+            ++written;
+        }
+        catch (const std::exception& e)
+        {
+            std::ostringstream oss;
+            oss << "Dropping a write of " << getName() << ": " << e.what();
+            logger::LOG.error(oss.str());
+        }
+    }
+
+    onWritten(written, coalesced);
+    onFailed(rows.size() - written);
+    return taken;
+}
+
+template class ModelWriteLane< Candle >;
+template class ModelWriteLane< Order >;
+template class ModelWriteLane< ClosedTrade >;
+template class ModelWriteLane< Log >;
+template class ModelWriteLane< DailyBalance >;
+
+WriteBehind& WriteBehind::getInstance()
+{
+    static WriteBehind instance;
+    return instance;
+}
+
+WriteBehind::~WriteBehind()
+{
+    stop();
+}
+
+void WriteBehind::start(size_t writers, size_t capacity, size_t batch_size, std::chrono::milliseconds interval)
+{
+    if (writers == 0 || batch_size == 0)
+    {
+        throw std::invalid_argument("Write-behind needs at least one writer and a batch size of at least 1");
+    }
+
+    std::lock_guard< std::mutex > lifecycle(lifecycle_mutex_);
+
+    if (running_.load())
+    {
+        throw std::runtime_error("Write-behind is already running");
+    }
+
+    lanes_ = std::make_tuple(std::make_unique< ModelWriteLane< Candle > >("candles", capacity),
+                             std::make_unique< ModelWriteLane< Order > >("orders", capacity),
+                             std::make_unique< ModelWriteLane< ClosedTrade > >("closed_trades", capacity),
+                             std::make_unique< ModelWriteLane< Log > >("logs", capacity),
+                             std::make_unique< ModelWriteLane< DailyBalance > >("daily_balances", capacity));
+    all_lanes_ = {&getLane< Candle >(),
+                  &getLane< Order >(),
+                  &getLane< ClosedTrade >(),
+                  &getLane< Log >(),
+                  &getLane< DailyBalance >()};
+
+    // Check out every connection first, so a failure leaves nothing running
+    std::vector< std::shared_ptr< sqlpp::postgresql::connection > > connections;
+    for (size_t i = 0; i < std::min(writers, all_lanes_.size()); ++i)
+    {
+        connections.push_back(Database::getInstance().getConnection());
+    }
+
+    writer_count_ = connections.size();
+    batch_size_   = batch_size;
+    interval_     = interval;
+    stopping_.store(false);
+    running_.store(true);
+
+    for (size_t i = 0; i < connections.size(); ++i)
+    {
+        writers_.emplace_back(&WriteBehind::runWriter, this, i, std::move(connections[i]));
+    }
+
+    if (!hook_registered_)
+    {
+        // Queued writes are stored before the pool waits for its connections to come back
+        DatabaseShutdownManager::getInstance().registerShutdownHook([] { WriteBehind::getInstance().stop(); });
+        hook_registered_ = true;
+    }
+}
+
+void WriteBehind::stop()
+{
+    std::lock_guard< std::mutex > lifecycle(lifecycle_mutex_);
+    if (!running_.load())
+    {
+        return;
+    }
+
+    // New writes are saved synchronously from now on, the ones being queued are waited for. A producer may be
+    // waiting for room, so the writers keep draining meanwhile.
+    running_.store(false);
+    while (producers_.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        stopping_.store(true);
+    }
+    wake_.notify_all();
+
+    for (auto& writer : writers_)
+    {
+        writer.join();
+    }
+    writers_.clear();
+
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+    }
+    written_.notify_all();
+}
+
+void WriteBehind::flush()
+{
+    std::unique_lock< std::mutex > lock(mutex_);
+    if (!running_.load())
+    {
+        return;
+    }
+
+    // Only what is queued now is waited for, producers may keep going
+    std::vector< uint64_t > targets;
+    for (auto* lane : all_lanes_)
+    {
+        targets.push_back(lane->getStats().enqueued_);
+    }
+
+    wake_.notify_all();
+    written_.wait(lock,
+                  [&]
+                  {
+                      for (size_t i = 0; i < all_lanes_.size(); ++i)
+                      {
+                          auto stats = all_lanes_[i]->getStats();
+                          if (stats.written_ + stats.coalesced_ + stats.failed_ < targets[i])
+                          {
+                              return false;
+                          }
+                      }
+                      return true;
+                  });
+}
+
+void WriteBehind::wake()
+{
+    wake_.notify_all();
+}
+
+void WriteBehind::runWriter(size_t index, std::shared_ptr< sqlpp::postgresql::connection > conn)
+{
+    // Every queue has a single consumer, the queues are dealt out to the writers
+    std::vector< WriteBehindLane* > owned;
+    for (size_t i = index; i < all_lanes_.size(); i += writer_count_)
+    {
+        owned.push_back(all_lanes_[i]);
+    }
+
+    auto isBacklogged = [&]
+    {
+        return std::any_of(owned.begin(), owned.end(), [this](auto* lane) { return lane->size() >= batch_size_; });
+    };
+
+    while (true)
+    {
+        // Nothing is queued anymore once stopping is set, so the drain after reading it is the last one
+        bool stopping = stopping_.load();
+
+        for (auto* lane : owned)
+        {
+            while (lane->writeBatch(conn, batch_size_) > 0)
+            {
+                // Taking the lock orders the counter updates before a flush checks them
+                {
+                    std::lock_guard< std::mutex > lock(mutex_);
+                }
+                written_.notify_all();
+            }
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+
+        std::unique_lock< std::mutex > lock(mutex_);
+        wake_.wait_for(lock, interval_, [&] { return stopping_.load() || isBacklogged(); });
+    }
+}
+
+} // namespace db
+} // namespace ct
@@ -0,0 +1,76 @@
+#include "BulkCopy.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+std::vector< uint8_t > bytesOf(const ct::db::BinaryCopyWriter& writer)
+{
+    return std::vector< uint8_t >(writer.data(), writer.data() + writer.size());
+}
+
+} // namespace
+
+TEST(BinaryCopyWriterTest, HeaderAndTrailer)
+{
+    ct::db::BinaryCopyWriter writer;
+
+    const std::vector< uint8_t > header{
+        'P', 'G', 'C', 'O', 'P', 'Y', '\n', 0xFF, '\r', '\n', 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    EXPECT_EQ(bytesOf(writer), header);
+
+    writer.clear();
+    writer.finish();
+    EXPECT_EQ(bytesOf(writer), (std::vector< uint8_t >{0xFF, 0xFF}));
+    EXPECT_EQ(writer.countRows(), 0);
+}
+
+TEST(BinaryCopyWriterTest, EncodesFieldsInNetworkOrder)
+{
+    ct::db::BinaryCopyWriter writer;
+    writer.clear();
+
+    writer.beginRow(6);
+    writer.writeInt64(1625184000000);
+    writer.writeDouble(1.5);
+    writer.writeInt32(-2);
+    writer.writeText("BTC");
+    writer.writeNull();
+    writer.writeUuid(boost::uuids::string_generator()("0123abcd-4567-89ef-0123-456789abcdef"));
+
+    std::vector< uint8_t > expected{0, 6};
+    // 1625184000000 = 0x0000017A_6483D800
+    expected.insert(expected.end(), {0, 0, 0, 8, 0x00, 0x00, 0x01, 0x7A, 0x64, 0x83, 0xD8, 0x00});
+    expected.insert(expected.end(), {0, 0, 0, 8, 0x3F, 0xF8, 0, 0, 0, 0, 0, 0});
+    expected.insert(expected.end(), {0, 0, 0, 4, 0xFF, 0xFF, 0xFF, 0xFE});
+    expected.insert(expected.end(), {0, 0, 0, 3, 'B', 'T', 'C'});
+    expected.insert(expected.end(), {0xFF, 0xFF, 0xFF, 0xFF});
+    expected.insert(expected.end(), {0, 0, 0, 36});
+    const std::string uuid = "0123abcd-4567-89ef-0123-456789abcdef";
+    expected.insert(expected.end(), uuid.begin(), uuid.end());
+
+    EXPECT_EQ(bytesOf(writer), expected);
+    EXPECT_EQ(writer.countRows(), 1);
+}
+
+TEST(BinaryCopyWriterTest, CandleRowsFollowTheTableLayout)
+{
+    blaze::DynamicMatrix< double > candles{{1625184000000, 100, 101, 102, 99, 5}};
+
+    ct::db::BinaryCopyWriter writer;
+    writer.clear();
+    ct::db::detail::writeCandleRow(writer, blaze::row(candles, 0), "Binance Spot", "BTC-USDT", "1m");
+
+    auto bytes = bytesOf(writer);
+    ASSERT_GE(bytes.size(), 2);
+    EXPECT_EQ(bytes[0], 0);
+    EXPECT_EQ(bytes[1], 10);
+
+    // Field count, id, timestamp, five doubles and the three text columns
+    size_t size = 2 + (4 + 36) + (4 + 8) + 5 * (4 + 8) + (4 + 12) + (4 + 8) + (4 + 2);
+    EXPECT_EQ(bytes.size(), size);
+
+    // The timeframe closes the row
+    EXPECT_EQ(std::string(bytes.end() - 2, bytes.end()), "1m");
+}
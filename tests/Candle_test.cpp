@@ -353,3 +353,32 @@ TEST_F(GetNextCandleTimestampTest, InvalidTimeframe)
     ct::timeframe::Timeframe invalid_timeframe = static_cast< ct::timeframe::Timeframe >(-1);
     EXPECT_THROW(ct::candle::getNextCandleTimestamp(baseCandle, invalid_timeframe), ct::exception::InvalidTimeframe);
 }
+
+TEST(SplitCandleTest, FollowsBullishPath)
+{
+    // open -> low -> high -> close
+    blaze::DynamicVector< double, blaze::rowVector > candle{0, 100, 110, 115, 95, 10};
+
+    EXPECT_TRUE(ct::candle::candleIncludesPrice(candle, 95));
+    EXPECT_FALSE(ct::candle::candleIncludesPrice(candle, 116));
+
+    auto [earlier, later] = ct::candle::splitCandle(candle, 98);
+    EXPECT_EQ(earlier, (blaze::DynamicVector< double, blaze::rowVector >{0, 100, 98, 100, 98, 10}));
+    EXPECT_EQ(later, (blaze::DynamicVector< double, blaze::rowVector >{0, 98, 110, 115, 95, 10}));
+
+    std::tie(earlier, later) = ct::candle::splitCandle(candle, 112);
+    EXPECT_EQ(earlier, (blaze::DynamicVector< double, blaze::rowVector >{0, 100, 112, 112, 95, 10}));
+    EXPECT_EQ(later, (blaze::DynamicVector< double, blaze::rowVector >{0, 112, 110, 115, 110, 10}));
+
+    EXPECT_THROW(ct::candle::splitCandle(candle, 120), std::invalid_argument);
+}
+
+TEST(SplitCandleTest, FollowsBearishPath)
+{
+    // open -> high -> low -> close
+    blaze::DynamicVector< double, blaze::rowVector > candle{0, 100, 90, 105, 85, 10};
+
+    auto [earlier, later] = ct::candle::splitCandle(candle, 95);
+    EXPECT_EQ(earlier, (blaze::DynamicVector< double, blaze::rowVector >{0, 100, 95, 105, 95, 10}));
+    EXPECT_EQ(later, (blaze::DynamicVector< double, blaze::rowVector >{0, 95, 90, 95, 85, 10}));
+}
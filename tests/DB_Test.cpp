@@ -1,8 +1,10 @@
+#include "BulkCopy.hpp"
 #include "DB.hpp"
 #include "Config.hpp"
 #include "Enum.hpp"
 #include "Logger.hpp"
 #include "Timeframe.hpp"
+#include "WriteBehind.hpp"
 
 #include <gtest/gtest.h>
 
@@ -368,6 +370,65 @@ TEST_F(DBTest, ConnectionPoolEdgeCases)
     ASSERT_NE(conn4, nullptr);
 }
 
+// Test connection pool metrics, thread affinity and background health checks
+TEST_F(DBTest, ConnectionPoolStatsAndHealthChecks)
+{
+    auto& pool = ct::db::ConnectionPool::getInstance();
+    pool.setMaxConnections(10);
+    EXPECT_THROW(pool.setMaxConnections(0), std::invalid_argument);
+    EXPECT_THROW(pool.setMaxConnections(ct::db::ConnectionPool::MAX_SLOTS + 1), std::invalid_argument);
+
+    auto countWaits = [](const ct::db::ConnectionPoolStats& stats)
+    {
+        uint64_t count = 0;
+        for (auto bucket : stats.wait_buckets_)
+        {
+            count += bucket;
+        }
+        return count;
+    };
+
+    auto before = pool.getStats();
+
+    // A thread gets the connection it used last back, with the statements it prepared on it
+    sqlpp::postgresql::connection* first = nullptr;
+    {
+        auto conn = pool.getConnection();
+        first     = conn.get();
+        EXPECT_EQ(pool.getStats().active_, before.active_ + 1);
+    }
+    {
+        auto conn = pool.getConnection();
+        EXPECT_EQ(conn.get(), first);
+    }
+
+    auto after = pool.getStats();
+    EXPECT_EQ(after.checkouts_, before.checkouts_ + 2);
+    EXPECT_EQ(countWaits(after), countWaits(before) + 2);
+    EXPECT_EQ(after.active_, before.active_);
+    EXPECT_GE(after.created_, after.open_);
+    EXPECT_LE(after.open_, after.max_);
+
+    // A connection returned broken is closed instead of going back to the pool
+    {
+        auto conn = pool.getConnection();
+        EXPECT_ANY_THROW(conn->execute("SELECT pg_terminate_backend(pg_backend_pid())"));
+    }
+    EXPECT_EQ(pool.getStats().closed_, after.closed_ + 1);
+
+    // Idle connections are pinged in the background
+    pool.setHealthCheckInterval(std::chrono::milliseconds(20));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    pool.setHealthCheckInterval(std::chrono::seconds(30));
+
+    auto checked = pool.getStats();
+    EXPECT_GT(checked.health_checks_, after.health_checks_);
+    EXPECT_EQ(checked.failed_health_checks_, after.failed_health_checks_);
+
+    auto conn = pool.getConnection();
+    ASSERT_NO_THROW({ conn->execute("SELECT 1"); });
+}
+
 // Test multithreaded connection pool
 TEST_F(DBTest, ConnectionPoolMultithreaded)
 {
@@ -1245,7 +1306,466 @@ TEST_F(DBTest, CandleFindByIdNonExistent)
     ASSERT_FALSE(result.has_value());
 }
 
+TEST_F(DBTest, CandleBulkCopy)
+{
+    auto conn                = ct::db::Database::getInstance().getConnection();
+    const std::string symbol = "CandleBulkCopy:BTC/USD";
+    const int64_t start      = 1625184000000;
+
+    blaze::DynamicMatrix< double > candles(1000, 6);
+    for (size_t i = 0; i < candles.rows(); ++i)
+    {
+        candles(i, 0) = start + static_cast< int64_t >(i) * 60000;
+        candles(i, 1) = 100.0 + i;
+        candles(i, 2) = 101.0 + i;
+        candles(i, 3) = 102.0 + i;
+        candles(i, 4) = 99.0 + i;
+        candles(i, 5) = 10.0;
+    }
+
+    ASSERT_EQ(ct::db::copyCandles(conn,
+                                  ct::enums::ExchangeName::BINANCE_SPOT,
+                                  symbol,
+                                  ct::timeframe::Timeframe::MINUTE_1,
+                                  candles,
+                                  ct::db::CopyConflict::FAIL),
+              1000);
+
+    // Ten stored candles with a new open price and one new candle
+    blaze::DynamicMatrix< double > overlap = blaze::submatrix(candles, 990, 0, 10, 6);
+    overlap.resize(11, 6);
+    blaze::row(overlap, 10) = blaze::row(overlap, 9);
+    overlap(10, 0) += 60000;
+    blaze::column(overlap, 1) = 1.0;
+
+    EXPECT_EQ(ct::db::copyCandles(conn,
+                                  ct::enums::ExchangeName::BINANCE_SPOT,
+                                  symbol,
+                                  ct::timeframe::Timeframe::MINUTE_1,
+                                  overlap,
+                                  ct::db::CopyConflict::IGNORE),
+              1);
+
+    auto stored = ct::db::Candle::findByFilter(conn,
+                                               ct::db::Candle::Filter()
+                                                   .withExchangeName(ct::enums::ExchangeName::BINANCE_SPOT)
+                                                   .withSymbol(symbol)
+                                                   .withTimeframe(ct::timeframe::Timeframe::MINUTE_1)
+                                                   .withTimestamp(start + 990 * 60000));
+    ASSERT_TRUE(stored.has_value());
+    ASSERT_EQ(stored->size(), 1);
+    EXPECT_DOUBLE_EQ((*stored)[0].getOpen(), 1090.0);
+    EXPECT_DOUBLE_EQ((*stored)[0].getClose(), 1091.0);
+
+    EXPECT_EQ(ct::db::copyCandles(conn,
+                                  ct::enums::ExchangeName::BINANCE_SPOT,
+                                  symbol,
+                                  ct::timeframe::Timeframe::MINUTE_1,
+                                  overlap,
+                                  ct::db::CopyConflict::UPDATE),
+              11);
+
+    stored = ct::db::Candle::findByFilter(conn,
+                                          ct::db::Candle::Filter()
+                                              .withExchangeName(ct::enums::ExchangeName::BINANCE_SPOT)
+                                              .withSymbol(symbol)
+                                              .withTimeframe(ct::timeframe::Timeframe::MINUTE_1));
+    ASSERT_TRUE(stored.has_value());
+    EXPECT_EQ(stored->size(), 1001);
+
+    // Copying straight into the table fails on duplicates and leaves the connection usable
+    EXPECT_THROW(ct::db::copyCandles(conn,
+                                     ct::enums::ExchangeName::BINANCE_SPOT,
+                                     symbol,
+                                     ct::timeframe::Timeframe::MINUTE_1,
+                                     overlap,
+                                     ct::db::CopyConflict::FAIL),
+                 std::runtime_error);
+
+    // Rows can come from any iterator range
+    std::vector< std::array< double, 6 > > rows{{static_cast< double >(start + 1001 * 60000), 1, 2, 3, 0.5, 7}};
+    EXPECT_EQ(ct::db::copyCandles(conn,
+                                  ct::enums::ExchangeName::BINANCE_SPOT,
+                                  symbol,
+                                  ct::timeframe::Timeframe::MINUTE_1,
+                                  rows.begin(),
+                                  rows.end()),
+              1);
+}
+
+TEST_F(DBTest, CandleStreamAndLoad)
+{
+    auto conn                = ct::db::Database::getInstance().getConnection();
+    const std::string symbol = "CandleStreamAndLoad:BTC/USD";
+    const int64_t start      = 1625184000000;
+
+    blaze::DynamicMatrix< double > candles(2500, 6);
+    for (size_t i = 0; i < candles.rows(); ++i)
+    {
+        candles(i, 0) = static_cast< double >(start + static_cast< int64_t >(i) * 60000);
+        candles(i, 1) = 100.0 + i;
+        candles(i, 2) = 100.5 + i;
+        candles(i, 3) = 101.0 + i;
+        candles(i, 4) = 99.0 + i;
+        candles(i, 5) = 0.1 * i;
+    }
+    ASSERT_EQ(ct::db::copyCandles(
+                  conn, ct::enums::ExchangeName::BINANCE_SPOT, symbol, ct::timeframe::Timeframe::MINUTE_1, candles),
+              2500);
+
+    auto filter = ct::db::Candle::Filter()
+                      .withExchangeName(ct::enums::ExchangeName::BINANCE_SPOT)
+                      .withSymbol(symbol)
+                      .withTimeframe(ct::timeframe::Timeframe::MINUTE_1);
+
+    std::vector< size_t > chunks;
+    std::set< int64_t > timestamps;
+    size_t streamed = ct::db::streamByFilter< ct::db::Candle >(conn,
+                                                                filter,
+                                                                [&](std::vector< ct::db::Candle >& chunk)
+                                                                {
+                                                                    chunks.push_back(chunk.size());
+                                                                    for (const auto& candle : chunk)
+                                                                    {
+                                                                        timestamps.insert(candle.getTimestamp());
+                                                                    }
+                                                                    return true;
+                                                                },
+                                                                1000);
+    EXPECT_EQ(streamed, 2500);
+    EXPECT_EQ(chunks, (std::vector< size_t >{1000, 1000, 500}));
+    EXPECT_EQ(timestamps.size(), 2500);
+
+    // Stopping early closes the cursor and leaves the connection usable
+    chunks.clear();
+    streamed = ct::db::streamByFilter< ct::db::Candle >(
+        conn,
+        filter,
+        [&](std::vector< ct::db::Candle >& chunk)
+        {
+            chunks.push_back(chunk.size());
+            return false;
+        },
+        1000);
+    EXPECT_EQ(streamed, 1000);
+    EXPECT_EQ(chunks.size(), 1);
+    EXPECT_TRUE(ct::db::Candle::findByFilter(conn, filter.withTimestamp(start)).has_value());
+
+    // A matrix sized for the range is filled in place, a smaller one grows
+    const int64_t finish = start + 1999 * 60000;
+    for (size_t rows : {2000, 10})
+    {
+        blaze::DynamicMatrix< double > loaded(rows, 6, -1.0);
+        size_t count = ct::db::loadCandles(conn,
+                                           ct::enums::ExchangeName::BINANCE_SPOT,
+                                           symbol,
+                                           ct::timeframe::Timeframe::MINUTE_1,
+                                           start + 60000,
+                                           finish,
+                                           loaded,
+                                           512);
+        ASSERT_EQ(count, 1999);
+        ASSERT_GE(loaded.rows(), count);
+        EXPECT_EQ(blaze::submatrix(loaded, 0, 0, count, 6), blaze::submatrix(candles, 1, 0, count, 6));
+    }
+}
+
+TEST_F(DBTest, CandleBinaryDecodingAgainstText)
+{
+    auto conn                = ct::db::Database::getInstance().getConnection();
+    const std::string symbol = "CandleBinaryDecodingAgainstText:BTC/USD";
+    const int64_t start      = 1625184000000;
+    const size_t count       = 50000;
+
+    blaze::DynamicMatrix< double > candles(count, 6);
+    for (size_t i = 0; i < count; ++i)
+    {
+        candles(i, 0) = static_cast< double >(start + static_cast< int64_t >(i) * 60000);
+        candles(i, 1) = 100.0 + i / 3.0;
+        candles(i, 2) = 100.5 + i / 7.0;
+        candles(i, 3) = 101.0 + i / 11.0;
+        candles(i, 4) = 99.0 + i / 13.0;
+        candles(i, 5) = 0.1 * i;
+    }
+    ASSERT_EQ(ct::db::copyCandles(
+                  conn, ct::enums::ExchangeName::BINANCE_SPOT, symbol, ct::timeframe::Timeframe::MINUTE_1, candles),
+              count);
+
+    const int64_t finish = start + static_cast< int64_t >(count - 1) * 60000;
+    auto timeRead        = [](const auto& read)
+    {
+        auto started = std::chrono::steady_clock::now();
+        read();
+        return std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - started).count();
+    };
+
+    // The current text path: models through findByFilter, then a matrix
+    blaze::DynamicMatrix< double > text(count, 6);
+    double textMs = timeRead(
+        [&]
+        {
+            auto rows = ct::db::Candle::findByFilter(conn,
+                                                     ct::db::Candle::Filter()
+                                                         .withExchangeName(ct::enums::ExchangeName::BINANCE_SPOT)
+                                                         .withSymbol(symbol)
+                                                         .withTimeframe(ct::timeframe::Timeframe::MINUTE_1)
+                                                         .withTimestampRange(start, finish)
+                                                         .withOrderBy("timestamp", ct::db::OrderBy::ASC));
+            ASSERT_EQ(rows->size(), count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& row = (*rows)[i];
+                text(i, 0)      = static_cast< double >(row.getTimestamp());
+                text(i, 1)      = row.getOpen();
+                text(i, 2)      = row.getClose();
+                text(i, 3)      = row.getHigh();
+                text(i, 4)      = row.getLow();
+                text(i, 5)      = row.getVolume();
+            }
+        });
+
+    blaze::DynamicMatrix< double > cursor(count, 6);
+    double cursorMs = timeRead(
+        [&]
+        {
+            ASSERT_EQ(ct::db::loadCandles(conn,
+                                          ct::enums::ExchangeName::BINANCE_SPOT,
+                                          symbol,
+                                          ct::timeframe::Timeframe::MINUTE_1,
+                                          start,
+                                          finish,
+                                          cursor),
+                      count);
+        });
+
+    blaze::DynamicMatrix< double > binary(count, 6);
+    double binaryMs = timeRead(
+        [&]
+        {
+            ASSERT_EQ(ct::db::loadCandlesBinary(conn,
+                                                ct::enums::ExchangeName::BINANCE_SPOT,
+                                                symbol,
+                                                ct::timeframe::Timeframe::MINUTE_1,
+                                                start,
+                                                finish,
+                                                binary),
+                      count);
+        });
+
+    // float8 text output round-trips, so both paths have to agree bit for bit
+    EXPECT_EQ(binary, candles);
+    EXPECT_EQ(cursor, candles);
+    EXPECT_EQ(text, candles);
+
+    RecordProperty("text_ms", std::to_string(textMs));
+    RecordProperty("cursor_ms", std::to_string(cursorMs));
+    RecordProperty("binary_ms", std::to_string(binaryMs));
+
+    // Trades decode their int4 counts as well
+    std::vector< std::array< double, 6 > > trades{{static_cast< double >(start), 100.25, 1.5, 0.5, 3, 2},
+                                                  {static_cast< double >(start + 1000), 100.5, 0, 2.5, 0, 7}};
+    ASSERT_EQ(ct::db::copyTrades(conn, ct::enums::ExchangeName::BINANCE_SPOT, symbol, trades.begin(), trades.end()),
+              2);
+
+    blaze::DynamicMatrix< double > loaded(0, 6);
+    ASSERT_EQ(
+        ct::db::loadTradesBinary(conn, ct::enums::ExchangeName::BINANCE_SPOT, symbol, start, start + 1000, loaded),
+        2);
+    for (size_t i = 0; i < trades.size(); ++i)
+    {
+        for (size_t j = 0; j < 6; ++j)
+        {
+            EXPECT_DOUBLE_EQ(loaded(i, j), trades[i][j]);
+        }
+    }
+}
+
+TEST_F(DBTest, CandleSaveUpsertsOnTheUniqueIndex)
+{
+    auto conn = ct::db::Database::getInstance().getConnection();
+
+    ct::db::Candle candle;
+    candle.setTimestamp(1625184000000);
+    candle.setOpen(100.0);
+    candle.setClose(101.0);
+    candle.setHigh(102.0);
+    candle.setLow(99.0);
+    candle.setVolume(10.0);
+    candle.setExchangeName(ct::enums::ExchangeName::BINANCE_SPOT);
+    candle.setSymbol("CandleSaveUpsertsOnTheUniqueIndex:BTC/USD");
+    candle.setTimeframe(ct::timeframe::Timeframe::MINUTE_1);
+    ASSERT_NO_THROW(candle.save(conn, true));
+    EXPECT_TRUE(ct::db::PreparedStatementCache::getInstance().isPrepared(*conn, "ct_upsert_candles"));
+
+    // Same key under a new id, the stored row keeps its id and takes the new prices
+    ct::db::Candle update = candle;
+    update.setId(boost::uuids::random_generator()());
+    update.setClose(105.0);
+    update.setVolume(12.5);
+    ASSERT_NO_THROW(update.save(conn, true));
+
+    auto stored = ct::db::Candle::findByFilter(conn,
+                                               ct::db::Candle::Filter()
+                                                   .withExchangeName(ct::enums::ExchangeName::BINANCE_SPOT)
+                                                   .withSymbol("CandleSaveUpsertsOnTheUniqueIndex:BTC/USD")
+                                                   .withTimeframe(ct::timeframe::Timeframe::MINUTE_1));
+    ASSERT_TRUE(stored.has_value());
+    ASSERT_EQ(stored->size(), 1);
+    EXPECT_EQ((*stored)[0].getId(), candle.getId());
+    EXPECT_DOUBLE_EQ((*stored)[0].getClose(), 105.0);
+    EXPECT_DOUBLE_EQ((*stored)[0].getVolume(), 12.5);
+
+    // Without update_on_conflict the duplicate is rejected
+    EXPECT_THROW(update.save(conn, false), std::exception);
+
+    // The reset after the failure deallocated the statement, the next upsert prepares it again
+    EXPECT_FALSE(ct::db::PreparedStatementCache::getInstance().isPrepared(*conn, "ct_upsert_candles"));
+    update.setClose(106.0);
+    ASSERT_NO_THROW(update.save(conn, true));
+    EXPECT_TRUE(ct::db::PreparedStatementCache::getInstance().isPrepared(*conn, "ct_upsert_candles"));
+}
+
+TEST_F(DBTest, FindByIdReusesThePreparedStatement)
+{
+    auto conn   = ct::db::Database::getInstance().getConnection();
+    auto& cache = ct::db::PreparedStatementCache::getInstance();
+
+    ct::db::Ticker ticker;
+    ticker.setTimestamp(1625184000000);
+    ticker.setLastPrice(35000.0);
+    ticker.setSymbol("FindByIdReusesThePreparedStatement:BTC/USD");
+    ticker.setExchangeName(ct::enums::ExchangeName::BINANCE_SPOT);
+    ASSERT_NO_THROW(ticker.save(conn));
+
+    // Prepared on the first lookup unless an earlier test already did on this connection
+    ASSERT_TRUE(ct::db::Ticker::findById(conn, ticker.getId()).has_value());
+
+    uint64_t hits   = cache.countHits();
+    uint64_t misses = cache.countMisses();
+    for (int i = 0; i < 5; ++i)
+    {
+        auto found = ct::db::Ticker::findById(conn, ticker.getId());
+        ASSERT_TRUE(found.has_value());
+        EXPECT_DOUBLE_EQ(found->getLastPrice(), 35000.0);
+    }
+    EXPECT_FALSE(ct::db::Ticker::findById(conn, boost::uuids::random_generator()()).has_value());
+    EXPECT_EQ(cache.countHits(), hits + 6);
+    EXPECT_EQ(cache.countMisses(), misses);
+
+    // A reset drops the statements, the next lookup prepares again
+    cache.invalidate(*conn);
+    conn->execute("DEALLOCATE ALL");
+    ASSERT_TRUE(ct::db::Ticker::findById(conn, ticker.getId()).has_value());
+    EXPECT_EQ(cache.countMisses(), misses + 1);
+}
+
+TEST_F(DBTest, OrderbookBulkCopy)
+{
+    const std::string symbol = "OrderbookBulkCopy:BTC/USD";
+
+    std::vector< std::pair< int64_t, std::vector< uint8_t > > > snapshots;
+    for (int64_t i = 0; i < 100; ++i)
+    {
+        snapshots.emplace_back(1625184000000 + i * 1000, std::vector< uint8_t >{0x00, 0x01, static_cast< uint8_t >(i)});
+    }
+
+    EXPECT_EQ(ct::db::copyOrderbooks(
+                  nullptr, ct::enums::ExchangeName::BINANCE_SPOT, symbol, snapshots.begin(), snapshots.end()),
+              100);
+    EXPECT_EQ(ct::db::copyOrderbooks(
+                  nullptr, ct::enums::ExchangeName::BINANCE_SPOT, symbol, snapshots.begin(), snapshots.end()),
+              0);
+
+    auto stored = ct::db::Orderbook::findByFilter(nullptr,
+                                                  ct::db::Orderbook::Filter()
+                                                      .withExchangeName(ct::enums::ExchangeName::BINANCE_SPOT)
+                                                      .withSymbol(symbol)
+                                                      .withTimestamp(1625184000000 + 42 * 1000));
+    ASSERT_TRUE(stored.has_value());
+    ASSERT_EQ(stored->size(), 1);
+    EXPECT_EQ((*stored)[0].getData(), (std::vector< uint8_t >{0x00, 0x01, 42}));
+}
+
 // Test multithreaded candle operations
+TEST_F(DBTest, WriteBehindCoalescesAndFlushes)
+{
+    auto& writeBehind        = ct::db::WriteBehind::getInstance();
+    const std::string symbol = "WriteBehindCoalescesAndFlushes:BTC/USD";
+    const int64_t start      = 1625184000000;
+
+    writeBehind.start(2, 1024, 64, std::chrono::milliseconds(10));
+    ASSERT_TRUE(writeBehind.isRunning());
+
+    // Two writes of every candle from several threads, the last one of each has to win
+    std::vector< std::thread > producers;
+    for (int p = 0; p < 4; ++p)
+    {
+        producers.emplace_back(
+            [&, p]
+            {
+                for (int i = 0; i < 50; ++i)
+                {
+                    ct::db::Candle candle(start + (p * 50 + i) * 60000,
+                                          100.0,
+                                          1.0,
+                                          102.0,
+                                          99.0,
+                                          5.0,
+                                          ct::enums::ExchangeName::BINANCE_SPOT,
+                                          symbol,
+                                          ct::timeframe::Timeframe::MINUTE_1);
+                    writeBehind.enqueue(candle);
+
+                    candle.setClose(static_cast< double >(p * 50 + i));
+                    writeBehind.enqueue(candle);
+                }
+            });
+    }
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    writeBehind.flush();
+
+    auto stats = writeBehind.getStats< ct::db::Candle >();
+    EXPECT_EQ(stats.enqueued_, 400);
+    EXPECT_EQ(stats.written_ + stats.coalesced_, 400);
+    EXPECT_EQ(stats.failed_, 0);
+    EXPECT_EQ(stats.depth_, 0);
+    EXPECT_GT(stats.max_depth_, 0);
+    EXPECT_LE(stats.max_depth_, stats.capacity_);
+
+    auto conn   = ct::db::Database::getInstance().getConnection();
+    auto stored = ct::db::Candle::findByFilter(conn,
+                                               ct::db::Candle::Filter()
+                                                   .withExchangeName(ct::enums::ExchangeName::BINANCE_SPOT)
+                                                   .withSymbol(symbol)
+                                                   .withTimeframe(ct::timeframe::Timeframe::MINUTE_1));
+    ASSERT_TRUE(stored.has_value());
+    ASSERT_EQ(stored->size(), 200);
+    for (const auto& candle : *stored)
+    {
+        EXPECT_DOUBLE_EQ(candle.getClose(), static_cast< double >((candle.getTimestamp() - start) / 60000));
+    }
+
+    // Once stopped, writes are saved on the calling thread
+    writeBehind.stop();
+    EXPECT_FALSE(writeBehind.isRunning());
+
+    ct::db::Candle late(start - 60000,
+                        1.0,
+                        1.0,
+                        1.0,
+                        1.0,
+                        1.0,
+                        ct::enums::ExchangeName::BINANCE_SPOT,
+                        symbol,
+                        ct::timeframe::Timeframe::MINUTE_1);
+    writeBehind.enqueue(late);
+    EXPECT_TRUE(ct::db::Candle::findById(conn, late.getId()).has_value());
+    EXPECT_EQ(writeBehind.getStats< ct::db::Candle >().enqueued_, 400);
+}
+
 TEST_F(DBTest, CandleMultithreadedOperations)
 {
     constexpr int numThreads = 10;
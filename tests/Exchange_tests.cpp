@@ -2,6 +2,8 @@
 #include "Enum.hpp"
 #include "Exception.hpp"
 #include "Exchange.hpp"
+#include "Order.hpp"
+#include "Position.hpp"
 #include "Route.hpp"
 
 #include <gtest/gtest.h>
@@ -368,6 +370,258 @@ TEST_F(ExchangeTest, StopAndLimitOrderTracking)
     EXPECT_THROW(exchange.onOrderSubmission(limitSell6), ct::exception::InsufficientBalance);
 }
 
+// Balances are kept in fixed-point units, reserving and releasing funds round-trips exactly
+TEST_F(ExchangeTest, FixedPointBalances)
+{
+    auto exchange = ct::exchange::SpotExchange(ct::enums::ExchangeName::BINANCE_SPOT, 10000.0, 0.001);
+    exchange.setAsset("USDT", 1000.1);
+
+    std::vector< ct::db::Order > orders;
+    for (int i = 0; i < 100; ++i)
+    {
+        orders.push_back(createTestOrder(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 0.1, 0.3));
+        exchange.onOrderSubmission(orders.back());
+    }
+    EXPECT_EQ(exchange.getAsset("USDT"), 997.1);
+
+    for (const auto& order : orders)
+    {
+        exchange.onOrderCancellation(order);
+    }
+    EXPECT_EQ(exchange.getAsset("USDT"), 1000.1);
+
+    // Fees are rounded to the asset precision
+    exchange.setAsset("BTC", 0.0);
+    auto buyOrder = createTestOrder(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 0.123456789, 100.0);
+    exchange.onOrderExecution(buyOrder);
+    EXPECT_EQ(exchange.getAsset("BTC"), 0.12333333);
+}
+
+// Margin of open orders is tracked on every order event, positions are read from PositionsState
+TEST_F(ExchangeTest, FuturesIncrementalMargin)
+{
+    auto exchange = std::make_shared< ct::exchange::FuturesExchange >(
+        ct::enums::ExchangeName::BINANCE_PERPETUAL_FUTURES, 10000.0, 0.0004, ct::enums::LeverageMode::CROSS, 2);
+
+    auto buyOrder  = createTestOrder(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 1.0, 4000.0);
+    auto sellOrder = createTestOrder(ct::enums::OrderSide::SELL, ct::enums::OrderType::LIMIT, -0.5, 6000.0);
+    exchange->onOrderSubmission(buyOrder);
+    exchange->onOrderSubmission(sellOrder);
+
+    // The larger side of the open orders is reserved
+    EXPECT_DOUBLE_EQ(exchange->getAvailableMargin(), 8000.0);
+
+    auto bigOrder = createTestOrder(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 2.0, 9000.0);
+    EXPECT_THROW(exchange->onOrderSubmission(bigOrder), ct::exception::InsufficientMargin);
+
+    auto reduceOnly = createTestOrder(ct::enums::OrderSide::BUY, ct::enums::OrderType::STOP, 2.0, 9000.0);
+    reduceOnly.setReduceOnly(true);
+    exchange->onOrderSubmission(reduceOnly);
+    EXPECT_DOUBLE_EQ(exchange->getAvailableMargin(), 8000.0);
+
+    exchange->onOrderCancellation(buyOrder);
+    EXPECT_DOUBLE_EQ(exchange->getAvailableMargin(), 8500.0);
+    EXPECT_NO_THROW(exchange->checkMarginConsistency());
+
+    // Executed orders move from open orders to the cost of the position they built
+    auto& positions = ct::position::PositionsState::getInstance();
+    positions.reset();
+
+    auto position =
+        std::make_shared< ct::position::Position >(ct::enums::ExchangeName::BINANCE_PERPETUAL_FUTURES, "BTC-USDT");
+    position->setExchange(exchange);
+    position->setQty(-0.5);
+    position->setEntryPrice(6000.0);
+    position->setCurrentPrice(6000.0);
+    positions.addPosition(position);
+
+    exchange->onOrderExecution(sellOrder);
+    EXPECT_DOUBLE_EQ(exchange->getAvailableMargin(), 8500.0);
+
+    // Unrealized profit of the short position frees margin
+    position->setCurrentPrice(5000.0);
+    EXPECT_DOUBLE_EQ(exchange->getAvailableMargin(), 9000.0);
+
+    EXPECT_NO_THROW(exchange->checkMarginConsistency());
+    positions.reset();
+}
+
+// Orders reserve on submission and release on cancellation or execution, so a round trip nets out
+TEST_F(ExchangeTest, SpotRoundTripThroughSandbox)
+{
+    const auto exchangeName = ct::enums::ExchangeName::BINANCE_SPOT;
+    auto& ordersState       = ct::order::OrdersState::getInstance();
+    auto& exchangesState    = ct::exchange::ExchangesState::getInstance();
+    ordersState.reset();
+    exchangesState.reset();
+    ct::position::PositionsState::getInstance().reset();
+
+    auto exchange = std::make_shared< ct::exchange::SpotExchange >(exchangeName, 10000.0, 0.001);
+    exchangesState.addExchange(exchange);
+    ct::exchange::Sandbox sandbox(exchangeName);
+
+    auto buy = sandbox.limitOrder("BTC-USDT", 1.0, 5000.0, ct::enums::OrderSide::BUY, false);
+    EXPECT_TRUE(buy->isSubmittedToExchange());
+    EXPECT_NEAR(exchange->getAsset("USDT"), 5000.0, 1e-8);
+
+    // Cancellation gives the reserved value back
+    auto canceled = sandbox.limitOrder("BTC-USDT", 0.5, 4000.0, ct::enums::OrderSide::BUY, false);
+    EXPECT_NEAR(exchange->getAsset("USDT"), 3000.0, 1e-8);
+    sandbox.cancelOrder("BTC-USDT", canceled->getIdAsString());
+    EXPECT_NEAR(exchange->getAsset("USDT"), 5000.0, 1e-8);
+
+    buy->execute(true);
+    EXPECT_NEAR(exchange->getAsset("BTC"), 0.999, 1e-8);
+    EXPECT_NEAR(exchange->getAsset("USDT"), 5000.0, 1e-8);
+
+    auto sell = sandbox.limitOrder("BTC-USDT", 0.999, 6000.0, ct::enums::OrderSide::SELL, false);
+    EXPECT_THROW(sandbox.limitOrder("BTC-USDT", 0.5, 6000.0, ct::enums::OrderSide::SELL, false),
+                 ct::exception::InsufficientBalance);
+    EXPECT_EQ(ordersState.countOrders(exchangeName, "BTC-USDT"), 3);
+
+    sell->execute(true);
+    EXPECT_NEAR(exchange->getAsset("BTC"), 0.0, 1e-8);
+    EXPECT_NEAR(exchange->getAsset("USDT"), 5000.0 + 0.999 * 6000.0 * 0.999, 1e-8);
+
+    // The executed sell no longer counts against the base balance, nor does it free any
+    EXPECT_THROW(sandbox.limitOrder("BTC-USDT", 0.5, 6000.0, ct::enums::OrderSide::SELL, false),
+                 ct::exception::InsufficientBalance);
+
+    // Orders that were never submitted leave the balances alone
+    auto untracked = std::make_shared< ct::db::Order >(
+        createTestOrder(ct::enums::OrderSide::SELL, ct::enums::OrderType::LIMIT, -0.5, 6000.0));
+    untracked->cancel(true);
+    EXPECT_NEAR(exchange->getAsset("USDT"), 5000.0 + 0.999 * 6000.0 * 0.999, 1e-8);
+
+    ordersState.reset();
+    exchangesState.reset();
+}
+
+// Every engine fill is settled at its own quantity and price as it arrives
+TEST_F(ExchangeTest, SandboxFillsReachTheExchangeAndPosition)
+{
+    const auto exchangeName = ct::enums::ExchangeName::BINANCE_SPOT;
+    auto& ordersState       = ct::order::OrdersState::getInstance();
+    auto& exchangesState    = ct::exchange::ExchangesState::getInstance();
+    auto& positions         = ct::position::PositionsState::getInstance();
+    ordersState.reset();
+    exchangesState.reset();
+    positions.reset();
+
+    auto exchange = std::make_shared< ct::exchange::SpotExchange >(exchangeName, 10000.0, 0.0);
+    exchangesState.addExchange(exchange);
+    auto position = std::make_shared< ct::position::Position >(exchangeName, "BTC-USDT");
+    positions.addPosition(position);
+
+    ct::exchange::Sandbox sandbox(exchangeName);
+    sandbox.enableMatching();
+
+    auto buy = sandbox.limitOrder("BTC-USDT", 2.0, 100.0, ct::enums::OrderSide::BUY, false);
+    EXPECT_NEAR(exchange->getAsset("USDT"), 9800.0, 1e-8);
+
+    sandbox.onPublicTrade("BTC-USDT", 100.0, 0.5);
+    sandbox.onPublicTrade("BTC-USDT", 99.0, 1.0);
+    EXPECT_EQ(sandbox.applyExecutionReports(), 2);
+    EXPECT_TRUE(buy->isPartiallyFilled());
+    EXPECT_NEAR(exchange->getAsset("BTC"), 1.5, 1e-8);
+    EXPECT_DOUBLE_EQ(position->getQty(), 1.5);
+    EXPECT_DOUBLE_EQ(position->getEntryPrice().value(), 100.0);
+
+    // Only the reservation of the unfilled part comes back
+    sandbox.cancelOrder("BTC-USDT", buy->getIdAsString());
+    EXPECT_NEAR(exchange->getAsset("USDT"), 9850.0, 1e-8);
+
+    // The market sell fills half against the bid at the bid's price, its remainder is canceled
+    auto bid  = sandbox.limitOrder("BTC-USDT", 0.5, 90.0, ct::enums::OrderSide::BUY, false);
+    auto sell = sandbox.marketOrder("BTC-USDT", 1.0, 95.0, ct::enums::OrderSide::SELL, false);
+    EXPECT_NEAR(exchange->getAsset("USDT"), 9805.0, 1e-8);
+
+    EXPECT_EQ(sandbox.applyExecutionReports(), 3);
+    EXPECT_TRUE(bid->isExecuted());
+    EXPECT_TRUE(sell->isCanceled());
+    EXPECT_DOUBLE_EQ(sell->getFilledQty(), -0.5);
+    EXPECT_NEAR(exchange->getAsset("USDT"), 9850.0, 1e-8);
+    EXPECT_NEAR(exchange->getAsset("BTC"), 1.5, 1e-8);
+    EXPECT_DOUBLE_EQ(position->getQty(), 1.5);
+
+    ordersState.reset();
+    exchangesState.reset();
+    positions.reset();
+}
+
+// Batches are applied as a whole or not at all
+TEST_F(ExchangeTest, SandboxBatchOrders)
+{
+    auto& state = ct::order::OrdersState::getInstance();
+    state.reset();
+
+    ct::exchange::Sandbox sandbox;
+    const auto exchangeName = ct::enums::ExchangeName::SANDBOX;
+
+    std::vector< ct::exchange::OrderSpec > specs = {
+        {"BTC-USDT", ct::enums::OrderType::LIMIT, ct::enums::OrderSide::BUY, 1.0, 90.0},
+        {"BTC-USDT", ct::enums::OrderType::STOP, ct::enums::OrderSide::SELL, 1.0, 80.0},
+        {"BTC-USDT", ct::enums::OrderType::LIMIT, ct::enums::OrderSide::SELL, 1.0, 120.0},
+    };
+
+    auto orders = sandbox.submitOrders(specs);
+    ASSERT_EQ(orders.size(), 3);
+    EXPECT_EQ(orders[1]->getOrderType(), ct::enums::OrderType::STOP);
+    EXPECT_DOUBLE_EQ(orders[1]->getQty(), -1.0);
+    EXPECT_EQ(state.countOrders(exchangeName, "BTC-USDT"), 3);
+
+    specs.push_back({"BTC-USDT", ct::enums::OrderType::LIMIT, ct::enums::OrderSide::BUY, 1.0, -5.0});
+    EXPECT_THROW(sandbox.submitOrders(specs), ct::exception::ExchangeRejectedOrder);
+    EXPECT_EQ(state.countOrders(exchangeName, "BTC-USDT"), 3);
+
+    EXPECT_THROW(sandbox.cancelOrders("BTC-USDT", {orders[0]->getIdAsString(), "unknown"}),
+                 ct::exception::ExchangeOrderNotFound);
+    EXPECT_FALSE(orders[0]->isCanceled());
+    EXPECT_EQ(state.findOrderById(exchangeName, "BTC-USDT", "unknown"), nullptr);
+
+    sandbox.cancelOrders("BTC-USDT", {orders[0]->getIdAsString(), orders[2]->getIdAsString()});
+    EXPECT_TRUE(orders[0]->isCanceled());
+    EXPECT_FALSE(orders[1]->isCanceled());
+    EXPECT_TRUE(orders[2]->isCanceled());
+
+    state.reset();
+}
+
+TEST_F(ExchangeTest, SandboxOrdersMatchInTheEngine)
+{
+    auto& ordersState = ct::order::OrdersState::getInstance();
+    ordersState.reset();
+
+    ct::exchange::Sandbox sandbox;
+    sandbox.enableMatching();
+    EXPECT_TRUE(sandbox.isMatching());
+
+    auto sell    = sandbox.limitOrder("BTC-USDT", 2, 100, ct::enums::OrderSide::SELL, false);
+    auto buy     = sandbox.marketOrder("BTC-USDT", 1, 100, ct::enums::OrderSide::BUY, false);
+    auto resting = sandbox.limitOrder("BTC-USDT", 1, 90, ct::enums::OrderSide::BUY, false);
+
+    // One fill per side, the limit order keeps resting with the remainder
+    EXPECT_EQ(sandbox.applyExecutionReports(), 2);
+    EXPECT_TRUE(buy->isExecuted());
+    EXPECT_DOUBLE_EQ(buy->getFilledQty(), 1);
+    EXPECT_TRUE(sell->isPartiallyFilled());
+    EXPECT_DOUBLE_EQ(sell->getFilledQty(), -1);
+    EXPECT_FALSE(resting->isExecuted());
+
+    // Canceling pulls the order from the book, its engine cancellation is not applied twice
+    sandbox.cancelOrder("BTC-USDT", resting->getIdAsString());
+    EXPECT_TRUE(resting->isCanceled());
+    EXPECT_EQ(sandbox.applyExecutionReports(), 0);
+
+    // Public trades fill what is left of the resting sell
+    sandbox.onPublicTrade("BTC-USDT", 100, 5);
+    EXPECT_EQ(sandbox.applyExecutionReports(), 1);
+    EXPECT_TRUE(sell->isExecuted());
+    EXPECT_DOUBLE_EQ(sell->getFilledQty(), -2);
+
+    ordersState.reset();
+}
+
 // TODO: Futures Exchange tests
 //
 class AppCurrencyTest : public ::testing::Test
@@ -0,0 +1,106 @@
+#include "FillSimulator.hpp"
+#include "Order.hpp"
+
+#include <gtest/gtest.h>
+
+class FillSimulatorTest : public ::testing::Test
+{
+   protected:
+    const ct::enums::ExchangeName exchange_ = ct::enums::ExchangeName::BINANCE_SPOT;
+    const std::string symbol_               = "BTC-USDT";
+
+    void SetUp() override { ct::order::OrdersState::getInstance().reset(); }
+    void TearDown() override { ct::order::OrdersState::getInstance().reset(); }
+
+    std::shared_ptr< ct::db::Order > addResting(ct::enums::OrderSide side, ct::enums::OrderType type, double price)
+    {
+        auto order = std::make_shared< ct::db::Order >(true);
+        order->setExchangeName(exchange_);
+        order->setSymbol(symbol_);
+        order->setOrderSide(side);
+        order->setOrderType(type);
+        order->setPrice(price);
+        ct::order::OrdersState::getInstance().addOrder(order);
+        return order;
+    }
+};
+
+TEST_F(FillSimulatorTest, PathDistance)
+{
+    ct::simulator::FillSimulator::Candle bullish{0, 100, 110, 115, 95, 10};
+    EXPECT_DOUBLE_EQ(ct::simulator::FillSimulator::getPathDistance(bullish, 100), 0);
+    EXPECT_DOUBLE_EQ(ct::simulator::FillSimulator::getPathDistance(bullish, 97), 3);
+    EXPECT_DOUBLE_EQ(ct::simulator::FillSimulator::getPathDistance(bullish, 105), 15);
+
+    ct::simulator::FillSimulator::Candle bearish{0, 100, 90, 105, 85, 10};
+    EXPECT_DOUBLE_EQ(ct::simulator::FillSimulator::getPathDistance(bearish, 103), 3);
+    EXPECT_DOUBLE_EQ(ct::simulator::FillSimulator::getPathDistance(bearish, 95), 15);
+}
+
+TEST_F(FillSimulatorTest, ExecutesInPathOrder)
+{
+    auto sellLimit = addResting(ct::enums::OrderSide::SELL, ct::enums::OrderType::LIMIT, 112);
+    auto buyLimit  = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 97);
+    auto buyStop   = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::STOP, 105);
+    auto sellStop  = addResting(ct::enums::OrderSide::SELL, ct::enums::OrderType::STOP, 99);
+    auto farLimit  = addResting(ct::enums::OrderSide::SELL, ct::enums::OrderType::LIMIT, 130);
+
+    std::shared_ptr< ct::db::Order > added;
+    std::vector< std::shared_ptr< ct::db::Order > > fills;
+    std::vector< double > closes;
+
+    ct::simulator::FillSimulator simulator(true);
+    simulator.setOnFill(
+        [&](const std::shared_ptr< ct::db::Order >& order, const ct::simulator::FillSimulator::Candle& candle)
+        {
+            fills.push_back(order);
+            closes.push_back(candle[ct::candle::_CLOSE_]);
+
+            // Orders placed on a fill are reachable by the rest of the candle
+            if (!added)
+            {
+                added = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 96);
+            }
+        });
+
+    // open -> low -> high -> close
+    ct::simulator::FillSimulator::Candle candle{0, 100, 110, 115, 95, 10};
+    EXPECT_EQ(simulator.simulate(exchange_, symbol_, candle), 5);
+
+    ASSERT_EQ(fills.size(), 5);
+    EXPECT_EQ(fills[0], sellStop);
+    EXPECT_EQ(fills[1], buyLimit);
+    EXPECT_EQ(fills[2], added);
+    EXPECT_EQ(fills[3], buyStop);
+    EXPECT_EQ(fills[4], sellLimit);
+    EXPECT_EQ(closes, (std::vector< double >{99, 97, 96, 105, 112}));
+
+    EXPECT_TRUE(sellLimit->isExecuted());
+    EXPECT_TRUE(farLimit->isActive());
+    EXPECT_EQ(ct::order::OrdersState::getInstance().getPendingOrders(exchange_, symbol_).size(), 1);
+    EXPECT_EQ(simulator.simulate(exchange_, symbol_, candle), 0);
+    EXPECT_EQ(simulator.countFills(), 5);
+}
+
+TEST_F(FillSimulatorTest, FillsUpdateThePosition)
+{
+    auto& positions = ct::position::PositionsState::getInstance();
+    positions.reset();
+
+    auto position = std::make_shared< ct::position::Position >(exchange_, symbol_);
+    position->setExchange(std::make_shared< ct::exchange::SpotExchange >(exchange_, 10000.0, 0.0));
+    positions.addPosition(position);
+
+    auto buyLimit = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 97);
+    buyLimit->setQty(2);
+
+    ct::simulator::FillSimulator simulator(true);
+    ct::simulator::FillSimulator::Candle candle{0, 100, 110, 115, 95, 10};
+    EXPECT_EQ(simulator.simulate(exchange_, symbol_, candle), 1);
+
+    // The position is opened by the order execution itself, at the fill price
+    EXPECT_DOUBLE_EQ(position->getQty(), 2);
+    EXPECT_DOUBLE_EQ(position->getEntryPrice().value(), 97);
+
+    positions.reset();
+}
@@ -2,6 +2,7 @@
 #include "Config.hpp"
 #include "Enum.hpp"
 #include "Exception.hpp"
+#include "FixedPoint.hpp"
 #include "Timeframe.hpp"
 
 #include <gtest/gtest.h>
@@ -1669,6 +1670,18 @@ TEST_F(UUIDTest, GenerateUniqueIdUniqueness)
     }
 }
 
+TEST_F(UUIDTest, GenerateFastUUIDIsVersion4)
+{
+    std::set< boost::uuids::uuid > ids;
+    const int iterations = 1000;
+    for (int i = 0; i < iterations; ++i)
+    {
+        auto id = ct::helper::generateFastUUID();
+        EXPECT_EQ(id.version(), boost::uuids::uuid::version_random_number_based);
+        EXPECT_TRUE(ids.insert(id).second); // Ensure no duplicates
+    }
+}
+
 // --- generate_short_unique_id Tests ---
 
 TEST_F(UUIDTest, GenerateShortUniqueIdLength)
@@ -5035,3 +5048,23 @@ TEST_F(CompressedResponseTest, ConsistentOutput)
 
     EXPECT_EQ(response1["data"], response2["data"]);
 }
+
+TEST(FixedScaleTest, ConvertsAndMultiplies)
+{
+    ct::helper::FixedScale scale;
+    EXPECT_EQ(scale.getFactor(), 100000000);
+    EXPECT_EQ(scale.toUnits(0.1), 10000000);
+    EXPECT_EQ(scale.toUnits(-2.999), -299900000);
+    EXPECT_EQ(scale.toDouble(scale.toUnits(0.3)), 0.3);
+
+    // Products are rounded half away from zero into the target scale
+    ct::helper::FixedScale cents(2);
+    ct::helper::FixedScale whole(0);
+    EXPECT_EQ(scale.multiply(scale.toUnits(1.5), scale, cents.toUnits(5000.25), cents), scale.toUnits(7500.375));
+    EXPECT_EQ(whole.multiply(1, whole, -150, cents), -2);
+    EXPECT_EQ(whole.multiply(5, whole, -125, cents), -6);
+
+    EXPECT_THROW(scale.toUnits(1e12), std::overflow_error);
+    EXPECT_THROW(scale.multiply(1000000000000, whole, 1000000, whole), std::overflow_error);
+    EXPECT_THROW(ct::helper::FixedScale(19), std::invalid_argument);
+}
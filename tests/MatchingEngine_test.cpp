@@ -0,0 +1,199 @@
+#include "MatchingEngine.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+ct::matching::EngineOrder makeOrder(
+    uint64_t id, ct::enums::OrderSide side, ct::enums::OrderType type, double qty, double price = 0.0)
+{
+    ct::matching::EngineOrder order;
+    order.id_    = id;
+    order.side_  = side;
+    order.type_  = type;
+    order.qty_   = qty;
+    order.price_ = price;
+    return order;
+}
+
+} // namespace
+
+TEST(MatchingBookTest, PriceTimePriorityWithPartialFills)
+{
+    using ct::enums::OrderSide;
+    using ct::enums::OrderType;
+
+    ct::matching::MatchingBook book;
+    std::vector< ct::matching::ExecutionReport > reports;
+
+    book.submit(makeOrder(1, OrderSide::SELL, OrderType::LIMIT, 1, 101), reports);
+    book.submit(makeOrder(2, OrderSide::SELL, OrderType::LIMIT, 2, 100), reports);
+    book.submit(makeOrder(3, OrderSide::SELL, OrderType::LIMIT, 1, 100), reports);
+    book.submit(makeOrder(4, OrderSide::BUY, OrderType::LIMIT, 1, 99), reports);
+    EXPECT_TRUE(reports.empty());
+    EXPECT_EQ(book.getBestAsk(), 100);
+    EXPECT_EQ(book.getBestBid(), 99);
+
+    // Takes order 2 fully, then order 3 which came later at the same price, then half of the next level
+    book.submit(makeOrder(5, OrderSide::BUY, OrderType::LIMIT, 3.5, 101), reports);
+    ASSERT_EQ(reports.size(), 6);
+    EXPECT_EQ(reports[0].order_id_, 2);
+    EXPECT_EQ(reports[1].order_id_, 5);
+    EXPECT_EQ(reports[1].counter_order_id_, 2);
+    EXPECT_DOUBLE_EQ(reports[1].remaining_qty_, 1.5);
+    EXPECT_EQ(reports[2].order_id_, 3);
+    EXPECT_EQ(reports[4].order_id_, 1);
+    EXPECT_DOUBLE_EQ(reports[4].price_, 101);
+    EXPECT_DOUBLE_EQ(reports[4].remaining_qty_, 0.5);
+    EXPECT_DOUBLE_EQ(reports[5].remaining_qty_, 0);
+    EXPECT_EQ(book.getBestAsk(), 101);
+    EXPECT_EQ(book.getLastPrice(), 101);
+
+    // A market order cancels what the book cannot fill
+    reports.clear();
+    book.submit(makeOrder(6, OrderSide::SELL, OrderType::MARKET, 3), reports);
+    ASSERT_EQ(reports.size(), 3);
+    EXPECT_EQ(reports[0].order_id_, 4);
+    EXPECT_EQ(reports[2].type_, ct::matching::ReportType::CANCEL);
+    EXPECT_DOUBLE_EQ(reports[2].remaining_qty_, 2);
+    EXPECT_FALSE(book.getBestBid().has_value());
+
+    reports.clear();
+    EXPECT_TRUE(book.cancel(1, reports));
+    EXPECT_FALSE(book.cancel(1, reports));
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_DOUBLE_EQ(reports[0].remaining_qty_, 0.5);
+    EXPECT_EQ(book.countResting(), 0);
+}
+
+TEST(MatchingBookTest, StopsAndPublicTrades)
+{
+    using ct::enums::OrderSide;
+    using ct::enums::OrderType;
+
+    ct::matching::MatchingBook book;
+    std::vector< ct::matching::ExecutionReport > reports;
+
+    book.submit(makeOrder(1, OrderSide::BUY, OrderType::LIMIT, 1, 100), reports);
+    book.submit(makeOrder(2, OrderSide::SELL, OrderType::STOP, 2, 95), reports);
+    book.submit(makeOrder(3, OrderSide::BUY, OrderType::STOP, 1, 110), reports);
+    EXPECT_TRUE(reports.empty());
+    EXPECT_EQ(book.countResting(), 3);
+
+    // The print fills the bid at its own price, then the sell stop takes the rest of the print
+    book.onPublicTrade(94, 1.5, reports);
+    ASSERT_EQ(reports.size(), 3);
+    EXPECT_EQ(reports[0].order_id_, 1);
+    EXPECT_DOUBLE_EQ(reports[0].price_, 100);
+    EXPECT_EQ(reports[0].counter_order_id_, 0);
+    EXPECT_EQ(reports[1].order_id_, 2);
+    EXPECT_DOUBLE_EQ(reports[1].price_, 94);
+    EXPECT_DOUBLE_EQ(reports[1].qty_, 1.5);
+    EXPECT_EQ(reports[2].type_, ct::matching::ReportType::CANCEL);
+    EXPECT_DOUBLE_EQ(reports[2].remaining_qty_, 0.5);
+
+    // Untriggered stops can be canceled
+    reports.clear();
+    EXPECT_TRUE(book.cancel(3, reports));
+    EXPECT_EQ(book.countResting(), 0);
+}
+
+TEST(MatchingEngineTest, ShardsSymbolsAcrossWorkers)
+{
+    ct::matching::MatchingEngine engine(2, 1024);
+
+    std::mutex mutex;
+    std::map< std::string, std::set< std::thread::id > > workers;
+    std::atomic< int > fills{0};
+    engine.setReportHandler(
+        [&](const std::string& symbol, const ct::matching::ExecutionReport& report)
+        {
+            std::lock_guard< std::mutex > lock(mutex);
+            workers[symbol].insert(std::this_thread::get_id());
+            if (report.type_ == ct::matching::ReportType::FILL)
+            {
+                ++fills;
+            }
+        });
+    engine.start();
+
+    const std::vector< std::string > symbols{"BTC-USDT", "ETH-USDT", "SOL-USDT", "XRP-USDT"};
+    for (const auto& symbol : symbols)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            engine.submit(symbol, ct::enums::OrderSide::SELL, ct::enums::OrderType::LIMIT, 1, 100 + i % 5);
+        }
+        engine.submit(symbol, ct::enums::OrderSide::BUY, ct::enums::OrderType::MARKET, 50);
+    }
+    engine.drain();
+
+    EXPECT_EQ(engine.countCommands(), symbols.size() * 101);
+    EXPECT_EQ(engine.countFills(), symbols.size() * 100);
+    EXPECT_EQ(fills.load(), symbols.size() * 100);
+    for (const auto& symbol : symbols)
+    {
+        EXPECT_EQ(workers[symbol].size(), 1);
+        ASSERT_NE(engine.getBook(symbol), nullptr);
+        EXPECT_EQ(engine.getBook(symbol)->countResting(), 50);
+        EXPECT_EQ(engine.getBook(symbol)->getBestAsk(), 102);
+    }
+
+    EXPECT_THROW(engine.submit("BTC-USDT", ct::enums::OrderSide::BUY, ct::enums::OrderType::FOK, 1, 100),
+                 std::invalid_argument);
+    EXPECT_THROW(engine.submit("BTC-USDT", ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 0, 100),
+                 std::invalid_argument);
+    engine.stop();
+}
+
+TEST(MatchingEngineTest, SustainedThroughput)
+{
+    constexpr size_t workers   = 4;
+    constexpr int producers    = 4;
+    constexpr int perProducer  = 50000;
+    constexpr int symbolsCount = 16;
+
+    ct::matching::MatchingEngine engine(workers, 1 << 16);
+    engine.start();
+
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector< std::thread > threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back(
+            [&engine, p]
+            {
+                std::mt19937 rng(p);
+                std::uniform_int_distribution< int > tick(-10, 10);
+                for (int i = 0; i < perProducer; ++i)
+                {
+                    std::string symbol = "SYM" + std::to_string((p + i) % symbolsCount);
+                    auto side          = i % 2 == 0 ? ct::enums::OrderSide::BUY : ct::enums::OrderSide::SELL;
+                    if (i % 10 == 0)
+                    {
+                        engine.submit(symbol, side, ct::enums::OrderType::MARKET, 1);
+                    }
+                    else
+                    {
+                        engine.submit(symbol, side, ct::enums::OrderType::LIMIT, 1, 1000 + tick(rng));
+                    }
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    engine.drain();
+
+    double seconds         = std::chrono::duration< double >(std::chrono::steady_clock::now() - started).count();
+    double ordersPerSecond = producers * perProducer / seconds;
+    RecordProperty("orders_per_second", std::to_string(static_cast< int64_t >(ordersPerSecond)));
+    RecordProperty("workers", std::to_string(workers));
+    RecordProperty("fills", std::to_string(engine.countFills()));
+
+    EXPECT_EQ(engine.countCommands(), producers * perProducer);
+    engine.stop();
+}
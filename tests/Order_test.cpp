@@ -0,0 +1,198 @@
+#include "Helper.hpp"
+#include "Order.hpp"
+
+#include <gtest/gtest.h>
+
+class OrdersStateTest : public ::testing::Test
+{
+   protected:
+    const ct::enums::ExchangeName exchange_ = ct::enums::ExchangeName::BINANCE_SPOT;
+    const std::string symbol_               = "BTC-USDT";
+
+    void SetUp() override { ct::order::OrdersState::getInstance().reset(); }
+    void TearDown() override { ct::order::OrdersState::getInstance().reset(); }
+
+    std::shared_ptr< ct::db::Order > addOrder(const std::string& symbol)
+    {
+        auto order = std::make_shared< ct::db::Order >(true);
+        order->setExchangeName(exchange_);
+        order->setSymbol(symbol);
+        ct::order::OrdersState::getInstance().addOrder(order);
+        return order;
+    }
+};
+
+TEST_F(OrdersStateTest, LooksUpByIdAndExchangeId)
+{
+    auto& state = ct::order::OrdersState::getInstance();
+    auto order  = addOrder(symbol_);
+    addOrder(symbol_);
+
+    EXPECT_EQ(state.getOrderById(exchange_, symbol_, order->getId()), order);
+    EXPECT_EQ(state.getOrderById(exchange_, symbol_, order->getIdAsString()), order);
+    EXPECT_EQ(state.getOrderById(exchange_, symbol_, order->getIdAsString().substr(0, 8)), order);
+
+    // Wrong pair is not a match
+    EXPECT_NE(state.getOrderById(exchange_, "ETH-USDT", order->getId()), order);
+
+    // Exchange ID assigned after the order was added
+    order->setExchangeId("12345");
+    EXPECT_EQ(state.getOrderById(exchange_, symbol_, "12345", true), order);
+
+    // Resubmission regenerates the ID
+    auto previousId = order->getId();
+    order->setStatus(ct::enums::OrderStatus::QUEUED);
+    order->resubmit();
+    EXPECT_EQ(state.getOrderById(exchange_, symbol_, order->getId()), order);
+    EXPECT_NE(state.getOrderById(exchange_, symbol_, previousId), order);
+}
+
+TEST_F(OrdersStateTest, TracksStatusChanges)
+{
+    auto& state = ct::order::OrdersState::getInstance();
+    auto first  = addOrder(symbol_);
+    auto second = addOrder(symbol_);
+    auto third  = addOrder(symbol_);
+
+    EXPECT_EQ(state.countActiveOrders(exchange_, symbol_), 3);
+
+    first->cancel(true);
+    third->setStatus(ct::enums::OrderStatus::EXECUTED);
+
+    EXPECT_EQ(state.countActiveOrders(exchange_, symbol_), 1);
+    EXPECT_EQ(state.countOrdersByStatus(exchange_, symbol_, ct::enums::OrderStatus::CANCELED), 1);
+    auto executed = state.getOrdersByStatus(exchange_, symbol_, ct::enums::OrderStatus::EXECUTED);
+    ASSERT_EQ(executed.size(), 1);
+    EXPECT_EQ(executed[0], third);
+
+    state.removeOrder(second);
+    EXPECT_EQ(state.countActiveOrders(), 0);
+    EXPECT_EQ(state.countOrders(exchange_, symbol_), 2);
+    EXPECT_NE(state.getOrderById(exchange_, symbol_, second->getId()), second);
+
+    // Removed orders are no longer tracked
+    second->setStatus(ct::enums::OrderStatus::ACTIVE);
+    EXPECT_EQ(state.countActiveOrders(), 0);
+}
+
+TEST_F(OrdersStateTest, OnlyTrackedOrdersUpdateTheIndexes)
+{
+    auto& state = ct::order::OrdersState::getInstance();
+    auto order  = addOrder(symbol_);
+    EXPECT_NE(order->getChangeListener(), nullptr);
+
+    // Copies and orders never added do not report to the state
+    ct::db::Order copy(*order);
+    EXPECT_EQ(copy.getChangeListener(), nullptr);
+    copy.cancel(true);
+    ct::db::Order detached(true);
+    detached.setExchangeName(exchange_);
+    detached.setSymbol(symbol_);
+    detached.setStatus(ct::enums::OrderStatus::EXECUTED);
+    EXPECT_EQ(state.countActiveOrders(exchange_, symbol_), 1);
+    EXPECT_EQ(state.getOrderById(exchange_, symbol_, order->getId()), order);
+
+    // Assigning into a tracked order keeps the indexes in sync
+    *order = copy;
+    EXPECT_EQ(state.countActiveOrders(exchange_, symbol_), 0);
+    EXPECT_EQ(state.countOrdersByStatus(exchange_, symbol_, ct::enums::OrderStatus::CANCELED), 1);
+
+    // Removed orders are detached
+    state.removeOrder(order);
+    EXPECT_EQ(order->getChangeListener(), nullptr);
+}
+
+TEST_F(OrdersStateTest, GettersReturnStoredOrders)
+{
+    auto& state = ct::order::OrdersState::getInstance();
+    auto buy    = addOrder(symbol_);
+    auto sell   = addOrder(symbol_);
+    buy->setOrderSide(ct::enums::OrderSide::BUY);
+    sell->setOrderSide(ct::enums::OrderSide::SELL);
+
+    const auto& orders = state.getOrders(exchange_, symbol_);
+    EXPECT_EQ(&orders, &state.getOrders(exchange_, symbol_));
+    ASSERT_EQ(orders.size(), 2);
+    EXPECT_TRUE(state.getActiveOrders(exchange_, "UNKNOWN-PAIR").empty());
+
+    // Iterating a view does not copy the shared pointers
+    auto uses = buy.use_count();
+    ct::order::OrdersView all(orders);
+    EXPECT_EQ(all.count(), 2);
+    EXPECT_EQ(buy.use_count(), uses);
+
+    ct::order::OrdersView sells(orders, ct::enums::OrderSide::BUY, false);
+    ASSERT_EQ(sells.count(), 1);
+    EXPECT_EQ(*sells.begin(), sell);
+
+    // Canceled orders are skipped by side filtered views
+    sell->cancel(true);
+    EXPECT_TRUE(sells.empty());
+    EXPECT_EQ(state.countActiveOrders(), 1);
+
+    // Clearing a pair drops its active orders as well
+    state.clearOrders(exchange_, symbol_);
+    EXPECT_EQ(state.countOrders(exchange_, symbol_), 0);
+    EXPECT_TRUE(state.getActiveOrders(exchange_, symbol_).empty());
+    EXPECT_EQ(state.countActiveOrders(), 0);
+}
+
+TEST_F(OrdersStateTest, PendingBookFollowsOrders)
+{
+    auto& state = ct::order::OrdersState::getInstance();
+
+    auto addResting = [this](ct::enums::OrderSide side, ct::enums::OrderType type, double price)
+    {
+        auto order = std::make_shared< ct::db::Order >(true);
+        order->setExchangeName(exchange_);
+        order->setSymbol(symbol_);
+        order->setOrderSide(side);
+        order->setOrderType(type);
+        order->setPrice(price);
+        ct::order::OrdersState::getInstance().addOrder(order);
+        return order;
+    };
+
+    auto buyLimit  = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::LIMIT, 95);
+    auto sellStop  = addResting(ct::enums::OrderSide::SELL, ct::enums::OrderType::STOP, 98);
+    auto sellLimit = addResting(ct::enums::OrderSide::SELL, ct::enums::OrderType::LIMIT, 105);
+    auto buyStop   = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::STOP, 102);
+    auto farLimit  = addResting(ct::enums::OrderSide::SELL, ct::enums::OrderType::LIMIT, 120);
+    addOrder(symbol_); // market order without price
+
+    const auto& book = state.getPendingOrders(exchange_, symbol_);
+    EXPECT_EQ(book.size(), 5);
+
+    // Falling side from the highest price down, then rising side from the lowest price up
+    auto triggered = book.getTriggered(90, 110);
+    ASSERT_EQ(triggered.size(), 4);
+    EXPECT_EQ(triggered[0], sellStop);
+    EXPECT_EQ(triggered[1], buyLimit);
+    EXPECT_EQ(triggered[2], buyStop);
+    EXPECT_EQ(triggered[3], sellLimit);
+
+    // Executed orders leave the book, moved orders are re-sorted
+    sellStop->setStatus(ct::enums::OrderStatus::EXECUTED);
+    farLimit->setPrice(101);
+    triggered = book.getTriggered(100, 110);
+    ASSERT_EQ(triggered.size(), 3);
+    EXPECT_EQ(triggered[0], farLimit);
+
+    state.removeOrder(buyStop);
+    EXPECT_EQ(book.size(), 3);
+
+    // Fill-or-kill orders rest like limits, stop-limit orders like stops
+    auto buyFok       = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::FOK, 97);
+    auto buyStopLimit = addResting(ct::enums::OrderSide::BUY, ct::enums::OrderType::STOP_LIMIT, 103);
+    EXPECT_EQ(book.size(), 5);
+
+    triggered.clear();
+    book.collectFalling(96, 99, triggered);
+    ASSERT_EQ(triggered.size(), 1);
+    EXPECT_EQ(triggered[0], buyFok);
+
+    triggered.clear();
+    book.collectRising(102, 104, triggered);
+    ASSERT_EQ(triggered.size(), 1);
+    EXPECT_EQ(triggered[0], buyStopLimit);
+}
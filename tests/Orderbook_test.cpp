@@ -1,4 +1,5 @@
 #include "Orderbook.hpp"
+#include "OrderbookArchive.hpp"
 
 #include <gtest/gtest.h>
 
@@ -69,3 +70,106 @@ TEST_F(OrderbooksStateTest, Stress)
         EXPECT_GE(result, 0.0);
     }
 }
+
+namespace
+{
+ct::orderbook::OrderbookSnapshot makeSnapshot(double mid, size_t depth, double step)
+{
+    auto nan = std::numeric_limits< double >::quiet_NaN();
+    ct::orderbook::OrderbookSnapshot snapshot;
+    for (size_t side = 0; side < 2; ++side)
+    {
+        for (auto& row : snapshot[side].data)
+        {
+            row.fill(nan);
+        }
+        for (size_t i = 0; i < depth; ++i)
+        {
+            double offset        = (i + 1) * step;
+            snapshot[side][0][i] = side == 0 ? mid + offset : mid - offset;
+            snapshot[side][1][i] = 0.001 * (i + 1);
+        }
+    }
+    return snapshot;
+}
+} // namespace
+
+TEST_F(OrderbooksStateTest, ArchiveRoundTrip)
+{
+    ct::orderbook::ArchivePrecision precision{0.01, 0.001};
+
+    std::vector< int64_t > timestamps;
+    std::vector< ct::orderbook::OrderbookSnapshot > snapshots;
+    for (int i = 0; i < 60; ++i)
+    {
+        timestamps.push_back(1609459200000 + i * 1000);
+        snapshots.push_back(makeSnapshot(30000.0 + i * 0.5, i % 2 == 0 ? 50 : 20, 0.5));
+    }
+
+    auto data = ct::orderbook::OrderbookArchive::encodeBatch(timestamps, snapshots, precision);
+    EXPECT_LT(data.size(), snapshots.size() * sizeof(ct::orderbook::OrderbookSnapshot) / 10);
+
+    std::vector< int64_t > decodedTimestamps;
+    std::vector< ct::orderbook::OrderbookSnapshot > decodedSnapshots;
+    ct::orderbook::OrderbookArchive::decodeBatch(data, decodedTimestamps, decodedSnapshots);
+
+    ASSERT_EQ(decodedTimestamps, timestamps);
+    ASSERT_EQ(decodedSnapshots.size(), snapshots.size());
+    for (size_t s = 0; s < snapshots.size(); ++s)
+    {
+        for (size_t side = 0; side < 2; ++side)
+        {
+            for (size_t i = 0; i < ct::lob::R_; ++i)
+            {
+                double price = snapshots[s][side][0][i];
+                if (std::isnan(price))
+                {
+                    EXPECT_TRUE(std::isnan(decodedSnapshots[s][side][0][i]));
+                    continue;
+                }
+                EXPECT_NEAR(decodedSnapshots[s][side][0][i], price, 1e-9);
+                EXPECT_NEAR(decodedSnapshots[s][side][1][i], snapshots[s][side][1][i], 1e-9);
+            }
+        }
+    }
+}
+
+TEST_F(OrderbooksStateTest, ArchiveRejectsMalformedData)
+{
+    std::vector< int64_t > timestamps;
+    std::vector< ct::orderbook::OrderbookSnapshot > snapshots;
+
+    EXPECT_THROW(ct::orderbook::OrderbookArchive::decodeBatch({1, 2, 3, 4}, timestamps, snapshots),
+                 std::runtime_error);
+
+    auto data = ct::orderbook::OrderbookArchive::encodeBatch(
+        {1000}, {makeSnapshot(100.0, 5, 0.1)}, ct::orderbook::ArchivePrecision{});
+    data.resize(data.size() - 2);
+    EXPECT_THROW(ct::orderbook::OrderbookArchive::decodeBatch(data, timestamps, snapshots), std::runtime_error);
+}
+
+TEST_F(OrderbooksStateTest, ArchiveQueueIsBounded)
+{
+    auto& archive = ct::orderbook::OrderbookArchive::getInstance();
+    archive.reset();
+    archive.setBatching(1, 2, 3);
+
+    // Nothing is written while the writer is stopped, the oldest rows make room for new ones
+    for (int i = 0; i < 5; ++i)
+    {
+        archive.add(
+            ct::enums::ExchangeName::BINANCE_SPOT, "BTC-USDT", 1609459200000 + i * 1000, makeSnapshot(100.0, 5, 0.1));
+    }
+    EXPECT_EQ(archive.countQueuedRows(), 3);
+    EXPECT_EQ(archive.countDroppedRows(), 2);
+
+    EXPECT_THROW(archive.setBatching(1, 4, 3), std::invalid_argument);
+    EXPECT_THROW(archive.setBatching(ct::orderbook::OrderbookArchive::MAX_BATCH_SIZE + 1, 2, 3),
+                 std::invalid_argument);
+
+    // The load lookback does not shrink with the batch size, older rows may span more
+    EXPECT_EQ(archive.getBatchSpan(), static_cast< int64_t >(ct::orderbook::OrderbookArchive::MAX_BATCH_SIZE) * 1000);
+
+    archive.setBatching(60, 10);
+    archive.reset();
+}
@@ -1 +1,118 @@
-// TODO:
+#include "Position.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(PositionSnapshotTest, MemoisesUntilInputsChange)
+{
+    ct::position::Position position(ct::enums::ExchangeName::BINANCE_SPOT, "BTC-USDT");
+    position.setExchange(
+        std::make_shared< ct::exchange::SpotExchange >(ct::enums::ExchangeName::BINANCE_SPOT, 10000.0, 0.0));
+
+    position.open(2, 100);
+    position.setCurrentPrice(110);
+
+    const auto& snapshot = position.getSnapshot();
+    EXPECT_EQ(snapshot.version_, position.getVersion());
+    EXPECT_EQ(snapshot.computed_, ct::position::PositionSnapshot::ALL);
+    EXPECT_DOUBLE_EQ(snapshot.value_, 220);
+    EXPECT_DOUBLE_EQ(snapshot.pnl_, 20);
+    EXPECT_DOUBLE_EQ(snapshot.total_cost_, 200);
+    EXPECT_DOUBLE_EQ(snapshot.roi_, 10);
+    EXPECT_DOUBLE_EQ(snapshot.leverage_, 1);
+
+    uint64_t version = position.getVersion();
+    EXPECT_DOUBLE_EQ(position.getPnl(), 20);
+    EXPECT_EQ(position.getVersion(), version);
+
+    position.setCurrentPrice(120);
+    EXPECT_GT(position.getVersion(), version);
+    EXPECT_DOUBLE_EQ(position.getValue(), 240);
+    EXPECT_DOUBLE_EQ(position.getPnl(), 40);
+    EXPECT_DOUBLE_EQ(position.getRoi(), 20);
+
+    position.increase(2, 140);
+    EXPECT_DOUBLE_EQ(position.getEntryPrice().value(), 120);
+    EXPECT_DOUBLE_EQ(position.getValue(), 480);
+    EXPECT_DOUBLE_EQ(position.getPnl(), 0);
+
+    position.close(120);
+    EXPECT_DOUBLE_EQ(position.getValue(), 0);
+    EXPECT_DOUBLE_EQ(position.getPnl(), 0);
+}
+
+TEST(PositionsStateTest, KeepsRunningPortfolioTotals)
+{
+    auto& state = ct::position::PositionsState::getInstance();
+    state.reset();
+
+    auto exchange =
+        std::make_shared< ct::exchange::SpotExchange >(ct::enums::ExchangeName::BINANCE_SPOT, 10000.0, 0.0);
+    auto btc = std::make_shared< ct::position::Position >(ct::enums::ExchangeName::BINANCE_SPOT, "BTC-USDT");
+    auto eth = std::make_shared< ct::position::Position >(ct::enums::ExchangeName::BINANCE_SPOT, "ETH-USDT");
+    btc->setExchange(exchange);
+    eth->setExchange(exchange);
+
+    EXPECT_EQ(state.addPosition(btc), 0);
+    EXPECT_EQ(state.addPosition(eth), 1);
+    EXPECT_EQ(state.getRouteIndex(ct::enums::ExchangeName::BINANCE_SPOT, "ETH-USDT"), 1);
+    EXPECT_EQ(state.getPosition(1), eth);
+    EXPECT_THROW(state.getRouteIndex(ct::enums::ExchangeName::BINANCE_SPOT, "XRP-USDT"), std::out_of_range);
+    EXPECT_EQ(state.countOpenPositions(), 0);
+
+    btc->open(1, 100);
+    btc->setCurrentPrice(120);
+    eth->open(2, 10);
+    eth->setCurrentPrice(9);
+
+    const auto& totals = state.getPortfolioMetrics();
+    EXPECT_EQ(state.countOpenPositions(), 2);
+    EXPECT_DOUBLE_EQ(totals.total_value_, 138);
+    EXPECT_DOUBLE_EQ(totals.total_pnl_, 18);
+    EXPECT_DOUBLE_EQ(totals.total_cost_, 120);
+
+    // The same totals are kept per exchange
+    const auto& spotTotals = state.getPortfolioMetrics(ct::enums::ExchangeName::BINANCE_SPOT);
+    EXPECT_DOUBLE_EQ(spotTotals.total_pnl_, 18);
+    EXPECT_DOUBLE_EQ(spotTotals.total_entry_value_, 120);
+    EXPECT_DOUBLE_EQ(state.getPortfolioMetrics(ct::enums::ExchangeName::BINANCE_PERPETUAL_FUTURES).total_pnl_, 0);
+
+    // Copies do not feed the totals
+    ct::position::Position copy = *btc;
+    copy.setCurrentPrice(1000);
+    EXPECT_DOUBLE_EQ(totals.total_value_, 138);
+
+    // Assigning into the stored position does
+    copy.setCurrentPrice(130);
+    *btc = copy;
+    EXPECT_DOUBLE_EQ(totals.total_value_, 148);
+    EXPECT_DOUBLE_EQ(totals.total_pnl_, 28);
+
+    copy.setCurrentPrice(120);
+    *btc = std::move(copy);
+    EXPECT_DOUBLE_EQ(totals.total_value_, 138);
+    EXPECT_DOUBLE_EQ(totals.total_pnl_, 18);
+
+    btc->reduce(0.5, 120);
+    EXPECT_DOUBLE_EQ(totals.total_value_, 78);
+    EXPECT_DOUBLE_EQ(totals.total_pnl_, 8);
+
+    btc->close(120);
+    EXPECT_EQ(state.countOpenPositions(), 1);
+    EXPECT_DOUBLE_EQ(totals.total_value_, 18);
+    EXPECT_DOUBLE_EQ(totals.total_pnl_, -2);
+
+    eth->close(9);
+    EXPECT_EQ(state.countOpenPositions(), 0);
+    EXPECT_DOUBLE_EQ(totals.total_value_, 0);
+
+    // A replaced route stops contributing
+    eth->open(1, 10);
+    auto replacement = std::make_shared< ct::position::Position >(ct::enums::ExchangeName::BINANCE_SPOT, "ETH-USDT");
+    replacement->setExchange(exchange);
+    EXPECT_EQ(state.countOpenPositions(), 1);
+    EXPECT_EQ(state.addPosition(replacement), 1);
+    EXPECT_EQ(state.countOpenPositions(), 0);
+
+    state.reset();
+    EXPECT_EQ(state.countRoutes(), 0);
+}
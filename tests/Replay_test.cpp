@@ -0,0 +1,98 @@
+#include "Orderbook.hpp"
+#include "OrderbookArchive.hpp"
+#include "Replay.hpp"
+#include "Trade.hpp"
+
+#include <gtest/gtest.h>
+
+class ReplayEngineTest : public ::testing::Test
+{
+   protected:
+    std::filesystem::path dir_;
+
+    void SetUp() override
+    {
+        dir_ = std::filesystem::temp_directory_path() / "ct_replay_test";
+        std::filesystem::create_directories(dir_);
+    }
+
+    void TearDown() override { std::filesystem::remove_all(dir_); }
+
+    static ct::orderbook::OrderbookSnapshot makeSnapshot(double mid)
+    {
+        auto nan = std::numeric_limits< double >::quiet_NaN();
+        ct::orderbook::OrderbookSnapshot snapshot;
+        for (size_t side = 0; side < 2; ++side)
+        {
+            for (auto& row : snapshot[side].data)
+            {
+                row.fill(nan);
+            }
+            snapshot[side][0][0] = side == 0 ? mid + 0.5 : mid - 0.5;
+            snapshot[side][1][0] = 1.0;
+        }
+        return snapshot;
+    }
+};
+
+TEST_F(ReplayEngineTest, MergesStreamsInTimestampOrder)
+{
+    const auto exchange = ct::enums::ExchangeName::BINANCE_SPOT;
+    const std::string symbol("BTC-USDT");
+
+    // Two batches of orderbooks at 0s, 1s, ..., 5s
+    std::vector< std::vector< uint8_t > > batches;
+    for (int b = 0; b < 2; ++b)
+    {
+        std::vector< int64_t > timestamps;
+        std::vector< ct::orderbook::OrderbookSnapshot > snapshots;
+        for (int i = 0; i < 3; ++i)
+        {
+            timestamps.push_back((b * 3 + i) * 1000);
+            snapshots.push_back(makeSnapshot(100.0 + b * 3 + i));
+        }
+        batches.push_back(
+            ct::orderbook::OrderbookArchive::encodeBatch(timestamps, snapshots, ct::orderbook::ArchivePrecision{}));
+    }
+    ct::replay::ReplayEngine::writeOrderbookFile(dir_ / "orderbooks.bin", batches);
+
+    // Raw trades at 250ms, 750ms and 1250ms: the third one closes the first one-second bucket
+    blaze::DynamicMatrix< double > trades{{250, 100.0, 1.0, 1}, {750, 102.0, 3.0, 0}, {1250, 101.0, 1.0, 1}};
+    ct::replay::ReplayEngine::writeTradeFile(dir_ / "trades.bin", trades);
+
+    ct::replay::ReplayEngine engine;
+    engine.loadOrderbookFile(dir_ / "orderbooks.bin", exchange, symbol, 1000, 4000);
+    engine.loadTradeFile(dir_ / "trades.bin", exchange, symbol);
+
+    std::vector< int64_t > seen;
+    engine.setOnEvent([&seen](const ct::replay::ReplayEvent& event) { seen.push_back(event.timestamp_); });
+
+    EXPECT_EQ(engine.run(), 7);
+    EXPECT_TRUE(std::is_sorted(seen.begin(), seen.end()));
+    EXPECT_EQ(seen.front(), 250);
+    EXPECT_EQ(seen.back(), 4000);
+
+    auto orderbooks = ct::orderbook::OrderbooksState::getInstance().getOrderbooks(exchange, symbol);
+    ASSERT_EQ(orderbooks.size(), 4);
+    EXPECT_DOUBLE_EQ(orderbooks[0][0][0][0], 101.5);
+    EXPECT_DOUBLE_EQ(orderbooks[-1][1][0][0], 103.5);
+
+    auto aggregated = ct::trade::TradesState::getInstance().getTrades(exchange, symbol);
+    ASSERT_EQ(aggregated.rows(), 1);
+    EXPECT_DOUBLE_EQ(aggregated(0, 0), 250);
+    EXPECT_DOUBLE_EQ(aggregated(0, 1), 101.5);
+    EXPECT_DOUBLE_EQ(aggregated(0, 2), 1.0);
+    EXPECT_DOUBLE_EQ(aggregated(0, 3), 3.0);
+}
+
+TEST_F(ReplayEngineTest, RejectsInvalidInput)
+{
+    ct::replay::ReplayEngine engine;
+    EXPECT_THROW(engine.setSpeed(-1.0), std::invalid_argument);
+    EXPECT_THROW(
+        engine.addTradeStream(ct::enums::ExchangeName::BINANCE_SPOT, "BTC-USDT", blaze::DynamicMatrix< double >(2, 3)),
+        std::invalid_argument);
+    EXPECT_THROW(engine.loadTradeFile(dir_ / "missing.bin", ct::enums::ExchangeName::BINANCE_SPOT, "BTC-USDT"),
+                 std::runtime_error);
+    EXPECT_EQ(engine.run(), 0);
+}
@@ -0,0 +1,197 @@
+#include "Orderbook.hpp"
+#include "Seqlock.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+// Every element of a published value carries the same sequence number, so a torn read is detectable
+ct::orderbook::PublishedOrderbook makeOrderbook(int64_t k)
+{
+    ct::orderbook::PublishedOrderbook orderbook;
+    orderbook.timestamp_ = k;
+    for (size_t i = 0; i < ct::lob::R_; ++i)
+    {
+        orderbook.asks_[0][i] = static_cast< double >(k);
+        orderbook.asks_[1][i] = static_cast< double >(k);
+        orderbook.bids_[0][i] = static_cast< double >(k);
+        orderbook.bids_[1][i] = static_cast< double >(k);
+    }
+    return orderbook;
+}
+
+bool isConsistent(const ct::orderbook::PublishedOrderbook& orderbook)
+{
+    auto k = static_cast< double >(orderbook.timestamp_);
+    for (size_t i = 0; i < ct::lob::R_; ++i)
+    {
+        if (orderbook.asks_[0][i] != k || orderbook.asks_[1][i] != k || orderbook.bids_[0][i] != k ||
+            orderbook.bids_[1][i] != k)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(SeqlockTest, SingleThreaded)
+{
+    ct::datastructure::Seqlock< ct::orderbook::PublishedOrderbook > slot(makeOrderbook(1));
+    EXPECT_EQ(slot.version(), 1);
+    EXPECT_EQ(slot.load().timestamp_, 1);
+
+    slot.store(makeOrderbook(2));
+    ct::orderbook::PublishedOrderbook out;
+    ASSERT_TRUE(slot.tryLoad(out));
+    EXPECT_EQ(out.timestamp_, 2);
+    EXPECT_TRUE(isConsistent(out));
+    EXPECT_EQ(slot.version(), 2);
+}
+
+// Stress test: one writer, several readers, no torn or out-of-order reads, with a read latency histogram
+TEST(SeqlockTest, ConcurrentReadersStress)
+{
+    constexpr int64_t WRITES = 200000;
+    constexpr size_t READERS = 4;
+    constexpr size_t BUCKETS = 24; // power-of-two nanosecond buckets
+    using Histogram          = std::array< uint64_t, BUCKETS >;
+
+    ct::datastructure::Seqlock< ct::orderbook::PublishedOrderbook > slot(makeOrderbook(0));
+    std::atomic< bool > done{false};
+    std::atomic< uint64_t > tornReads{0};
+    std::atomic< uint64_t > backwardReads{0};
+    std::vector< Histogram > histograms(READERS, Histogram{});
+
+    std::vector< std::thread > readers;
+    for (size_t r = 0; r < READERS; ++r)
+    {
+        readers.emplace_back(
+            [&, r]()
+            {
+                int64_t last    = 0;
+                auto& histogram = histograms[r];
+                while (!done.load(std::memory_order_acquire))
+                {
+                    auto start     = std::chrono::steady_clock::now();
+                    auto orderbook = slot.load();
+                    auto elapsed   = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                                       std::chrono::steady_clock::now() - start)
+                                       .count();
+
+                    size_t bucket = 0;
+                    while (bucket + 1 < BUCKETS && (int64_t{1} << (bucket + 1)) <= elapsed)
+                    {
+                        ++bucket;
+                    }
+                    ++histogram[bucket];
+
+                    if (!isConsistent(orderbook))
+                    {
+                        tornReads.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    if (orderbook.timestamp_ < last)
+                    {
+                        backwardReads.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    last = orderbook.timestamp_;
+                }
+            });
+    }
+
+    for (int64_t k = 1; k <= WRITES; ++k)
+    {
+        slot.store(makeOrderbook(k));
+    }
+    done.store(true, std::memory_order_release);
+
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    EXPECT_EQ(tornReads.load(), 0);
+    EXPECT_EQ(backwardReads.load(), 0);
+    EXPECT_EQ(slot.load().timestamp_, WRITES);
+    EXPECT_EQ(slot.version(), static_cast< uint64_t >(WRITES + 1));
+
+    Histogram total{};
+    uint64_t reads = 0;
+    for (const auto& histogram : histograms)
+    {
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            total[b] += histogram[b];
+            reads += histogram[b];
+        }
+    }
+    EXPECT_GT(reads, 0);
+
+    // One property per non-empty bucket, keyed by its upper bound in nanoseconds
+    RecordProperty("reads", std::to_string(reads));
+    RecordProperty("readers", std::to_string(READERS));
+    for (size_t b = 0; b < BUCKETS; ++b)
+    {
+        if (total[b] > 0)
+        {
+            RecordProperty("below_" + std::to_string(uint64_t{1} << (b + 1)) + "_ns", std::to_string(total[b]));
+        }
+    }
+}
+
+TEST(SeqlockTest, OrderbooksStateReadersSeeCompleteBooks)
+{
+    const auto exchange = ct::enums::ExchangeName::BINANCE_SPOT;
+    const std::string symbol("ETH-USDT");
+
+    auto& state = ct::orderbook::OrderbooksState::getInstance();
+    state.initSymbol(exchange, symbol);
+
+    std::atomic< bool > done{false};
+    std::atomic< uint64_t > tornReads{0};
+
+    std::thread reader(
+        [&]()
+        {
+            while (!done.load(std::memory_order_acquire))
+            {
+                auto snapshot = state.getSnapshot(exchange, symbol);
+                auto bestAsk  = state.getBestAsk(exchange, symbol);
+
+                // Before the first publication both sides are NaN
+                if (std::isnan(snapshot.asks_[0][0]) || std::isnan(bestAsk[0]))
+                {
+                    continue;
+                }
+
+                // Each call returns one complete book, and books are only ever published forward
+                auto k = snapshot.timestamp_ / 1000;
+                if (snapshot.asks_[0][0] != 1000.0 + k || snapshot.asks_[0][ct::lob::R_ - 1] != 1000.0 + k + 49 ||
+                    snapshot.bids_[0][ct::lob::R_ - 1] != 999.0 + k - 49 || bestAsk[0] < snapshot.asks_[0][0])
+                {
+                    tornReads.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+
+    for (int k = 0; k < 20000; ++k)
+    {
+        blaze::StaticVector< ct::lob::LimitOrderbook< ct::lob::R_, ct::lob::C_ >, 2UL, blaze::rowVector > orderbook;
+        for (size_t i = 0; i < ct::lob::R_; ++i)
+        {
+            orderbook[0][0][i] = 1000.0 + k + i;
+            orderbook[0][1][i] = 1.0;
+            orderbook[1][0][i] = 999.0 + k - i;
+            orderbook[1][1][i] = 1.0;
+        }
+        state.addFormattedOrderbook(exchange, symbol, k * 1000, orderbook);
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    EXPECT_EQ(tornReads.load(), 0);
+    EXPECT_DOUBLE_EQ(state.getBestAsk(exchange, symbol)[0], 1000.0 + 19999);
+    EXPECT_EQ(state.getSnapshot(exchange, symbol).timestamp_, 19999 * 1000);
+}
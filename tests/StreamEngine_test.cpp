@@ -0,0 +1,198 @@
+#include "EventQueue.hpp"
+#include "Order.hpp"
+#include "StreamEngine.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(MpscQueueTest, RejectsInvalidCapacity)
+{
+    EXPECT_THROW(ct::datastructure::MpscQueue< int >(0), std::invalid_argument);
+    EXPECT_THROW(ct::datastructure::MpscQueue< int >(1), std::invalid_argument);
+    EXPECT_THROW(ct::datastructure::MpscQueue< int >(12), std::invalid_argument);
+    EXPECT_NO_THROW(ct::datastructure::MpscQueue< int >(16));
+}
+
+TEST(MpscQueueTest, FifoAndFull)
+{
+    ct::datastructure::MpscQueue< int > queue(4);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_TRUE(queue.tryPush(i));
+    }
+    EXPECT_FALSE(queue.tryPush(4));
+    EXPECT_EQ(queue.size(), 4);
+
+    int value = -1;
+    for (int lap = 0; lap < 3; ++lap)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT_TRUE(queue.tryPop(value));
+            EXPECT_EQ(value, lap * 4 + i);
+            EXPECT_TRUE(queue.tryPush(lap * 4 + i + 4));
+        }
+    }
+
+    while (queue.tryPop(value))
+    {
+    }
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.tryPop(value));
+}
+
+TEST(MpscQueueTest, ConcurrentProducersKeepTheirOrder)
+{
+    constexpr int producers = 4;
+    constexpr int perThread = 20000;
+
+    ct::datastructure::MpscQueue< std::pair< int, int > > queue(256);
+
+    std::vector< std::thread > threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back(
+            [&queue, p]
+            {
+                for (int i = 0; i < perThread; ++i)
+                {
+                    while (!queue.tryPush(std::make_pair(p, i)))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+    }
+
+    std::vector< int > next(producers, 0);
+    std::pair< int, int > item;
+    int received = 0;
+    while (received < producers * perThread)
+    {
+        if (queue.tryPop(item))
+        {
+            ASSERT_EQ(item.second, next[item.first]);
+            ++next[item.first];
+            ++received;
+        }
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(StreamEngineTest, AppliesEventsOnOneThread)
+{
+    ct::stream::StreamEngine engine(64);
+
+    std::vector< std::string > applied;
+    std::set< std::thread::id > appliers;
+    engine.setHandler(ct::stream::StreamEventType::ORDER_EXECUTION,
+                      [&](const ct::stream::StreamEvent& event)
+                      {
+                          applied.push_back(event.symbol_);
+                          appliers.insert(std::this_thread::get_id());
+                      });
+    engine.setHandler(ct::stream::StreamEventType::ORDER_CANCELLATION,
+                      [](const ct::stream::StreamEvent&) { throw std::runtime_error("unknown order"); });
+
+    engine.start();
+    EXPECT_THROW(engine.setHandler(ct::stream::StreamEventType::BALANCE, nullptr), std::logic_error);
+
+    constexpr int producers = 3;
+    constexpr int perThread = 500;
+
+    std::vector< std::thread > threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back(
+            [&engine, p]
+            {
+                for (int i = 0; i < perThread; ++i)
+                {
+                    ct::stream::StreamEvent event;
+                    event.type_          = ct::stream::StreamEventType::ORDER_EXECUTION;
+                    event.exchange_name_ = ct::enums::ExchangeName::SANDBOX;
+                    event.symbol_        = std::to_string(p);
+                    engine.post(std::move(event));
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ct::stream::StreamEvent failing;
+    failing.type_          = ct::stream::StreamEventType::ORDER_CANCELLATION;
+    failing.exchange_name_ = ct::enums::ExchangeName::SANDBOX;
+    engine.post(failing);
+
+    // stop drains what is still queued
+    engine.stop();
+
+    EXPECT_EQ(applied.size(), producers * perThread);
+    ASSERT_EQ(appliers.size(), 1);
+    EXPECT_NE(*appliers.begin(), std::this_thread::get_id());
+    EXPECT_EQ(engine.countApplied(), producers * perThread);
+    EXPECT_EQ(engine.countFailed(), 1);
+    EXPECT_EQ(engine.countPending(), 0);
+
+    auto stats = engine.getLatencyStats();
+    EXPECT_EQ(stats.count_, producers * perThread + 1);
+    EXPECT_GE(stats.max_us_, stats.mean_us_);
+    EXPECT_LE(stats.p50_us_, stats.p99_us_);
+}
+
+TEST(StreamEngineTest, PostFailsWhenFullAndStopped)
+{
+    ct::stream::StreamEngine engine(2);
+    engine.setHandler(ct::stream::StreamEventType::BALANCE, [](const ct::stream::StreamEvent&) {});
+
+    ct::stream::StreamEvent event;
+    event.type_ = ct::stream::StreamEventType::BALANCE;
+    engine.post(event);
+    engine.post(event);
+    EXPECT_THROW(engine.post(event), std::runtime_error);
+    EXPECT_EQ(engine.countPending(), 2);
+
+    // Queued events are applied once the engine runs
+    engine.start();
+    engine.stop();
+    EXPECT_EQ(engine.countApplied(), 2);
+}
+
+TEST(StreamEngineTest, UnknownExchangeIdFails)
+{
+    auto& ordersState = ct::order::OrdersState::getInstance();
+    ordersState.reset();
+
+    auto order = std::make_shared< ct::db::Order >(true);
+    order->setExchangeName(ct::enums::ExchangeName::SANDBOX);
+    order->setSymbol("BTC-USDT");
+    order->setExchangeId("known");
+    ordersState.addOrder(order);
+
+    ct::stream::StreamEngine engine(8);
+
+    ct::stream::StreamEvent event;
+    event.type_          = ct::stream::StreamEventType::ORDER_EXECUTION;
+    event.exchange_name_ = ct::enums::ExchangeName::SANDBOX;
+    event.symbol_        = "BTC-USDT";
+    event.data_          = {{"exchange_id", "unknown"}};
+    engine.post(event);
+
+    engine.start();
+    engine.stop();
+
+    // No empty stand-in order is executed for the miss
+    EXPECT_EQ(engine.countApplied(), 0);
+    EXPECT_EQ(engine.countFailed(), 1);
+    EXPECT_FALSE(order->isExecuted());
+    EXPECT_EQ(ordersState.countOrders(ct::enums::ExchangeName::SANDBOX, "BTC-USDT"), 1);
+
+    ordersState.reset();
+}
@@ -0,0 +1,71 @@
+#include "Helper.hpp"
+#include "Ticker.hpp"
+
+#include <gtest/gtest.h>
+
+class TickersStateTest : public ::testing::Test
+{
+   protected:
+    const ct::enums::ExchangeName exchange_ = ct::enums::ExchangeName::BINANCE_SPOT;
+    const std::string symbol_               = "BTC-USDT";
+    ct::ticker::TickersState state_;
+
+    void SetUp() override { state_.initSymbol(exchange_, symbol_, 4); }
+
+    // Tickers stamped in the past are never throttled
+    void addTicker(double price)
+    {
+        double timestamp = static_cast< double >(ct::helper::nowToTimestamp() - 2000);
+        blaze::DynamicVector< double, blaze::rowVector > ticker{timestamp, price, price + 1, price - 1, 10.0};
+        state_.addTicker(ticker, exchange_, symbol_);
+    }
+};
+
+TEST_F(TickersStateTest, RingKeepsLatestTickers)
+{
+    EXPECT_THROW(state_.getCurrentTicker(exchange_, symbol_), std::out_of_range);
+
+    for (int i = 0; i < 6; ++i)
+    {
+        addTicker(100.0 + i);
+    }
+
+    EXPECT_EQ(state_.count(exchange_, symbol_), 4);
+    EXPECT_DOUBLE_EQ(state_.getCurrentTicker(exchange_, symbol_)[1], 105.0);
+    EXPECT_DOUBLE_EQ(state_.getPastTicker(exchange_, symbol_, 3)[1], 102.0);
+    EXPECT_THROW(state_.getPastTicker(exchange_, symbol_, 4), std::out_of_range);
+
+    auto tickers = state_.getTickers(exchange_, symbol_);
+    ASSERT_EQ(tickers.rows(), 4);
+    EXPECT_DOUBLE_EQ(tickers(0, 1), 102.0);
+    EXPECT_DOUBLE_EQ(tickers(3, 1), 105.0);
+    EXPECT_DOUBLE_EQ(tickers(3, 4), 10.0);
+}
+
+TEST_F(TickersStateTest, ThrottlesWithinOneSecond)
+{
+    double now = static_cast< double >(ct::helper::nowToTimestamp());
+    state_.addTicker(blaze::DynamicVector< double, blaze::rowVector >{now, 1.0, 1.0, 1.0, 1.0}, exchange_, symbol_);
+    state_.addTicker(blaze::DynamicVector< double, blaze::rowVector >{now, 2.0, 2.0, 2.0, 2.0}, exchange_, symbol_);
+
+    EXPECT_EQ(state_.count(exchange_, symbol_), 1);
+    EXPECT_DOUBLE_EQ(state_.getCurrentTicker(exchange_, symbol_)[1], 1.0);
+}
+
+TEST_F(TickersStateTest, StalenessTracking)
+{
+    EXPECT_EQ(state_.getLastUpdated(exchange_, symbol_), 0);
+    EXPECT_TRUE(state_.isStale(exchange_, symbol_, 5000));
+
+    addTicker(100.0);
+    int64_t lastUpdated = state_.getLastUpdated(exchange_, symbol_);
+    EXPECT_GT(lastUpdated, 0);
+
+    EXPECT_FALSE(state_.isStale(exchange_, symbol_, 5000, lastUpdated + 5000));
+    EXPECT_TRUE(state_.isStale(exchange_, symbol_, 5000, lastUpdated + 5001));
+
+    state_.initSymbol(exchange_, "ETH-USDT");
+    auto stale = state_.getStaleKeys(5000, lastUpdated + 1000);
+    ASSERT_EQ(stale.size(), 1);
+    EXPECT_EQ(stale[0], ct::helper::makeKey(exchange_, "ETH-USDT"));
+}
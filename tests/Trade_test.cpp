@@ -0,0 +1,136 @@
+#include "Trade.hpp"
+
+#include <gtest/gtest.h>
+
+class TradesStateTest : public ::testing::Test
+{
+   protected:
+    const ct::enums::ExchangeName exchange_ = ct::enums::ExchangeName::BINANCE_SPOT;
+    const std::string symbol_               = "SOL-USDT";
+
+    void SetUp() override { ct::trade::TradesState::getInstance().initSymbol(exchange_, symbol_); }
+
+    void addTrade(double timestamp, double price, double qty, double side)
+    {
+        blaze::StaticVector< double, 6UL, blaze::rowVector > trade{timestamp, price, qty, side, 0, 0};
+        ct::trade::TradesState::getInstance().addTrade(trade, exchange_, symbol_);
+    }
+};
+
+TEST_F(TradesStateTest, AggregatesOneSecondBuckets)
+{
+    addTrade(1000, 10.0, 1.0, 1);
+    addTrade(1400, 12.0, 2.0, 0);
+    addTrade(1999, 11.0, 1.0, 1);
+
+    // Nothing is emitted until a trade lands at least one second after the first trade of the bucket
+    EXPECT_EQ(ct::trade::TradesState::getInstance().getTrades(exchange_, symbol_).rows(), 0);
+
+    addTrade(2000, 20.0, 4.0, 0);
+    addTrade(3500, 30.0, 1.0, 1);
+
+    auto trades = ct::trade::TradesState::getInstance().getTrades(exchange_, symbol_);
+    ASSERT_EQ(trades.rows(), 2);
+
+    // Timestamp is the one of the first trade in the bucket
+    EXPECT_DOUBLE_EQ(trades(0, 0), 1000);
+    EXPECT_DOUBLE_EQ(trades(0, 1), (10.0 * 1.0 + 12.0 * 2.0 + 11.0 * 1.0) / 4.0);
+    EXPECT_DOUBLE_EQ(trades(0, 2), 2.0);
+    EXPECT_DOUBLE_EQ(trades(0, 3), 2.0);
+    EXPECT_DOUBLE_EQ(trades(0, 4), 2);
+    EXPECT_DOUBLE_EQ(trades(0, 5), 1);
+
+    EXPECT_DOUBLE_EQ(trades(1, 0), 2000);
+    EXPECT_DOUBLE_EQ(trades(1, 1), 20.0);
+    EXPECT_DOUBLE_EQ(trades(1, 2), 0.0);
+    EXPECT_DOUBLE_EQ(trades(1, 3), 4.0);
+    EXPECT_DOUBLE_EQ(trades(1, 4), 0);
+    EXPECT_DOUBLE_EQ(trades(1, 5), 1);
+}
+
+TEST_F(TradesStateTest, ZeroQuantityBucketThrows)
+{
+    addTrade(1000, 10.0, 0.0, 1);
+    EXPECT_THROW(addTrade(2000, 10.0, 1.0, 1), std::runtime_error);
+}
+
+TEST(TradeTapeTest, EvictsByCapacityAndRetention)
+{
+    ct::trade::TradeTape tape(5);
+    for (int i = 0; i < 8; ++i)
+    {
+        tape.append(i * 100, 10.0 + i, 1.0, i % 2);
+    }
+    ASSERT_EQ(tape.size(), 5);
+    EXPECT_EQ(tape.getTimestamp(0), 300);
+    EXPECT_EQ(tape.getTimestamp(4), 700);
+    EXPECT_THROW(tape.getPrice(5), std::out_of_range);
+
+    ct::trade::TradeTape retained(100, 250);
+    for (int i = 0; i < 10; ++i)
+    {
+        retained.append(i * 100, 1.0, 1.0, 1);
+    }
+    ASSERT_EQ(retained.size(), 3);
+    EXPECT_EQ(retained.getTimestamp(0), 700);
+
+    // A late print keeps the tape sorted
+    retained.append(50, 1.0, 1.0, 1);
+    EXPECT_EQ(retained.getTimestamp(retained.size() - 1), 900);
+}
+
+TEST(TradeTapeTest, RangeQueries)
+{
+    ct::trade::TradeTape tape(5);
+    for (int i = 0; i < 8; ++i)
+    {
+        tape.append(i * 100, 10.0 + i, 1.0, i % 2);
+    }
+
+    auto [first, last] = tape.range(400, 600);
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(last, 4);
+    EXPECT_EQ(tape.getTrades(400, 600).rows(), 3);
+    EXPECT_DOUBLE_EQ(tape.vwap(400, 600), 15.0);
+    EXPECT_TRUE(std::isnan(tape.vwap(10000, 20000)));
+
+    auto volume = tape.volume(0, 1000);
+    EXPECT_DOUBLE_EQ(volume.buy_qty_, 3.0);
+    EXPECT_DOUBLE_EQ(volume.sell_qty_, 2.0);
+    EXPECT_EQ(volume.buy_count_, 3);
+    EXPECT_EQ(volume.sell_count_, 2);
+
+    auto profile = tape.volumeProfile(0, 1000, 2.0);
+    ASSERT_EQ(profile.rows(), 3);
+    EXPECT_DOUBLE_EQ(profile(0, 0), 12.0);
+    EXPECT_DOUBLE_EQ(profile(0, 1), 1.0);
+    EXPECT_DOUBLE_EQ(profile(0, 2), 0.0);
+    EXPECT_DOUBLE_EQ(profile(2, 0), 16.0);
+    EXPECT_DOUBLE_EQ(profile(2, 1), 1.0);
+    EXPECT_DOUBLE_EQ(profile(2, 2), 1.0);
+}
+
+TEST_F(TradesStateTest, FeedsEnabledTape)
+{
+    EXPECT_THROW(ct::trade::TradesState::getInstance().getTape(exchange_, symbol_), std::runtime_error);
+
+    ct::trade::TradesState::getInstance().enableTape(exchange_, symbol_, 1000);
+    addTrade(1000, 10.0, 1.0, 1);
+    addTrade(1500, 20.0, 1.0, 0);
+
+    const auto& tape = ct::trade::TradesState::getInstance().getTape(exchange_, symbol_);
+    EXPECT_EQ(tape.size(), 2);
+    EXPECT_DOUBLE_EQ(tape.vwap(0, 2000), 15.0);
+}
+
+TEST_F(TradesStateTest, RejectedTradeIsNotTaped)
+{
+    ct::trade::TradesState::getInstance().enableTape(exchange_, symbol_, 1000);
+    addTrade(1000, 10.0, 0.0, 1);
+
+    // Closing a bucket without quantity rejects the trade that closes it
+    EXPECT_THROW(addTrade(2500, 20.0, 1.0, 0), std::runtime_error);
+
+    const auto& tape = ct::trade::TradesState::getInstance().getTape(exchange_, symbol_);
+    EXPECT_EQ(tape.size(), 1);
+}